@@ -0,0 +1,65 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== Ownership map: pointer -> (owner, block index) ใน O(1) =====
+// radix 3 ชั้นตาม address: [8 bit][8 bit][64 granule × 1KB]
+// ทุก granule เก็บ region ใหญ่ (>= 1KB) ได้ 2 ตัว (ขอบระหว่าง region สองอัน)
+// + หัว chain ของ region เล็ก (< 1KB, ทับได้ไม่เกิน 2 granule) ที่ lookup เดินต่อ
+// ใช้ร่วมกันทุกชนิด pool: static pool, extent, dpool page, arena
+//
+// lookup ไม่ใช้ lock (อ่านอย่างเดียว + เช็ค generation แล้ววนใหม่ถ้าชน unregister)
+// register/unregister ใช้ mutex, ตาราง region โตทีละ chunk ตามที่ใช้จริง
+
+#ifndef OWN_MAX_REGIONS
+#define OWN_MAX_REGIONS 65503 // id เก็บใน uint16_t, ตารางจองจริงตามจำนวนที่ลงทะเบียน
+#endif
+
+#ifndef OWN_SMALL_PER_GRANULE
+#define OWN_SMALL_PER_GRANULE 32 // region เล็กสูงสุดต่อ granule (คุมความยาว chain ตอน lookup)
+#endif
+
+#define OWN_GRANULE_SHIFT 10
+#define OWN_GRANULE_SIZE (1u << OWN_GRANULE_SHIFT)
+
+typedef enum
+{
+    OWN_KIND_NONE = 0,
+    OWN_KIND_STATIC_POOL, // memory_pool_t (lab2)
+    OWN_KIND_POOL_EXTENT, // extent ที่ต่อเพิ่มของ pool
+    OWN_KIND_DPOOL_PAGE,  // dpool_page_t (lab1)
+    OWN_KIND_ARENA,       // bump arena: ไม่มีโครงสร้าง block
+} own_kind_t;
+
+typedef struct
+{
+    void *owner;          // pool / page / arena ที่เป็นเจ้าของ
+    own_kind_t kind;
+    uint32_t block_index; // ใช้ได้เมื่อ region มี stride
+    bool exact;           // ptr ตรงกับ payload ของ block พอดี (ไม่ใช่กลาง block)
+} own_lookup_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    bool own_map_init(void);
+
+    // base..base+len = ช่วงของ block ทั้งหมด
+    // stride = ระยะห่างระหว่าง block (0 = ไม่มีโครงสร้าง block), hdr = offset ถึง payload ใน block
+    // คืน region id (>0) หรือ -1 ถ้าเต็ม/ซ้อนกัน/หน่วยความจำไม่พอ
+    int own_register(void *base, size_t len, own_kind_t kind, void *owner, size_t stride, size_t hdr);
+    void own_unregister(int id);
+
+    // คืน false ถ้า ptr ไม่อยู่ใน region ใดเลย
+    bool own_lookup(const void *ptr, own_lookup_t *out);
+
+    // ตัวเลขไว้ดูใน stats
+    size_t own_map_region_count(void);
+    size_t own_map_overhead_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
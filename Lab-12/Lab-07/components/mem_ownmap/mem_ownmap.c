@@ -0,0 +1,381 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "mem_ownmap.h"
+
+static const char *TAG = "OWNMAP";
+
+// address space 32 bit (ESP32): L1 = bit 31..24, L2 = bit 23..16, granule = bit 15..10
+#define L1_SHIFT 24
+#define L2_SHIFT 16
+#define LEAF_GRANULES (1u << (L2_SHIFT - OWN_GRANULE_SHIFT)) // 64
+#define GRANULE_MASK ((uintptr_t)OWN_GRANULE_SIZE - 1)
+
+// ตาราง region แบบ chunk โตเป็นเท่าตัว: chunk k มี 32 << k ตัว (ไม่ย้าย/ไม่คืน → lookup อ่านได้ไม่ต้อง lock)
+#define CHUNK0_SHIFT 5
+#define DIR_SIZE 11 // รวม 32 × (2^11 - 1) = 65504 id
+
+typedef struct
+{
+    uintptr_t base;
+    uintptr_t end;
+    void *owner;
+    uint32_t stride;
+    uint16_t hdr;
+    uint8_t stride_shift; // 0xFF = stride ไม่ใช่กำลังสอง → ใช้หาร
+    uint8_t kind;
+    volatile uint16_t link[2]; // region เล็ก: id ถัดไปใน chain ของ granule แรก/ที่สอง, ว่าง: link[0] = free list
+} own_region_t;
+
+typedef struct
+{
+    volatile uint16_t ids[LEAF_GRANULES][3]; // [0],[1] = region ใหญ่, [2] = หัว chain region เล็ก
+} own_leaf_t;
+
+typedef struct
+{
+    own_leaf_t *volatile leaf[256];
+} own_l2_t;
+
+static own_l2_t *volatile s_l1[256];
+static own_region_t *volatile s_dir[DIR_SIZE]; // id 0 = ว่าง
+static SemaphoreHandle_t s_lock;
+static uint32_t s_next = 1;   // id ถัดไปที่ยังไม่เคยใช้
+static uint16_t s_free;       // id ที่คืนแล้ว (ต่อกันผ่าน link[0])
+static volatile uint32_t s_gen; // เพิ่มทุกครั้งที่ region หลุดจาก map → lookup ที่คร่อมอยู่วนใหม่
+static size_t s_count;
+static size_t s_overhead;
+
+_Static_assert(OWN_MAX_REGIONS < (1u << CHUNK0_SHIFT) * ((1u << DIR_SIZE) - 1u), "region id must fit in the chunk directory");
+_Static_assert(OWN_MAX_REGIONS <= UINT16_MAX, "region id must fit in uint16_t");
+
+bool own_map_init(void)
+{
+    if (s_lock)
+        return true;
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock != NULL;
+}
+
+static inline uint32_t chunk_of(uint32_t id)
+{
+    return 31u - (uint32_t)__builtin_clz((id >> CHUNK0_SHIFT) + 1u);
+}
+
+static inline own_region_t *region_at(uint32_t id)
+{
+    uint32_t k = chunk_of(id);
+    return &s_dir[k][id - ((1u << CHUNK0_SHIFT << k) - (1u << CHUNK0_SHIFT))];
+}
+
+// ถือ s_lock อยู่
+static int region_alloc_id(void)
+{
+    if (s_free)
+    {
+        uint16_t id = s_free;
+        s_free = region_at(id)->link[0];
+        region_at(id)->link[0] = 0;
+        return id;
+    }
+    if (s_next > OWN_MAX_REGIONS)
+        return -1;
+    uint32_t k = chunk_of(s_next);
+    if (!s_dir[k])
+    {
+        size_t n = (size_t)1 << CHUNK0_SHIFT << k;
+        own_region_t *c = heap_caps_calloc(n, sizeof(own_region_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!c)
+            return -1;
+        s_overhead += n * sizeof(own_region_t);
+        __atomic_store_n(&s_dir[k], c, __ATOMIC_RELEASE);
+    }
+    return (int)s_next++;
+}
+
+// ถือ s_lock อยู่: region หลุดจาก map แล้ว → บอก lookup ที่คร่อมอยู่ก่อนล้าง/ใช้ซ้ำ
+static void region_release_id(uint16_t id)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE); // การถอดออกจาก leaf/chain ต้องเห็นก่อน gen ใหม่
+    __atomic_add_fetch(&s_gen, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); // gen ใหม่ต้องเห็นก่อนการล้าง field ด้านล่าง
+    own_region_t *r = region_at(id);
+    memset((void *)r, 0, sizeof(*r));
+    r->link[0] = s_free;
+    s_free = id;
+}
+
+static inline own_leaf_t *leaf_for(uintptr_t a)
+{
+    own_l2_t *l2 = s_l1[a >> L1_SHIFT];
+    return l2 ? l2->leaf[(a >> L2_SHIFT) & 0xFF] : NULL;
+}
+
+static own_leaf_t *leaf_for_create(uintptr_t a)
+{
+    own_l2_t *l2 = s_l1[a >> L1_SHIFT];
+    if (!l2)
+    {
+        l2 = heap_caps_calloc(1, sizeof(*l2), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!l2)
+            return NULL;
+        s_overhead += sizeof(*l2);
+        __atomic_store_n(&s_l1[a >> L1_SHIFT], l2, __ATOMIC_RELEASE);
+    }
+    own_leaf_t *lf = l2->leaf[(a >> L2_SHIFT) & 0xFF];
+    if (!lf)
+    {
+        lf = heap_caps_calloc(1, sizeof(*lf), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!lf)
+            return NULL;
+        s_overhead += sizeof(*lf);
+        __atomic_store_n(&l2->leaf[(a >> L2_SHIFT) & 0xFF], lf, __ATOMIC_RELEASE);
+    }
+    return lf;
+}
+
+static inline uint8_t granule_of(uintptr_t a)
+{
+    return (uint8_t)((a >> OWN_GRANULE_SHIFT) & (LEAF_GRANULES - 1));
+}
+
+static inline bool region_is_small(const own_region_t *r)
+{
+    return r->end - r->base < OWN_GRANULE_SIZE;
+}
+
+// link ของ region เล็กใน chain ของ granule g (g = address ต้น granule)
+static inline volatile uint16_t *chain_link(own_region_t *r, uintptr_t g)
+{
+    return &r->link[(r->base & ~GRANULE_MASK) == g ? 0 : 1];
+}
+
+// ถือ s_lock อยู่: [b,e) ไม่ทับ region ไหนใน granule g, *chain = จำนวน region เล็กใน chain
+static bool granule_fits(volatile uint16_t *slot, uintptr_t g, uintptr_t b, uintptr_t e, int *chain)
+{
+    for (int k = 0; k < 2; k++)
+    {
+        const own_region_t *o = slot[k] ? region_at(slot[k]) : NULL;
+        if (o && b < o->end && o->base < e)
+            return false;
+    }
+    int n = 0;
+    for (uint16_t id = slot[2]; id; id = *chain_link(region_at(id), g), n++)
+    {
+        const own_region_t *o = region_at(id);
+        if (b < o->end && o->base < e)
+            return false;
+    }
+    *chain = n;
+    return true;
+}
+
+// region ใหญ่: เดินทุก granule ที่ [base,end) ทับ; set=true → ใส่ id, set=false → ลบ id
+static bool mark_range(uintptr_t base, uintptr_t end, uint16_t id, bool set)
+{
+    uintptr_t g = base & ~GRANULE_MASK;
+    for (; g < end; g += OWN_GRANULE_SIZE)
+    {
+        own_leaf_t *lf = set ? leaf_for_create(g) : leaf_for(g);
+        if (!lf && set)
+            return false;
+        if (!lf)
+            continue;
+        volatile uint16_t *slot = lf->ids[granule_of(g)];
+        if (set)
+        {
+            int chain;
+            if (!granule_fits(slot, g, base, end, &chain))
+                return false; // ซ้อนกับ region เดิม
+            if (slot[0] == 0)
+                __atomic_store_n(&slot[0], id, __ATOMIC_RELEASE);
+            else if (slot[1] == 0)
+                __atomic_store_n(&slot[1], id, __ATOMIC_RELEASE);
+            else
+                return false;
+        }
+        else
+        {
+            if (slot[0] == id)
+                __atomic_store_n(&slot[0], 0, __ATOMIC_RELEASE);
+            if (slot[1] == id)
+                __atomic_store_n(&slot[1], 0, __ATOMIC_RELEASE);
+        }
+    }
+    return true;
+}
+
+// region เล็ก: ทับไม่เกิน 2 granule → ตรวจ/สร้าง leaf ให้ครบก่อน แล้วค่อยต่อหัว chain (ไม่มีทางล้มกลางทาง)
+static bool link_small(own_region_t *r, uint16_t id)
+{
+    uintptr_t g0 = r->base & ~GRANULE_MASK, g1 = (r->end - 1) & ~GRANULE_MASK;
+    volatile uint16_t *slots[2] = {NULL, NULL};
+    for (uintptr_t g = g0, k = 0; k < 2 && g <= g1; g += OWN_GRANULE_SIZE, k++)
+    {
+        own_leaf_t *lf = leaf_for_create(g);
+        int chain;
+        if (!lf)
+            return false;
+        slots[k] = lf->ids[granule_of(g)];
+        if (!granule_fits(slots[k], g, r->base, r->end, &chain) || chain >= OWN_SMALL_PER_GRANULE)
+            return false;
+    }
+    for (uintptr_t g = g0, k = 0; k < 2 && slots[k]; g += OWN_GRANULE_SIZE, k++)
+    {
+        *chain_link(r, g) = slots[k][2];
+        __atomic_store_n(&slots[k][2], id, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+// ถอดออกจาก chain (region ที่ถูกถอดยังชี้ต่อได้ จนกว่าจะถูก reset ใน region_release_id)
+static void unlink_small(own_region_t *r, uint16_t id)
+{
+    uintptr_t g0 = r->base & ~GRANULE_MASK, g1 = (r->end - 1) & ~GRANULE_MASK;
+    for (uintptr_t g = g0; g <= g1; g += OWN_GRANULE_SIZE)
+    {
+        own_leaf_t *lf = leaf_for(g);
+        if (!lf)
+            continue;
+        volatile uint16_t *pp = &lf->ids[granule_of(g)][2];
+        while (*pp && *pp != id)
+            pp = chain_link(region_at(*pp), g);
+        if (*pp == id)
+            __atomic_store_n(pp, *chain_link(r, g), __ATOMIC_RELEASE);
+    }
+}
+
+int own_register(void *base, size_t len, own_kind_t kind, void *owner, size_t stride, size_t hdr)
+{
+    if (!base || len == 0 || kind == OWN_KIND_NONE || !own_map_init())
+        return -1;
+
+    uintptr_t b = (uintptr_t)base, e = b + len;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int id = region_alloc_id();
+    if (id > 0)
+    {
+        own_region_t *r = region_at((uint32_t)id);
+        r->base = b;
+        r->end = e;
+        r->owner = owner;
+        r->stride = (uint32_t)stride;
+        r->hdr = (uint16_t)hdr;
+        r->stride_shift = 0xFF;
+        if (stride && (stride & (stride - 1)) == 0)
+            r->stride_shift = (uint8_t)__builtin_ctz((unsigned)stride);
+        r->kind = (uint8_t)kind;
+        __atomic_thread_fence(__ATOMIC_RELEASE); // region ต้องครบก่อน publish id ลง leaf
+
+        bool ok = region_is_small(r) ? link_small(r, (uint16_t)id) : mark_range(b, e, (uint16_t)id, true);
+        if (ok)
+        {
+            s_count++;
+        }
+        else
+        {
+            if (!region_is_small(r))
+                mark_range(b, e, (uint16_t)id, false);
+            region_release_id((uint16_t)id);
+            ESP_LOGW(TAG, "register %p+%u failed (overlap or no memory)", base, (unsigned)len);
+            id = -1;
+        }
+    }
+    else
+    {
+        ESP_LOGW(TAG, "region table full or no memory (%u regions)", (unsigned)s_count);
+    }
+    xSemaphoreGive(s_lock);
+    return id;
+}
+
+void own_unregister(int id)
+{
+    if (id <= 0 || !s_lock)
+        return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    own_region_t *r = ((uint32_t)id < s_next) ? region_at((uint32_t)id) : NULL;
+    if (r && r->kind != OWN_KIND_NONE)
+    {
+        if (region_is_small(r))
+            unlink_small(r, (uint16_t)id);
+        else
+            mark_range(r->base, r->end, (uint16_t)id, false);
+        region_release_id((uint16_t)id);
+        s_count--;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static const own_region_t *find_region(uintptr_t a)
+{
+    own_leaf_t *lf = leaf_for(a);
+    if (!lf)
+        return NULL;
+
+    const volatile uint16_t *slot = lf->ids[granule_of(a)];
+    for (int k = 0; k < 2; k++)
+    {
+        uint16_t id = __atomic_load_n(&slot[k], __ATOMIC_ACQUIRE);
+        const own_region_t *r = id ? region_at(id) : NULL;
+        if (r && a >= r->base && a < r->end)
+            return r;
+    }
+
+    // chain ของ region เล็ก: ยาวไม่เกิน OWN_SMALL_PER_GRANULE ถ้าไม่ชน unregister (ชนแล้ว generation จะฟ้อง)
+    uintptr_t g = a & ~GRANULE_MASK;
+    uint16_t id = __atomic_load_n(&slot[2], __ATOMIC_ACQUIRE);
+    for (int n = 0; id && n < OWN_SMALL_PER_GRANULE; n++)
+    {
+        own_region_t *r = region_at(id);
+        if (a >= r->base && a < r->end)
+            return r;
+        id = __atomic_load_n(chain_link(r, g), __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+bool own_lookup(const void *ptr, own_lookup_t *out)
+{
+    uintptr_t a = (uintptr_t)ptr;
+    for (;;)
+    {
+        uint32_t gen = __atomic_load_n(&s_gen, __ATOMIC_ACQUIRE);
+        const own_region_t *r = find_region(a);
+        if (r)
+        {
+            out->owner = r->owner;
+            out->kind = (own_kind_t)r->kind;
+            out->block_index = 0;
+            out->exact = false;
+            if (r->stride)
+            {
+                uintptr_t off = a - r->base;
+                uint32_t idx, rem;
+                if (r->stride_shift != 0xFF)
+                {
+                    idx = (uint32_t)(off >> r->stride_shift);
+                    rem = (uint32_t)(off & (r->stride - 1));
+                }
+                else
+                {
+                    idx = (uint32_t)(off / r->stride);
+                    rem = (uint32_t)(off - (uintptr_t)idx * r->stride);
+                }
+                out->block_index = idx;
+                out->exact = (rem == r->hdr);
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s_gen, __ATOMIC_RELAXED) == gen)
+            return r != NULL;
+    }
+}
+
+size_t own_map_region_count(void) { return s_count; }
+size_t own_map_overhead_bytes(void) { return s_overhead + sizeof(s_l1) + sizeof(s_dir); }
@@ -0,0 +1,67 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== TLSF (Two-Level Segregated Fit) บน region ที่ผู้เรียกจัดหาให้ =====
+// free list แยกตามขนาดสองชั้น: FL = กำลังสองของขนาด, SL = แบ่งแต่ละช่วงกำลังสองเป็น 2^SL_LOG2 ช่อง
+// หา list ที่พอดีด้วย bitmap + ffs/fls → malloc/free/realloc ใช้เวลาคงที่ ไม่ขึ้นกับจำนวน block
+// free รวม block ข้างเคียงทันที (ทั้งซ้ายและขวา) → ไม่มี fragment ที่รอ "ค่อยรวมทีหลัง"
+//
+// control + header ทั้งหมดอยู่ใน region เดียวกัน (ไม่ malloc เพิ่ม)
+// ทุก API ถือ spinlock ของ instance: critical section สั้นและมีขอบเขตแน่นอน
+
+#ifndef TLSF_SL_LOG2
+#define TLSF_SL_LOG2 4 // 16 ช่องต่อช่วงกำลังสอง (waste จากการปัดขึ้น ≤ ~6%)
+#endif
+#ifndef TLSF_FL_MAX
+#define TLSF_FL_MAX 23 // block ใหญ่สุด 2^23 = 8MB
+#endif
+
+typedef struct tlsf_control tlsf_t;
+
+typedef struct
+{
+    size_t pool_bytes;   // ขนาด payload ทั้งหมดหลังหัก control
+    size_t used_bytes;   // payload ของ block ที่ถูกจองอยู่
+    size_t peak_used;
+    size_t free_bytes;
+    size_t largest_free; // หัว list ว่างที่ใหญ่สุด (≥ 15/16 ของ block ว่างใหญ่สุดจริง, ขอได้แน่นอนลบการปัดขึ้น)
+    uint32_t free_blocks;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t fails;
+} tlsf_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // วาง control ไว้ต้น mem แล้วที่เหลือเป็น pool เดียว; NULL ถ้า bytes เล็กหรือใหญ่เกิน
+    tlsf_t *tlsf_create(void *mem, size_t bytes);
+    // ขนาด control struct (ไว้คำนวณว่าต้องจอง region เท่าไร)
+    size_t tlsf_overhead(void);
+
+    void *tlsf_malloc(tlsf_t *t, size_t size);
+    void tlsf_free(tlsf_t *t, void *ptr);
+    // ขยายในที่ถ้า block ถัดไปว่างพอ, ย่อในที่เสมอ; ไม่งั้น malloc + copy + free
+    void *tlsf_realloc(tlsf_t *t, void *ptr, size_t size);
+
+    // ptr อยู่ใน pool ของ t หรือไม่ (เช็คช่วง address อย่างเดียว)
+    bool tlsf_owns(const tlsf_t *t, const void *ptr);
+    // payload ที่ใช้ได้จริงของ block (≥ ขนาดที่ขอ)
+    size_t tlsf_block_size(const void *ptr);
+
+    // O(1): ตัวนับที่อัปเดตทุก operation + bitmap (ไม่เดิน free list)
+    void tlsf_get_stats(tlsf_t *t, tlsf_stats_t *out);
+    // เดินทุก block ตรวจ header/flag/การรวม/การอยู่ใน list ที่ถูก — O(n), ใช้ตอน debug
+    bool tlsf_check(tlsf_t *t);
+    // แบบ incremental: ตรวจต่อจากที่ค้างไว้ไม่เกิน max_blocks block ต่อการถือ lock, เช็คแต่ละ block แบบ O(1)
+    // (link สองทางของ free list แทนการเดินหา) → ช่วงปิด interrupt มีขอบเขตแน่นอนไม่ขึ้นกับขนาด pool
+    // true = จบรอบ (ครบหรือเจอจุดเสีย), *ok = false ถ้าเสีย; cursor อยู่ใน instance → หลายผู้เรียกเดินรอบเดียวกัน
+    bool tlsf_check_step(tlsf_t *t, uint32_t max_blocks, bool *ok);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,604 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "tlsf.h"
+
+// ===== ค่าคงที่ของการแบ่งขนาด =====
+// align = ขนาด word (4 บน ESP32) เท่ากับที่ heap_caps_malloc ให้
+#define ALIGN_SIZE sizeof(size_t)
+#define ALIGN_LOG2 ((sizeof(size_t) == 8) ? 3 : 2)
+#define SL_COUNT (1u << TLSF_SL_LOG2)
+#define FL_SHIFT (TLSF_SL_LOG2 + ALIGN_LOG2)
+#define FL_COUNT (TLSF_FL_MAX - FL_SHIFT + 1)
+#define SMALL_BLOCK ((size_t)1 << FL_SHIFT) // ต่ำกว่านี้ใช้ FL=0 แบ่งเชิงเส้น
+
+_Static_assert(SL_COUNT <= 32, "sl bitmap is 32 bits");
+_Static_assert(TLSF_FL_MAX < 32, "fl bitmap is 32 bits");
+
+// ===== Block header =====
+// prev_phys อยู่ใน word สุดท้ายของ payload ของ block ก่อนหน้า (ใช้ได้เฉพาะตอน block ก่อนหน้าว่าง)
+// → block ที่ถูกจองเสีย overhead แค่ size ตัวเดียว
+// size: บิต 0 = block นี้ว่าง, บิต 1 = block ก่อนหน้าว่าง
+// next_free/prev_free อยู่ใน payload (มีความหมายเฉพาะ block ว่าง)
+typedef struct tlsf_block
+{
+    struct tlsf_block *prev_phys;
+    size_t size;
+    struct tlsf_block *next_free;
+    struct tlsf_block *prev_free;
+} block_t;
+
+#define BIT_FREE ((size_t)1)
+#define BIT_PREV_FREE ((size_t)2)
+#define HDR_OVERHEAD sizeof(size_t)
+#define PAYLOAD_OFFSET (offsetof(block_t, size) + sizeof(size_t))
+#define BLOCK_SIZE_MIN (sizeof(block_t) - sizeof(block_t *))
+#define BLOCK_SIZE_MAX ((size_t)1 << TLSF_FL_MAX)
+
+struct tlsf_control
+{
+    block_t null_block; // sentinel ท้ายทุก free list (ไม่ต้องเช็ค NULL ตอน unlink)
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[FL_COUNT];
+    block_t *blocks[FL_COUNT][SL_COUNT];
+    portMUX_TYPE lock;
+    uint8_t *pool_start; // payload แรก
+    uint8_t *pool_end;   // sentinel block สุดท้าย
+    size_t pool_bytes;
+    size_t used_bytes;
+    size_t peak_used;
+    size_t free_bytes;    // ผลรวม payload ใน free list (อัปเดตตอน insert/remove → stats ไม่ต้องเดิน list)
+    uint32_t free_blocks;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t fails;
+    // tlsf_check_step: block ถัดไปที่จะตรวจ (NULL = เริ่มรอบใหม่) — block_absorb เลื่อนให้ถ้า block นี้ถูกรวม
+    block_t *check_pos;
+    uint32_t mutations; // นับการเปลี่ยน free list → รู้ว่ารอบตรวจที่ค้างอยู่ยังเป็น snapshot เดียวกันไหม
+    uint32_t check_mut;
+    uint32_t check_free;
+    size_t check_free_bytes;
+};
+
+// ===== bit ops =====
+static inline int tlsf_ffs(uint32_t w) { return __builtin_ctz(w); } // w ≠ 0
+static inline int tlsf_fls(size_t s) { return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)s); }
+
+static inline size_t align_up(size_t x, size_t a) { return (x + (a - 1)) & ~(a - 1); }
+static inline size_t align_down(size_t x, size_t a) { return x - (x & (a - 1)); }
+
+// ===== block helpers =====
+static inline size_t block_size(const block_t *b) { return b->size & ~(BIT_FREE | BIT_PREV_FREE); }
+static inline void block_set_size(block_t *b, size_t s) { b->size = s | (b->size & (BIT_FREE | BIT_PREV_FREE)); }
+static inline bool block_is_last(const block_t *b) { return block_size(b) == 0; }
+static inline bool block_is_free(const block_t *b) { return (b->size & BIT_FREE) != 0; }
+static inline void block_set_free(block_t *b) { b->size |= BIT_FREE; }
+static inline void block_set_used(block_t *b) { b->size &= ~BIT_FREE; }
+static inline bool block_is_prev_free(const block_t *b) { return (b->size & BIT_PREV_FREE) != 0; }
+static inline void block_set_prev_free(block_t *b) { b->size |= BIT_PREV_FREE; }
+static inline void block_set_prev_used(block_t *b) { b->size &= ~BIT_PREV_FREE; }
+
+static inline block_t *block_from_ptr(const void *p) { return (block_t *)((uint8_t *)p - PAYLOAD_OFFSET); }
+static inline void *block_to_ptr(const block_t *b) { return (uint8_t *)b + PAYLOAD_OFFSET; }
+static inline block_t *offset_to_block(const void *p, ptrdiff_t off) { return (block_t *)((uint8_t *)p + off); }
+
+static inline block_t *block_next(const block_t *b)
+{
+    return offset_to_block(block_to_ptr(b), (ptrdiff_t)(block_size(b) - HDR_OVERHEAD));
+}
+
+static inline block_t *block_link_next(block_t *b)
+{
+    block_t *next = block_next(b);
+    next->prev_phys = b;
+    return next;
+}
+
+static inline void block_mark_as_free(block_t *b)
+{
+    block_t *next = block_link_next(b);
+    block_set_prev_free(next);
+    block_set_free(b);
+}
+
+static inline void block_mark_as_used(block_t *b)
+{
+    block_set_prev_used(block_next(b));
+    block_set_used(b);
+}
+
+// ===== mapping ขนาด → (fl, sl) =====
+static inline void mapping_insert(size_t size, int *fl, int *sl)
+{
+    if (size < SMALL_BLOCK)
+    {
+        *fl = 0;
+        *sl = (int)(size / (SMALL_BLOCK / SL_COUNT));
+    }
+    else
+    {
+        int f = tlsf_fls(size);
+        *sl = (int)(size >> (f - TLSF_SL_LOG2)) ^ (int)SL_COUNT;
+        *fl = f - (FL_SHIFT - 1);
+    }
+}
+
+// ปัดขึ้นไปช่องถัดไป → block แรกของ list ที่เจอใหญ่พอเสมอ (good fit ไม่ต้องเดิน list)
+static inline void mapping_search(size_t size, int *fl, int *sl)
+{
+    if (size >= SMALL_BLOCK)
+        size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+static block_t *search_suitable_block(tlsf_t *t, int *fl, int *sl)
+{
+    uint32_t sl_map = t->sl_bitmap[*fl] & (~0u << *sl);
+    if (!sl_map)
+    {
+        uint32_t fl_map = (*fl + 1 < 32) ? (t->fl_bitmap & (~0u << (*fl + 1))) : 0;
+        if (!fl_map)
+            return NULL;
+        *fl = tlsf_ffs(fl_map);
+        sl_map = t->sl_bitmap[*fl];
+    }
+    *sl = tlsf_ffs(sl_map);
+    return t->blocks[*fl][*sl];
+}
+
+// ===== free list =====
+static void remove_free_block(tlsf_t *t, block_t *b, int fl, int sl)
+{
+    block_t *prev = b->prev_free;
+    block_t *next = b->next_free;
+    next->prev_free = prev;
+    prev->next_free = next;
+    t->free_bytes -= block_size(b);
+    t->free_blocks--;
+    t->mutations++;
+    if (t->blocks[fl][sl] == b)
+    {
+        t->blocks[fl][sl] = next;
+        if (next == &t->null_block)
+        {
+            t->sl_bitmap[fl] &= ~(1u << sl);
+            if (!t->sl_bitmap[fl])
+                t->fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+static void insert_free_block(tlsf_t *t, block_t *b, int fl, int sl)
+{
+    block_t *cur = t->blocks[fl][sl];
+    b->next_free = cur;
+    b->prev_free = &t->null_block;
+    cur->prev_free = b;
+    t->blocks[fl][sl] = b;
+    t->free_bytes += block_size(b);
+    t->free_blocks++;
+    t->mutations++;
+    t->fl_bitmap |= 1u << fl;
+    t->sl_bitmap[fl] |= 1u << sl;
+}
+
+static inline void block_remove(tlsf_t *t, block_t *b)
+{
+    int fl, sl;
+    mapping_insert(block_size(b), &fl, &sl);
+    remove_free_block(t, b, fl, sl);
+}
+
+static inline void block_insert(tlsf_t *t, block_t *b)
+{
+    int fl, sl;
+    mapping_insert(block_size(b), &fl, &sl);
+    insert_free_block(t, b, fl, sl);
+}
+
+// ===== split / merge =====
+static inline bool block_can_split(const block_t *b, size_t size) { return block_size(b) >= sizeof(block_t) + size; }
+
+// ตัด b ให้เหลือ size แล้วคืนส่วนที่เหลือ (mark ว่างแล้ว แต่ยังไม่เข้า list)
+static block_t *block_split(block_t *b, size_t size)
+{
+    block_t *rest = offset_to_block(block_to_ptr(b), (ptrdiff_t)(size - HDR_OVERHEAD));
+    size_t rest_size = block_size(b) - (size + HDR_OVERHEAD);
+    rest->size = 0;
+    block_set_size(rest, rest_size);
+    block_set_size(b, size);
+    block_mark_as_free(rest);
+    return rest;
+}
+
+static block_t *block_absorb(tlsf_t *t, block_t *prev, block_t *b)
+{
+    if (t->check_pos == b)
+        t->check_pos = prev; // b ไม่ใช่ขอบ block แล้ว → ตรวจต่อจาก prev (ซ้ำได้ ข้ามไม่ได้)
+    prev->size += block_size(b) + HDR_OVERHEAD;
+    block_link_next(prev);
+    return prev;
+}
+
+static block_t *block_merge_prev(tlsf_t *t, block_t *b)
+{
+    if (block_is_prev_free(b))
+    {
+        block_t *prev = b->prev_phys;
+        block_remove(t, prev);
+        b = block_absorb(t, prev, b);
+    }
+    return b;
+}
+
+static block_t *block_merge_next(tlsf_t *t, block_t *b)
+{
+    block_t *next = block_next(b);
+    if (block_is_free(next))
+    {
+        block_remove(t, next);
+        b = block_absorb(t, b, next);
+    }
+    return b;
+}
+
+static void block_trim_free(tlsf_t *t, block_t *b, size_t size)
+{
+    if (block_can_split(b, size))
+    {
+        block_t *rest = block_split(b, size);
+        block_link_next(b);
+        block_set_prev_free(rest);
+        block_insert(t, rest);
+    }
+}
+
+static void block_trim_used(tlsf_t *t, block_t *b, size_t size)
+{
+    if (block_can_split(b, size))
+    {
+        block_t *rest = block_split(b, size);
+        block_set_prev_used(rest);
+        rest = block_merge_next(t, rest);
+        block_insert(t, rest);
+    }
+}
+
+static size_t adjust_request_size(size_t size)
+{
+    if (size == 0 || size >= BLOCK_SIZE_MAX)
+        return 0;
+    size_t a = align_up(size, ALIGN_SIZE);
+    return a < BLOCK_SIZE_MIN ? BLOCK_SIZE_MIN : a;
+}
+
+static block_t *block_locate_free(tlsf_t *t, size_t size)
+{
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= FL_COUNT)
+        return NULL;
+    block_t *b = search_suitable_block(t, &fl, &sl);
+    if (b)
+        remove_free_block(t, b, fl, sl);
+    return b;
+}
+
+static void note_used(tlsf_t *t, ptrdiff_t delta)
+{
+    t->used_bytes += (size_t)delta;
+    if (t->used_bytes > t->peak_used)
+        t->peak_used = t->used_bytes;
+}
+
+// ===== เวอร์ชันที่ถือ lock อยู่แล้ว =====
+static void *malloc_locked(tlsf_t *t, size_t size)
+{
+    size_t adj = adjust_request_size(size);
+    block_t *b = adj ? block_locate_free(t, adj) : NULL;
+    if (!b)
+    {
+        t->fails++;
+        return NULL;
+    }
+    block_trim_free(t, b, adj);
+    block_mark_as_used(b);
+    note_used(t, (ptrdiff_t)block_size(b));
+    t->allocs++;
+    return block_to_ptr(b);
+}
+
+static void free_locked(tlsf_t *t, void *ptr)
+{
+    block_t *b = block_from_ptr(ptr);
+    t->used_bytes -= block_size(b);
+    t->frees++;
+    block_mark_as_free(b);
+    b = block_merge_prev(t, b);
+    b = block_merge_next(t, b);
+    block_insert(t, b);
+}
+
+// ===== API =====
+size_t tlsf_overhead(void) { return align_up(sizeof(tlsf_t), ALIGN_SIZE) + 2 * HDR_OVERHEAD; }
+
+tlsf_t *tlsf_create(void *mem, size_t bytes)
+{
+    uint8_t *base = (uint8_t *)align_up((uintptr_t)mem, ALIGN_SIZE);
+    size_t lead = (size_t)(base - (uint8_t *)mem);
+    size_t ctl = align_up(sizeof(tlsf_t), ALIGN_SIZE);
+    if (!mem || bytes < lead + tlsf_overhead() + BLOCK_SIZE_MIN)
+        return NULL;
+
+    // pool = ส่วนหลัง control; หัก header ของ block แรกกับ sentinel ท้าย
+    size_t pool_bytes = align_down(bytes - lead - ctl - 2 * HDR_OVERHEAD, ALIGN_SIZE);
+    if (pool_bytes < BLOCK_SIZE_MIN || pool_bytes >= BLOCK_SIZE_MAX)
+        return NULL;
+
+    tlsf_t *t = (tlsf_t *)base;
+    memset(t, 0, sizeof(*t));
+    t->null_block.next_free = &t->null_block;
+    t->null_block.prev_free = &t->null_block;
+    for (int i = 0; i < FL_COUNT; i++)
+        for (int j = 0; j < (int)SL_COUNT; j++)
+            t->blocks[i][j] = &t->null_block;
+    portMUX_INITIALIZE(&t->lock);
+
+    // prev_phys ของ block แรกทับท้าย control ได้ เพราะไม่มีใครอ่าน (block แรกไม่มี prev ว่าง)
+    uint8_t *pool = base + ctl;
+    block_t *b = offset_to_block(pool, -(ptrdiff_t)HDR_OVERHEAD);
+    b->size = pool_bytes;
+    block_set_free(b);
+    block_set_prev_used(b);
+    block_insert(t, b);
+
+    block_t *last = block_link_next(b);
+    last->size = 0;
+    block_set_used(last);
+    block_set_prev_free(last);
+
+    t->pool_start = (uint8_t *)block_to_ptr(b);
+    t->pool_end = (uint8_t *)last;
+    t->pool_bytes = pool_bytes;
+    return t;
+}
+
+void *tlsf_malloc(tlsf_t *t, size_t size)
+{
+    taskENTER_CRITICAL(&t->lock);
+    void *p = malloc_locked(t, size);
+    taskEXIT_CRITICAL(&t->lock);
+    return p;
+}
+
+void tlsf_free(tlsf_t *t, void *ptr)
+{
+    if (!ptr)
+        return;
+    taskENTER_CRITICAL(&t->lock);
+    free_locked(t, ptr);
+    taskEXIT_CRITICAL(&t->lock);
+}
+
+void *tlsf_realloc(tlsf_t *t, void *ptr, size_t size)
+{
+    if (ptr && size == 0)
+    {
+        tlsf_free(t, ptr);
+        return NULL;
+    }
+    if (!ptr)
+        return tlsf_malloc(t, size);
+
+    block_t *b = block_from_ptr(ptr);
+    size_t adj = adjust_request_size(size);
+    if (!adj)
+        return NULL;
+
+    taskENTER_CRITICAL(&t->lock);
+    size_t cur = block_size(b);
+    block_t *next = block_next(b);
+    size_t combined = cur + block_size(next) + HDR_OVERHEAD;
+    bool in_place = adj <= cur || (block_is_free(next) && adj <= combined);
+    if (in_place)
+    {
+        if (adj > cur)
+        {
+            block_merge_next(t, b);
+            block_mark_as_used(b);
+        }
+        block_trim_used(t, b, adj);
+        note_used(t, (ptrdiff_t)block_size(b) - (ptrdiff_t)cur);
+    }
+    taskEXIT_CRITICAL(&t->lock);
+    if (in_place)
+        return ptr;
+
+    // ย้าย: copy นอก critical section (memcpy ยาวไม่ควรปิด interrupt)
+    void *p = tlsf_malloc(t, size);
+    if (p)
+    {
+        memcpy(p, ptr, cur < size ? cur : size);
+        tlsf_free(t, ptr);
+    }
+    return p;
+}
+
+bool tlsf_owns(const tlsf_t *t, const void *ptr)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    return t && p >= t->pool_start && p < t->pool_end;
+}
+
+size_t tlsf_block_size(const void *ptr) { return ptr ? block_size(block_from_ptr(ptr)) : 0; }
+
+void tlsf_get_stats(tlsf_t *t, tlsf_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    taskENTER_CRITICAL(&t->lock);
+    out->pool_bytes = t->pool_bytes;
+    out->used_bytes = t->used_bytes;
+    out->peak_used = t->peak_used;
+    out->allocs = t->allocs;
+    out->frees = t->frees;
+    out->fails = t->fails;
+    out->free_bytes = t->free_bytes;
+    out->free_blocks = t->free_blocks;
+    // list สูงสุดที่ไม่ว่าง (fls ของ bitmap สองชั้น) → หัว list เป็น block จริงที่ใหญ่ไม่น้อยกว่า 15/16 ของตัวใหญ่สุด
+    if (t->fl_bitmap)
+    {
+        int fl = tlsf_fls(t->fl_bitmap);
+        int sl = tlsf_fls(t->sl_bitmap[fl]);
+        out->largest_free = block_size(t->blocks[fl][sl]);
+    }
+    taskEXIT_CRITICAL(&t->lock);
+}
+
+bool tlsf_check(tlsf_t *t)
+{
+    bool ok = true;
+    uint32_t phys_free = 0, listed = 0;
+    size_t phys_free_bytes = 0;
+
+    taskENTER_CRITICAL(&t->lock);
+    // 1) เดินทาง physical: flag ตรงกัน, ไม่มีว่างติดกัน, free block อยู่ใน list ที่ mapping บอก
+    block_t *b = block_from_ptr(t->pool_start);
+    bool prev_free = false;
+    while (ok && !block_is_last(b))
+    {
+        size_t s = block_size(b);
+        block_t *next = block_next(b);
+        if (s < BLOCK_SIZE_MIN || (uint8_t *)next > t->pool_end || block_is_prev_free(b) != prev_free)
+            ok = false;
+        else if (block_is_free(b))
+        {
+            int fl, sl;
+            mapping_insert(s, &fl, &sl);
+            if (prev_free || next->prev_phys != b || !(t->sl_bitmap[fl] & (1u << sl)))
+                ok = false;
+            else
+            {
+                block_t *it = t->blocks[fl][sl];
+                while (it != &t->null_block && it != b)
+                    it = it->next_free;
+                ok = it == b;
+            }
+            phys_free++;
+            phys_free_bytes += s;
+        }
+        prev_free = block_is_free(b);
+        b = next;
+    }
+    ok = ok && (uint8_t *)b == t->pool_end && block_is_prev_free(b) == prev_free;
+
+    // 2) bitmap ตรงกับ list ที่ไม่ว่าง และจำนวน block ใน list = จำนวน block ว่างจริง
+    for (int i = 0; ok && i < FL_COUNT; i++)
+    {
+        if (!(t->fl_bitmap & (1u << i)) != !t->sl_bitmap[i])
+            ok = false;
+        for (int j = 0; ok && j < (int)SL_COUNT; j++)
+        {
+            bool has = t->blocks[i][j] != &t->null_block;
+            if (has != !!(t->sl_bitmap[i] & (1u << j)))
+                ok = false;
+            for (block_t *it = t->blocks[i][j]; ok && it != &t->null_block; it = it->next_free)
+            {
+                if (!block_is_free(it) || (it->next_free != &t->null_block && it->next_free->prev_free != it))
+                    ok = false;
+                listed++;
+            }
+        }
+    }
+    ok = ok && listed == phys_free && t->free_blocks == phys_free && t->free_bytes == phys_free_bytes;
+    taskEXIT_CRITICAL(&t->lock);
+    return ok;
+}
+
+// block อยู่ในช่วง pool (ก่อน deref pointer ที่อ่านจาก header/link ที่อาจเสีย)
+static inline bool block_in_pool(const tlsf_t *t, const block_t *b)
+{
+    const uint8_t *p = (const uint8_t *)block_to_ptr(b);
+    return p >= t->pool_start && p < t->pool_end && ((uintptr_t)p & (ALIGN_SIZE - 1)) == 0;
+}
+
+// ตรวจ block เดียวด้วยข้อมูลรอบตัวมันเท่านั้น (ไม่เดิน list) → O(1) ต่อ block
+static bool check_block_local(tlsf_t *t, block_t *b)
+{
+    size_t s = block_size(b);
+    block_t *next = block_next(b);
+    if (s < BLOCK_SIZE_MIN || (uint8_t *)next > t->pool_end || block_is_prev_free(next) != block_is_free(b))
+        return false;
+    if (block_is_prev_free(b) && (!block_in_pool(t, b->prev_phys) || !block_is_free(b->prev_phys) ||
+                                  block_next(b->prev_phys) != b))
+        return false;
+    if (!block_is_free(b))
+        return true;
+
+    // ว่าง: ไม่ติดกับ block ว่างอื่น, อยู่ใน list ของขนาดตัวเอง (link สองทางชี้กลับ b)
+    int fl, sl;
+    mapping_insert(s, &fl, &sl);
+    if (block_is_prev_free(b) || next->prev_phys != b || !(t->sl_bitmap[fl] & (1u << sl)))
+        return false;
+    block_t *pf = b->prev_free, *nf = b->next_free;
+    if (pf == &t->null_block ? t->blocks[fl][sl] != b : (!block_in_pool(t, pf) || pf->next_free != b))
+        return false;
+    return nf == &t->null_block || (block_in_pool(t, nf) && nf->prev_free == b);
+}
+
+// ท้ายรอบ: bitmap ตรงกับหัว list ทุกช่อง (ขนาดคงที่ FL_COUNT * SL_COUNT)
+static bool check_heads(tlsf_t *t)
+{
+    for (int i = 0; i < FL_COUNT; i++)
+    {
+        if (!(t->fl_bitmap & (1u << i)) != !t->sl_bitmap[i])
+            return false;
+        for (int j = 0; j < (int)SL_COUNT; j++)
+        {
+            block_t *h = t->blocks[i][j];
+            bool has = h != &t->null_block;
+            if (has != !!(t->sl_bitmap[i] & (1u << j)))
+                return false;
+            if (has && (!block_in_pool(t, h) || h->prev_free != &t->null_block))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool tlsf_check_step(tlsf_t *t, uint32_t max_blocks, bool *ok)
+{
+    bool good = true, done = false;
+    taskENTER_CRITICAL(&t->lock);
+    if (!t->check_pos)
+    {
+        t->check_pos = block_from_ptr(t->pool_start);
+        t->check_mut = t->mutations;
+        t->check_free = 0;
+        t->check_free_bytes = 0;
+    }
+    block_t *b = t->check_pos;
+    for (uint32_t n = 0; good && n < max_blocks && !block_is_last(b); n++)
+    {
+        good = check_block_local(t, b);
+        if (block_is_free(b))
+        {
+            t->check_free++;
+            t->check_free_bytes += block_size(b);
+        }
+        b = block_next(b);
+    }
+    if (good && block_is_last(b))
+    {
+        good = (uint8_t *)b == t->pool_end && check_heads(t);
+        // ไม่มีใครแก้ free list ตลอดรอบ → ยอดที่นับได้ต้องตรงตัวนับ (ไม่งั้นเป็นคนละ snapshot เทียบไม่ได้)
+        if (good && t->mutations == t->check_mut)
+            good = t->check_free == t->free_blocks && t->check_free_bytes == t->free_bytes;
+        done = true;
+    }
+    t->check_pos = (good && !done) ? b : NULL;
+    taskEXIT_CRITICAL(&t->lock);
+    *ok = good;
+    return done || !good;
+}
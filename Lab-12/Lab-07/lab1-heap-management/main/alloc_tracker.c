@@ -0,0 +1,327 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "alloc_tracker.h"
+
+static const char *TAG = "ALLOC_TRACK";
+
+#define STRIPE_MASK (ALLOC_TRACK_STRIPES - 1u)
+_Static_assert((ALLOC_TRACK_STRIPES & STRIPE_MASK) == 0, "ALLOC_TRACK_STRIPES must be a power of two");
+_Static_assert(ALLOC_TRACK_STRIPES <= 64, "stripe index is taken from the low hash bits");
+
+static alloc_track_stripe_t s_stripes[ALLOC_TRACK_STRIPES];
+static bool s_ready = false;
+
+/* ======================
+ * Hash
+ * ====================== */
+// murmur3 fmix32: pointer ที่ align 4/8/16 ยังกระจายทุกบิต
+static inline uint32_t ptr_hash(const void *p)
+{
+    uint32_t h = (uint32_t)(uintptr_t)p;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// บิตล่างเลือก stripe, บิตที่เหลือเลือกช่องใน table
+static inline alloc_track_stripe_t *stripe_of(uint32_t h) { return &s_stripes[h & STRIPE_MASK]; }
+static inline uint32_t home_of(const alloc_track_stripe_t *s, uint32_t h) { return (h >> 6) & s->mask; }
+
+/* ======================
+ * Init
+ * ====================== */
+bool alloc_track_init(uint32_t capacity, uint32_t caps)
+{
+    if (s_ready)
+        return true;
+
+    uint32_t per = (capacity + ALLOC_TRACK_STRIPES - 1) / ALLOC_TRACK_STRIPES;
+    if (per == 0 || per > UINT16_MAX - 1)
+        return false;
+
+    // table ≥ per × 100 / LOAD_PCT และเป็นกำลังสอง
+    uint32_t want = (uint32_t)(((uint64_t)per * 100u + ALLOC_TRACK_LOAD_PCT - 1) / ALLOC_TRACK_LOAD_PCT);
+    uint32_t tsize = 8;
+    while (tsize < want)
+        tsize <<= 1;
+
+    for (int i = 0; i < ALLOC_TRACK_STRIPES; i++)
+    {
+        alloc_track_stripe_t *s = &s_stripes[i];
+        memset(s, 0, sizeof(*s));
+        portMUX_INITIALIZE(&s->lock);
+        s->slab = (alloc_track_entry_t *)heap_caps_calloc(per, sizeof(alloc_track_entry_t), caps);
+        s->table = (uint16_t *)heap_caps_calloc(tsize, sizeof(uint16_t), caps);
+        if (!s->slab || !s->table)
+        {
+            ESP_LOGE(TAG, "init: no memory for %lu entries", (unsigned long)capacity);
+            s_ready = true; // ให้ deinit คืนของที่จองไปแล้ว
+            alloc_track_deinit();
+            return false;
+        }
+        s->mask = tsize - 1;
+        s->cap = (uint16_t)per;
+        // free list: 1 → 2 → ... → per → 0
+        for (uint32_t k = 0; k < per; k++)
+            s->slab[k].size = (k + 1 < per) ? k + 2 : 0;
+        s->free_head = 1;
+    }
+    s_ready = true;
+    ESP_LOGI(TAG, "tracker: %lu entries, %d stripes × table %lu", (unsigned long)(per * ALLOC_TRACK_STRIPES),
+             ALLOC_TRACK_STRIPES, (unsigned long)tsize);
+    return true;
+}
+
+void alloc_track_deinit(void)
+{
+    if (!s_ready)
+        return;
+    for (int i = 0; i < ALLOC_TRACK_STRIPES; i++)
+    {
+        heap_caps_free(s_stripes[i].slab);
+        heap_caps_free(s_stripes[i].table);
+        s_stripes[i].slab = NULL;
+        s_stripes[i].table = NULL;
+        s_stripes[i].cap = 0;
+    }
+    s_ready = false;
+}
+
+/* ======================
+ * Probe / delete (เรียกขณะถือ lock ของ stripe)
+ * ====================== */
+// คืนตำแหน่งใน table ของ ptr หรือ -1
+static int32_t probe_find(alloc_track_stripe_t *s, const void *ptr, uint32_t h)
+{
+    uint32_t i = home_of(s, h);
+    for (uint32_t n = 0; n <= s->mask; n++)
+    {
+        uint16_t v = s->table[i];
+        if (v == 0)
+            return -1;
+        if (s->slab[v - 1].ptr == ptr)
+            return (int32_t)i;
+        i = (i + 1) & s->mask;
+    }
+    return -1;
+}
+
+// backward shift: เลื่อน entry ถัดไปที่ "ข้าม" ช่องว่างกลับมาเติม จนเจอช่องว่างจริง
+static void table_erase(alloc_track_stripe_t *s, uint32_t hole)
+{
+    uint32_t j = hole;
+    for (;;)
+    {
+        j = (j + 1) & s->mask;
+        uint16_t v = s->table[j];
+        if (v == 0)
+            break;
+        uint32_t home = home_of(s, ptr_hash(s->slab[v - 1].ptr));
+        // ย้ายได้ถ้า home ไม่อยู่ในช่วง (hole, j] แบบวนรอบ
+        if (((j - home) & s->mask) >= ((j - hole) & s->mask))
+        {
+            s->table[hole] = v;
+            hole = j;
+        }
+    }
+    s->table[hole] = 0;
+}
+
+/* ======================
+ * API
+ * ====================== */
+bool alloc_track_insert(void *ptr, size_t size, uint32_t caps, const char *description)
+{
+    if (!s_ready || !ptr)
+        return false;
+    uint32_t h = ptr_hash(ptr);
+    alloc_track_stripe_t *s = stripe_of(h);
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+    bool ok = false;
+
+    taskENTER_CRITICAL(&s->lock);
+    int32_t at = probe_find(s, ptr, h);
+    uint16_t idx1;
+    if (at >= 0)
+    {
+        // pointer เดิมยังค้าง (free ที่ไม่ผ่าน tracker) → เขียนทับ record เดิม
+        idx1 = s->table[at];
+        s->bytes_out += s->slab[idx1 - 1].size;
+        s->removes++;
+        s->live--;
+    }
+    else if (s->free_head)
+    {
+        idx1 = s->free_head;
+        s->free_head = (uint16_t)s->slab[idx1 - 1].size;
+        uint32_t i = home_of(s, h), n = 0;
+        while (s->table[i] != 0)
+        {
+            i = (i + 1) & s->mask;
+            n++;
+        }
+        s->table[i] = idx1;
+        if (n > s->max_probe)
+            s->max_probe = (uint16_t)n;
+    }
+    else
+    {
+        s->overflow++;
+        idx1 = 0;
+    }
+
+    if (idx1)
+    {
+        alloc_track_entry_t *e = &s->slab[idx1 - 1];
+        e->ptr = ptr;
+        e->size = size;
+        e->caps = caps;
+        e->description = description;
+        e->timestamp_ms = now_ms;
+        s->inserts++;
+        s->live++;
+        s->bytes_in += size;
+        ok = true;
+    }
+    taskEXIT_CRITICAL(&s->lock);
+    return ok;
+}
+
+bool alloc_track_remove(void *ptr, alloc_track_entry_t *out)
+{
+    if (!s_ready || !ptr)
+        return false;
+    uint32_t h = ptr_hash(ptr);
+    alloc_track_stripe_t *s = stripe_of(h);
+    bool ok = false;
+
+    taskENTER_CRITICAL(&s->lock);
+    int32_t at = probe_find(s, ptr, h);
+    if (at >= 0)
+    {
+        uint16_t idx1 = s->table[at];
+        alloc_track_entry_t *e = &s->slab[idx1 - 1];
+        if (out)
+            *out = *e;
+        table_erase(s, (uint32_t)at);
+        s->bytes_out += e->size;
+        e->ptr = NULL;
+        e->size = s->free_head;
+        s->free_head = idx1;
+        s->removes++;
+        s->live--;
+        ok = true;
+    }
+    taskEXIT_CRITICAL(&s->lock);
+    return ok;
+}
+
+bool alloc_track_lookup(const void *ptr, alloc_track_entry_t *out)
+{
+    if (!s_ready || !ptr)
+        return false;
+    uint32_t h = ptr_hash(ptr);
+    alloc_track_stripe_t *s = stripe_of(h);
+
+    taskENTER_CRITICAL(&s->lock);
+    int32_t at = probe_find(s, ptr, h);
+    if (at >= 0 && out)
+        *out = s->slab[s->table[at] - 1];
+    taskEXIT_CRITICAL(&s->lock);
+    return at >= 0;
+}
+
+void alloc_track_get_stats(alloc_track_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_ready)
+        return;
+    for (int i = 0; i < ALLOC_TRACK_STRIPES; i++)
+    {
+        alloc_track_stripe_t *s = &s_stripes[i];
+        taskENTER_CRITICAL(&s->lock);
+        out->capacity += s->cap;
+        out->live += s->live;
+        out->inserts += s->inserts;
+        out->removes += s->removes;
+        out->overflow += s->overflow;
+        if (s->max_probe > out->max_probe)
+            out->max_probe = s->max_probe;
+        out->bytes_in += s->bytes_in;
+        out->bytes_out += s->bytes_out;
+        out->overhead_bytes += (size_t)s->cap * sizeof(alloc_track_entry_t) + (s->mask + 1) * sizeof(uint16_t);
+        taskEXIT_CRITICAL(&s->lock);
+    }
+}
+
+// ถือ lock ทีละ record (critical section สั้น) แล้วเรียก callback นอก lock
+size_t alloc_track_foreach(alloc_track_visit_fn fn, void *arg)
+{
+    size_t n = 0;
+    if (!s_ready)
+        return 0;
+    for (int i = 0; i < ALLOC_TRACK_STRIPES; i++)
+    {
+        alloc_track_stripe_t *s = &s_stripes[i];
+        for (uint32_t k = 0; k < s->cap; k++)
+        {
+            alloc_track_entry_t e;
+            taskENTER_CRITICAL(&s->lock);
+            e = s->slab[k];
+            taskEXIT_CRITICAL(&s->lock);
+            if (e.ptr)
+            {
+                fn(&e, arg);
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+// cursor = (stripe << 16) | slab index; ถือ lock ทีละ record เหมือน foreach
+bool alloc_track_scan(uint32_t *cursor, uint32_t max_slots, alloc_track_check_fn fn, void *arg,
+                      alloc_track_scan_t *res)
+{
+    uint32_t si = *cursor >> 16, k = *cursor & 0xFFFFu;
+    for (uint32_t n = 0; s_ready && si < ALLOC_TRACK_STRIPES && n < max_slots;)
+    {
+        alloc_track_stripe_t *s = &s_stripes[si];
+        if (k >= s->cap)
+        {
+            si++;
+            k = 0;
+            continue;
+        }
+        taskENTER_CRITICAL(&s->lock);
+        const alloc_track_entry_t *e = &s->slab[k];
+        if (e->ptr)
+        {
+            uint32_t h = ptr_hash(e->ptr);
+            int32_t at = stripe_of(h) == s ? probe_find(s, e->ptr, h) : -1;
+            bool ok = at >= 0 && s->table[at] == k + 1 && (!fn || fn(e, arg));
+            res->visited++;
+            if (!ok && res->bad++ == 0)
+                res->first_bad = *e;
+        }
+        taskEXIT_CRITICAL(&s->lock);
+        k++;
+        n++;
+    }
+    if (!s_ready || si >= ALLOC_TRACK_STRIPES)
+    {
+        *cursor = 0;
+        return true;
+    }
+    *cursor = (si << 16) | k;
+    return false;
+}
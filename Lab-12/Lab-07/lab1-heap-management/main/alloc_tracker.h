@@ -0,0 +1,101 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef ALLOC_TRACK_STRIPES
+#define ALLOC_TRACK_STRIPES 4 // จำนวน stripe (กำลังสอง) ≥ 2 × จำนวน core → สอง core แทบไม่ชน lock เดียวกัน
+#endif
+
+#ifndef ALLOC_TRACK_LOAD_PCT
+#define ALLOC_TRACK_LOAD_PCT 50 // load factor สูงสุดของ hash table (probe สั้นแม้เต็ม slab)
+#endif
+
+/* ======================
+ * Allocation tracker
+ * ======================
+ * pointer → record แบบ O(1) สำหรับ tracked_malloc/tracked_free
+ * - แบ่งเป็น stripe ตาม hash ของ pointer: แต่ละ stripe มี spinlock, hash table, slab ของตัวเอง
+ *   (probe/ลบไม่ข้าม stripe → ไม่ต้องถือหลาย lock)
+ * - open addressing + linear probing, ลบแบบ backward shift (ไม่มี tombstone → probe ไม่ยาวขึ้นตามเวลา)
+ * - record อยู่ใน slab ที่จองไว้ตั้งแต่ init: ไม่มี malloc ระหว่าง track
+ */
+typedef struct
+{
+    void *ptr; // NULL = ว่าง (size ใช้เป็น next ของ free list)
+    size_t size;
+    uint32_t caps;
+    const char *description;
+    uint32_t timestamp_ms;
+} alloc_track_entry_t;
+
+typedef struct
+{
+    portMUX_TYPE lock;
+    uint16_t *table;            // slab index + 1 (0 = ช่องว่าง)
+    uint32_t mask;              // ขนาด table - 1
+    alloc_track_entry_t *slab;
+    uint16_t free_head;         // slab index + 1 ของ record ว่างตัวแรก
+    uint16_t cap;
+    uint16_t live;
+    uint16_t max_probe;         // probe ยาวสุดที่เคยเจอ (ตรวจว่ายัง O(1) จริง)
+    uint32_t inserts;
+    uint32_t removes;
+    uint32_t overflow;          // slab เต็ม → ไม่ได้ track
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} alloc_track_stripe_t;
+
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t live;
+    uint32_t inserts;
+    uint32_t removes;
+    uint32_t overflow;
+    uint32_t max_probe;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    size_t overhead_bytes; // slab + table
+} alloc_track_stats_t;
+
+// callback ของ alloc_track_foreach ได้สำเนาของ record (ไม่ได้ถือ lock ระหว่างเรียก)
+typedef void (*alloc_track_visit_fn)(const alloc_track_entry_t *e, void *arg);
+
+// capacity รวมทุก stripe (แต่ละ stripe ไม่เกิน 65535), caps = ที่อยู่ของ slab/table (เช่น SPIRAM)
+bool alloc_track_init(uint32_t capacity, uint32_t caps);
+void alloc_track_deinit(void);
+
+// false = slab ของ stripe นั้นเต็ม (นับใน overflow)
+bool alloc_track_insert(void *ptr, size_t size, uint32_t caps, const char *description);
+// false = ไม่พบ pointer; *out = record ที่ถูกลบ (NULL ได้)
+bool alloc_track_remove(void *ptr, alloc_track_entry_t *out);
+bool alloc_track_lookup(const void *ptr, alloc_track_entry_t *out);
+
+void alloc_track_get_stats(alloc_track_stats_t *out);
+size_t alloc_track_foreach(alloc_track_visit_fn fn, void *arg);
+
+// callback ของ alloc_track_scan: เรียกขณะถือ lock ของ stripe (record ถูกลบ/free ระหว่างนั้นไม่ได้)
+// → ห้าม block / malloc / log; false = record นี้เสีย
+typedef bool (*alloc_track_check_fn)(const alloc_track_entry_t *e, void *arg);
+
+typedef struct
+{
+    uint32_t visited;              // record ที่ใช้อยู่ซึ่งถูกตรวจ
+    uint32_t bad;                  // หาไม่เจอผ่าน table ของ stripe ตัวเอง หรือ fn คืน false
+    alloc_track_entry_t first_bad; // ptr = NULL ถ้ายังไม่มี
+} alloc_track_scan_t;
+
+// ตรวจทีละช่วง: เดิน slab ต่อจาก *cursor ไม่เกิน max_slots ช่อง (ผลสะสมลง *res)
+// คืน true เมื่อเดินครบทุก stripe แล้ว (*cursor กลับเป็น 0)
+bool alloc_track_scan(uint32_t *cursor, uint32_t max_slots, alloc_track_check_fn fn, void *arg,
+                      alloc_track_scan_t *res);
+
+#endif // ALLOC_TRACKER_H
@@ -0,0 +1,295 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "cold_store.h"
+
+static const char *TAG = "COLD";
+
+static inline uint32_t now_ms(void) { return (uint32_t)(esp_timer_get_time() / 1000); }
+
+static cold_entry_t *lookup(cold_store_t *cs, cold_handle_t h)
+{
+    uint32_t idx1 = h & 0xFFFFu;
+    if (idx1 == 0 || idx1 > cs->n)
+        return NULL;
+    cold_entry_t *e = &cs->e[idx1 - 1];
+    return (e->used && e->gen == (uint16_t)(h >> 16)) ? e : NULL;
+}
+
+/* ======================
+ * Compress / decompress (ถือ lock)
+ * ====================== */
+// บีบ src ลง buffer ชั่วคราวขนาด bound แล้วหดให้พอดี → *out (ดิบถ้าบีบไม่ลง)
+static bool encode_locked(cold_store_t *cs, const uint8_t *src, size_t len, uint8_t **out, uint32_t *out_len,
+                          uint8_t *codec)
+{
+    uint8_t *tmp = (uint8_t *)heap_caps_malloc(len ? len : 1, cs->caps);
+    if (!tmp)
+        return false;
+    uint64_t t0 = esp_timer_get_time();
+    mcodec_id_t used;
+    size_t clen = mcodec_compress_best(cs->codec, src, len, tmp, len, cs->work, &used);
+    cs->enc_us += esp_timer_get_time() - t0;
+    cs->compressions++;
+    if (clen < len)
+    {
+        uint8_t *fit = (uint8_t *)heap_caps_realloc(tmp, clen ? clen : 1, cs->caps);
+        if (fit)
+            tmp = fit;
+    }
+    *out = tmp;
+    *out_len = (uint32_t)clen;
+    *codec = (uint8_t)used;
+    return true;
+}
+
+static bool decode_locked(cold_store_t *cs, cold_entry_t *e)
+{
+    uint8_t *raw = (uint8_t *)heap_caps_malloc(e->raw_len ? e->raw_len : 1, cs->caps);
+    if (!raw)
+        return false;
+    uint64_t t0 = esp_timer_get_time();
+    size_t n = mcodec_decompress((mcodec_id_t)e->codec, e->comp, e->comp_len, raw, e->raw_len);
+    cs->dec_us += esp_timer_get_time() - t0;
+    cs->decompressions++;
+    if (n != e->raw_len)
+    {
+        ESP_LOGE(TAG, "'%s': decoded %u of %u bytes", e->desc ? e->desc : "?", (unsigned)n, (unsigned)e->raw_len);
+        heap_caps_free(raw);
+        return false;
+    }
+    e->hot = raw;
+    return true;
+}
+
+static void drop_locked(cold_entry_t *e)
+{
+    if (e->hot && e->hot != e->comp)
+        heap_caps_free(e->hot);
+    heap_caps_free(e->comp);
+    e->hot = e->comp = NULL;
+}
+
+/* ======================
+ * API
+ * ====================== */
+int cold_init(cold_store_t *cs, uint16_t max_entries, mcodec_id_t codec, uint32_t idle_ms, uint32_t caps)
+{
+    memset(cs, 0, sizeof(*cs));
+    if (max_entries == 0)
+        return -1;
+    cs->e = (cold_entry_t *)heap_caps_calloc(max_entries, sizeof(cold_entry_t), caps);
+    cs->work = heap_caps_malloc(MCODEC_WORK_BYTES, caps);
+    cs->lock = xSemaphoreCreateMutex();
+    if (!cs->e || !cs->work || !cs->lock)
+    {
+        ESP_LOGE(TAG, "init: no memory for %u entries", (unsigned)max_entries);
+        cold_destroy(cs);
+        return -1;
+    }
+    cs->n = max_entries;
+    cs->codec = codec;
+    cs->idle_ms = idle_ms;
+    cs->caps = caps;
+    return 0;
+}
+
+void cold_destroy(cold_store_t *cs)
+{
+    for (uint16_t i = 0; cs->e && i < cs->n; i++)
+        if (cs->e[i].used)
+            drop_locked(&cs->e[i]);
+    heap_caps_free(cs->e);
+    heap_caps_free(cs->work);
+    if (cs->lock)
+        vSemaphoreDelete(cs->lock);
+    memset(cs, 0, sizeof(*cs));
+}
+
+cold_handle_t cold_put(cold_store_t *cs, const void *data, size_t len, const char *desc)
+{
+    if (len > MCODEC_MAX_INPUT)
+    {
+        cs->put_fails++;
+        return COLD_INVALID;
+    }
+    cold_handle_t h = COLD_INVALID;
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    cold_entry_t *e = NULL;
+    for (uint16_t i = 0; i < cs->n && !e; i++)
+        if (!cs->e[i].used)
+            e = &cs->e[i];
+    if (e && encode_locked(cs, (const uint8_t *)data, len, &e->comp, &e->comp_len, &e->codec))
+    {
+        e->hot = e->codec == MCODEC_RAW ? e->comp : NULL;
+        e->raw_len = (uint32_t)len;
+        e->last_ms = now_ms();
+        e->desc = desc;
+        e->pins = 0;
+        e->dirty = false;
+        e->used = true;
+        h = ((cold_handle_t)e->gen << 16) | (uint32_t)(e - cs->e + 1);
+    }
+    else
+    {
+        cs->put_fails++;
+    }
+    xSemaphoreGive(cs->lock);
+    return h;
+}
+
+bool cold_free(cold_store_t *cs, cold_handle_t h)
+{
+    bool ok = false;
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    cold_entry_t *e = lookup(cs, h);
+    if (e && e->pins == 0)
+    {
+        drop_locked(e);
+        e->used = false;
+        e->gen++;
+        ok = true;
+    }
+    xSemaphoreGive(cs->lock);
+    return ok;
+}
+
+void *cold_acquire(cold_store_t *cs, cold_handle_t h, bool write)
+{
+    void *p = NULL;
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    cold_entry_t *e = lookup(cs, h);
+    if (e && e->pins < UINT16_MAX)
+    {
+        if (e->hot)
+            cs->hot_hits++;
+        if (e->hot || decode_locked(cs, e))
+        {
+            if (write && !e->dirty)
+            {
+                // รูปบีบล้าสมัยแล้ว: คืนทันที (RAW ใช้ buffer เดียวกัน → เก็บ hot ไว้)
+                if (e->comp != e->hot)
+                    heap_caps_free(e->comp);
+                e->comp = NULL;
+                e->dirty = true;
+            }
+            e->pins++;
+            e->last_ms = now_ms();
+            p = e->hot;
+        }
+    }
+    xSemaphoreGive(cs->lock);
+    return p;
+}
+
+void cold_release(cold_store_t *cs, cold_handle_t h)
+{
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    cold_entry_t *e = lookup(cs, h);
+    if (e && e->pins)
+    {
+        e->pins--;
+        e->last_ms = now_ms();
+    }
+    xSemaphoreGive(cs->lock);
+}
+
+size_t cold_size(cold_store_t *cs, cold_handle_t h)
+{
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    cold_entry_t *e = lookup(cs, h);
+    size_t n = e ? e->raw_len : 0;
+    xSemaphoreGive(cs->lock);
+    return n;
+}
+
+uint32_t cold_sweep(cold_store_t *cs)
+{
+    uint32_t cooled = 0, t = now_ms();
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < cs->n; i++)
+    {
+        cold_entry_t *e = &cs->e[i];
+        if (!e->used || !e->hot || e->pins || (uint32_t)(t - e->last_ms) < cs->idle_ms)
+            continue;
+        if (e->dirty)
+        {
+            uint8_t *comp;
+            uint32_t clen;
+            uint8_t codec;
+            if (!encode_locked(cs, e->hot, e->raw_len, &comp, &clen, &codec))
+                continue; // ไม่มีที่ให้บีบตอนนี้ → ค้าง hot ไว้รอบหน้า
+            heap_caps_free(e->hot);
+            e->comp = comp;
+            e->comp_len = clen;
+            e->codec = codec;
+            e->dirty = false;
+            e->hot = codec == MCODEC_RAW ? comp : NULL;
+        }
+        else if (e->hot != e->comp)
+        {
+            heap_caps_free(e->hot);
+            e->hot = NULL;
+        }
+        else
+        {
+            continue; // RAW ที่ไม่ถูกแก้: ไม่มีอะไรให้ทำ
+        }
+        cooled++;
+    }
+    xSemaphoreGive(cs->lock);
+    return cooled;
+}
+
+size_t cold_shed(cold_store_t *cs)
+{
+    size_t freed = 0;
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < cs->n; i++)
+    {
+        cold_entry_t *e = &cs->e[i];
+        // dirty ต้องบีบใหม่ (จองหน่วยความจำ) → ปล่อยให้ sweep ตามปกติ
+        if (!e->used || !e->hot || e->hot == e->comp || e->pins || e->dirty)
+            continue;
+        heap_caps_free(e->hot);
+        e->hot = NULL;
+        freed += e->raw_len;
+    }
+    xSemaphoreGive(cs->lock);
+    return freed;
+}
+
+void cold_get_stats(cold_store_t *cs, cold_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    xSemaphoreTake(cs->lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < cs->n; i++)
+    {
+        const cold_entry_t *e = &cs->e[i];
+        if (!e->used)
+            continue;
+        out->entries++;
+        out->raw_bytes += e->raw_len;
+        if (e->comp)
+            out->stored_bytes += e->comp_len;
+        if (e->hot && e->hot != e->comp)
+        {
+            out->hot++;
+            out->stored_bytes += e->raw_len;
+        }
+        if (!e->dirty && e->codec <= MCODEC_LZ)
+            out->by_codec[e->codec]++;
+    }
+    out->compressions = cs->compressions;
+    out->decompressions = cs->decompressions;
+    out->hot_hits = cs->hot_hits;
+    out->put_fails = cs->put_fails;
+    out->enc_us = cs->enc_us;
+    out->dec_us = cs->dec_us;
+    xSemaphoreGive(cs->lock);
+}
@@ -0,0 +1,92 @@
+#ifndef COLD_STORE_H
+#define COLD_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "mem_codec.h"
+
+/* ======================
+ * Cold buffer store
+ * ======================
+ * เก็บข้อมูลที่ไม่ค่อยถูกแตะ (ประวัติ event, log, snapshot) ในรูปบีบอัด แล้วคลายให้อัตโนมัติเมื่อเข้าถึง
+ * - put: บีบทันที (codec ตาม config, AUTO = เลือกที่เล็กกว่า, บีบไม่ลง → เก็บดิบ)
+ * - acquire: ถ้ายัง cold → คลายเป็นสำเนา "hot" แล้วคืน pointer (ต้อง release เมื่อเลิกใช้)
+ *   อ่านอย่างเดียว: เก็บรูปบีบไว้ด้วย → sweep แค่ทิ้งสำเนา hot (ไม่ต้องบีบซ้ำ)
+ *   เขียน: ทิ้งรูปบีบ (ล้าสมัย) → sweep บีบใหม่
+ * - sweep: entry ที่ hot และไม่ถูก acquire ค้าง นานเกิน idle_ms → กลับเป็น cold
+ * - ขนาดต่อ entry ไม่เกิน MCODEC_MAX_INPUT, lock เป็น mutex (บีบ/คลายใช้เวลาระดับ ms)
+ */
+typedef uint32_t cold_handle_t; // (gen << 16) | (index + 1), 0 = ไม่ถูกต้อง
+#define COLD_INVALID 0u
+
+typedef struct
+{
+    uint8_t *comp; // รูปที่เก็บ (บีบแล้ว หรือดิบถ้า codec = RAW), NULL = ล้าสมัยเพราะถูกเขียน
+    uint8_t *hot;  // สำเนาดิบ (NULL = cold), codec RAW: ชี้ที่เดียวกับ comp
+    uint32_t raw_len;
+    uint32_t comp_len;
+    uint32_t last_ms;
+    const char *desc;
+    uint16_t pins;
+    uint16_t gen;
+    uint8_t codec;
+    bool used;
+    bool dirty;
+} cold_entry_t;
+
+typedef struct
+{
+    cold_entry_t *e;
+    uint16_t n;
+    mcodec_id_t codec;
+    uint32_t idle_ms;
+    uint32_t caps;
+    void *work; // hash table ของ LZ (ใช้ภายใต้ lock)
+    SemaphoreHandle_t lock;
+    uint32_t compressions;
+    uint32_t decompressions;
+    uint32_t hot_hits; // acquire ที่เจอสำเนา hot อยู่แล้ว
+    uint32_t put_fails;
+    uint64_t enc_us;
+    uint64_t dec_us;
+} cold_store_t;
+
+typedef struct
+{
+    uint32_t entries;
+    uint32_t hot;
+    size_t raw_bytes;    // ขนาดดิบรวมของทุก entry
+    size_t stored_bytes; // ที่ใช้จริงตอนนี้ (รูปบีบ + สำเนา hot)
+    uint32_t by_codec[3];
+    uint32_t compressions;
+    uint32_t decompressions;
+    uint32_t hot_hits;
+    uint32_t put_fails;
+    uint64_t enc_us;
+    uint64_t dec_us;
+} cold_stats_t;
+
+int cold_init(cold_store_t *cs, uint16_t max_entries, mcodec_id_t codec, uint32_t idle_ms, uint32_t caps);
+void cold_destroy(cold_store_t *cs);
+
+// copy data เข้า store (บีบทันที); COLD_INVALID = เต็ม / ใหญ่เกิน / หน่วยความจำไม่พอ
+cold_handle_t cold_put(cold_store_t *cs, const void *data, size_t len, const char *desc);
+bool cold_free(cold_store_t *cs, cold_handle_t h); // entry ที่ยังถูก acquire อยู่จะไม่ถูกคืน
+
+// pointer ใช้ได้จนกว่า release; write = จะแก้ข้อมูล (รูปบีบเดิมถูกทิ้ง)
+void *cold_acquire(cold_store_t *cs, cold_handle_t h, bool write);
+void cold_release(cold_store_t *cs, cold_handle_t h);
+size_t cold_size(cold_store_t *cs, cold_handle_t h);
+
+// คืนจำนวน entry ที่กลับเป็น cold ในรอบนี้
+uint32_t cold_sweep(cold_store_t *cs);
+// ความจำตึง: ทิ้งสำเนา hot ที่ไม่ได้ถูกแก้และไม่ถูก acquire ค้างทันที (ไม่สน idle, ไม่จองเพิ่ม) → คืน byte ที่ปล่อย
+size_t cold_shed(cold_store_t *cs);
+void cold_get_stats(cold_store_t *cs, cold_stats_t *out);
+
+#endif // COLD_STORE_H
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "sdkconfig.h"
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+#include "esp_debug_helpers.h" // esp_backtrace_get_start / get_next_frame
+#endif
+
+#include "heap_sampler.h"
+
+static const char *TAG = "HEAP_SAMPLE";
+
+#define SITE_MASK (HEAP_SAMPLE_SITES - 1u)
+#define LIVE_SLOTS (HEAP_SAMPLE_MAX_LIVE * 2u) // load ≤ 50%
+#define LIVE_MASK (LIVE_SLOTS - 1u)
+_Static_assert((HEAP_SAMPLE_SITES & SITE_MASK) == 0, "HEAP_SAMPLE_SITES must be a power of two");
+_Static_assert((LIVE_SLOTS & LIVE_MASK) == 0, "HEAP_SAMPLE_MAX_LIVE must be a power of two");
+_Static_assert(HEAP_SAMPLE_SITES <= UINT16_MAX, "site index is u16");
+
+typedef struct
+{
+    void *ptr; // NULL = ว่าง
+    uint32_t size;
+    uint16_t site;
+} live_slot_t;
+
+int32_t g_heap_sample_countdown[portNUM_PROCESSORS];
+uint8_t g_heap_sample_filter[256];
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static heap_sample_site_t s_sites[HEAP_SAMPLE_SITES];
+static bool s_site_used[HEAP_SAMPLE_SITES];
+static live_slot_t s_live[LIVE_SLOTS];
+static uint32_t s_live_count;
+static uint32_t s_mean;
+static heap_sample_stats_t s_stats;
+
+/* ======================
+ * Sampling interval
+ * ====================== */
+// ระยะถัดไปแบบ exponential (Poisson process บนแกน byte) → ความน่าจะเป็นที่ allocation ขนาด s
+// ถูกเลือก = 1 - exp(-s/mean) ซึ่งเป็นสมมติฐานเดียวกับที่ pprof ใช้ unsample heap_v2
+static int32_t next_interval(void)
+{
+    if (s_mean == 0)
+        return INT32_MAX;
+    float u = (float)((esp_random() >> 8) + 1u) / 16777217.0f; // (0, 1]
+    float v = -logf(u) * (float)s_mean;
+    if (v > (float)(INT32_MAX / 2))
+        v = (float)(INT32_MAX / 2);
+    return (int32_t)v + 1;
+}
+
+void heap_sample_init(uint32_t mean_bytes)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_mean = mean_bytes;
+    s_stats.mean_bytes = mean_bytes;
+    taskEXIT_CRITICAL(&s_lock);
+    for (int c = 0; c < portNUM_PROCESSORS; c++)
+        g_heap_sample_countdown[c] = next_interval();
+}
+
+/* ======================
+ * Backtrace
+ * ====================== */
+// noinline (ทั้งตัวนี้และ heap_sample_record): จำนวน frame ที่ข้ามด้านล่างนับจาก frame จริง
+// ถ้า compiler inline เข้าไป frame จะหายไปหนึ่งชั้นแล้ว stack จะเริ่มผิดที่
+static __attribute__((noinline)) uint32_t capture_stack(uintptr_t *pc, void *caller)
+{
+    uint32_t n = 0;
+    pc[n++] = (uintptr_t)caller;
+#if CONFIG_IDF_TARGET_ARCH_XTENSA && HEAP_SAMPLE_DEPTH > 1
+    // frame: capture_stack → heap_sample_record → tracked_malloc → ผู้เรียก (= caller แล้ว) → ...
+    esp_backtrace_frame_t f;
+    esp_backtrace_get_start(&f.pc, &f.sp, &f.next_pc);
+    for (int skip = 0; skip < 3; skip++)
+    {
+        if (f.next_pc == 0 || !esp_backtrace_get_next_frame(&f))
+            return n;
+    }
+    while (n < HEAP_SAMPLE_DEPTH && f.next_pc != 0 && esp_backtrace_get_next_frame(&f))
+    {
+        // windowed ABI: 2 บิตบนของ return address คือขนาด window → แปลงกลับเป็น address จริง
+        pc[n++] = (uintptr_t)(((f.pc & 0x3FFFFFFFu) | 0x40000000u) - 3u);
+    }
+#endif
+    return n;
+}
+
+/* ======================
+ * Tables (ถือ s_lock)
+ * ====================== */
+static int find_site(const uintptr_t *pc, uint32_t depth)
+{
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        h ^= (uint32_t)pc[i];
+        h *= 16777619u;
+    }
+    uint32_t i = h & SITE_MASK;
+    for (uint32_t n = 0; n < HEAP_SAMPLE_SITES; n++, i = (i + 1) & SITE_MASK)
+    {
+        heap_sample_site_t *s = &s_sites[i];
+        if (!s_site_used[i])
+        {
+            memset(s, 0, sizeof(*s));
+            memcpy(s->pc, pc, depth * sizeof(pc[0]));
+            s->depth = depth;
+            s_site_used[i] = true;
+            s_stats.sites++;
+            return (int)i;
+        }
+        if (s->depth == depth && memcmp(s->pc, pc, depth * sizeof(pc[0])) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+static inline uint32_t live_home(const void *ptr) { return ((uint32_t)(uintptr_t)ptr * 0x85EBCA6Bu) >> 7 & LIVE_MASK; }
+
+static void live_erase(uint32_t hole)
+{
+    uint32_t j = hole;
+    for (;;)
+    {
+        j = (j + 1) & LIVE_MASK;
+        if (!s_live[j].ptr)
+            break;
+        uint32_t home = live_home(s_live[j].ptr);
+        if (((j - home) & LIVE_MASK) >= ((j - hole) & LIVE_MASK))
+        {
+            s_live[hole] = s_live[j];
+            hole = j;
+        }
+    }
+    s_live[hole].ptr = NULL;
+}
+
+static inline void filter_inc(const void *ptr)
+{
+    uint8_t *f = &g_heap_sample_filter[heap_sample_filter_slot(ptr)];
+    if (*f < UINT8_MAX)
+        __atomic_store_n(f, (uint8_t)(*f + 1), __ATOMIC_RELAXED);
+}
+
+static inline void filter_dec(const void *ptr)
+{
+    uint8_t *f = &g_heap_sample_filter[heap_sample_filter_slot(ptr)];
+    if (*f > 0 && *f < UINT8_MAX) // อิ่มตัวแล้วค้างไว้ (แค่ทำให้ free ช่องนั้นเข้า lock บ่อยขึ้น)
+        __atomic_store_n(f, (uint8_t)(*f - 1), __ATOMIC_RELAXED);
+}
+
+/* ======================
+ * Record / forget
+ * ====================== */
+__attribute__((noinline)) void heap_sample_record(void *ptr, size_t size, void *caller)
+{
+    uintptr_t pc[HEAP_SAMPLE_DEPTH];
+    uint32_t depth = capture_stack(pc, caller);
+    int32_t next = next_interval();
+
+    taskENTER_CRITICAL(&s_lock);
+    // allocation ใหญ่อาจข้ามหลายช่วง → ยังนับ sample เดียว (pprof คิดความน่าจะเป็นจากขนาดเอง)
+    g_heap_sample_countdown[xPortGetCoreID()] = next;
+    s_stats.samples++;
+    int si = find_site(pc, depth);
+    if (si < 0)
+    {
+        s_stats.site_dropped++;
+        taskEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    heap_sample_site_t *s = &s_sites[si];
+    s->alloc_count++;
+    s->alloc_bytes += size;
+
+    if (s_live_count < HEAP_SAMPLE_MAX_LIVE)
+    {
+        uint32_t i = live_home(ptr);
+        while (s_live[i].ptr && s_live[i].ptr != ptr)
+            i = (i + 1) & LIVE_MASK;
+        if (!s_live[i].ptr)
+        {
+            s_live_count++;
+            filter_inc(ptr);
+        }
+        else
+        {
+            // pointer เดิมถูก free นอก tracked_free → ย้ายยอด live ออกจาก site เก่า
+            heap_sample_site_t *old = &s_sites[s_live[i].site];
+            if (old->live_count)
+            {
+                old->live_count--;
+                old->live_bytes -= (old->live_bytes >= s_live[i].size) ? s_live[i].size : old->live_bytes;
+            }
+        }
+        s_live[i] = (live_slot_t){ptr, (uint32_t)size, (uint16_t)si};
+        s->live_count++;
+        s->live_bytes += size;
+    }
+    else
+        s_stats.live_dropped++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void heap_sample_forget(void *ptr)
+{
+    taskENTER_CRITICAL(&s_lock);
+    uint32_t i = live_home(ptr);
+    for (uint32_t n = 0; n < LIVE_SLOTS && s_live[i].ptr; n++, i = (i + 1) & LIVE_MASK)
+    {
+        if (s_live[i].ptr == ptr)
+        {
+            heap_sample_site_t *s = &s_sites[s_live[i].site];
+            if (s->live_count)
+            {
+                s->live_count--;
+                s->live_bytes -= (s->live_bytes >= s_live[i].size) ? s_live[i].size : s->live_bytes;
+            }
+            filter_dec(ptr);
+            live_erase(i);
+            s_live_count--;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+/* ======================
+ * Report / dump
+ * ====================== */
+void heap_sample_get_stats(heap_sample_stats_t *out)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static bool copy_site(uint32_t i, heap_sample_site_t *out)
+{
+    taskENTER_CRITICAL(&s_lock);
+    bool used = s_site_used[i];
+    if (used)
+        *out = s_sites[i];
+    taskEXIT_CRITICAL(&s_lock);
+    return used;
+}
+
+// ตัวคูณ unsample แบบเดียวกับ pprof: 1 / (1 - exp(-avg/mean))
+static float unsample_scale(uint64_t bytes, uint32_t count)
+{
+    if (count == 0 || s_mean == 0)
+        return 1.0f;
+    float avg = (float)bytes / (float)count;
+    return 1.0f / (1.0f - expf(-avg / (float)s_mean));
+}
+
+void heap_sample_print_top(int n)
+{
+    enum
+    {
+        TOP_MAX = 8
+    };
+    if (n > TOP_MAX)
+        n = TOP_MAX;
+    heap_sample_site_t top[TOP_MAX];
+    float top_est[TOP_MAX];
+    int have = 0;
+
+    for (uint32_t i = 0; i < HEAP_SAMPLE_SITES; i++)
+    {
+        heap_sample_site_t s;
+        if (!copy_site(i, &s) || s.alloc_count == 0)
+            continue;
+        float est = (float)s.alloc_bytes * unsample_scale(s.alloc_bytes, s.alloc_count);
+        int pos = have;
+        while (pos > 0 && top_est[pos - 1] < est)
+            pos--;
+        if (pos >= n)
+            continue;
+        int last = (have < n) ? have : n - 1;
+        for (int k = last; k > pos; k--)
+        {
+            top[k] = top[k - 1];
+            top_est[k] = top_est[k - 1];
+        }
+        top[pos] = s;
+        top_est[pos] = est;
+        if (have < n)
+            have++;
+    }
+
+    heap_sample_stats_t st;
+    heap_sample_get_stats(&st);
+    ESP_LOGI(TAG, "top call sites (1 sample / %lu B, %lu samples, %lu sites, dropped live=%lu site=%lu)",
+             (unsigned long)st.mean_bytes, (unsigned long)st.samples, (unsigned long)st.sites,
+             (unsigned long)st.live_dropped, (unsigned long)st.site_dropped);
+    for (int k = 0; k < have; k++)
+    {
+        const heap_sample_site_t *s = &top[k];
+        float scale = unsample_scale(s->alloc_bytes, s->alloc_count);
+        ESP_LOGI(TAG, "#%d ~%lu B alloc (~%lu objs), ~%lu B in use @ 0x%08lx%s", k, (unsigned long)top_est[k],
+                 (unsigned long)((float)s->alloc_count * scale),
+                 (unsigned long)((float)s->live_bytes * unsample_scale(s->live_bytes, s->live_count)),
+                 (unsigned long)s->pc[0], s->depth > 1 ? " ..." : "");
+    }
+}
+
+// legacy heap profile ของ gperftools: `pprof firmware.elf heap.txt` unsample ด้วย heap_v2/<rate>
+size_t heap_sample_dump(heap_sample_write_fn write, void *arg)
+{
+    char line[48 + HEAP_SAMPLE_DEPTH * 11];
+    uint64_t live_n = 0, live_b = 0, alloc_n = 0, alloc_b = 0;
+    size_t n = 0;
+
+    for (uint32_t i = 0; i < HEAP_SAMPLE_SITES; i++)
+    {
+        heap_sample_site_t s;
+        if (!copy_site(i, &s))
+            continue;
+        live_n += s.live_count;
+        live_b += s.live_bytes;
+        alloc_n += s.alloc_count;
+        alloc_b += s.alloc_bytes;
+    }
+    snprintf(line, sizeof(line), "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%lu\n", (unsigned long long)live_n,
+             (unsigned long long)live_b, (unsigned long long)alloc_n, (unsigned long long)alloc_b,
+             (unsigned long)s_mean);
+    write(line, arg);
+
+    for (uint32_t i = 0; i < HEAP_SAMPLE_SITES; i++)
+    {
+        heap_sample_site_t s;
+        if (!copy_site(i, &s) || s.alloc_count == 0)
+            continue;
+        int off = snprintf(line, sizeof(line), "%lu: %llu [%lu: %llu] @", (unsigned long)s.live_count,
+                           (unsigned long long)s.live_bytes, (unsigned long)s.alloc_count,
+                           (unsigned long long)s.alloc_bytes);
+        for (uint32_t d = 0; d < s.depth && off > 0 && (size_t)off < sizeof(line); d++)
+            off += snprintf(line + off, sizeof(line) - (size_t)off, " 0x%08lx", (unsigned long)s.pc[d]);
+        if (off > 0 && (size_t)off < sizeof(line) - 1)
+        {
+            line[off++] = '\n';
+            line[off] = '\0';
+        }
+        write(line, arg);
+        n++;
+    }
+    // mapping ครอบทั้ง address space (start=0, offset=0) → pprof ใช้ address ตรง ๆ กับ ELF ที่ให้มา
+    write("\nMAPPED_LIBRARIES:\n00000000-ffffffff r-xp 00000000 00:00 0 firmware.elf\n", arg);
+    return n;
+}
+
+void heap_sample_reset(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    for (uint32_t i = 0; i < HEAP_SAMPLE_SITES; i++)
+    {
+        s_sites[i].alloc_count = 0;
+        s_sites[i].alloc_bytes = 0;
+    }
+    s_stats.samples = 0;
+    s_stats.live_dropped = 0;
+    s_stats.site_dropped = 0;
+    taskEXIT_CRITICAL(&s_lock);
+}
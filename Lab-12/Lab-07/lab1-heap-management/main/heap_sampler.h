@@ -0,0 +1,95 @@
+#ifndef HEAP_SAMPLER_H
+#define HEAP_SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef HEAP_SAMPLE_MEAN_BYTES
+#define HEAP_SAMPLE_MEAN_BYTES 16384 // สุ่มเฉลี่ย 1 ครั้งต่อทุก ๆ N byte ที่ allocate (0 = ปิด)
+#endif
+
+#ifndef HEAP_SAMPLE_DEPTH
+#define HEAP_SAMPLE_DEPTH 4 // จำนวน frame ต่อ call site (frame แรก = ผู้เรียก tracked_malloc)
+#endif
+
+#ifndef HEAP_SAMPLE_SITES
+#define HEAP_SAMPLE_SITES 128 // จำนวน call site ที่แยกเก็บได้ (กำลังสอง)
+#endif
+
+#ifndef HEAP_SAMPLE_MAX_LIVE
+#define HEAP_SAMPLE_MAX_LIVE 512 // sample ที่ยังไม่ถูก free ได้พร้อมกัน (ใช้คิด in-use bytes)
+#endif
+
+/* ======================
+ * Sampling heap profiler
+ * ======================
+ * hot path: นับถอยหลัง byte ต่อ core — ถึง 0 เมื่อไหร่ค่อยเก็บ sample (ระยะห่างสุ่มแบบ exponential
+ * เฉลี่ย HEAP_SAMPLE_MEAN_BYTES → ทุก byte มีโอกาสถูกสุ่มเท่ากัน ไม่ลำเอียงตามรูปแบบขนาด)
+ * sample เก็บ backtrace สั้น ๆ แล้วรวมยอดต่อ call site ในตารางขนาดคงที่
+ * free: filter 256 ช่อง (ตัวนับต่อ hash) ตัดสินว่า pointer นี้อาจเป็น sample หรือไม่โดยไม่ต้องถือ lock
+ * dump: legacy heap profile ("heap profile: ... @ heap_v2/<rate>") ที่ pprof อ่านได้และ unsample เอง
+ */
+typedef struct
+{
+    uintptr_t pc[HEAP_SAMPLE_DEPTH];
+    uint32_t depth;
+    uint32_t alloc_count; // จำนวน sample (ยังไม่ scale)
+    uint64_t alloc_bytes;
+    uint32_t live_count;
+    uint64_t live_bytes;
+} heap_sample_site_t;
+
+typedef struct
+{
+    uint32_t samples;
+    uint32_t live_dropped; // map ของ sample ที่ยัง live เต็ม → นับแค่ยอด alloc
+    uint32_t site_dropped; // ตาราง call site เต็ม
+    uint32_t sites;
+    uint32_t mean_bytes;
+} heap_sample_stats_t;
+
+typedef void (*heap_sample_write_fn)(const char *text, void *arg);
+
+extern int32_t g_heap_sample_countdown[portNUM_PROCESSORS];
+extern uint8_t g_heap_sample_filter[256];
+
+void heap_sample_init(uint32_t mean_bytes);
+void heap_sample_record(void *ptr, size_t size, void *caller);
+void heap_sample_forget(void *ptr);
+
+// hot path: true = allocation นี้ควรถูก sample (เรียก heap_sample_record ต่อ)
+// task อาจย้าย core ระหว่างอ่าน/เขียนตัวนับได้ — ผลคือ sample คลาดไปเล็กน้อย ไม่กระทบความถูกต้อง
+static inline bool heap_sample_should(size_t size)
+{
+    int32_t *c = &g_heap_sample_countdown[xPortGetCoreID()];
+    *c -= (int32_t)size;
+    return *c <= 0;
+}
+
+static inline uint32_t heap_sample_filter_slot(const void *ptr)
+{
+    uint32_t h = (uint32_t)(uintptr_t)ptr * 0x9E3779B1u;
+    return h >> 24;
+}
+
+// hot path ของ free: ส่วนใหญ่จบที่ load เดียว
+static inline void heap_sample_on_free(void *ptr)
+{
+    if (__atomic_load_n(&g_heap_sample_filter[heap_sample_filter_slot(ptr)], __ATOMIC_RELAXED))
+        heap_sample_forget(ptr);
+}
+
+void heap_sample_get_stats(heap_sample_stats_t *out);
+// ประมาณยอดจริงจาก sample (สำหรับ log) — pprof ใช้ค่า raw จาก dump แล้วคำนวณเอง
+void heap_sample_print_top(int n);
+size_t heap_sample_dump(heap_sample_write_fn write, void *arg);
+void heap_sample_reset(void);
+
+#endif // HEAP_SAMPLER_H
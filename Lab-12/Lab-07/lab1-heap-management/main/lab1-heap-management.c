@@ -15,6 +15,7 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 #include "esp_random.h" // ✅ IDF 5+ ต้อง include แยก
+#include "esp_memory_utils.h"
 #include "driver/gpio.h"
 
 // (ถ้ามีในโปรเจ็กต์) เดโม shared memory
@@ -23,6 +24,25 @@
 // mbedTLS AES (มากับ ESP-IDF อยู่แล้ว)
 #include "mbedtls/aes.h"
 
+// ownership map ร่วมกับ lab2 (components/mem_ownmap)
+#include "mem_ownmap.h"
+
+// pointer → record แบบ O(1) (hash table แบ่ง stripe)
+#include "alloc_tracker.h"
+
+// sampling profiler: สุ่ม allocation ตาม byte แล้วรวมยอดต่อ call site (dump ให้ pprof)
+#include "heap_sampler.h"
+
+// Relocatable heap: handle + pin, compaction เบื้องหลัง
+#include "reloc_heap.h"
+
+// บีบอัด: RLE ทีละ word + LZ ตระกูล LZ4 (streaming API) และ store ของ buffer ที่ไม่ค่อยถูกแตะ
+#include "mem_codec.h"
+#include "cold_store.h"
+
+// TLSF (components/tlsf): region แยกของ allocation อายุยาว
+#include "tlsf.h"
+
 /* =========================
  *      CONFIG / DEFINES
  * ========================= */
@@ -40,7 +60,54 @@ static const char *TAG = "HEAP_MGMT";
 #define LOW_MEMORY_THRESHOLD 50000      // 50KB
 #define CRITICAL_MEMORY_THRESHOLD 20000 // 20KB
 #define FRAGMENTATION_THRESHOLD 0.30f
-#define MAX_ALLOCATIONS 100
+#define MP_LARGEST_LOW 16384     // largest free block (internal) ต่ำกว่านี้ = pressure LOW (แม้ free รวมยังเหลือ)
+#define MP_LARGEST_CRITICAL 8192 // ต่ำกว่านี้ = CRITICAL
+#define MP_POLL_MS 250           // MemPressure task ตรวจระดับทุกเท่านี้ (= ความละเอียดของ recovery time)
+#define MP_REPEAT_MS 2000        // ระดับยังไม่ลด → reclaim ซ้ำได้ทุกเท่านี้
+#define MP_SYNC_WAIT_MS 20       // tracked_malloc ที่ล้มเหลวรอคนที่กำลัง reclaim อยู่ได้นานเท่านี้
+#define MP_MAX_HANDLERS 8
+
+// จำนวน allocation ที่ track พร้อมกันได้ (slab จองตอนบูต ~24 byte/entry)
+#ifndef TRACK_CAPACITY_SPIRAM
+#define TRACK_CAPACITY_SPIRAM 16384
+#endif
+#ifndef TRACK_CAPACITY_INTERNAL
+#define TRACK_CAPACITY_INTERNAL 2048
+#endif
+#define TRACK_LIST_MAX 32 // print_allocation_summary แสดงไม่เกินนี้ (ที่เหลือแสดงเป็นจำนวน)
+#define TRACK_CAP_MANUAL MALLOC_CAP_INVALID // ติดใน caps ของ record จาก register_allocation_manual (ไม่ใช่ block ของ heap_caps)
+
+#define HEAP_SAMPLE_TOP 5          // call site ที่แสดงทุกรอบของ monitor
+#define HEAP_SAMPLE_DUMP_EVERY 6   // dump profile ทุก N รอบของ monitor (0 = ไม่ dump)
+
+#define RHEAP_BYTES (24 * 1024)     // region ของ handle heap (internal RAM)
+#define RHEAP_MAX_HANDLES 256
+#define RHEAP_STEP_BUDGET_US 500    // เวลาสูงสุดต่อขั้นของ compaction เบื้องหลัง (แล้วคืน CPU 1 tick)
+#define RHEAP_COMPACT_PERIOD_MS 5000 // compactor ตื่นมาเช็คเองถ้าไม่มีใครปลุก
+
+#define COLD_MAX_ENTRIES 32
+#define COLD_IDLE_MS 3000   // สำเนาที่คลายไว้ไม่ถูกแตะเกินนี้ → sweep บีบกลับ
+#define COLD_LOG_CHUNK 2048 // ขนาด log ต่อ entry ของ ColdLog task
+#define COLD_LOG_KEEP 16    // entry ล่าสุดที่เก็บ (pressure CRITICAL ทิ้งครึ่งที่เก่ากว่า)
+
+#ifndef LT_POLICY_ENABLE
+#define LT_POLICY_ENABLE 1 // 0 = lt_malloc ไป heap ตรงทั้งหมด (ยังเรียนรู้อยู่) — ไว้เทียบ soak แบบ A/B
+#endif
+#define LT_SITES 64             // description ที่เรียนรู้ได้พร้อมกัน (กำลังสอง)
+#define LT_MIN_SAMPLES 8        // ต้องเห็นอย่างน้อยเท่านี้ก่อนตัดสิน
+#define LT_SHORT_MS 5000        // อายุเฉลี่ยต่ำกว่านี้ = transient → dpool
+#define LT_LONG_MS 60000        // อายุเฉลี่ยเกินนี้ หรือแทบไม่เคยคืนนานเท่านี้ = long-lived → region แยก
+#define LT_LONG_BYTES (24 * 1024)
+
+#ifndef IC_BUDGET_US
+#define IC_BUDGET_US 300 // เวลาต่อครั้งของ integrity checker แบบ incremental (ตรวจทีละชิ้นจนหมด budget)
+#endif
+#define IC_PERIOD_MS 200  // heap_integrity_test_task เรียกทุกเท่านี้
+#define IC_TRACK_SLICE 32 // slot ของ tracker ต่อชิ้น
+#define IC_TLSF_SLICE 16  // block ของ TLSF ต่อชิ้น (ต่อการปิด interrupt หนึ่งครั้ง)
+#ifndef IC_FULL_SCAN_DEBUG
+#define IC_FULL_SCAN_DEBUG 0 // 1 = monitor เรียก heap_caps_check_integrity_all ทุกรอบด้วย (debug: หยุดทั้งระบบตามขนาด heap)
+#endif
 
 #ifndef ALIGN_UP
 #define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
@@ -51,21 +118,6 @@ static const char *TAG = "HEAP_MGMT";
  * ========================= */
 typedef struct
 {
-    void *ptr;
-    size_t size;
-    uint32_t caps;
-    const char *description;
-    uint64_t timestamp;
-    bool is_active;
-} memory_allocation_t;
-
-typedef struct
-{
-    uint32_t total_allocations;
-    uint32_t total_deallocations;
-    uint32_t current_allocations;
-    uint64_t total_bytes_allocated;
-    uint64_t total_bytes_deallocated;
     uint64_t peak_usage;
     uint32_t allocation_failures;
     uint32_t fragmentation_events;
@@ -75,198 +127,340 @@ typedef struct
 /* =========================
  *        GLOBALS
  * ========================= */
-static memory_allocation_t allocations[MAX_ALLOCATIONS];
-static memory_stats_t stats = {0};
-static SemaphoreHandle_t memory_mutex = NULL;
+static memory_stats_t stats = {0}; // ตัวนับ alloc/free/bytes อยู่ใน tracker (ต่อ stripe), ที่นี่เหลือ event/peak
 static bool memory_monitoring_enabled = true;
+static bool tracking_verbose = true; // log ทุก alloc/free (benchmark ปิดชั่วคราว)
+static size_t current_tracked_bytes = 0;
+static rheap_t g_rheap;
+static bool g_rheap_ready = false;
+static TaskHandle_t g_rheap_compactor = NULL;
+
+static cold_store_t g_cold;
+static bool g_cold_ready = false;
 
 /* =========================
  *  FORWARD DECLARATIONS
  * ========================= */
 // tracking helpers
-static int find_free_allocation_slot(void);
-static int find_allocation_by_ptr(void *ptr);
-static void *tracked_malloc(size_t size, uint32_t caps, const char *description);
+static void *tracked_malloc(size_t size, uint32_t caps, const char *description) __attribute__((noinline));
 static void tracked_free(void *ptr, const char *description);
 
 // manual register helpers (สำหรับ memory pool หรือ arena)
-static void register_allocation_manual(void *ptr, size_t size, uint32_t caps, const char *description);
-static void unregister_allocation_manual(void *ptr, const char *description);
+static bool register_allocation_manual(void *ptr, size_t size, uint32_t caps, const char *description);
+static bool unregister_allocation_manual(void *ptr, const char *description);
 
 // memory analytics
 static void analyze_memory_status(void);
 static void print_allocation_summary(void);
 static void detect_memory_leaks(void);
-
-// RLE helpers
-static size_t rle_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity);
-static size_t rle_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity);
+static void lt_log_status(void);
 
 // secure memory helpers
 static void secure_wipe(void *p, size_t n);
 
+/* =========================
+ *   MEMORY PRESSURE BUS
+ * ========================= */
+// component ลง callback คืนหน่วยความจำพร้อม priority (เลขน้อย = ถูก/ไม่เสียข้อมูล → เรียกก่อน) และระดับต่ำสุดที่ยอมถูกเรียก
+// - mp_poll (MemPressure task): internal free / largest free block ข้ามเกณฑ์ขึ้น → เรียกตาม priority จนระดับลดลง
+// - tracked_malloc ล้มเหลว → mp_reclaim_sync เรียกทุกตัวจน block ใหญ่สุดพอ แล้วลองใหม่ 1 ครั้ง
+// - recovery time = ตั้งแต่ออกจาก NONE จนกลับมา NONE (ละเอียดเท่า MP_POLL_MS)
+// callback ถูกเรียกนอก critical section แต่ถือ s_mp_lock: จองหน่วยความจำเองได้ (ล้มเหลวก็ไม่ reclaim ซ้อน)
+typedef enum
+{
+    MP_NONE = 0,
+    MP_LOW,
+    MP_CRITICAL,
+} mp_level_t;
+
+typedef void (*mp_reclaim_fn)(mp_level_t level, void *arg);
+
+typedef struct
+{
+    const char *name;
+    mp_reclaim_fn fn;
+    void *arg;
+    uint8_t prio;
+    uint8_t min_level;
+    uint32_t calls;
+    uint64_t freed; // free heap ที่เพิ่มขึ้นระหว่าง callback (วัดจริง ไม่ใช่ที่ component อ้าง)
+} mp_handler_t;
+
+typedef struct
+{
+    uint32_t spikes;       // ออกจาก NONE
+    uint32_t reclaims;     // รอบ reclaim จาก poll
+    uint32_t sync_attempts;
+    uint32_t sync_rescued; // tracked_malloc ที่ล้มเหลวแล้วได้หลัง reclaim
+    uint64_t freed;
+    int64_t spike_us;
+    int64_t last_reclaim_us;
+    uint32_t last_recovery_ms;
+    uint32_t max_recovery_ms;
+} mp_stats_t;
+
+static mp_handler_t s_mp[MP_MAX_HANDLERS]; // เรียงตาม prio
+static int s_mp_count = 0;
+static SemaphoreHandle_t s_mp_lock = NULL; // handler ทำงานได้ทีละคน
+static mp_level_t s_mp_level = MP_NONE;
+static mp_stats_t s_mp_stats;
+
+static const char *mp_level_name(mp_level_t lv) { return lv == MP_CRITICAL ? "CRITICAL" : lv == MP_LOW ? "LOW" : "OK"; }
+
+static mp_level_t mp_classify(size_t internal_free, size_t internal_largest)
+{
+    if (internal_free < CRITICAL_MEMORY_THRESHOLD || internal_largest < MP_LARGEST_CRITICAL)
+        return MP_CRITICAL;
+    if (internal_free < LOW_MEMORY_THRESHOLD || internal_largest < MP_LARGEST_LOW)
+        return MP_LOW;
+    return MP_NONE;
+}
+
+static mp_level_t mp_current_level(void)
+{
+    return mp_classify(heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                       heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+}
+
+static bool mp_init(void)
+{
+    s_mp_lock = xSemaphoreCreateMutex();
+    return s_mp_lock != NULL;
+}
+
+// prio เท่ากัน: ลงก่อนเรียกก่อน
+static bool mp_register(const char *name, uint8_t prio, mp_level_t min_level, mp_reclaim_fn fn, void *arg)
+{
+    if (!s_mp_lock || !fn)
+        return false;
+    xSemaphoreTake(s_mp_lock, portMAX_DELAY);
+    bool ok = s_mp_count < MP_MAX_HANDLERS;
+    if (ok)
+    {
+        int i = s_mp_count++;
+        for (; i > 0 && s_mp[i - 1].prio > prio; i--)
+            s_mp[i] = s_mp[i - 1];
+        s_mp[i] = (mp_handler_t){name, fn, arg, prio, (uint8_t)min_level, 0, 0};
+    }
+    xSemaphoreGive(s_mp_lock);
+    return ok;
+}
+
+// ถือ s_mp_lock: เรียกตาม priority จนพอ (need > 0: block ใหญ่สุดของ caps ≥ need, ไม่งั้น: ระดับลดลงต่ำกว่า level)
+static size_t mp_run_locked(mp_level_t level, size_t need, uint32_t caps)
+{
+    size_t total = 0;
+    for (int i = 0; i < s_mp_count; i++)
+    {
+        mp_handler_t *h = &s_mp[i];
+        if (h->min_level > level)
+            continue;
+        size_t before = esp_get_free_heap_size();
+        h->fn(level, h->arg);
+        size_t after = esp_get_free_heap_size();
+        size_t got = after > before ? after - before : 0;
+        h->calls++;
+        h->freed += got;
+        total += got;
+        if (need ? heap_caps_get_largest_free_block(caps) >= need : mp_current_level() < level)
+            break;
+    }
+    s_mp_stats.freed += total;
+    return total;
+}
+
+// เรียกเป็นระยะ: ระดับสูงขึ้น (หรือค้างนานเกิน MP_REPEAT_MS) → reclaim; กลับ NONE → บันทึก recovery time
+static mp_level_t mp_poll(void)
+{
+    if (!s_mp_lock)
+        return MP_NONE;
+    xSemaphoreTake(s_mp_lock, portMAX_DELAY);
+    mp_level_t lv = mp_current_level();
+    int64_t now = esp_timer_get_time();
+    if (lv > MP_NONE && s_mp_level == MP_NONE)
+    {
+        s_mp_stats.spikes++;
+        s_mp_stats.spike_us = now;
+    }
+    if (lv > s_mp_level || (lv > MP_NONE && now - s_mp_stats.last_reclaim_us >= MP_REPEAT_MS * 1000LL))
+    {
+        s_mp_stats.reclaims++;
+        s_mp_stats.last_reclaim_us = now;
+        size_t got = mp_run_locked(lv, 0, 0);
+        mp_level_t after = mp_current_level();
+        ESP_LOGW(TAG, "🫧 memory pressure %s: reclaimed %u B → %s", mp_level_name(lv), (unsigned)got,
+                 mp_level_name(after));
+        lv = after;
+        now = esp_timer_get_time();
+    }
+    if (lv == MP_NONE && s_mp_level != MP_NONE)
+    {
+        s_mp_stats.last_recovery_ms = (uint32_t)((now - s_mp_stats.spike_us) / 1000);
+        if (s_mp_stats.last_recovery_ms > s_mp_stats.max_recovery_ms)
+            s_mp_stats.max_recovery_ms = s_mp_stats.last_recovery_ms;
+    }
+    s_mp_level = lv;
+    xSemaphoreGive(s_mp_lock);
+    return lv;
+}
+
+// tracked_malloc ล้มเหลว: reclaim ทุกระดับทันที; true = ควรลองจองใหม่
+static bool mp_reclaim_sync(size_t size, uint32_t caps)
+{
+    if (!s_mp_lock || xSemaphoreGetMutexHolder(s_mp_lock) == xTaskGetCurrentTaskHandle())
+        return false; // handler เองจองไม่ได้ → ไม่ reclaim ซ้อน
+    if (xSemaphoreTake(s_mp_lock, pdMS_TO_TICKS(MP_SYNC_WAIT_MS)) != pdTRUE)
+        return false;
+    s_mp_stats.sync_attempts++;
+    if (s_mp_level == MP_NONE)
+    {
+        // spike ที่ poll ยังไม่ทันเห็น → เริ่มนับ recovery จากตรงนี้
+        s_mp_level = MP_CRITICAL;
+        s_mp_stats.spikes++;
+        s_mp_stats.spike_us = esp_timer_get_time();
+    }
+    size_t got = mp_run_locked(MP_CRITICAL, size ? size : 1, caps);
+    xSemaphoreGive(s_mp_lock);
+    return got > 0 || heap_caps_get_largest_free_block(caps) >= size;
+}
+
 /* =========================
  *   TRACKING UTILITIES
  * ========================= */
-static int find_free_allocation_slot(void)
+// peak ของ byte ที่ track อยู่ (atomic: tracker ไม่มี lock รวมแล้ว)
+static void track_note_bytes(size_t add, size_t sub)
 {
-    for (int i = 0; i < MAX_ALLOCATIONS; i++)
+    size_t cur = __atomic_add_fetch(&current_tracked_bytes, add - sub, __ATOMIC_RELAXED);
+    uint64_t peak = __atomic_load_n(&stats.peak_usage, __ATOMIC_RELAXED);
+    while (cur > peak &&
+           !__atomic_compare_exchange_n(&stats.peak_usage, &peak, (uint64_t)cur, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
     {
-        if (!allocations[i].is_active)
-            return i;
     }
-    return -1;
 }
 
-static int find_allocation_by_ptr(void *ptr)
+static void track_overflow_warn(void *ptr, const char *description)
 {
-    for (int i = 0; i < MAX_ALLOCATIONS; i++)
+    // เตือนเป็นระยะ ไม่ใช่ทุกครั้ง (เดิมเต็มแล้วเงียบ)
+    static uint32_t last_ms = 0;
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+    if (now_ms - last_ms > 1000)
     {
-        if (allocations[i].is_active && allocations[i].ptr == ptr)
-            return i;
+        last_ms = now_ms;
+        ESP_LOGW(TAG, "⚠️ Allocation tracking full! %p (%s) not tracked", ptr, description ? description : "-");
     }
-    return -1;
 }
 
-static void *tracked_malloc(size_t size, uint32_t caps, const char *description)
+// track = false: sampler อย่างเดียว ไม่แตะ tracker (site = call site สำหรับ profiler)
+static inline void *tracked_malloc_impl(size_t size, uint32_t caps, const char *description, bool track, void *site)
 {
     void *ptr = heap_caps_malloc(size, caps);
+    if (!ptr && size && mp_reclaim_sync(size, caps))
+    {
+        ptr = heap_caps_malloc(size, caps);
+        if (ptr)
+            __atomic_add_fetch(&s_mp_stats.sync_rescued, 1, __ATOMIC_RELAXED);
+    }
 
-    if (memory_monitoring_enabled && memory_mutex)
+    // sampler ทำงานแม้ปิด monitoring: hot path คือการลบตัวนับ 1 ครั้ง
+    if (ptr && heap_sample_should(size))
+        heap_sample_record(ptr, size, site);
+
+    if (track)
     {
-        if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+        if (ptr)
         {
-            if (ptr)
+            if (alloc_track_insert(ptr, size, caps, description))
             {
-                int slot = find_free_allocation_slot();
-                if (slot >= 0)
-                {
-                    allocations[slot].ptr = ptr;
-                    allocations[slot].size = size;
-                    allocations[slot].caps = caps;
-                    allocations[slot].description = description;
-                    allocations[slot].timestamp = esp_timer_get_time();
-                    allocations[slot].is_active = true;
-
-                    stats.total_allocations++;
-                    stats.current_allocations++;
-                    stats.total_bytes_allocated += size;
-
-                    size_t current_usage = stats.total_bytes_allocated - stats.total_bytes_deallocated;
-                    if (current_usage > stats.peak_usage)
-                        stats.peak_usage = current_usage;
-
+                track_note_bytes(size, 0);
+                if (tracking_verbose)
                     ESP_LOGI(TAG, "✅ Allocated %u bytes at %p (%s)",
                              (unsigned)size, ptr, description ? description : "-");
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "⚠️ Allocation tracking full!");
-                }
             }
             else
             {
-                stats.allocation_failures++;
-                ESP_LOGE(TAG, "❌ Failed to allocate %u bytes (%s)",
-                         (unsigned)size, description ? description : "-");
+                track_overflow_warn(ptr, description);
             }
-            xSemaphoreGive(memory_mutex);
+        }
+        else
+        {
+            __atomic_add_fetch(&stats.allocation_failures, 1, __ATOMIC_RELAXED);
+            ESP_LOGE(TAG, "❌ Failed to allocate %u bytes (%s)",
+                     (unsigned)size, description ? description : "-");
         }
     }
     return ptr;
 }
 
-static void tracked_free(void *ptr, const char *description)
+// noinline: __builtin_return_address(0) ต้องเป็นผู้เรียกจริง (call site ของ profiler)
+static void *tracked_malloc(size_t size, uint32_t caps, const char *description)
+{
+    return tracked_malloc_impl(size, caps, description, memory_monitoring_enabled, __builtin_return_address(0));
+}
+
+static inline void tracked_free_impl(void *ptr, const char *description, bool track)
 {
     if (!ptr)
         return;
 
-    if (memory_monitoring_enabled && memory_mutex)
+    if (track)
     {
-        if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+        alloc_track_entry_t e;
+        if (alloc_track_remove(ptr, &e))
         {
-            int slot = find_allocation_by_ptr(ptr);
-            if (slot >= 0)
-            {
-                allocations[slot].is_active = false;
-                stats.total_deallocations++;
-                stats.current_allocations--;
-                stats.total_bytes_deallocated += allocations[slot].size;
-
+            track_note_bytes(0, e.size);
+            if (tracking_verbose)
                 ESP_LOGI(TAG, "🗑️ Freed %u bytes at %p (%s)",
-                         (unsigned)allocations[slot].size, ptr, description ? description : "-");
-            }
-            else
-            {
-                ESP_LOGW(TAG, "⚠️ Freeing untracked pointer %p (%s)", ptr, description ? description : "-");
-            }
-            xSemaphoreGive(memory_mutex);
+                         (unsigned)e.size, ptr, description ? description : "-");
+        }
+        else
+        {
+            ESP_LOGW(TAG, "⚠️ Freeing untracked pointer %p (%s)", ptr, description ? description : "-");
         }
     }
+    heap_sample_on_free(ptr);
     heap_caps_free(ptr);
 }
 
+static void tracked_free(void *ptr, const char *description)
+{
+    tracked_free_impl(ptr, description, memory_monitoring_enabled);
+}
+
 /* =========================
  *  MANUAL REGISTER HELPERS
  * ========================= */
-static void register_allocation_manual(void *ptr, size_t size, uint32_t caps, const char *description)
+static bool register_allocation_manual(void *ptr, size_t size, uint32_t caps, const char *description)
 {
-    if (!ptr || !memory_mutex)
-        return;
-    if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+    if (!ptr)
+        return false;
+    if (alloc_track_insert(ptr, size, caps | TRACK_CAP_MANUAL, description))
     {
-        int slot = find_free_allocation_slot();
-        if (slot >= 0)
-        {
-            allocations[slot].ptr = ptr;
-            allocations[slot].size = size;
-            allocations[slot].caps = caps;
-            allocations[slot].description = description;
-            allocations[slot].timestamp = esp_timer_get_time();
-            allocations[slot].is_active = true;
-
-            stats.total_allocations++;
-            stats.current_allocations++;
-            stats.total_bytes_allocated += size;
-
-            size_t current_usage = stats.total_bytes_allocated - stats.total_bytes_deallocated;
-            if (current_usage > stats.peak_usage)
-                stats.peak_usage = current_usage;
-
+        track_note_bytes(size, 0);
+        if (tracking_verbose)
             ESP_LOGI(TAG, "✅ Registered manual %u bytes at %p (%s)",
                      (unsigned)size, ptr, description ? description : "-");
-        }
-        else
-        {
-            ESP_LOGW(TAG, "⚠️ Manual tracking full for %p (%s)", ptr, description ? description : "-");
-        }
-        xSemaphoreGive(memory_mutex);
+        return true;
     }
+    ESP_LOGW(TAG, "⚠️ Manual tracking full for %p (%s)", ptr, description ? description : "-");
+    return false;
 }
 
-static void unregister_allocation_manual(void *ptr, const char *description)
+// คืน false ถ้า tracker ไม่มี record ของ ptr (free ซ้ำ หรือไม่เคย register)
+static bool unregister_allocation_manual(void *ptr, const char *description)
 {
-    if (!ptr || !memory_mutex)
-        return;
-    if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+    if (!ptr)
+        return false;
+    alloc_track_entry_t e;
+    if (alloc_track_remove(ptr, &e))
     {
-        int slot = find_allocation_by_ptr(ptr);
-        if (slot >= 0)
-        {
-            allocations[slot].is_active = false;
-            stats.total_deallocations++;
-            stats.current_allocations--;
-            stats.total_bytes_deallocated += allocations[slot].size;
-
+        track_note_bytes(0, e.size);
+        if (tracking_verbose)
             ESP_LOGI(TAG, "🗑️ Unregistered manual %u bytes at %p (%s)",
-                     (unsigned)allocations[slot].size, ptr, description ? description : "-");
-        }
-        else
-        {
-            ESP_LOGW(TAG, "⚠️ Unregister: pointer not found %p (%s)", ptr, description ? description : "-");
-        }
-        xSemaphoreGive(memory_mutex);
+                     (unsigned)e.size, ptr, description ? description : "-");
+        return true;
     }
+    ESP_LOGW(TAG, "⚠️ Unregister: pointer not found %p (%s)", ptr, description ? description : "-");
+    return false;
 }
 
 /* =========================
@@ -291,7 +485,9 @@ static void analyze_memory_status(void)
     ESP_LOGI(TAG, "Minimum Ever Free:    %u", (unsigned)esp_get_minimum_free_heap_size());
     ESP_LOGI(TAG, "Internal Fragmentation: %.1f%%", internal_fragmentation * 100.0f);
 
-    if (internal_free < CRITICAL_MEMORY_THRESHOLD)
+    // ระดับเดียวกับ pressure bus (free รวม + largest block); reclaim เกิดใน MemPressure task / ตอนจองล้มเหลว
+    mp_level_t level = mp_classify(internal_free, internal_largest);
+    if (level == MP_CRITICAL)
     {
         gpio_set_level(LED_MEMORY_ERROR, 1);
         gpio_set_level(LED_LOW_MEMORY, 1);
@@ -299,7 +495,7 @@ static void analyze_memory_status(void)
         stats.low_memory_events++;
         ESP_LOGW(TAG, "🚨 CRITICAL: Very low memory!");
     }
-    else if (internal_free < LOW_MEMORY_THRESHOLD)
+    else if (level == MP_LOW)
     {
         gpio_set_level(LED_LOW_MEMORY, 1);
         gpio_set_level(LED_MEMORY_ERROR, 0);
@@ -325,159 +521,118 @@ static void analyze_memory_status(void)
         gpio_set_level(LED_FRAGMENTATION, 0);
     }
 
+    // block ของ heap_caps ย้ายไม่ได้ แต่ของ handle heap ย้ายได้ → fragment เกินเกณฑ์ก็ปลุก compactor
+    if (g_rheap_ready)
+    {
+        rheap_stats_t rs;
+        rheap_get_stats(&g_rheap, &rs);
+        ESP_LOGI(TAG, "Handle Heap:          live=%lu free=%u largest=%u frag=%.1f%% moved=%lu",
+                 (unsigned long)rs.live, (unsigned)rs.free_bytes, (unsigned)rs.largest_free,
+                 rs.fragmentation * 100.0f, (unsigned long)rs.moves);
+        if (rs.fragmentation > FRAGMENTATION_THRESHOLD && g_rheap_compactor)
+            xTaskNotifyGive(g_rheap_compactor);
+    }
+    if (g_cold_ready)
+    {
+        cold_stats_t cst;
+        cold_get_stats(&g_cold, &cst);
+        ESP_LOGI(TAG, "Cold Store:           entries=%lu hot=%lu raw=%u stored=%u (%.1f%%) decomp=%lu",
+                 (unsigned long)cst.entries, (unsigned long)cst.hot, (unsigned)cst.raw_bytes,
+                 (unsigned)cst.stored_bytes, cst.raw_bytes ? 100.0f * (float)cst.stored_bytes / (float)cst.raw_bytes : 0.0f,
+                 (unsigned long)cst.decompressions);
+    }
+    lt_log_status();
+    ESP_LOGI(TAG, "Mem Pressure:         %s spikes=%lu reclaims=%lu freed=%llu sync=%lu/%lu recovery last=%lu max=%lu ms",
+             mp_level_name(s_mp_level), (unsigned long)s_mp_stats.spikes, (unsigned long)s_mp_stats.reclaims,
+             (unsigned long long)s_mp_stats.freed, (unsigned long)s_mp_stats.sync_rescued,
+             (unsigned long)s_mp_stats.sync_attempts, (unsigned long)s_mp_stats.last_recovery_ms,
+             (unsigned long)s_mp_stats.max_recovery_ms);
+
     gpio_set_level(LED_SPIRAM_ACTIVE, spiram_free > 0 ? 1 : 0);
     ESP_LOGI(TAG, "═══════════════════════════════");
 }
 
-static void print_allocation_summary(void)
+typedef struct
 {
-    if (!memory_mutex)
+    uint64_t now_us;
+    int shown;
+    int hidden;
+    int leak_count;
+    size_t leaked_bytes;
+} track_visit_t;
+
+static void summary_visit(const alloc_track_entry_t *e, void *arg)
+{
+    track_visit_t *v = (track_visit_t *)arg;
+    if (v->shown >= TRACK_LIST_MAX)
+    {
+        v->hidden++;
         return;
-    if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
-    {
-        ESP_LOGI(TAG, "\n📈 ═══ ALLOCATION STATISTICS ═══");
-        ESP_LOGI(TAG, "Total Allocations:    %lu", (unsigned long)stats.total_allocations);
-        ESP_LOGI(TAG, "Total Deallocations:  %lu", (unsigned long)stats.total_deallocations);
-        ESP_LOGI(TAG, "Current Allocations:  %lu", (unsigned long)stats.current_allocations);
-        ESP_LOGI(TAG, "Total Allocated:      %llu", (unsigned long long)stats.total_bytes_allocated);
-        ESP_LOGI(TAG, "Total Deallocated:    %llu", (unsigned long long)stats.total_bytes_deallocated);
-        ESP_LOGI(TAG, "Peak Usage:           %llu", (unsigned long long)stats.peak_usage);
-        ESP_LOGI(TAG, "Allocation Failures:  %lu", (unsigned long)stats.allocation_failures);
-        ESP_LOGI(TAG, "Fragmentation Events: %lu", (unsigned long)stats.fragmentation_events);
-        ESP_LOGI(TAG, "Low Memory Events:    %lu", (unsigned long)stats.low_memory_events);
-
-        if (stats.current_allocations > 0)
-        {
-            ESP_LOGI(TAG, "\n🔍 ═══ ACTIVE ALLOCATIONS ═══");
-            for (int i = 0; i < MAX_ALLOCATIONS; i++)
-            {
-                if (allocations[i].is_active)
-                {
-                    uint64_t age_ms = (esp_timer_get_time() - allocations[i].timestamp) / 1000ULL;
-                    ESP_LOGI(TAG, "Slot %d: %u bytes @%p (%s) age=%llu ms",
-                             i, (unsigned)allocations[i].size, allocations[i].ptr,
-                             allocations[i].description ? allocations[i].description : "-",
-                             (unsigned long long)age_ms);
-                }
-            }
-        }
-        xSemaphoreGive(memory_mutex);
     }
+    uint32_t age_ms = (uint32_t)(v->now_us / 1000ULL) - e->timestamp_ms;
+    ESP_LOGI(TAG, "#%d: %u bytes @%p (%s) age=%lu ms",
+             v->shown, (unsigned)e->size, e->ptr, e->description ? e->description : "-", (unsigned long)age_ms);
+    v->shown++;
 }
 
-static void detect_memory_leaks(void)
+static void print_allocation_summary(void)
 {
-    if (!memory_mutex)
-        return;
-    if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
+    alloc_track_stats_t ts;
+    alloc_track_get_stats(&ts);
+
+    ESP_LOGI(TAG, "\n📈 ═══ ALLOCATION STATISTICS ═══");
+    ESP_LOGI(TAG, "Total Allocations:    %lu", (unsigned long)ts.inserts);
+    ESP_LOGI(TAG, "Total Deallocations:  %lu", (unsigned long)ts.removes);
+    ESP_LOGI(TAG, "Current Allocations:  %lu", (unsigned long)ts.live);
+    ESP_LOGI(TAG, "Total Allocated:      %llu", (unsigned long long)ts.bytes_in);
+    ESP_LOGI(TAG, "Total Deallocated:    %llu", (unsigned long long)ts.bytes_out);
+    ESP_LOGI(TAG, "Peak Usage:           %llu", (unsigned long long)stats.peak_usage);
+    ESP_LOGI(TAG, "Allocation Failures:  %lu", (unsigned long)stats.allocation_failures);
+    ESP_LOGI(TAG, "Fragmentation Events: %lu", (unsigned long)stats.fragmentation_events);
+    ESP_LOGI(TAG, "Low Memory Events:    %lu", (unsigned long)stats.low_memory_events);
+    ESP_LOGI(TAG, "Tracker:              %lu/%lu entries, max probe %lu, untracked %lu, overhead %u bytes",
+             (unsigned long)ts.live, (unsigned long)ts.capacity, (unsigned long)ts.max_probe,
+             (unsigned long)ts.overflow, (unsigned)ts.overhead_bytes);
+
+    if (ts.live > 0)
     {
-        uint64_t now = esp_timer_get_time();
-        int leak_count = 0;
-        size_t leaked_bytes = 0;
-        for (int i = 0; i < MAX_ALLOCATIONS; i++)
-        {
-            if (allocations[i].is_active)
-            {
-                uint64_t age_ms = (now - allocations[i].timestamp) / 1000ULL;
-                if (age_ms > 30000ULL)
-                {
-                    ESP_LOGW(TAG, "POTENTIAL LEAK: %u @%p (%s) age=%llu ms",
-                             (unsigned)allocations[i].size, allocations[i].ptr,
-                             allocations[i].description ? allocations[i].description : "-",
-                             (unsigned long long)age_ms);
-                    leak_count++;
-                    leaked_bytes += allocations[i].size;
-                }
-            }
-        }
-        if (leak_count > 0)
-        {
-            ESP_LOGW(TAG, "Found %d potential leaks totaling %u bytes",
-                     leak_count, (unsigned)leaked_bytes);
-            gpio_set_level(LED_MEMORY_ERROR, 1);
-        }
-        else
-        {
-            gpio_set_level(LED_MEMORY_ERROR, 0);
-            ESP_LOGI(TAG, "No memory leaks detected");
-        }
-        xSemaphoreGive(memory_mutex);
+        ESP_LOGI(TAG, "\n🔍 ═══ ACTIVE ALLOCATIONS ═══");
+        track_visit_t v = {.now_us = esp_timer_get_time()};
+        alloc_track_foreach(summary_visit, &v);
+        if (v.hidden)
+            ESP_LOGI(TAG, "... and %d more", v.hidden);
     }
 }
 
-/* =========================
- *       RLE HELPERS
- * ========================= */
-static size_t rle_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity)
+static void leak_visit(const alloc_track_entry_t *e, void *arg)
 {
-    size_t in_pos = 0, out_pos = 0;
-    while (in_pos < in_len)
+    track_visit_t *v = (track_visit_t *)arg;
+    uint32_t age_ms = (uint32_t)(v->now_us / 1000ULL) - e->timestamp_ms;
+    if (age_ms > 30000U)
     {
-        size_t run_len = 1;
-        while (in_pos + run_len < in_len && run_len < 127 && in[in_pos + run_len] == in[in_pos])
-            run_len++;
-        if (run_len >= 3)
-        {
-            uint8_t header = (uint8_t)(257 - run_len); // 129..255
-            if (out_pos + 2 > out_capacity)
-                break;
-            out[out_pos++] = header;
-            out[out_pos++] = in[in_pos];
-            in_pos += run_len;
-        }
-        else
-        {
-            size_t lit_start = in_pos, lit_len = 0;
-            while (in_pos < in_len && lit_len < 128)
-            {
-                if (in_pos + 2 < in_len && in[in_pos] == in[in_pos + 1] && in[in_pos] == in[in_pos + 2])
-                    break;
-                in_pos++;
-                lit_len++;
-            }
-            if (lit_len > 0)
-            {
-                if (out_pos + 1 + lit_len > out_capacity)
-                    break;
-                out[out_pos++] = (uint8_t)(lit_len - 1);
-                memcpy(out + out_pos, in + lit_start, lit_len);
-                out_pos += lit_len;
-            }
-        }
+        if (v->leak_count < TRACK_LIST_MAX)
+            ESP_LOGW(TAG, "POTENTIAL LEAK: %u @%p (%s) age=%lu ms",
+                     (unsigned)e->size, e->ptr, e->description ? e->description : "-", (unsigned long)age_ms);
+        v->leak_count++;
+        v->leaked_bytes += e->size;
     }
-    return out_pos;
 }
 
-static size_t rle_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity)
+static void detect_memory_leaks(void)
 {
-    size_t in_pos = 0, out_pos = 0;
-    while (in_pos < in_len && out_pos < out_capacity)
+    track_visit_t v = {.now_us = esp_timer_get_time()};
+    alloc_track_foreach(leak_visit, &v);
+    if (v.leak_count > 0)
     {
-        uint8_t header = in[in_pos++];
-        if (header <= 127)
-        {
-            size_t lit_len = (size_t)header + 1;
-            if (in_pos + lit_len > in_len || out_pos + lit_len > out_capacity)
-                break;
-            memcpy(out + out_pos, in + in_pos, lit_len);
-            in_pos += lit_len;
-            out_pos += lit_len;
-        }
-        else if (header >= 129)
-        {
-            size_t rep_len = 257 - (size_t)header;
-            if (in_pos >= in_len || out_pos + rep_len > out_capacity)
-                break;
-            uint8_t value = in[in_pos++];
-            memset(out + out_pos, value, rep_len);
-            out_pos += rep_len;
-        }
-        else
-        {
-            // 128 = NOP
-        }
+        ESP_LOGW(TAG, "Found %d potential leaks totaling %u bytes",
+                 v.leak_count, (unsigned)v.leaked_bytes);
+        gpio_set_level(LED_MEMORY_ERROR, 1);
+    }
+    else
+    {
+        gpio_set_level(LED_MEMORY_ERROR, 0);
+        ESP_LOGI(TAG, "No memory leaks detected");
     }
-    return out_pos;
 }
 
 /* =========================
@@ -568,7 +723,8 @@ static int secure_store(secure_blob_t *sb, const void *plaintext, size_t len, ui
         return -3;
     }
     sb->in_use = true;
-    ESP_LOGI(TAG, "🔒 secure_store: len=%u desc=%s", (unsigned)len, desc ? desc : "-");
+    if (tracking_verbose)
+        ESP_LOGI(TAG, "🔒 secure_store: len=%u desc=%s", (unsigned)len, desc ? desc : "-");
     return 0;
 }
 
@@ -604,14 +760,43 @@ static void secure_free(secure_blob_t *sb)
  *   (2) Bump-Pointer Arena
  * ========================= */
 // ---- Slab Pools ----
+// page ของแต่ละ class เป็นของ core ที่สร้างมัน: ลิสต์ตามความเต็ม partial (แบ่ง band) / full / empty ต่อ (class, core)
+// alloc = page แรกของ band ที่เต็มที่สุด (bitmap + ctz) → O(1) ไม่ว่าจะมีกี่ page, และอัด block ให้แน่น
+// lock เป็น spinlock ต่อ (class, core): alloc/free บน core เจ้าของไม่ชนกับ core อื่นเลย
+// free ข้าม core → push ลง remote stack ของเจ้าของแบบ lock-free แล้วเจ้าของดึงไปคืนทีละก้อน
+#define DPOOL_BANDS 8                    // partial band: 0 = เหลือ free น้อยสุด (≤ 8 เพื่อใส่ใน uint8 bitmap)
+#define DPOOL_LIST_FULL DPOOL_BANDS      // free_count == 0
+#define DPOOL_LIST_EMPTY (DPOOL_BANDS + 1) // free_count == blocks
+#define DPOOL_NLISTS (DPOOL_BANDS + 2)
+#define DPOOL_REMOTE_BATCH 16            // remote free ค้างถึงเท่านี้ → เจ้าของดึงคืนตอน alloc ถัดไป
+// cache ของ page ว่างต่อ (class, core): เกิน HIGH คืน heap ทันที, ส่วนที่เกิน LOW คืนเมื่อว่างนานเกิน DECAY
+// → งานที่แกว่งรอบขอบ page ไม่ต้อง tracked_malloc + จัด block ใหม่ทุกรอบ
+#ifndef DPOOL_EMPTY_LOW
+#define DPOOL_EMPTY_LOW 1
+#endif
+#ifndef DPOOL_EMPTY_HIGH
+#define DPOOL_EMPTY_HIGH 4
+#endif
+#ifndef DPOOL_EMPTY_DECAY_MS
+#define DPOOL_EMPTY_DECAY_MS 5000
+#endif
+_Static_assert(DPOOL_BANDS <= 8, "partial_map is uint8_t");
+
 typedef struct dpool_page_t
 {
     struct dpool_page_t *next;
+    struct dpool_page_t *prev;
     uint8_t *base;
     uint16_t block_size;
     uint16_t blocks;
     uint16_t free_count;
+    uint8_t ci;   // class index
+    uint8_t list; // ลิสต์ที่ page อยู่ (band / FULL / EMPTY)
+    uint8_t core; // core เจ้าของ (แก้ free_list ได้เฉพาะตอนถือ lock ของ core นี้)
+    uint32_t empty_since_ms; // เวลาที่เข้า EMPTY (ใช้คิด decay)
     void *free_list;
+    int own_id; // region id ใน ownership map (-1 = ไม่ได้ลง)
+    struct dynamic_pool_mgr_t *pm; // pool เจ้าของ page (แยก block ของ dpool คนละตัวออกจากกัน)
 } dpool_page_t;
 
 typedef struct dpool_block_hdr_t
@@ -620,19 +805,56 @@ typedef struct dpool_block_hdr_t
     uint16_t sizeclass;
 } dpool_block_hdr_t;
 
+typedef struct dpool_core_t
+{
+    portMUX_TYPE lock;
+    uint8_t partial_map;                // bit b = lists[b] มี page
+    dpool_page_t *lists[DPOOL_NLISTS];  // [0..BANDS-1] partial, FULL, EMPTY
+    uint32_t list_count[DPOOL_NLISTS];
+    uint32_t list_gen[DPOOL_NLISTS];    // +1 ทุกครั้งที่ page ออกจากลิสต์ (cursor ที่ถือ page ไว้ข้ามการปล่อย lock ใช้ตรวจ)
+    uint32_t free_blocks;
+    uint32_t total_blocks;
+    void *remote_head;       // LIFO ของ block ที่ core อื่น free (push ด้วย CAS, ดึงทั้งก้อนด้วย exchange → ไม่มี ABA)
+    uint32_t remote_pending; // atomic
+    uint32_t remote_frees;   // atomic
+    uint32_t remote_drains;
+    uint32_t pages_created;
+    uint32_t pages_released;
+} dpool_core_t;
+
 typedef struct dpool_class_t
 {
     uint16_t size;
     uint16_t blocks_per_page;
-    dpool_page_t *pages;
+    uint16_t empty_low;  // page ว่างที่เก็บไว้เสมอ (ต่อ core)
+    uint16_t empty_high; // เกินนี้คืน heap ทันที
+    uint32_t decay_ms;   // page ว่างเกิน low ที่ค้างนานกว่านี้ถูกคืนตอน dpool_defrag_hint
+    dpool_core_t core[portNUM_PROCESSORS];
 } dpool_class_t;
 
+typedef struct
+{
+    uint32_t pages;
+    uint32_t empty_pages;
+    uint32_t free_blocks;
+    uint32_t total_blocks;
+    uint32_t pages_created;
+    uint32_t pages_released;
+    uint32_t remote_frees;
+    uint32_t remote_pending;
+    uint32_t remote_drains;
+} dpool_class_stats_t;
+
 typedef struct dynamic_pool_mgr_t
 {
     uint32_t caps;
-    SemaphoreHandle_t lock;
+    bool ready;
 #define DPOOL_NCLASS 6
     dpool_class_t cls[DPOOL_NCLASS];
+    // snapshot ของ dpool_dump ครั้งก่อน → อัตราสร้าง/คืน page ต่อวินาที
+    int64_t dump_us;
+    uint32_t dump_created[DPOOL_NCLASS];
+    uint32_t dump_released[DPOOL_NCLASS];
 } dynamic_pool_mgr_t;
 
 static inline uint16_t _choose_blocks_per_page(uint16_t blk)
@@ -657,19 +879,32 @@ static int dpool_init(dynamic_pool_mgr_t *pm, uint32_t caps)
         return -1;
     memset(pm, 0, sizeof(*pm));
     pm->caps = caps ? caps : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    pm->lock = xSemaphoreCreateMutex();
-    if (!pm->lock)
-        return -2;
     const uint16_t sizes[DPOOL_NCLASS] = {64, 128, 256, 512, 1024, 2048};
     for (int i = 0; i < DPOOL_NCLASS; i++)
     {
         pm->cls[i].size = sizes[i];
         pm->cls[i].blocks_per_page = _choose_blocks_per_page(sizes[i]);
-        pm->cls[i].pages = NULL;
+        pm->cls[i].empty_low = DPOOL_EMPTY_LOW;
+        pm->cls[i].empty_high = DPOOL_EMPTY_HIGH;
+        pm->cls[i].decay_ms = DPOOL_EMPTY_DECAY_MS;
+        for (int k = 0; k < portNUM_PROCESSORS; k++)
+            portMUX_INITIALIZE(&pm->cls[i].core[k].lock);
     }
+    pm->ready = true;
+    pm->dump_us = esp_timer_get_time();
     return 0;
 }
 
+// high = 0 → ไม่ cache (คืน page ทันทีที่ว่าง)
+static void dpool_set_empty_cache(dynamic_pool_mgr_t *pm, int ci, uint16_t low, uint16_t high, uint32_t decay_ms)
+{
+    if (!pm || ci < 0 || ci >= DPOOL_NCLASS)
+        return;
+    pm->cls[ci].empty_high = high;
+    pm->cls[ci].empty_low = low < high ? low : high;
+    pm->cls[ci].decay_ms = decay_ms;
+}
+
 static int _class_index_for_size(size_t size)
 {
     if (size <= 64)
@@ -687,7 +922,113 @@ static int _class_index_for_size(size_t size)
     return -1;
 }
 
-static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci)
+// ---- page lists (ถือ k->lock) ----
+static inline uint8_t _dpool_list_for(const dpool_page_t *pg)
+{
+    if (pg->free_count == 0)
+        return DPOOL_LIST_FULL;
+    if (pg->free_count >= pg->blocks)
+        return DPOOL_LIST_EMPTY;
+    return (uint8_t)((uint32_t)pg->free_count * DPOOL_BANDS / pg->blocks);
+}
+
+static void _dpool_link(dpool_core_t *k, dpool_page_t *pg, uint8_t list)
+{
+    pg->list = list;
+    pg->prev = NULL;
+    pg->next = k->lists[list];
+    if (pg->next)
+        pg->next->prev = pg;
+    k->lists[list] = pg;
+    k->list_count[list]++;
+    if (list < DPOOL_BANDS)
+        k->partial_map |= (uint8_t)(1u << list);
+    else if (list == DPOOL_LIST_EMPTY)
+        pg->empty_since_ms = (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void _dpool_unlink(dpool_core_t *k, dpool_page_t *pg)
+{
+    uint8_t list = pg->list;
+    if (pg->prev)
+        pg->prev->next = pg->next;
+    else
+        k->lists[list] = pg->next;
+    if (pg->next)
+        pg->next->prev = pg->prev;
+    pg->next = pg->prev = NULL;
+    k->list_count[list]--;
+    k->list_gen[list]++;
+    if (list < DPOOL_BANDS && !k->lists[list])
+        k->partial_map &= (uint8_t)~(1u << list);
+}
+
+// หลัง free_count เปลี่ยน: ย้ายลิสต์เฉพาะเมื่อข้าม band
+static inline void _dpool_relist(dpool_core_t *k, dpool_page_t *pg)
+{
+    uint8_t list = _dpool_list_for(pg);
+    if (list != pg->list)
+    {
+        _dpool_unlink(k, pg);
+        _dpool_link(k, pg, list);
+    }
+}
+
+static inline void _dpool_put_locked(dpool_core_t *k, dpool_page_t *pg, void *ptr)
+{
+    *((void **)ptr) = pg->free_list;
+    pg->free_list = ptr;
+    if (pg->free_count < pg->blocks)
+    {
+        pg->free_count++;
+        k->free_blocks++;
+    }
+    _dpool_relist(k, pg);
+}
+
+// คืน block ที่ core อื่น free ไว้ทั้งหมดเข้า page ของมัน (header ผ่านการตรวจตอน dpool_free แล้ว)
+static void _dpool_drain_remote_locked(dpool_core_t *k)
+{
+    void *blk = __atomic_exchange_n(&k->remote_head, NULL, __ATOMIC_ACQUIRE);
+    if (!blk)
+        return;
+    uint32_t n = 0;
+    while (blk)
+    {
+        void *next = *((void **)blk);
+        dpool_page_t *pg = ((dpool_block_hdr_t *)((uint8_t *)blk - sizeof(dpool_block_hdr_t)))->owner;
+        _dpool_put_locked(k, pg, blk);
+        blk = next;
+        n++;
+    }
+    __atomic_sub_fetch(&k->remote_pending, n, __ATOMIC_RELAXED);
+    k->remote_drains++;
+}
+
+// partial ที่เต็มที่สุด → empty ที่มีอยู่ → NULL (ผู้เรียกสร้าง page ใหม่นอก lock)
+static void *_dpool_take_locked(dpool_core_t *k)
+{
+    if (!k->partial_map && __atomic_load_n(&k->remote_head, __ATOMIC_RELAXED))
+        _dpool_drain_remote_locked(k);
+
+    dpool_page_t *pg;
+    if (k->partial_map)
+        pg = k->lists[__builtin_ctz(k->partial_map)];
+    else if (k->lists[DPOOL_LIST_EMPTY])
+        pg = k->lists[DPOOL_LIST_EMPTY];
+    else
+        return NULL;
+
+    void *payload = pg->free_list;
+    pg->free_list = *((void **)payload);
+    pg->free_count--;
+    k->free_blocks--;
+    _dpool_relist(k, pg);
+    return payload;
+}
+
+// สร้าง page (ไม่ถือ lock: tracked_malloc/own_register อาจ block) — ผู้เรียกเอาไป link เอง
+static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci, int core)
 {
     dpool_class_t *c = &pm->cls[ci];
     const uint16_t bsz = c->size;
@@ -707,7 +1048,10 @@ static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci)
     pg->block_size = bsz;
     pg->blocks = blocks;
     pg->free_count = blocks;
+    pg->ci = (uint8_t)ci;
+    pg->core = (uint8_t)core;
     pg->free_list = NULL;
+    pg->pm = pm;
 
     for (int i = 0; i < blocks; i++)
     {
@@ -720,353 +1064,2884 @@ static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci)
         pg->free_list = payload;
     }
 
-    pg->next = c->pages;
-    c->pages = pg;
+    pg->own_id = own_register(pg->base, one * blocks, OWN_KIND_DPOOL_PAGE, pg, one, hdr_sz);
+    if (pg->own_id < 0)
+    {
+        tracked_free(mem, "DPOOL_PAGE");
+        return NULL;
+    }
 
-    ESP_LOGI(TAG, "🧩 DPOOL new page: class=%d size=%u blocks=%u total=%u@%p",
-             ci, (unsigned)bsz, (unsigned)blocks, (unsigned)total, mem);
+    if (tracking_verbose)
+        ESP_LOGI(TAG, "🧩 DPOOL new page: class=%d core=%d size=%u blocks=%u total=%u@%p",
+                 ci, core, (unsigned)bsz, (unsigned)blocks, (unsigned)total, mem);
     return pg;
 }
 
-static void *_dpool_alloc_locked(dynamic_pool_mgr_t *pm, size_t size, const char *desc)
+static void _dpool_destroy_pages(dpool_page_t *pg)
 {
-    int ci = _class_index_for_size(size);
-    if (ci < 0)
-        return NULL;
-    dpool_class_t *c = &pm->cls[ci];
-
-    dpool_page_t *pg = c->pages;
-    while (pg && !pg->free_list)
-        pg = pg->next;
-
-    if (!pg)
+    while (pg)
     {
-        pg = _alloc_new_page(pm, ci);
-        if (!pg)
-            return NULL;
+        dpool_page_t *next = pg->next;
+        if (pg->own_id > 0)
+            own_unregister(pg->own_id);
+        tracked_free(pg, "DPOOL_PAGE");
+        pg = next;
     }
+}
 
-    void *payload = pg->free_list;
-    pg->free_list = *((void **)payload);
-    if (pg->free_count)
-        pg->free_count--;
-
-    register_allocation_manual(payload, c->size, pm->caps, desc ? desc : "DPOOL");
-    return payload;
+// ถอด page ออกจาก EMPTY (ถือ k->lock) แล้วต่อเข้า chain ที่จะ free นอก lock
+static inline void _dpool_detach_empty(dpool_core_t *k, dpool_page_t *pg, dpool_page_t **chain)
+{
+    _dpool_unlink(k, pg);
+    k->free_blocks -= pg->blocks;
+    k->total_blocks -= pg->blocks;
+    k->pages_released++;
+    pg->next = *chain;
+    *chain = pg;
 }
 
-static void dpool_release_empty_pages_locked(dynamic_pool_mgr_t *pm, int ci)
+// ดึง remote ที่ค้างแล้วคืน page ว่างของ (class, core) ตาม watermark — free จริงนอก critical section
+// all = true: คืนทุกใบ (ไม่สน low/decay)
+static void dpool_release_empty_pages(dynamic_pool_mgr_t *pm, int ci, int core, bool all)
 {
     dpool_class_t *c = &pm->cls[ci];
-    dpool_page_t **pp = &c->pages;
-    while (*pp)
+    dpool_core_t *k = &c->core[core];
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    dpool_page_t *chain = NULL;
+
+    taskENTER_CRITICAL(&k->lock);
+    _dpool_drain_remote_locked(k);
+    dpool_page_t *pg = k->lists[DPOOL_LIST_EMPTY];
+    uint32_t keep = all ? 0 : c->empty_low;
+    // ลิสต์เป็น LIFO: หัว = ว่างล่าสุด → เก็บ keep ใบแรกไว้ ที่เหลือคืนถ้าเกิน high หรือค้างนานพอ
+    for (uint32_t seen = 0; pg; seen++)
     {
-        dpool_page_t *pg = *pp;
-        if (pg->free_count == pg->blocks)
-        {
-            *pp = pg->next;
-            tracked_free(pg, "DPOOL_PAGE");
-        }
-        else
-        {
-            pp = &pg->next;
-        }
+        dpool_page_t *next = pg->next;
+        if (seen >= keep &&
+            (all || seen >= c->empty_high || (uint32_t)(now_ms - pg->empty_since_ms) >= c->decay_ms))
+            _dpool_detach_empty(k, pg, &chain);
+        pg = next;
     }
+    taskEXIT_CRITICAL(&k->lock);
+    _dpool_destroy_pages(chain);
 }
 
+// เรียกเป็นระยะ: คืน page ว่างที่ค้างเกิน decay (เหลือ low ต่อ core)
 static void dpool_defrag_hint(dynamic_pool_mgr_t *pm)
 {
-    if (!pm || !pm->lock)
+    if (!pm || !pm->ready)
         return;
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(100)) == pdTRUE)
+    for (int i = 0; i < DPOOL_NCLASS; i++)
+        for (int k = 0; k < portNUM_PROCESSORS; k++)
+            dpool_release_empty_pages(pm, i, k, false);
+}
+
+// คืน page ว่างทุกใบ (เช่นตอนหน่วยความจำตึง)
+static void dpool_shrink(dynamic_pool_mgr_t *pm)
+{
+    if (!pm || !pm->ready)
+        return;
+    for (int i = 0; i < DPOOL_NCLASS; i++)
+        for (int k = 0; k < portNUM_PROCESSORS; k++)
+            dpool_release_empty_pages(pm, i, k, true);
+}
+
+static void *dpool_alloc(dynamic_pool_mgr_t *pm, size_t size, const char *desc)
+{
+    if (!pm || !pm->ready || !size)
+        return NULL;
+    int ci = _class_index_for_size(size);
+    if (ci < 0)
+        return NULL;
+    dpool_class_t *c = &pm->cls[ci];
+    // task อาจย้าย core หลังอ่าน id → แค่ใช้ลิสต์ของอีก core (spinlock กันไว้แล้ว) ไม่ผิด
+    int core = xPortGetCoreID();
+    dpool_core_t *k = &c->core[core];
+
+    taskENTER_CRITICAL(&k->lock);
+    if (__atomic_load_n(&k->remote_pending, __ATOMIC_RELAXED) >= DPOOL_REMOTE_BATCH)
+        _dpool_drain_remote_locked(k);
+    void *p = _dpool_take_locked(k);
+    taskEXIT_CRITICAL(&k->lock);
+
+    if (!p)
+    {
+        dpool_page_t *pg = _alloc_new_page(pm, ci, core);
+        if (!pg)
+            return NULL;
+        taskENTER_CRITICAL(&k->lock);
+        _dpool_link(k, pg, DPOOL_LIST_EMPTY);
+        k->free_blocks += pg->blocks;
+        k->total_blocks += pg->blocks;
+        k->pages_created++;
+        p = _dpool_take_locked(k);
+        taskEXIT_CRITICAL(&k->lock);
+    }
+
+    // dpool_free ปฏิเสธ block ที่ tracker ไม่มี record → tracker เต็มก็ต้องคืน block แล้วถือว่า alloc ไม่สำเร็จ
+    if (!register_allocation_manual(p, c->size, pm->caps, desc ? desc : "DPOOL"))
     {
-        for (int i = 0; i < DPOOL_NCLASS; i++)
-            dpool_release_empty_pages_locked(pm, i);
-        xSemaphoreGive(pm->lock);
+        own_lookup_t own;
+        if (own_lookup(p, &own))
+        {
+            taskENTER_CRITICAL(&k->lock);
+            _dpool_put_locked(k, (dpool_page_t *)own.owner, p);
+            taskEXIT_CRITICAL(&k->lock);
+        }
+        return NULL;
     }
+    return p;
 }
 
-static void *dpool_alloc(dynamic_pool_mgr_t *pm, size_t size, const char *desc)
+static void dpool_free(dynamic_pool_mgr_t *pm, void *ptr, const char *desc)
+{
+    if (!pm || !pm->ready || !ptr)
+        return;
+
+    // ตรวจเจ้าของจาก ownership map แทนการเชื่อ header ตรง ๆ (กัน pointer แปลกปลอม/กลาง block)
+    own_lookup_t own;
+    if (!own_lookup(ptr, &own) || own.kind != OWN_KIND_DPOOL_PAGE || !own.exact)
+    {
+        ESP_LOGW(TAG, "⚠️ dpool_free: %p is not a DPOOL block (%s)", ptr, desc ? desc : "-");
+        return;
+    }
+    dpool_page_t *pg = (dpool_page_t *)own.owner;
+    // tracker ไม่มี record → block นี้ถูกคืนไปแล้ว (double free) อย่าใส่ freelist ซ้ำ
+    if (!unregister_allocation_manual(ptr, desc ? desc : "DPOOL"))
+    {
+        ESP_LOGW(TAG, "⚠️ dpool_free: %p has no live record, ignoring (%s)", ptr, desc ? desc : "-");
+        return;
+    }
+
+    dpool_class_t *c = &pm->cls[pg->ci];
+    dpool_core_t *k = &c->core[pg->core];
+    if (pg->core == xPortGetCoreID())
+    {
+        dpool_page_t *chain = NULL;
+        taskENTER_CRITICAL(&k->lock);
+        _dpool_put_locked(k, pg, ptr);
+        // cache เต็มเกิน high → คืน page ที่เพิ่งว่าง (free นอก lock)
+        if (pg->list == DPOOL_LIST_EMPTY && k->list_count[DPOOL_LIST_EMPTY] > c->empty_high)
+            _dpool_detach_empty(k, pg, &chain);
+        taskEXIT_CRITICAL(&k->lock);
+        _dpool_destroy_pages(chain);
+        return;
+    }
+
+    void *head = __atomic_load_n(&k->remote_head, __ATOMIC_RELAXED);
+    do
+    {
+        *((void **)ptr) = head;
+    } while (!__atomic_compare_exchange_n(&k->remote_head, &head, ptr, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&k->remote_pending, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&k->remote_frees, 1, __ATOMIC_RELAXED);
+}
+
+static void dpool_get_class_stats(dynamic_pool_mgr_t *pm, int ci, dpool_class_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!pm || !pm->ready || ci < 0 || ci >= DPOOL_NCLASS)
+        return;
+    for (int k = 0; k < portNUM_PROCESSORS; k++)
+    {
+        dpool_core_t *kc = &pm->cls[ci].core[k];
+        taskENTER_CRITICAL(&kc->lock);
+        for (int l = 0; l < DPOOL_NLISTS; l++)
+            out->pages += kc->list_count[l];
+        out->empty_pages += kc->list_count[DPOOL_LIST_EMPTY];
+        out->free_blocks += kc->free_blocks;
+        out->total_blocks += kc->total_blocks;
+        out->pages_created += kc->pages_created;
+        out->pages_released += kc->pages_released;
+        out->remote_frees += kc->remote_frees;
+        out->remote_pending += kc->remote_pending;
+        out->remote_drains += kc->remote_drains;
+        taskEXIT_CRITICAL(&kc->lock);
+    }
+}
+
+static void dpool_dump(dynamic_pool_mgr_t *pm)
+{
+    if (!pm || !pm->ready)
+        return;
+    int64_t now = esp_timer_get_time();
+    float dt_s = (float)(now - pm->dump_us) / 1e6f;
+    pm->dump_us = now;
+    if (dt_s <= 0.0f)
+        dt_s = 1.0f;
+
+    ESP_LOGI(TAG, "🔎 DPOOL DUMP:");
+    for (int i = 0; i < DPOOL_NCLASS; i++)
+    {
+        dpool_class_t *c = &pm->cls[i];
+        dpool_class_stats_t st;
+        dpool_get_class_stats(pm, i, &st);
+        float create_rate = (float)(st.pages_created - pm->dump_created[i]) / dt_s;
+        float release_rate = (float)(st.pages_released - pm->dump_released[i]) / dt_s;
+        pm->dump_created[i] = st.pages_created;
+        pm->dump_released[i] = st.pages_released;
+        ESP_LOGI(TAG, "  class[%d]: size=%u pages=%lu (empty=%lu, cache %u..%u) free=%lu/%lu remote=%lu (pending=%lu drains=%lu)",
+                 i, (unsigned)c->size, (unsigned long)st.pages, (unsigned long)st.empty_pages,
+                 (unsigned)c->empty_low, (unsigned)c->empty_high, (unsigned long)st.free_blocks,
+                 (unsigned long)st.total_blocks, (unsigned long)st.remote_frees, (unsigned long)st.remote_pending,
+                 (unsigned long)st.remote_drains);
+        ESP_LOGI(TAG, "             page churn: created=%lu (%.2f/s) released=%lu (%.2f/s)",
+                 (unsigned long)st.pages_created, create_rate, (unsigned long)st.pages_released, release_rate);
+    }
+}
+
+// ---- Bump Arena ----
+// block ต่อกันเป็น chain (ใหม่สุดอยู่หัว): alloc = บวก offset ของ block หัว
+// - shared: บวก offset ด้วย atomic fetch-add (ไม่มี lock) — mutex ใช้เฉพาะตอนต่อ block ใหม่ (slow path)
+// - local (ต่อ task): บวกตรง ๆ ไม่มี atomic
+// - arena_mark / arena_release_to: คืนทุกอย่างที่ alloc หลัง mark (ซ้อนกันได้แบบ stack)
+//   ใช้เมื่อไม่มี task อื่น alloc จาก arena เดียวกันพร้อมกัน (arena ต่อ task หรือ scope ของ stage เดียว)
+// allocation ย่อยไม่ลง tracker (ทั้ง block ถูก track ตอน tracked_malloc แล้ว) → fast path เหลือไม่กี่คำสั่ง
+#define ARENA_ALIGN 8
+#ifndef ARENA_LOCAL_BLOCK
+#define ARENA_LOCAL_BLOCK 4096 // ขนาด block แรก/ที่ต่อเพิ่มของ arena ต่อ task
+#endif
+#define ARENA_LOCAL_MAX_TASKS 8 // จำนวน task ที่มี arena ของตัวเองได้พร้อมกัน
+#define ARENA_TLS_INDEX 1       // slot 0 เป็นของ pthread TLS ใน ESP-IDF (sdkconfig.defaults ตั้งไว้ 2 slot)
+_Static_assert(ARENA_TLS_INDEX > 0 && ARENA_TLS_INDEX < configNUM_THREAD_LOCAL_STORAGE_POINTERS,
+               "raise CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS for the arena slot");
+#ifndef CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS
+#error "arena needs CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS=y (see sdkconfig.defaults)"
+#endif
+
+typedef struct arena_block_t
 {
-    if (!pm || !pm->lock || !size)
+    struct arena_block_t *prev;
+    uint8_t *data;
+    size_t cap;  // หาร ARENA_ALIGN ลงตัว
+    size_t used; // shared: atomic (fetch-add ที่ล้นทำให้เกิน cap ได้ → block นั้นถือว่าเต็ม)
+    int own_id;  // region id ใน ownership map (-1 = ไม่ได้ลง)
+} arena_block_t;
+
+typedef struct bump_arena_t
+{
+    arena_block_t *head;  // block ปัจจุบัน (shared: อ่าน/เขียนแบบ atomic)
+    arena_block_t *first; // block แรก (arena_reset ย้อนกลับมาที่นี่)
+    arena_block_t *spare; // block ที่ต่อเพิ่มแล้วถูกคืน เก็บไว้ 1 ใบ → scope ที่โตซ้ำ ๆ ไม่ต้อง malloc ใหม่
+    size_t block_size;    // ขนาดขั้นต่ำของ block ที่ต่อเพิ่ม
+    uint32_t caps;
+    bool shared;
+    SemaphoreHandle_t grow_lock; // shared เท่านั้น
+    uint32_t blocks;
+    uint32_t grows;
+    size_t reserved; // cap รวมทุก block ใน chain
+} bump_arena_t;
+
+typedef struct
+{
+    arena_block_t *block;
+    size_t used;
+} arena_mark_t;
+
+// ทุก block (รวมที่ต่อเพิ่ม) ลง ownership map → pointer ใดใน arena ก็หาเจ้าของได้
+static arena_block_t *_arena_new_block(bump_arena_t *ar, size_t cap)
+{
+    const size_t hdr = ALIGN_UP(sizeof(arena_block_t), ARENA_ALIGN);
+    cap = ALIGN_UP(cap, ARENA_ALIGN);
+    uint8_t *mem = (uint8_t *)tracked_malloc(hdr + cap, ar->caps, "ARENA_BUF");
+    if (!mem)
+        return NULL;
+    arena_block_t *b = (arena_block_t *)mem;
+    b->prev = NULL;
+    b->data = mem + hdr;
+    b->cap = cap;
+    b->used = 0;
+    b->own_id = own_register(b->data, cap, OWN_KIND_ARENA, ar, 0, 0);
+    return b;
+}
+
+static void _arena_free_block(arena_block_t *b, bool wipe)
+{
+    if (b->own_id > 0)
+        own_unregister(b->own_id);
+    if (wipe)
+        secure_wipe(b->data, b->cap);
+    tracked_free(b, "ARENA_BUF");
+}
+
+static int arena_init_ex(bump_arena_t *ar, size_t capacity, uint32_t caps, bool shared)
+{
+    if (!ar || !capacity)
+        return -1;
+    memset(ar, 0, sizeof(*ar));
+    ar->caps = caps ? caps : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ar->block_size = capacity;
+    ar->shared = shared;
+    if (shared)
+    {
+        ar->grow_lock = xSemaphoreCreateMutex();
+        if (!ar->grow_lock)
+            return -3;
+    }
+    ar->first = ar->head = _arena_new_block(ar, capacity);
+    if (!ar->head)
+    {
+        if (ar->grow_lock)
+            vSemaphoreDelete(ar->grow_lock);
+        ar->grow_lock = NULL;
+        return -2;
+    }
+    ar->blocks = 1;
+    ar->reserved = ar->head->cap;
+    return 0;
+}
+
+// arena ใช้ร่วมหลาย task (fetch-add)
+static int arena_init(bump_arena_t *ar, size_t capacity, uint32_t caps)
+{
+    return arena_init_ex(ar, capacity, caps, true);
+}
+
+// block หัวเต็ม: ต่อ block ใหม่ (หรือใช้ spare) แล้วจอง need byte แรกให้ผู้เรียก
+static void *_arena_alloc_slow(bump_arena_t *ar, arena_block_t *seen, size_t need, size_t a)
+{
+    if (ar->shared && xSemaphoreTake(ar->grow_lock, portMAX_DELAY) != pdTRUE)
         return NULL;
     void *p = NULL;
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(100)) == pdTRUE)
+    arena_block_t *b = __atomic_load_n(&ar->head, __ATOMIC_ACQUIRE);
+    if (b != seen)
+    {
+        // task อื่นต่อ block ให้แล้วระหว่างรอ lock
+        size_t off = __atomic_fetch_add(&b->used, need, __ATOMIC_RELAXED);
+        if (off + need <= b->cap)
+            p = (void *)ALIGN_UP((uintptr_t)b->data + off, a);
+    }
+    if (!p)
     {
-        p = _dpool_alloc_locked(pm, size, desc);
-        xSemaphoreGive(pm->lock);
+        arena_block_t *nb = NULL;
+        if (ar->spare && ar->spare->cap >= need)
+        {
+            nb = ar->spare;
+            ar->spare = NULL;
+        }
+        else
+        {
+            nb = _arena_new_block(ar, need > ar->block_size ? need : ar->block_size);
+        }
+        if (nb)
+        {
+            nb->prev = b;
+            nb->used = need;
+            p = (void *)ALIGN_UP((uintptr_t)nb->data, a);
+            ar->blocks++;
+            ar->grows++;
+            ar->reserved += nb->cap;
+            __atomic_store_n(&ar->head, nb, __ATOMIC_RELEASE);
+        }
     }
+    if (ar->shared)
+        xSemaphoreGive(ar->grow_lock);
     return p;
 }
 
-static void dpool_free(dynamic_pool_mgr_t *pm, void *ptr, const char *desc)
+static void *arena_alloc(bump_arena_t *ar, size_t size, size_t align, const char *desc)
+{
+    (void)desc;
+    if (!ar || !ar->head || !size)
+        return NULL;
+    size_t a = (align < ARENA_ALIGN) ? ARENA_ALIGN : align;
+    // offset เดินทีละ ARENA_ALIGN เสมอ → align ที่ใหญ่กว่าเผื่อ padding ไว้ในก้อนที่จอง
+    size_t need = ALIGN_UP(size, ARENA_ALIGN) + (a - ARENA_ALIGN);
+
+    if (!ar->shared)
+    {
+        arena_block_t *b = ar->head;
+        size_t off = b->used;
+        if (off + need <= b->cap)
+        {
+            b->used = off + need;
+            return (void *)ALIGN_UP((uintptr_t)b->data + off, a);
+        }
+        return _arena_alloc_slow(ar, b, need, a);
+    }
+
+    arena_block_t *b = __atomic_load_n(&ar->head, __ATOMIC_ACQUIRE);
+    size_t off = __atomic_fetch_add(&b->used, need, __ATOMIC_RELAXED);
+    if (off + need <= b->cap)
+        return (void *)ALIGN_UP((uintptr_t)b->data + off, a);
+    return _arena_alloc_slow(ar, b, need, a);
+}
+
+static arena_mark_t arena_mark(bump_arena_t *ar)
+{
+    arena_mark_t m = {NULL, 0};
+    if (ar && ar->head)
+    {
+        m.block = __atomic_load_n(&ar->head, __ATOMIC_ACQUIRE);
+        m.used = __atomic_load_n(&m.block->used, __ATOMIC_RELAXED);
+        if (m.used > m.block->cap)
+            m.used = m.block->cap;
+    }
+    return m;
+}
+
+// คืนทุกอย่างหลัง mark: block ที่ต่อหลัง mark ถูกคืน heap (ใบใหญ่สุดเก็บเป็น spare)
+static void arena_release_to(bump_arena_t *ar, arena_mark_t m)
+{
+    if (!ar || !ar->head || !m.block)
+        return;
+    arena_block_t *b = ar->head;
+    while (b != m.block && b->prev)
+    {
+        arena_block_t *prev = b->prev;
+        ar->blocks--;
+        ar->reserved -= b->cap;
+        if (!ar->spare || ar->spare->cap < b->cap)
+        {
+            if (ar->spare)
+                _arena_free_block(ar->spare, false);
+            ar->spare = b;
+        }
+        else
+        {
+            _arena_free_block(b, false);
+        }
+        b = prev;
+    }
+    if (b == m.block)
+        __atomic_store_n(&b->used, m.used, __ATOMIC_RELAXED);
+    __atomic_store_n(&ar->head, b, __ATOMIC_RELEASE);
+}
+
+static void arena_reset(bump_arena_t *ar)
+{
+    if (!ar || !ar->first)
+        return;
+    arena_release_to(ar, (arena_mark_t){ar->first, 0});
+}
+
+static size_t arena_used(bump_arena_t *ar)
+{
+    size_t n = 0;
+    if (!ar)
+        return 0;
+    for (arena_block_t *b = __atomic_load_n(&ar->head, __ATOMIC_ACQUIRE); b; b = b->prev)
+    {
+        size_t u = __atomic_load_n(&b->used, __ATOMIC_RELAXED);
+        n += (u < b->cap) ? u : b->cap;
+    }
+    return n;
+}
+
+static void arena_destroy(bump_arena_t *ar)
+{
+    if (!ar)
+        return;
+    arena_block_t *b = ar->head;
+    while (b)
+    {
+        arena_block_t *prev = b->prev;
+        _arena_free_block(b, true);
+        b = prev;
+    }
+    if (ar->spare)
+        _arena_free_block(ar->spare, true);
+    if (ar->grow_lock)
+        vSemaphoreDelete(ar->grow_lock);
+    memset(ar, 0, sizeof(*ar));
+}
+
+// ---- Arena ต่อ task (ไม่มี lock) ----
+typedef enum
+{
+    ARENA_SLOT_FREE = 0,
+    ARENA_SLOT_ACTIVE,
+    ARENA_SLOT_ORPHAN, // task ถูกลบแล้ว รอ arena_task_local_reap คืน heap
+    ARENA_SLOT_REAPING, // กำลังถูกคืน (monitor กับ pressure bus เรียก reap พร้อมกันได้)
+} arena_slot_state_t;
+
+static bump_arena_t g_task_arenas[ARENA_LOCAL_MAX_TASKS];
+static volatile arena_slot_state_t g_task_arena_state[ARENA_LOCAL_MAX_TASKS];
+static portMUX_TYPE g_task_arena_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t g_task_arena_none; // sentinel: task นี้ขอแล้วแต่ slot เต็ม/init ไม่ผ่าน
+
+// callback ตอน task ถูกลบ: อาจรันใน idle task → ห้าม block, แค่ mark ไว้ให้ monitor คืน
+static void arena_task_deleted_cb(int index, void *value)
+{
+    (void)index;
+    if (!value || value == (void *)&g_task_arena_none)
+        return;
+    int i = (int)((bump_arena_t *)value - g_task_arenas);
+    portENTER_CRITICAL(&g_task_arena_mux);
+    g_task_arena_state[i] = ARENA_SLOT_ORPHAN;
+    portEXIT_CRITICAL(&g_task_arena_mux);
+}
+
+// scratch arena ของ task ปัจจุบัน (สร้างครั้งแรกที่เรียก), NULL = slot เต็ม
+static bump_arena_t *arena_task_local(void)
+{
+    void *v = pvTaskGetThreadLocalStoragePointer(NULL, ARENA_TLS_INDEX);
+    if (v == (void *)&g_task_arena_none)
+        return NULL;
+    if (v)
+        return (bump_arena_t *)v;
+
+    int slot = -1;
+    portENTER_CRITICAL(&g_task_arena_mux);
+    for (int i = 0; i < ARENA_LOCAL_MAX_TASKS; i++)
+    {
+        if (g_task_arena_state[i] == ARENA_SLOT_FREE)
+        {
+            g_task_arena_state[i] = ARENA_SLOT_ACTIVE;
+            slot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&g_task_arena_mux);
+
+    bump_arena_t *ar = NULL;
+    if (slot >= 0)
+    {
+        if (arena_init_ex(&g_task_arenas[slot], ARENA_LOCAL_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, false) == 0)
+            ar = &g_task_arenas[slot];
+        else
+            g_task_arena_state[slot] = ARENA_SLOT_FREE;
+    }
+    vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, ARENA_TLS_INDEX,
+                                                    ar ? (void *)ar : (void *)&g_task_arena_none,
+                                                    arena_task_deleted_cb);
+    return ar;
+}
+
+// คืน arena ของ task ที่ถูกลบไปแล้ว (เรียกจาก monitor และ pressure bus)
+static void arena_task_local_reap(void)
+{
+    for (int i = 0; i < ARENA_LOCAL_MAX_TASKS; i++)
+    {
+        portENTER_CRITICAL(&g_task_arena_mux);
+        bool mine = g_task_arena_state[i] == ARENA_SLOT_ORPHAN;
+        if (mine)
+            g_task_arena_state[i] = ARENA_SLOT_REAPING;
+        portEXIT_CRITICAL(&g_task_arena_mux);
+        if (!mine)
+            continue;
+        arena_destroy(&g_task_arenas[i]);
+        portENTER_CRITICAL(&g_task_arena_mux);
+        g_task_arena_state[i] = ARENA_SLOT_FREE;
+        portEXIT_CRITICAL(&g_task_arena_mux);
+    }
+}
+
+// ---- Segmented Buffer ----
+// buffer ขนาดใหญ่ = ตาราง pointer ไปยัง chunk ขนาดคงที่ (block ของ class ใหญ่สุดใน dpool)
+// → ต้องการแค่ page ของ dpool (~8KB) ต่อเนื่อง ไม่ใช่ทั้งก้อน: ใช้ได้แม้ largest free block เหลือเล็ก
+// offset → (chunk, ตำแหน่งใน chunk) ด้วย shift/mask; ช่วงที่ต่อเนื่องจริงยาวไม่เกิน 1 chunk
+// iterator / iovec ให้ผู้ใช้ทำงานกับช่วงต่อเนื่องตรง ๆ โดยไม่ต้อง copy
+#define SEG_CHUNK_SHIFT 11
+#define SEG_CHUNK (1u << SEG_CHUNK_SHIFT) // = class 2048 ของ dpool
+#define SEG_CHUNK_MASK (SEG_CHUNK - 1u)
+
+typedef struct
+{
+    dynamic_pool_mgr_t *pm;
+    uint8_t **chunks;
+    uint32_t nchunks;
+    size_t len;
+} seg_buf_t;
+
+typedef struct
+{
+    const seg_buf_t *sb;
+    size_t off;
+    size_t end;
+} seg_iter_t;
+
+typedef struct
 {
-    if (!pm || !pm->lock || !ptr)
+    void *base;
+    size_t len;
+} seg_iovec_t;
+
+// แหล่ง chunk ของ large_allocation_test_task (ready = false ถ้า init ไม่สำเร็จ → seg_alloc คืน -1)
+static dynamic_pool_mgr_t g_seg_pool;
+
+static void seg_free(seg_buf_t *sb)
+{
+    if (!sb->chunks)
         return;
-    unregister_allocation_manual(ptr, desc ? desc : "DPOOL"); // สถิติ
+    for (uint32_t i = 0; i < sb->nchunks; i++)
+        if (sb->chunks[i])
+            dpool_free(sb->pm, sb->chunks[i], "SEG_CHUNK");
+    tracked_free(sb->chunks, "SEG_TABLE");
+    memset(sb, 0, sizeof(*sb));
+}
+
+// ได้ครบทุก chunk หรือไม่ได้เลย (คืนที่จองไปแล้วถ้าขาดกลางทาง)
+static int seg_alloc(seg_buf_t *sb, dynamic_pool_mgr_t *pm, size_t len)
+{
+    memset(sb, 0, sizeof(*sb));
+    if (!pm || !pm->ready || len == 0)
+        return -1;
+    uint32_t n = (uint32_t)((len + SEG_CHUNK_MASK) >> SEG_CHUNK_SHIFT);
+    sb->chunks = (uint8_t **)tracked_malloc(n * sizeof(uint8_t *), pm->caps, "SEG_TABLE");
+    if (!sb->chunks)
+        return -1;
+    memset(sb->chunks, 0, n * sizeof(uint8_t *));
+    sb->pm = pm;
+    sb->nchunks = n;
+    sb->len = len;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        sb->chunks[i] = (uint8_t *)dpool_alloc(pm, SEG_CHUNK, "SEG_CHUNK");
+        if (!sb->chunks[i])
+        {
+            seg_free(sb);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void seg_iter_init(seg_iter_t *it, const seg_buf_t *sb, size_t off, size_t n)
+{
+    it->sb = sb;
+    it->off = off < sb->len ? off : sb->len;
+    it->end = (n > sb->len - it->off) ? sb->len : it->off + n;
+}
+
+// ช่วงต่อเนื่องถัดไป (ไม่ข้ามขอบ chunk): คืนความยาว, 0 = หมด
+static size_t seg_iter_next(seg_iter_t *it, uint8_t **span)
+{
+    if (it->off >= it->end)
+        return 0;
+    size_t in = it->off & SEG_CHUNK_MASK;
+    size_t n = SEG_CHUNK - in;
+    if (n > it->end - it->off)
+        n = it->end - it->off;
+    *span = it->sb->chunks[it->off >> SEG_CHUNK_SHIFT] + in;
+    it->off += n;
+    return n;
+}
+
+static size_t seg_write(seg_buf_t *sb, size_t off, const void *src, size_t n)
+{
+    seg_iter_t it;
+    uint8_t *span;
+    size_t len, done = 0;
+    seg_iter_init(&it, sb, off, n);
+    while ((len = seg_iter_next(&it, &span)) != 0)
+    {
+        memcpy(span, (const uint8_t *)src + done, len);
+        done += len;
+    }
+    return done;
+}
+
+static size_t seg_read(const seg_buf_t *sb, size_t off, void *dst, size_t n)
+{
+    seg_iter_t it;
+    uint8_t *span;
+    size_t len, done = 0;
+    seg_iter_init(&it, sb, off, n);
+    while ((len = seg_iter_next(&it, &span)) != 0)
+    {
+        memcpy((uint8_t *)dst + done, span, len);
+        done += len;
+    }
+    return done;
+}
+
+static size_t seg_fill(seg_buf_t *sb, size_t off, uint8_t v, size_t n)
+{
+    seg_iter_t it;
+    uint8_t *span;
+    size_t len, done = 0;
+    seg_iter_init(&it, sb, off, n);
+    while ((len = seg_iter_next(&it, &span)) != 0)
+    {
+        memset(span, v, len);
+        done += len;
+    }
+    return done;
+}
+
+// scatter-gather: copy ระหว่าง segmented buffer สองอัน (ขอบ chunk ไม่ตรงกันได้) — memcpy ทีละช่วงที่ต่อเนื่องทั้งสองฝั่ง
+static size_t seg_copy(seg_buf_t *dst, size_t dst_off, const seg_buf_t *src, size_t src_off, size_t n)
+{
+    seg_iter_t si, di;
+    uint8_t *sp = NULL, *dp = NULL;
+    size_t sl = 0, dl = 0, done = 0;
+    seg_iter_init(&si, src, src_off, n);
+    seg_iter_init(&di, dst, dst_off, n);
+    for (;;)
+    {
+        if (!sl && (sl = seg_iter_next(&si, &sp)) == 0)
+            break;
+        if (!dl && (dl = seg_iter_next(&di, &dp)) == 0)
+            break;
+        size_t k = sl < dl ? sl : dl;
+        memcpy(dp, sp, k);
+        sp += k;
+        dp += k;
+        sl -= k;
+        dl -= k;
+        done += k;
+    }
+    return done;
+}
+
+// ช่วง [off, off+n) เป็น iovec (ส่งต่อให้ API แบบ scatter-gather เช่น socket/SPI DMA) — คืนจำนวนช่องที่ใช้
+static int seg_iovec(const seg_buf_t *sb, size_t off, size_t n, seg_iovec_t *iov, int max)
+{
+    seg_iter_t it;
+    uint8_t *span;
+    size_t len;
+    int k = 0;
+    seg_iter_init(&it, sb, off, n);
+    while (k < max && (len = seg_iter_next(&it, &span)) != 0)
+        iov[k++] = (seg_iovec_t){span, len};
+    return k;
+}
+
+// ---- Secure Segmented Stream ----
+// secure_store/secure_load: ตั้ง key ใหม่ทุกครั้ง + ถอดทั้งก้อนลง buffer แยก
+// stream: key schedule ขยายครั้งเดียวแล้ว cache ไว้ (หลาย buffer ใช้ key เดียวกัน ต่างกันที่ nonce)
+//         ciphertext อยู่ใน chunk ของ segmented buffer, counter คำนวณจาก offset → เข้ารหัส/ถอดเฉพาะช่วงที่แตะ
+//         keystream สร้างทีละช่วงต่อเนื่อง (ทั้ง span ของ chunk ในการเรียก mbedtls ครั้งเดียว) ไม่ใช่ทีละ block
+// counter block = nonce 8 byte (สุ่มต่อ buffer) || index ของ block 16 byte แบบ big-endian 8 byte
+// ⚠️ เขียนทับช่วงเดิมใช้ keystream เดิม: ใครเห็นทั้ง ciphertext เก่าและใหม่ XOR กันได้ plaintext XOR (แบบเดียวกับ CTR ทั่วไป)
+#define SEC_KEY_CACHE 4
+
+typedef struct
+{
+    mbedtls_aes_context ctx;
+    uint8_t key[16];
+    uint16_t refs; // 0 = ช่องว่าง
+    uint32_t hits; // ได้จาก cache โดยไม่ต้อง setkey ใหม่
+} sec_key_t;
+
+typedef struct
+{
+    seg_buf_t seg;
+    sec_key_t *key;
+    uint8_t nonce[8];
+    const char *desc;
+} sec_stream_t;
+
+static sec_key_t s_sec_keys[SEC_KEY_CACHE];
+static portMUX_TYPE s_sec_key_mux = portMUX_INITIALIZER_UNLOCKED;
 
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(100)) == pdTRUE)
+static bool sec_key_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t d = 0; // เวลาคงที่ ไม่หยุดที่ byte แรกที่ต่าง
+    for (int i = 0; i < 16; i++)
+        d |= a[i] ^ b[i];
+    return d == 0;
+}
+
+// key เดิม → ใช้ schedule ที่ขยายไว้แล้ว, key ใหม่ → setkey ลงช่องว่าง (NULL ถ้า cache เต็ม)
+static sec_key_t *sec_key_get(const uint8_t key[16])
+{
+    sec_key_t *k = NULL, *free_slot = NULL;
+    taskENTER_CRITICAL(&s_sec_key_mux);
+    for (int i = 0; i < SEC_KEY_CACHE && !k; i++)
+    {
+        if (s_sec_keys[i].refs == 0)
+            free_slot = free_slot ? free_slot : &s_sec_keys[i];
+        else if (sec_key_equal(s_sec_keys[i].key, key))
+            k = &s_sec_keys[i];
+    }
+    if (k)
+    {
+        k->refs++;
+        k->hits++;
+    }
+    else if (free_slot)
+    {
+        // ขยาย key ใน critical section: ทำครั้งเดียวต่อ key และสั้น (ESP32 HW AES = copy key)
+        mbedtls_aes_init(&free_slot->ctx);
+        if (mbedtls_aes_setkey_enc(&free_slot->ctx, key, 128) == 0)
+        {
+            memcpy(free_slot->key, key, 16);
+            free_slot->refs = 1;
+            free_slot->hits = 0;
+            k = free_slot;
+        }
+        else
+        {
+            mbedtls_aes_free(&free_slot->ctx);
+        }
+    }
+    taskEXIT_CRITICAL(&s_sec_key_mux);
+    return k;
+}
+
+static void sec_key_put(sec_key_t *k)
+{
+    if (!k)
+        return;
+    taskENTER_CRITICAL(&s_sec_key_mux);
+    if (k->refs && --k->refs == 0)
+    {
+        mbedtls_aes_free(&k->ctx);
+        secure_wipe(k->key, sizeof(k->key));
+    }
+    taskEXIT_CRITICAL(&s_sec_key_mux);
+}
+
+// XOR keystream ของช่วง [off, off+n) ระหว่าง chunk กับ buffer ภายนอก
+// to_seg: ext → chunk (เข้ารหัสตอนเขียน), ไม่งั้น chunk → ext (ถอดตอนอ่าน); ext = NULL → ทำในที่ (chunk → chunk)
+static int sec_ctr_range(sec_stream_t *s, size_t off, size_t n, uint8_t *ext, bool to_seg)
+{
+    unsigned char ctr[16], ks[16];
+    size_t nc_off = off & 15u;
+    uint64_t blk = (uint64_t)(off >> 4);
+    memcpy(ctr, s->nonce, 8);
+    for (int i = 15; i >= 8; i--, blk >>= 8)
+        ctr[i] = (unsigned char)blk;
+    int rc = 0;
+    if (nc_off)
+    {
+        // เริ่มกลาง block: เตรียม keystream ของ block นี้เอง แล้วให้ mbedtls ใช้ต่อจาก nc_off
+        rc = mbedtls_aes_crypt_ecb(&s->key->ctx, MBEDTLS_AES_ENCRYPT, ctr, ks);
+        for (int i = 15; i >= 0 && ++ctr[i] == 0; i--)
+        {
+        }
+    }
+
+    seg_iter_t it;
+    uint8_t *span;
+    size_t len, done = 0;
+    seg_iter_init(&it, &s->seg, off, n);
+    while (rc == 0 && (len = seg_iter_next(&it, &span)) != 0)
+    {
+        const uint8_t *in = ext ? (to_seg ? ext + done : span) : span;
+        uint8_t *out = ext ? (to_seg ? span : ext + done) : span;
+        rc = mbedtls_aes_crypt_ctr(&s->key->ctx, len, &nc_off, ctr, ks, in, out);
+        done += len;
+    }
+    secure_wipe(ks, sizeof(ks));
+    secure_wipe(ctr, sizeof(ctr));
+    return rc == 0 ? (int)done : -3;
+}
+
+// chunk มาจาก g_seg_pool (class 2048 ของ dpool) → ciphertext ไม่ต้องการ block ต่อเนื่องใหญ่
+static int sec_open(sec_stream_t *s, const uint8_t key[16], size_t len, const char *desc)
+{
+    memset(s, 0, sizeof(*s));
+    s->key = sec_key_get(key);
+    if (!s->key)
+        return -1;
+    if (seg_alloc(&s->seg, &g_seg_pool, len) != 0)
+    {
+        sec_key_put(s->key);
+        s->key = NULL;
+        return -2;
+    }
+    fill_random(s->nonce, sizeof(s->nonce));
+    s->desc = desc;
+    return 0;
+}
+
+// plaintext จาก src ถูกเข้ารหัสตรงลง chunk (ไม่มีสำเนา plaintext ค้างใน buffer ที่เก็บ)
+static int sec_write(sec_stream_t *s, size_t off, const void *src, size_t n)
+{
+    return sec_ctr_range(s, off, n, (uint8_t *)src, true);
+}
+
+// ถอดเฉพาะช่วงที่ขอลง dst (ช่วงอื่นไม่ถูกแตะ)
+static int sec_read(sec_stream_t *s, size_t off, void *dst, size_t n)
+{
+    return sec_ctr_range(s, off, n, (uint8_t *)dst, false);
+}
+
+// สลับช่วงระหว่าง ciphertext ⇄ plaintext ในที่ (CTR เข้า/ถอดคือ XOR เดียวกัน)
+// ใช้คู่กับ seg_iovec: ถอด → แก้ผ่าน iovec → เรียกซ้ำเพื่อเข้ารหัสกลับ
+static int sec_crypt_inplace(sec_stream_t *s, size_t off, size_t n)
+{
+    return sec_ctr_range(s, off, n, NULL, false);
+}
+
+static void sec_close(sec_stream_t *s)
+{
+    seg_iter_t it;
+    uint8_t *span;
+    size_t len;
+    seg_iter_init(&it, &s->seg, 0, s->seg.len);
+    while ((len = seg_iter_next(&it, &span)) != 0)
+        secure_wipe(span, len);
+    seg_free(&s->seg);
+    sec_key_put(s->key);
+    memset(s, 0, sizeof(*s));
+}
+
+/* =========================
+ *  LIFETIME-AWARE ALLOCATION
+ * ========================= */
+// ก้อนอายุสั้นกับอายุยาวสลับกันใน heap เดียว → พอก้อนสั้นคืน ช่องว่างถูกก้อนยาวขวางไว้ = fragment ถาวร
+// lt_malloc เรียนรู้อายุต่อ description (pointer ของ string เดียวกับที่ tracker เก็บ) จากเวลา alloc→free
+// แล้วแยกที่อยู่: transient → dpool (page ของ class เดียวกันคืนได้ทั้งใบ), long-lived → TLSF region ที่จองไว้ตั้งแต่บูต
+// ที่เหลือ (ยังไม่รู้ / อายุกลาง ๆ / ใหญ่เกิน pool / caps พิเศษ) → tracked_malloc เหมือนเดิม
+// ⚠️ pointer จาก lt_malloc ต้องคืนด้วย lt_free เท่านั้น
+typedef enum
+{
+    LT_UNKNOWN = 0,
+    LT_SHORT,
+    LT_LONG,
+} lt_class_t;
+
+typedef struct
+{
+    const char *desc; // key (NULL = ช่องว่าง)
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t ewma_ms; // อายุเฉลี่ยแบบ EWMA น้ำหนัก 1/8
+    uint32_t first_ms;
+    uint8_t cls;
+} lt_site_t;
+
+enum
+{
+    LT_ROUTE_HEAP = 0,
+    LT_ROUTE_POOL,
+    LT_ROUTE_LONG,
+};
+
+// ตารางเรียนรู้ + เกณฑ์ + สวิตช์: lt_malloc/lt_free ใช้ g_lt, benchmark มีชุดของตัวเอง (ไม่แตะค่าที่ task อื่นใช้อยู่)
+typedef struct
+{
+    lt_site_t sites[LT_SITES];
+    uint32_t short_ms; // อายุเฉลี่ยต่ำกว่านี้ = สั้น
+    uint32_t long_ms;  // อายุเฉลี่ย (หรืออายุของ site ที่แทบไม่คืน) ถึงนี้ = ยาว
+    bool enabled;      // false = เรียนรู้อย่างเดียว ไม่ route
+    uint32_t routed[3];
+} lt_policy_t;
+
+static lt_policy_t g_lt = {.short_ms = LT_SHORT_MS, .long_ms = LT_LONG_MS, .enabled = LT_POLICY_ENABLE};
+static portMUX_TYPE s_lt_mux = portMUX_INITIALIZER_UNLOCKED;
+static dynamic_pool_mgr_t g_lt_pool;
+static tlsf_t *g_lt_long = NULL;
+static void *g_lt_long_mem = NULL;
+
+static bool lt_init(void)
+{
+    if (dpool_init(&g_lt_pool, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) != 0)
+        return false;
+    g_lt_long_mem = heap_caps_malloc(LT_LONG_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    g_lt_long = g_lt_long_mem ? tlsf_create(g_lt_long_mem, LT_LONG_BYTES) : NULL;
+    return g_lt_long != NULL;
+}
+
+// เรียกขณะถือ s_lt_mux; NULL = ตารางเต็ม (description นั้นไม่ถูกเรียนรู้)
+static lt_site_t *lt_site_locked(lt_policy_t *pol, const char *desc)
+{
+    uint32_t h = (uint32_t)(((uintptr_t)desc >> 2) * 2654435761u) & (LT_SITES - 1);
+    for (int i = 0; i < LT_SITES; i++, h = (h + 1) & (LT_SITES - 1))
+    {
+        lt_site_t *st = &pol->sites[h];
+        if (st->desc == desc)
+            return st;
+        if (!st->desc)
+        {
+            st->desc = desc;
+            st->first_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+            return st;
+        }
+    }
+    return NULL;
+}
+
+static void lt_reclassify_locked(const lt_policy_t *pol, lt_site_t *st, uint32_t now_ms)
+{
+    if (st->allocs < LT_MIN_SAMPLES)
+        st->cls = LT_UNKNOWN;
+    else if (st->frees >= LT_MIN_SAMPLES && st->ewma_ms < pol->short_ms)
+        st->cls = LT_SHORT;
+    else if ((st->frees >= LT_MIN_SAMPLES && st->ewma_ms >= pol->long_ms) ||
+             (st->frees * 4 < st->allocs && now_ms - st->first_ms >= pol->long_ms))
+        st->cls = LT_LONG; // อายุยาวจริง หรือสร้างแล้วแทบไม่เคยคืนมานานพอ
+    else
+        st->cls = LT_UNKNOWN;
+}
+
+static void lt_learn(lt_policy_t *pol, const char *desc, uint32_t life_ms)
+{
+    if (!desc)
+        return;
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+    taskENTER_CRITICAL(&s_lt_mux);
+    lt_site_t *st = lt_site_locked(pol, desc);
+    if (st)
+    {
+        st->ewma_ms = st->frees ? (uint32_t)((int32_t)st->ewma_ms + ((int32_t)life_ms - (int32_t)st->ewma_ms) / 8)
+                                : life_ms;
+        st->frees++;
+        lt_reclassify_locked(pol, st, now_ms);
+    }
+    taskEXIT_CRITICAL(&s_lt_mux);
+}
+
+// pool / long region ตามที่เรียนรู้, NULL = ให้ tracked_malloc จัดการ (noinline แยกไว้ → call site ของ profiler ยังเป็นผู้เรียก lt_malloc)
+static void *__attribute__((noinline)) lt_route(lt_policy_t *pol, size_t size, uint32_t caps, const char *desc)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+    uint8_t cls = LT_UNKNOWN;
+    taskENTER_CRITICAL(&s_lt_mux);
+    lt_site_t *st = desc ? lt_site_locked(pol, desc) : NULL;
+    if (st)
+    {
+        st->allocs++;
+        lt_reclassify_locked(pol, st, now_ms);
+        cls = st->cls;
+    }
+    taskEXIT_CRITICAL(&s_lt_mux);
+
+    const uint32_t plain = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT | MALLOC_CAP_32BIT | MALLOC_CAP_DEFAULT;
+    if (!pol->enabled || !g_lt_long || (caps & ~plain) != 0)
+        return NULL;
+    void *p = NULL;
+    if (cls == LT_SHORT && size <= SEG_CHUNK)
+    {
+        p = dpool_alloc(&g_lt_pool, size, desc); // ลง tracker ให้เองพร้อม desc/เวลา
+        if (p)
+            __atomic_add_fetch(&pol->routed[LT_ROUTE_POOL], 1, __ATOMIC_RELAXED);
+    }
+    else if (cls == LT_LONG)
+    {
+        p = tlsf_malloc(g_lt_long, size);
+        if (p)
+        {
+            register_allocation_manual(p, size, caps, desc);
+            __atomic_add_fetch(&pol->routed[LT_ROUTE_LONG], 1, __ATOMIC_RELAXED);
+        }
+    }
+    return p;
+}
+
+static inline __attribute__((always_inline)) void *lt_malloc_with(lt_policy_t *pol, size_t size, uint32_t caps,
+                                                                   const char *desc)
+{
+    void *p = lt_route(pol, size, caps, desc);
+    if (!p)
+    {
+        p = tracked_malloc(size, caps, desc);
+        if (p)
+            __atomic_add_fetch(&pol->routed[LT_ROUTE_HEAP], 1, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+static inline __attribute__((always_inline)) void *lt_malloc(size_t size, uint32_t caps, const char *desc)
+{
+    return lt_malloc_with(&g_lt, size, caps, desc);
+}
+
+// คืนได้ไม่ว่า block มาจากทางไหน; อายุถูกเรียนรู้เข้า pol (ต้องเป็นชุดเดียวกับตอน alloc)
+static void lt_free_with(lt_policy_t *pol, void *ptr, const char *desc)
+{
+    if (!ptr)
+        return;
+    alloc_track_entry_t e;
+    if (alloc_track_lookup(ptr, &e))
+        lt_learn(pol, e.description, (uint32_t)(esp_timer_get_time() / 1000ULL) - e.timestamp_ms);
+
+    own_lookup_t own;
+    if (g_lt_long && tlsf_owns(g_lt_long, ptr))
+    {
+        unregister_allocation_manual(ptr, desc);
+        tlsf_free(g_lt_long, ptr);
+    }
+    else if (own_lookup(ptr, &own) && own.kind == OWN_KIND_DPOOL_PAGE)
+    {
+        // block ของ dpool ตัวอื่น (เช่น g_seg_pool) → คืนให้เจ้าของจริง ห้ามใส่ class/core ของ g_lt_pool
+        dynamic_pool_mgr_t *owner = ((dpool_page_t *)own.owner)->pm;
+        if (owner != &g_lt_pool)
+            ESP_LOGW(TAG, "⚠️ lt_free: %p belongs to another dpool (%s)", ptr, desc ? desc : "-");
+        dpool_free(owner, ptr, desc);
+    }
+    else
+    {
+        tracked_free(ptr, desc);
+    }
+}
+
+static void lt_free(void *ptr, const char *desc) { lt_free_with(&g_lt, ptr, desc); }
+
+// บรรทัดสถานะใน analyze_memory_status
+static void lt_log_status(void)
+{
+    if (!g_lt_long)
+        return;
+    uint32_t sites = 0, n_short = 0, n_long = 0;
+    taskENTER_CRITICAL(&s_lt_mux);
+    for (int i = 0; i < LT_SITES; i++)
+    {
+        if (!g_lt.sites[i].desc)
+            continue;
+        sites++;
+        n_short += g_lt.sites[i].cls == LT_SHORT;
+        n_long += g_lt.sites[i].cls == LT_LONG;
+    }
+    taskEXIT_CRITICAL(&s_lt_mux);
+    tlsf_stats_t ts;
+    tlsf_get_stats(g_lt_long, &ts);
+    ESP_LOGI(TAG, "Lifetime Policy:      %s sites=%lu short=%lu long=%lu routed pool/long/heap=%lu/%lu/%lu region used=%u largest=%u",
+             g_lt.enabled ? "on" : "off", (unsigned long)sites, (unsigned long)n_short, (unsigned long)n_long,
+             (unsigned long)__atomic_load_n(&g_lt.routed[LT_ROUTE_POOL], __ATOMIC_RELAXED),
+             (unsigned long)__atomic_load_n(&g_lt.routed[LT_ROUTE_LONG], __ATOMIC_RELAXED),
+             (unsigned long)__atomic_load_n(&g_lt.routed[LT_ROUTE_HEAP], __ATOMIC_RELAXED), (unsigned)ts.used_bytes,
+             (unsigned)ts.largest_free);
+}
+
+/* =========================
+ *  INCREMENTAL INTEGRITY CHECK
+ * ========================= */
+// heap_caps_check_integrity_all เดินทุก block ของทุก heap ในครั้งเดียว → หยุดนานตามขนาด heap
+// ที่นี่ตรวจทีละชิ้นจนหมด budget แล้วจำ cursor ไว้ทำต่อครั้งหน้า: record ใน tracker → dpool page → region ขนาดคงที่
+// TLSF ตรวจทีละ IC_TLSF_SLICE block; ชิ้นใหญ่สุดคือ handle heap ทั้ง region (RHEAP_BYTES, ถือ mutex ไม่ปิด interrupt)
+// → เวลาต่อครั้งมีขอบเขตแน่นอนไม่ขึ้นกับขนาด heap
+// ครบหนึ่งรอบ = ทุกอย่างถูกตรวจอย่างน้อยหนึ่งครั้ง (coverage period)
+enum
+{
+    IC_PHASE_TRACK = 0,
+    IC_PHASE_DPOOL,
+    IC_PHASE_REGION,
+    IC_NPHASE,
+};
+
+typedef struct
+{
+    // cursor (state เป็นของผู้เรียกคนเดียว ไม่มี lock)
+    uint8_t phase;
+    uint32_t track_cursor;
+    uint8_t pool, ci, core, list;
+    // page ถัดไปในลิสต์ ใช้ต่อได้เมื่อ list_gen ยังเท่า page_gen (ไม่มี page ออกจากลิสต์ระหว่างครั้ง)
+    // ไม่งั้นเริ่มลิสต์ใหม่จากหัว; เปลี่ยนซ้ำอีกในลิสต์เดียวกัน → ข้ามไปลิสต์ถัดไป (รอบหน้าก็เจอ)
+    dpool_page_t *page;
+    uint32_t page_gen;
+    bool resume;
+    uint8_t restarts;
+    uint8_t region;
+    int64_t cycle_start_us;
+    uint32_t cycle_units;
+    // ผล
+    uint32_t cycles;
+    uint32_t last_period_ms; // coverage period ของรอบล่าสุด
+    uint32_t max_period_ms;
+    uint32_t last_units;     // record + page + ชิ้นของ region ที่ตรวจในรอบล่าสุด
+    uint32_t errors;
+    uint32_t calls;
+    uint32_t max_call_us;
+} ic_state_t;
+
+static dynamic_pool_mgr_t *const s_ic_pools[] = {&g_seg_pool, &g_lt_pool};
+
+// เรียกขณะถือ lock ของ stripe: record ต้องสอดคล้องกับเจ้าของของ pointer
+static bool ic_check_record(const alloc_track_entry_t *e, void *arg)
+{
+    (void)arg;
+    if (!e->size)
+        return false;
+    if (e->caps & TRACK_CAP_MANUAL)
+    {
+        own_lookup_t own;
+        if (g_lt_long && tlsf_owns(g_lt_long, e->ptr))
+            return tlsf_block_size(e->ptr) >= e->size;
+        if (own_lookup(e->ptr, &own))
+            return own.kind != OWN_KIND_DPOOL_PAGE || own.exact;
+        return true; // dpool ที่ไม่ลง ownership map: block ถูกตรวจพร้อม page ใน phase dpool
+    }
+    // block ของ heap_caps: header ถูกเขียนทับ → ขนาดเพี้ยน (เปิด poisoning: IDF ตรวจ canary แล้ว abort เอง)
+    return esp_ptr_byte_accessible(e->ptr) && heap_caps_get_allocated_size(e->ptr) >= e->size;
+}
+
+// เรียกขณะถือ lock ของ core เจ้าของ: header ทุก block ต้องชี้กลับ page (block ก่อนหน้าเขียนเกินจะทับตรงนี้)
+// free list ต้องอยู่ใน page ตรงขอบ block ยาวเท่า free_count และไม่วน (use-after-free ทำให้ link เพี้ยน)
+static bool ic_check_dpool_page_locked(const dpool_page_t *pg, uint8_t ci, uint8_t core, uint8_t list)
+{
+    const size_t hdr = sizeof(dpool_block_hdr_t);
+    const size_t one = ALIGN_UP(hdr + pg->block_size, 8);
+    if (pg->ci != ci || pg->core != core || pg->list != list || pg->free_count > pg->blocks ||
+        (pg->next && pg->next->prev != pg) || _dpool_list_for(pg) != list)
+        return false;
+    for (uint16_t i = 0; i < pg->blocks; i++)
+    {
+        const dpool_block_hdr_t *bh = (const dpool_block_hdr_t *)(pg->base + (size_t)i * one);
+        if (bh->owner != pg || bh->sizeclass != ci)
+            return false;
+    }
+    uint32_t n = 0;
+    for (const uint8_t *b = (const uint8_t *)pg->free_list; b; b = *(const uint8_t *const *)b)
+    {
+        if (b < pg->base + hdr || (size_t)(b - pg->base) >= one * pg->blocks ||
+            (size_t)(b - pg->base - hdr) % one != 0 || ++n > pg->free_count)
+            return false;
+    }
+    return n == pg->free_count;
+}
+
+// ตรวจ page ถัดไปหนึ่งใบ; true = เดินครบทุก pool แล้ว
+static bool ic_step_dpool(ic_state_t *ic, uint32_t *bad)
+{
+    const uint8_t npools = (uint8_t)(sizeof(s_ic_pools) / sizeof(s_ic_pools[0]));
+    while (ic->pool < npools)
+    {
+        dynamic_pool_mgr_t *pm = s_ic_pools[ic->pool];
+        if (pm->ready)
+        {
+            dpool_core_t *k = &pm->cls[ic->ci].core[ic->core];
+            bool ok = true;
+            taskENTER_CRITICAL(&k->lock);
+            dpool_page_t *pg = k->lists[ic->list];
+            if (ic->resume && k->list_gen[ic->list] == ic->page_gen)
+                pg = ic->page;
+            else if (ic->resume && ic->restarts++)
+                pg = NULL;
+            if (pg)
+            {
+                ok = ic_check_dpool_page_locked(pg, ic->ci, ic->core, ic->list);
+                ic->page = pg->next;
+                ic->page_gen = k->list_gen[ic->list];
+                ic->resume = true;
+            }
+            taskEXIT_CRITICAL(&k->lock);
+            if (pg)
+            {
+                if (!ok)
+                {
+                    ESP_LOGE(TAG, "🚨 integrity: dpool page %p (pool %u class %u core %u) corrupted", pg,
+                             (unsigned)ic->pool, (unsigned)ic->ci, (unsigned)ic->core);
+                    (*bad)++;
+                }
+                ic->cycle_units++;
+                return false;
+            }
+            ic->page = NULL;
+            ic->resume = false;
+            ic->restarts = 0;
+            if (++ic->list < DPOOL_NLISTS)
+                continue;
+            ic->list = 0;
+            if (++ic->core < portNUM_PROCESSORS)
+                continue;
+            ic->core = 0;
+            if (++ic->ci < DPOOL_NCLASS)
+                continue;
+            ic->ci = 0;
+        }
+        ic->pool++;
+    }
+    ic->pool = 0;
+    return true;
+}
+
+// region ขนาดคงที่ทีละอัน; true = ครบแล้ว
+static bool ic_step_region(ic_state_t *ic, uint32_t *bad)
+{
+    bool ok = true;
+    switch (ic->region++)
+    {
+    case 0:
+        // ทีละช่วง block: ไม่จบรอบ → อยู่ที่ region นี้ต่อครั้งหน้า
+        if (g_lt_long && !tlsf_check_step(g_lt_long, IC_TLSF_SLICE, &ok))
+            ic->region--;
+        if (!ok)
+            ESP_LOGE(TAG, "🚨 integrity: lifetime long region (TLSF) corrupted");
+        break;
+    case 1:
+        ok = !g_rheap_ready || rheap_check(&g_rheap);
+        if (!ok)
+            ESP_LOGE(TAG, "🚨 integrity: handle heap corrupted");
+        break;
+    default:
+        ic->region = 0;
+        return true;
+    }
+    *bad += !ok;
+    ic->cycle_units++;
+    return false;
+}
+
+// ตรวจต่อจาก cursor จนหมด budget (อย่างน้อยหนึ่งชิ้น) หรือครบรอบ; true = ครบรอบในครั้งนี้
+static bool ic_step(ic_state_t *ic, uint32_t budget_us)
+{
+    int64_t t0 = esp_timer_get_time();
+    if (!ic->cycle_start_us)
+        ic->cycle_start_us = t0;
+    uint32_t bad = 0;
+    bool wrapped = false;
+    do
+    {
+        bool done;
+        if (ic->phase == IC_PHASE_TRACK)
+        {
+            alloc_track_scan_t res = {0};
+            done = alloc_track_scan(&ic->track_cursor, IC_TRACK_SLICE, ic_check_record, NULL, &res);
+            ic->cycle_units += res.visited;
+            if (res.bad)
+            {
+                ESP_LOGE(TAG, "🚨 integrity: %lu bad allocation record(s), first %p (%u B, %s)",
+                         (unsigned long)res.bad, res.first_bad.ptr, (unsigned)res.first_bad.size,
+                         res.first_bad.description ? res.first_bad.description : "-");
+                bad += res.bad;
+            }
+        }
+        else if (ic->phase == IC_PHASE_DPOOL)
+        {
+            done = ic_step_dpool(ic, &bad);
+        }
+        else
+        {
+            done = ic_step_region(ic, &bad);
+        }
+        if (done && ++ic->phase == IC_NPHASE)
+        {
+            int64_t now = esp_timer_get_time();
+            ic->phase = IC_PHASE_TRACK;
+            ic->last_period_ms = (uint32_t)((now - ic->cycle_start_us) / 1000);
+            if (ic->last_period_ms > ic->max_period_ms)
+                ic->max_period_ms = ic->last_period_ms;
+            ic->last_units = ic->cycle_units;
+            ic->cycle_units = 0;
+            ic->cycle_start_us = now;
+            ic->cycles++;
+            wrapped = true;
+        }
+    } while (!wrapped && esp_timer_get_time() - t0 < (int64_t)budget_us);
+
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    if (dt > ic->max_call_us)
+        ic->max_call_us = dt;
+    ic->calls++;
+    if (bad)
+    {
+        ic->errors += bad;
+        gpio_set_level(LED_MEMORY_ERROR, 1);
+    }
+    return wrapped;
+}
+
+/* =========================
+ *   PRESSURE HANDLERS
+ * ========================= */
+// เรียงตามราคา: page ว่างใน cache ของ dpool → arena ของ task ที่ตายแล้ว → สำเนา hot ของ cold store
+// → ประวัติ log เก่า (CRITICAL เท่านั้น: ข้อมูลหายจริง)
+static struct
+{
+    portMUX_TYPE mux;
+    cold_handle_t ring[COLD_LOG_KEEP];
+    uint32_t head; // ช่องที่จะเขียนถัดไป = เก่าสุด (แก้โดย ColdLog task เท่านั้น)
+} s_cold_log = {.mux = portMUX_INITIALIZER_UNLOCKED};
+
+static void mp_shed_dpool(mp_level_t level, void *arg)
+{
+    dpool_shrink(&g_seg_pool);
+    dpool_shrink(&g_lt_pool);
+}
+
+static void mp_shed_arenas(mp_level_t level, void *arg) { arena_task_local_reap(); }
+
+static void mp_shed_cold_hot(mp_level_t level, void *arg)
+{
+    if (g_cold_ready)
+        cold_shed(&g_cold);
+}
+
+static void mp_shed_cold_log(mp_level_t level, void *arg)
+{
+    cold_handle_t drop[COLD_LOG_KEEP / 2];
+    taskENTER_CRITICAL(&s_cold_log.mux);
+    for (int i = 0; i < COLD_LOG_KEEP / 2; i++)
+    {
+        uint32_t k = (s_cold_log.head + i) % COLD_LOG_KEEP;
+        drop[i] = s_cold_log.ring[k];
+        s_cold_log.ring[k] = COLD_INVALID;
+    }
+    taskEXIT_CRITICAL(&s_cold_log.mux);
+    for (int i = 0; i < COLD_LOG_KEEP / 2; i++)
+        if (drop[i] && !cold_free(&g_cold, drop[i]))
+        {
+            // ถูก acquire ค้างอยู่ → คืนเข้าช่องเดิม (ถ้ายังว่าง) ไม่งั้นหลุดจาก ring
+            uint32_t k = (s_cold_log.head + i) % COLD_LOG_KEEP;
+            taskENTER_CRITICAL(&s_cold_log.mux);
+            if (!s_cold_log.ring[k])
+                s_cold_log.ring[k] = drop[i];
+            taskEXIT_CRITICAL(&s_cold_log.mux);
+        }
+}
+
+static void mp_register_handlers(void)
+{
+    if (!mp_init())
+    {
+        ESP_LOGW(TAG, "Memory pressure bus init failed");
+        return;
+    }
+    mp_register("dpool-empty", 0, MP_LOW, mp_shed_dpool, NULL);
+    mp_register("arena-orphans", 1, MP_LOW, mp_shed_arenas, NULL);
+    mp_register("cold-hot", 2, MP_LOW, mp_shed_cold_hot, NULL);
+    mp_register("cold-log", 3, MP_CRITICAL, mp_shed_cold_log, NULL);
+}
+
+/* =========================
+ *            TASKS
+ * ========================= */
+static void memory_stress_test_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🧪 Memory stress test started");
+    void *test_ptrs[20] = {0};
+    int count = 0;
+
+    while (1)
+    {
+        int action = (int)(esp_random() % 3);
+        if (action == 0 && count < 20)
+        {
+            size_t size = 100 + (esp_random() % 2000);
+            uint32_t caps = (esp_random() % 2) ? MALLOC_CAP_INTERNAL : MALLOC_CAP_DEFAULT;
+            test_ptrs[count] = lt_malloc(size, caps, "StressTest");
+            if (test_ptrs[count])
+            {
+                memset(test_ptrs[count], 0xAA, size);
+                count++;
+            }
+        }
+        else if (action == 1 && count > 0)
+        {
+            int idx = (int)(esp_random() % count);
+            if (test_ptrs[idx])
+            {
+                lt_free(test_ptrs[idx], "StressTest");
+                for (int i = idx; i < count - 1; i++)
+                    test_ptrs[i] = test_ptrs[i + 1];
+                count--;
+            }
+        }
+        else
+        {
+            analyze_memory_status();
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000 + (esp_random() % 2000)));
+    }
+}
+
+static void memory_pool_test_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🏊 Memory pool mini test started");
+    const size_t sizes[] = {64, 128, 256, 512, 1024};
+    void *p[5][6] = {{0}};
+    while (1)
+    {
+        for (int s = 0; s < 5; s++)
+            for (int i = 0; i < 6; i++)
+            {
+                // description ต้องเป็น string คงที่: tracker เก็บแค่ pointer และ lt_malloc ใช้เป็น key เรียนรู้อายุ
+                p[s][i] = lt_malloc(sizes[s], MALLOC_CAP_INTERNAL, "PoolMini");
+                if (p[s][i])
+                    memset(p[s][i], 0x55 + s, sizes[s]);
+            }
+        vTaskDelay(pdMS_TO_TICKS(3000));
+        for (int s = 4; s >= 0; s--)
+            for (int i = 5; i >= 0; i--)
+            {
+                if (p[s][i])
+                {
+                    lt_free(p[s][i], "PoolMini");
+                    p[s][i] = NULL;
+                }
+            }
+        vTaskDelay(pdMS_TO_TICKS(4000));
+    }
+}
+
+// sink ของ codec stream: ต่อท้ายลง buffer ที่เตรียมไว้ (เกิน cap = หยุด stream)
+typedef struct
+{
+    uint8_t *p;
+    size_t len;
+    size_t cap;
+} codec_sink_buf_t;
+
+static int codec_sink_append(const void *data, size_t len, void *arg)
+{
+    codec_sink_buf_t *b = (codec_sink_buf_t *)arg;
+    if (b->len + len > b->cap)
+        return -1;
+    memcpy(b->p + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+// ส่ง src ผ่าน stream ทีละ 1KB (เหมือนข้อมูลที่ทยอยเข้ามา) → ผลลัพธ์ต่อท้ายใน out
+static int codec_stream_run(mcodec_id_t codec, bool decode, const uint8_t *src, size_t n, codec_sink_buf_t *out,
+                            uint32_t blocks[3])
+{
+    mcodec_stream_t st;
+    if (mcodec_stream_init(&st, codec, decode, 0, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, codec_sink_append, out) != 0)
+        return -1;
+    int rc = 0;
+    for (size_t off = 0; off < n && rc == 0; off += 1024)
+        rc = mcodec_stream_write(&st, src + off, n - off < 1024 ? n - off : 1024);
+    if (rc == 0)
+        rc = mcodec_stream_flush(&st);
+    if (blocks)
+        memcpy(blocks, st.blocks, sizeof(st.blocks));
+    mcodec_stream_deinit(&st);
+    return rc;
+}
+
+static void large_allocation_test_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🐘 Large allocation test started");
+    while (1)
+    {
+        size_t n = 50000 + (esp_random() % 100000);
+        void *buf = tracked_malloc(n, MALLOC_CAP_INTERNAL, "LargeInternal");
+        if (!buf)
+            buf = tracked_malloc(n, MALLOC_CAP_SPIRAM, "LargeSPIRAM");
+        if (buf)
+        {
+            // Fill then compress/decompress
+            for (size_t i = 0; i < n;)
+            {
+                size_t run = 1 + (esp_random() % 256);
+                uint8_t v = (uint8_t)(esp_random() & 0xFF);
+                if (i + run > n)
+                    run = n - i;
+                memset((uint8_t *)buf + i, v, run);
+                i += run;
+                size_t mix = (esp_random() % 64);
+                if (i + mix > n)
+                    mix = n - i;
+                for (size_t j = 0; j < mix; j++)
+                    ((uint8_t *)buf)[i + j] = (uint8_t)(esp_random() & 0xFF);
+                i += mix;
+            }
+            // block ที่บีบไม่ลงเก็บดิบ → frame ไม่เกิน n + header ต่อ block
+            size_t cap = n + (n / MCODEC_STREAM_BLOCK + 1) * MCODEC_FRAME_HDR;
+            void *c = tracked_malloc(cap, MALLOC_CAP_INTERNAL, "CODEC_C");
+            void *d = tracked_malloc(n, MALLOC_CAP_INTERNAL, "CODEC_D");
+            if (c && d)
+            {
+                codec_sink_buf_t cb = {(uint8_t *)c, 0, cap}, db = {(uint8_t *)d, 0, n};
+                uint32_t blocks[3] = {0};
+                uint64_t cs = esp_timer_get_time();
+                int rc = codec_stream_run(MCODEC_AUTO, false, (const uint8_t *)buf, n, &cb, blocks);
+                uint64_t ce = esp_timer_get_time();
+                if (rc == 0)
+                    rc = codec_stream_run(MCODEC_AUTO, true, cb.p, cb.len, &db, NULL);
+                uint64_t de = esp_timer_get_time();
+                bool ok = rc == 0 && db.len == n && memcmp(buf, d, n) == 0;
+                ESP_LOGI(TAG, "🔁 CODEC: orig=%u comp=%u (%.2f%%) blocks raw/rle/lz=%lu/%lu/%lu enc_us=%llu dec_us=%llu ok=%d",
+                         (unsigned)n, (unsigned)cb.len, cb.len ? 100.f * (float)cb.len / (float)n : 0.f,
+                         (unsigned long)blocks[MCODEC_RAW], (unsigned long)blocks[MCODEC_RLE],
+                         (unsigned long)blocks[MCODEC_LZ], (unsigned long long)(ce - cs),
+                         (unsigned long long)(de - ce), ok);
+            }
+            if (c)
+                tracked_free(c, "CODEC_C");
+            if (d)
+                tracked_free(d, "CODEC_D");
+            tracked_free(buf, "Large");
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Large alloc failed");
+            analyze_memory_status();
+            // ไม่มี block ต่อเนื่องใหญ่พอ → segmented buffer (ต้องการแค่ page ของ dpool ต่อเนื่อง)
+            seg_buf_t sb;
+            if (seg_alloc(&sb, &g_seg_pool, n) == 0)
+            {
+                for (size_t i = 0; i < n;)
+                {
+                    size_t run = 1 + (esp_random() % 256);
+                    i += seg_fill(&sb, i, (uint8_t)(esp_random() & 0xFF), run);
+                }
+                seg_iter_t it;
+                uint8_t *span;
+                size_t len, spans = 0;
+                uint32_t sum = 0;
+                seg_iter_init(&it, &sb, 0, n);
+                while ((len = seg_iter_next(&it, &span)) != 0)
+                {
+                    for (size_t k = 0; k < len; k++)
+                        sum += span[k];
+                    spans++;
+                }
+                ESP_LOGI(TAG, "📦 SEG fallback: %u bytes in %lu chunks (largest free %u) spans=%u sum=%08lx",
+                         (unsigned)n, (unsigned long)sb.nchunks,
+                         (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT), (unsigned)spans,
+                         (unsigned long)sum);
+
+                // ต่อ header ไว้หน้า payload ใน buffer ใหม่: ขอบ chunk สองฝั่งเหลื่อมกัน 8 byte
+                // → seg_copy ตัดแต่ละช่วงตามฝั่งที่สั้นกว่า ไม่ต้องมี buffer ต่อเนื่องขนาด n ตรงกลาง
+                seg_buf_t framed;
+                uint32_t hdr[2] = {(uint32_t)n, sum};
+                if (seg_alloc(&framed, &g_seg_pool, sizeof(hdr) + n) == 0)
+                {
+                    seg_write(&framed, 0, hdr, sizeof(hdr));
+                    size_t copied = seg_copy(&framed, sizeof(hdr), &sb, 0, n);
+
+                    // ฝั่งผู้รับ: อ่าน header แล้วตรวจ payload ทีละ iovec (แบบที่ส่งต่อให้ socket/DMA)
+                    uint32_t rx[2] = {0}, rsum = 0;
+                    seg_iovec_t iov[8];
+                    size_t off = sizeof(hdr);
+                    int k, nvec = 0;
+                    seg_read(&framed, 0, rx, sizeof(rx));
+                    while ((k = seg_iovec(&framed, off, framed.len - off, iov, 8)) > 0)
+                    {
+                        for (int j = 0; j < k; j++)
+                        {
+                            for (size_t b = 0; b < iov[j].len; b++)
+                                rsum += ((const uint8_t *)iov[j].base)[b];
+                            off += iov[j].len;
+                        }
+                        nvec += k;
+                    }
+                    bool ok = copied == n && rx[0] == (uint32_t)n && rx[1] == sum && rsum == sum;
+                    ESP_LOGI(TAG, "📦 SEG frame: hdr+%u bytes copied across shifted chunks, %d iovecs, sum %08lx %s",
+                             (unsigned)copied, nvec, (unsigned long)rsum, ok ? "OK" : "MISMATCH");
+                    seg_free(&framed);
+                }
+                seg_free(&sb);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(12000));
+    }
+}
+
+// compaction ทีละขั้น (≤ RHEAP_STEP_BUDGET_US) สลับกับคืน CPU → task อื่นที่ pin/alloc รอไม่นาน
+// รอบแรกอาจเริ่มกลาง region (cursor ค้างจากครั้งก่อน) → ทำ 2 รอบให้ครอบคลุมทั้ง region
+static void rheap_compactor_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🧲 Handle heap compactor started");
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RHEAP_COMPACT_PERIOD_MS));
+        rheap_stats_t before, after;
+        rheap_get_stats(&g_rheap, &before);
+        if (before.fragmentation <= FRAGMENTATION_THRESHOLD)
+            continue;
+
+        uint64_t t0 = esp_timer_get_time();
+        uint32_t steps = 0, moved = 0, max_step_us = 0;
+        int passes = 0;
+        while (passes < 2)
+        {
+            uint32_t m;
+            uint64_t s0 = esp_timer_get_time();
+            passes += rheap_compact(&g_rheap, RHEAP_STEP_BUDGET_US, &m) ? 1 : 0;
+            uint32_t dt = (uint32_t)(esp_timer_get_time() - s0);
+            if (dt > max_step_us)
+                max_step_us = dt;
+            moved += m;
+            steps++;
+            vTaskDelay(1);
+        }
+        rheap_get_stats(&g_rheap, &after);
+        ESP_LOGI(TAG, "🧲 compact: largest %u → %u B, frag %.1f%% → %.1f%%, moved=%lu in %lu steps (max %lu us), %llu ms",
+                 (unsigned)before.largest_free, (unsigned)after.largest_free, before.fragmentation * 100.0f,
+                 after.fragmentation * 100.0f, (unsigned long)moved, (unsigned long)steps, (unsigned long)max_step_us,
+                 (unsigned long long)((esp_timer_get_time() - t0) / 1000ULL));
+    }
+}
+
+// ข้อความอายุต่างกัน: ก้อนสั้นคืนทันที ก้อนยาวค้างใน ring แล้วถูกแทนแบบสุ่ม → handle heap fragment เรื่อย ๆ
+// ทุกครั้งที่ใช้ข้อมูลต้อง pin/unpin (pointer ใช้ได้เฉพาะช่วงที่ pin อยู่)
+#define RELOC_DEMO_KEEP 24
+static void reloc_demo_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🧲 Relocatable handle demo started");
+    rheap_handle_t keep[RELOC_DEMO_KEEP] = {0};
+    while (1)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            size_t n = 32 + (esp_random() % 480);
+            rheap_handle_t h = rheap_alloc(&g_rheap, n);
+            if (h == RHEAP_INVALID)
+                continue;
+            uint8_t *p = (uint8_t *)rheap_pin(&g_rheap, h);
+            memset(p, (uint8_t)h, n);
+            rheap_unpin(&g_rheap, h);
+
+            int slot = (int)(esp_random() % RELOC_DEMO_KEEP);
+            if (esp_random() % 3 == 0)
+            {
+                if (keep[slot])
+                    rheap_free(&g_rheap, keep[slot]);
+                keep[slot] = h;
+            }
+            else
+            {
+                rheap_free(&g_rheap, h);
+            }
+        }
+        // ตรวจว่าข้อมูลยังอยู่ครบแม้ถูกย้าย
+        for (int i = 0; i < RELOC_DEMO_KEEP; i++)
+        {
+            if (!keep[i])
+                continue;
+            size_t n = rheap_size(&g_rheap, keep[i]);
+            const uint8_t *p = (const uint8_t *)rheap_pin(&g_rheap, keep[i]);
+            for (size_t k = 0; p && k < n; k++)
+                if (p[k] != (uint8_t)keep[i])
+                {
+                    ESP_LOGE(TAG, "🧲 handle 0x%08lx corrupted at %u", (unsigned long)keep[i], (unsigned)k);
+                    gpio_set_level(LED_MEMORY_ERROR, 1);
+                    break;
+                }
+            rheap_unpin(&g_rheap, keep[i]);
+        }
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+}
+
+// log ที่เขียนแล้วแทบไม่ถูกอ่าน: สะสมเป็นชิ้นละ COLD_LOG_CHUNK แล้วฝากเข้า cold store (บีบทันที)
+// อ่านชิ้นเก่าแบบสุ่มเป็นครั้งคราว → คลายเป็นสำเนา hot ชั่วคราว แล้ว sweep บีบกลับเมื่อไม่ถูกแตะเกิน COLD_IDLE_MS
+static void cold_log_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🧊 Cold log store started");
+    uint32_t seq = 0;
+    char *buf = (char *)tracked_malloc(COLD_LOG_CHUNK, MALLOC_CAP_8BIT, "COLD_LOG");
+    if (!buf)
+    {
+        vTaskDelete(NULL);
+        return;
+    }
+    while (1)
+    {
+        size_t len = 0;
+        while (len + 128 < COLD_LOG_CHUNK)
+        {
+            int w = snprintf(buf + len, COLD_LOG_CHUNK - len, "I (%lu) HEAP_MGMT: seq=%lu free=%u largest=%u min=%u\n",
+                             (unsigned long)(esp_timer_get_time() / 1000), (unsigned long)seq++,
+                             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+                             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+            if (w <= 0)
+                break;
+            len += (size_t)w;
+        }
+        // ring ใช้ร่วมกับ pressure handler (ทิ้ง log เก่าได้ทุกเมื่อ) → สลับ handle ใต้ mux, cold_* นอก mux
+        uint32_t pick = esp_random() % COLD_LOG_KEEP;
+        taskENTER_CRITICAL(&s_cold_log.mux);
+        cold_handle_t old = s_cold_log.ring[s_cold_log.head];
+        s_cold_log.ring[s_cold_log.head] = COLD_INVALID;
+        taskEXIT_CRITICAL(&s_cold_log.mux);
+        if (old)
+            cold_free(&g_cold, old);
+        cold_handle_t nh = cold_put(&g_cold, buf, len, "LOG");
+        taskENTER_CRITICAL(&s_cold_log.mux);
+        s_cold_log.ring[s_cold_log.head] = nh;
+        s_cold_log.head = (s_cold_log.head + 1) % COLD_LOG_KEEP;
+        cold_handle_t h = s_cold_log.ring[pick];
+        taskEXIT_CRITICAL(&s_cold_log.mux);
+        const char *p = h ? (const char *)cold_acquire(&g_cold, h, false) : NULL;
+        if (p)
+        {
+            if (memcmp(p, "I (", 3) != 0)
+            {
+                ESP_LOGE(TAG, "🧊 cold entry 0x%08lx corrupted", (unsigned long)h);
+                gpio_set_level(LED_MEMORY_ERROR, 1);
+            }
+            cold_release(&g_cold, h);
+        }
+        cold_sweep(&g_cold);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+// ส่ง dump ออก console ตรง ๆ (ไม่มี prefix ของ log) → คัดระหว่าง marker แล้วป้อน pprof ได้เลย
+static void heap_profile_write_console(const char *text, void *arg)
+{
+    fputs(text, stdout);
+}
+
+static void heap_profile_dump_console(void)
+{
+    printf("----- BEGIN HEAP PROFILE -----\n");
+    heap_sample_dump(heap_profile_write_console, NULL);
+    printf("----- END HEAP PROFILE -----\n");
+    fflush(stdout);
+}
+
+static void mem_pressure_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "🫧 Memory pressure watcher started (%u ms)", (unsigned)MP_POLL_MS);
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(MP_POLL_MS));
+        mp_poll();
+    }
+}
+
+static void memory_monitor_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "📊 Memory monitor started");
+    uint32_t round = 0;
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+        analyze_memory_status();
+        print_allocation_summary();
+        detect_memory_leaks();
+        heap_sample_print_top(HEAP_SAMPLE_TOP);
+        arena_task_local_reap();
+        if (g_lt_long)
+            dpool_defrag_hint(&g_lt_pool); // page ของ transient ที่ว่างนานเกิน decay คืน heap
+        if (HEAP_SAMPLE_DUMP_EVERY && ++round % HEAP_SAMPLE_DUMP_EVERY == 0)
+            heap_profile_dump_console();
+        // ปกติ ic_step ใน heap_integrity_test_task ตรวจแทนแบบมีขอบเขตเวลา
+#if IC_FULL_SCAN_DEBUG
+        if (!heap_caps_check_integrity_all(true))
+        {
+            ESP_LOGE(TAG, "🚨 HEAP CORRUPTION DETECTED");
+            gpio_set_level(LED_MEMORY_ERROR, 1);
+        }
+#endif
+        ESP_LOGI(TAG, "Free heap: %u", (unsigned)esp_get_free_heap_size());
+        ESP_LOGI(TAG, "Uptime: %llu ms\n", (unsigned long long)(esp_timer_get_time() / 1000ULL));
+    }
+}
+
+/* =========================
+ *   TRACKER BENCHMARK
+ * ========================= */
+#ifndef TRACK_BENCH_ENABLE
+#define TRACK_BENCH_ENABLE 0 // 1 = รัน benchmark ตอนบูต
+#endif
+#define TRACK_BENCH_ROUNDS 2000
+#define TRACK_BENCH_SIZE 32
+
+#ifndef ARENA_BENCH_ENABLE
+#define ARENA_BENCH_ENABLE 0 // 1 = รัน benchmark ของ arena (รันต่อจาก tracker bench ใน task เดียวกัน)
+#endif
+#define ARENA_BENCH_ROUNDS 4000
+#ifndef RHEAP_BENCH_ENABLE
+#define RHEAP_BENCH_ENABLE 0 // 1 = รัน fragmentation torture ของ handle heap (รันต่อจาก arena bench)
+#endif
+#define RHEAP_BENCH_BYTES (32 * 1024)
+#define RHEAP_BENCH_EVENTS 5 // จำนวนรอบ "ทำให้ fragment → compact → ขอก้อนใหญ่" ติดกัน
+#ifndef SEG_BENCH_ENABLE
+#define SEG_BENCH_ENABLE 0 // 1 = รัน throughput ของ segmented buffer เทียบ buffer ต่อเนื่อง (รันต่อจาก handle heap)
+#endif
+#define SEG_BENCH_BYTES (64 * 1024)
+#define SEG_BENCH_REPS 8
+#define SEG_BENCH_RANDOM 4096 // จำนวน read สุ่ม 16 byte ต่อรอบ
+#ifndef CODEC_BENCH_ENABLE
+#define CODEC_BENCH_ENABLE 0 // 1 = รัน ratio/throughput ของ codec (รันต่อจาก segmented buffer)
+#endif
+#define CODEC_BENCH_BYTES (16 * 1024)
+#define CODEC_BENCH_REPS 8
+#ifndef SECURE_BENCH_ENABLE
+#define SECURE_BENCH_ENABLE 0 // 1 = รันเทียบ secure_store/load กับ secure stream (รันต่อจาก codec)
+#endif
+#define SECURE_BENCH_MAX (16 * 1024)
+#define SECURE_BENCH_REPS 32
+#ifndef LT_BENCH_ENABLE
+#define LT_BENCH_ENABLE 0 // 1 = รันเทียบ fragmentation แบบปิด/เปิด lifetime policy (รันต่อจาก secure)
+#endif
+#define LT_BENCH_STEPS 2000
+#define LT_BENCH_RING 32 // ก้อนสั้นอยู่ได้ ~8 step แล้วถูกแทน
+#define LT_BENCH_LONG 48 // ก้อนยาว 1 ก้อนทุก 8 step (ค้างจนจบรอบ)
+#ifndef IC_BENCH_ENABLE
+#define IC_BENCH_ENABLE 0 // 1 = รันเทียบ full integrity scan กับ incremental checker (รันต่อจาก lifetime)
+#endif
+#ifndef MP_BENCH_ENABLE
+#define MP_BENCH_ENABLE 0 // 1 = รันจำลอง pressure spike → reclaim → recovery (รันต่อจาก integrity)
+#endif
+#define MP_BENCH_CACHE (32 * 1024) // segmented buffer ที่จองแล้วคืน → page ว่างค้างใน cache ให้ reclaim
+#define MP_BENCH_BALLAST 512       // ก้อน ballast 1KB สูงสุด
+#define MP_BENCH_SYNC_BYTES 6144   // ก้อนที่ขอตอน largest block เหลือไม่พอ (ต้องได้จาก sync reclaim)
+
+#ifndef DPOOL_BENCH_ENABLE
+#define DPOOL_BENCH_ENABLE 0 // 1 = รัน benchmark ของ dpool (รันต่อจาก tracker bench ใน task เดียวกัน)
+#endif
+// task เดียวรันทุก bench ที่เปิดตามลำดับ (ทั้งหมดปิดเป็นค่าเริ่มต้น: กิน RAM/CPU ตอนบูตและรบกวน task อื่น)
+#define BENCH_TASK_ENABLE                                                                                              \
+    (TRACK_BENCH_ENABLE || DPOOL_BENCH_ENABLE || ARENA_BENCH_ENABLE || RHEAP_BENCH_ENABLE || SEG_BENCH_ENABLE ||       \
+     CODEC_BENCH_ENABLE || SECURE_BENCH_ENABLE || LT_BENCH_ENABLE || IC_BENCH_ENABLE || MP_BENCH_ENABLE)
+#define DPOOL_BENCH_BLOCKS 4  // block ต่อ page ของ bench (page เล็ก → ได้หลายพัน page)
+#define DPOOL_BENCH_ROUNDS 2000
+
+// pointer ปลอมนอกช่วง heap จริง ใช้เติม table ให้มี live entry ตามต้องการโดยไม่ต้อง malloc จริง
+static inline void *bench_fake_ptr(uint32_t i) { return (void *)(uintptr_t)(0x10000000u + i * 16u); }
+
+#if DPOOL_BENCH_ENABLE && portNUM_PROCESSORS > 1
+typedef struct
+{
+    dynamic_pool_mgr_t *pm;
+    QueueHandle_t hand; // producer → consumer (free ข้าม core)
+    SemaphoreHandle_t done;
+} dpool_bench_arg_t;
+
+static void dpool_bench_local_task(void *arg)
+{
+    dpool_bench_arg_t *a = (dpool_bench_arg_t *)arg;
+    for (int r = 0; r < DPOOL_BENCH_ROUNDS * 4; r++)
+        dpool_free(a->pm, dpool_alloc(a->pm, 64, "DPOOL_MT"), "DPOOL_MT");
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void dpool_bench_producer_task(void *arg)
+{
+    dpool_bench_arg_t *a = (dpool_bench_arg_t *)arg;
+    for (int r = 0; r < DPOOL_BENCH_ROUNDS * 4; r++)
+    {
+        void *p = dpool_alloc(a->pm, 64, "DPOOL_MT");
+        if (p)
+            xQueueSend(a->hand, &p, portMAX_DELAY);
+    }
+    void *end = NULL;
+    xQueueSend(a->hand, &end, portMAX_DELAY);
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void dpool_bench_consumer_task(void *arg)
+{
+    dpool_bench_arg_t *a = (dpool_bench_arg_t *)arg;
+    void *p;
+    while (xQueueReceive(a->hand, &p, portMAX_DELAY) == pdTRUE && p)
+        dpool_free(a->pm, p, "DPOOL_MT");
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+// throughput (alloc+free ต่อ ms) ของ 1 core เทียบ 2 core พร้อมกัน แล้ว alloc core 0 / free core 1 (ผ่าน remote queue)
+static void dpool_bench_scaling(uint32_t caps)
+{
+    dynamic_pool_mgr_t pm;
+    if (dpool_init(&pm, caps) != 0)
+        return;
+    dpool_bench_arg_t a = {.pm = &pm, .hand = xQueueCreate(64, sizeof(void *)), .done = xSemaphoreCreateCounting(2, 0)};
+    if (!a.hand || !a.done)
+        return;
+    const uint32_t ops = DPOOL_BENCH_ROUNDS * 4;
+
+    ESP_LOGI(TAG, "\n⏱️ ═══ DPOOL MULTI-CORE (class 64 B, %lu alloc+free per task) ═══", (unsigned long)ops);
+    uint64_t t0 = esp_timer_get_time();
+    xTaskCreatePinnedToCore(dpool_bench_local_task, "DpoolMT0", 3072, &a, 2, NULL, 0);
+    xSemaphoreTake(a.done, portMAX_DELAY);
+    uint64_t t1 = esp_timer_get_time();
+    xTaskCreatePinnedToCore(dpool_bench_local_task, "DpoolMT0", 3072, &a, 2, NULL, 0);
+    xTaskCreatePinnedToCore(dpool_bench_local_task, "DpoolMT1", 3072, &a, 2, NULL, 1);
+    xSemaphoreTake(a.done, portMAX_DELAY);
+    xSemaphoreTake(a.done, portMAX_DELAY);
+    uint64_t t2 = esp_timer_get_time();
+    xTaskCreatePinnedToCore(dpool_bench_producer_task, "DpoolProd", 3072, &a, 2, NULL, 0);
+    xTaskCreatePinnedToCore(dpool_bench_consumer_task, "DpoolCons", 3072, &a, 2, NULL, 1);
+    xSemaphoreTake(a.done, portMAX_DELAY);
+    xSemaphoreTake(a.done, portMAX_DELAY);
+    uint64_t t3 = esp_timer_get_time();
+
+    uint32_t one = (uint32_t)(ops * 1000ULL / (t1 - t0 ? t1 - t0 : 1));
+    uint32_t two = (uint32_t)(2ULL * ops * 1000ULL / (t2 - t1 ? t2 - t1 : 1));
+    ESP_LOGI(TAG, "1 core : %6lu ops/ms", (unsigned long)one);
+    ESP_LOGI(TAG, "2 cores: %6lu ops/ms (x%lu.%02lu)", (unsigned long)two, (unsigned long)(two / (one ? one : 1)),
+             (unsigned long)(two * 100ULL / (one ? one : 1) % 100));
+    ESP_LOGI(TAG, "cross-core producer/consumer: %lu ops/ms", (unsigned long)(ops * 1000ULL / (t3 - t2 ? t3 - t2 : 1)));
+    dpool_dump(&pm);
+    dpool_shrink(&pm);
+    vQueueDelete(a.hand);
+    vSemaphoreDelete(a.done);
+}
+#endif
+
+#if DPOOL_BENCH_ENABLE
+#define DPOOL_SAW_BASE 192  // live block ฐาน (3 page ของ class 128 B)
+#define DPOOL_SAW_SWING 96  // ขึ้น/ลงรอบละเท่านี้ → ข้ามขอบ page 2 ใบทุกรอบ
+#define DPOOL_SAW_CYCLES 200
+
+// งานฟันเลื่อย: ค้าง BASE block แล้ว alloc/free SWING block ซ้ำ ๆ — เทียบไม่มี cache กับ cache ค่าเริ่มต้น
+static void dpool_bench_sawtooth(uint32_t caps)
+{
+    void **blk = (void **)heap_caps_malloc((DPOOL_SAW_BASE + DPOOL_SAW_SWING) * sizeof(void *), caps);
+    if (!blk)
+        return;
+    ESP_LOGI(TAG, "\n⏱️ ═══ DPOOL SAWTOOTH (class 128 B, %d ± %d blocks, %d cycles) ═══", DPOOL_SAW_BASE,
+             DPOOL_SAW_SWING, DPOOL_SAW_CYCLES);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        dynamic_pool_mgr_t pm;
+        if (dpool_init(&pm, caps) != 0)
+            break;
+        if (pass == 0)
+            dpool_set_empty_cache(&pm, 1, 0, 0, 0);
+
+        for (int i = 0; i < DPOOL_SAW_BASE; i++)
+            blk[i] = dpool_alloc(&pm, 128, "DPOOL_SAW");
+        dpool_class_stats_t st0, st1;
+        dpool_get_class_stats(&pm, 1, &st0);
+        uint64_t t0 = esp_timer_get_time();
+        for (int cyc = 0; cyc < DPOOL_SAW_CYCLES; cyc++)
+        {
+            for (int i = DPOOL_SAW_BASE; i < DPOOL_SAW_BASE + DPOOL_SAW_SWING; i++)
+                blk[i] = dpool_alloc(&pm, 128, "DPOOL_SAW");
+            for (int i = DPOOL_SAW_BASE + DPOOL_SAW_SWING - 1; i >= DPOOL_SAW_BASE; i--)
+                dpool_free(&pm, blk[i], "DPOOL_SAW");
+        }
+        uint64_t t1 = esp_timer_get_time();
+        dpool_get_class_stats(&pm, 1, &st1);
+
+        char label[24];
+        snprintf(label, sizeof(label), pass == 0 ? "no cache" : "cache %d..%d", DPOOL_EMPTY_LOW, DPOOL_EMPTY_HIGH);
+        uint32_t created = st1.pages_created - st0.pages_created;
+        uint32_t released = st1.pages_released - st0.pages_released;
+        ESP_LOGI(TAG, "%-12s: pages created=%4lu released=%4lu (%lu.%02lu per cycle)  %5lu us/cycle",
+                 label, (unsigned long)created, (unsigned long)released,
+                 (unsigned long)((created + released) / DPOOL_SAW_CYCLES),
+                 (unsigned long)((created + released) * 100UL / DPOOL_SAW_CYCLES % 100),
+                 (unsigned long)((t1 - t0) / DPOOL_SAW_CYCLES));
+
+        for (int i = 0; i < DPOOL_SAW_BASE; i++)
+            dpool_free(&pm, blk[i], "DPOOL_SAW");
+        dpool_shrink(&pm);
+        vTaskDelay(1);
+    }
+    heap_caps_free(blk);
+}
+
+// เวลาต่อคู่ dpool_alloc+dpool_free เมื่อ class มี page เต็มเป็นพัน ๆ และมี partial กระจายอยู่
+// "scan" = เวลาเดินทุก page หนึ่งรอบ (= worst case ของการเลือก page แบบไล่ลิสต์)
+static void dpool_bench(void)
+{
+    static const uint32_t levels[] = {16, 128, 1024, 2048};
+    bool spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+    uint32_t caps = spiram ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    alloc_track_stats_t ts;
+    alloc_track_get_stats(&ts);
+
+    dynamic_pool_mgr_t pm;
+    if (dpool_init(&pm, caps) != 0)
+        return;
+    pm.cls[0].blocks_per_page = DPOOL_BENCH_BLOCKS;
+    const size_t page_bytes = sizeof(dpool_page_t) +
+                              DPOOL_BENCH_BLOCKS * ALIGN_UP(sizeof(dpool_block_hdr_t) + pm.cls[0].size, 8) + 16;
+
+    ESP_LOGI(TAG, "\n⏱️ ═══ DPOOL PAGE SELECTION (class 64 B, %d blocks/page, %s) ═══", DPOOL_BENCH_BLOCKS,
+             spiram ? "SPIRAM" : "internal");
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++)
+    {
+        uint32_t pages = levels[l];
+        uint32_t nblk = pages * DPOOL_BENCH_BLOCKS;
+        // ใช้ไม่เกินครึ่งของ heap ที่เหลือ และเหลือที่ใน tracker ให้ task อื่น
+        if ((size_t)pages * page_bytes + nblk * sizeof(void *) > heap_caps_get_free_size(caps) / 2 ||
+            nblk + pages + 512 > ts.capacity - ts.live)
+        {
+            ESP_LOGW(TAG, "pages=%lu skipped (not enough memory/tracker capacity)", (unsigned long)pages);
+            break;
+        }
+        void **blk = (void **)heap_caps_malloc(nblk * sizeof(void *), caps);
+        if (!blk)
+            break;
+        uint32_t got = 0;
+        while (got < nblk && (blk[got] = dpool_alloc(&pm, 1, "DPOOL_BENCH")) != NULL)
+            got++;
+        // page ทุก ๆ 8 ให้เหลือ free 1 block (partial กระจายทั่วลิสต์)
+        for (uint32_t i = 0; i + DPOOL_BENCH_BLOCKS <= got; i += 8 * DPOOL_BENCH_BLOCKS)
+        {
+            dpool_free(&pm, blk[i], "DPOOL_BENCH");
+            blk[i] = NULL;
+        }
+
+        uint64_t t0 = esp_timer_get_time();
+        for (int r = 0; r < DPOOL_BENCH_ROUNDS; r++)
+            dpool_free(&pm, dpool_alloc(&pm, 1, "DPOOL_BENCH"), "DPOOL_BENCH");
+        uint64_t t1 = esp_timer_get_time();
+        uint32_t visited = 0, full = 0, band0 = 0;
+        volatile uint32_t sink = 0;
+        for (int k = 0; k < portNUM_PROCESSORS; k++)
+        {
+            dpool_core_t *kc = &pm.cls[0].core[k];
+            taskENTER_CRITICAL(&kc->lock);
+            for (int li = 0; li < DPOOL_NLISTS; li++)
+                for (dpool_page_t *pg = kc->lists[li]; pg; pg = pg->next, visited++)
+                    sink += (pg->free_list != NULL);
+            full += kc->list_count[DPOOL_LIST_FULL];
+            band0 += kc->list_count[0];
+            taskEXIT_CRITICAL(&kc->lock);
+        }
+        uint64_t t2 = esp_timer_get_time();
+
+        ESP_LOGI(TAG, "pages=%5lu  alloc+free=%5lu ns  scan=%7lu ns  full=%lu partial(band0)=%lu",
+                 (unsigned long)visited, (unsigned long)((t1 - t0) * 1000ULL / DPOOL_BENCH_ROUNDS),
+                 (unsigned long)((t2 - t1) * 1000ULL), (unsigned long)full, (unsigned long)band0);
+
+        for (uint32_t i = 0; i < got; i++)
+            if (blk[i])
+                dpool_free(&pm, blk[i], "DPOOL_BENCH");
+        heap_caps_free(blk);
+        dpool_shrink(&pm);
+        vTaskDelay(1);
+    }
+#if portNUM_PROCESSORS > 1
+    dpool_bench_scaling(caps);
+#endif
+    dpool_bench_sawtooth(caps);
+}
+#endif
+
+#if ARENA_BENCH_ENABLE
+// scratch แบบ request: mark → alloc 4 ก้อน → release_to เทียบกับ heap_caps_malloc/free 4 คู่
+static void arena_bench(void)
+{
+    static const size_t sz[4] = {24, 64, 200, 48};
+    bump_arena_t shared;
+    if (arena_init(&shared, 4096, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) != 0)
+        return;
+    bump_arena_t *local = arena_task_local();
+    if (!local)
+    {
+        arena_destroy(&shared);
+        return;
+    }
+    volatile uintptr_t sink = 0;
+
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < ARENA_BENCH_ROUNDS; r++)
+    {
+        void *p[4];
+        for (int i = 0; i < 4; i++)
+            p[i] = heap_caps_malloc(sz[i], MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        for (int i = 0; i < 4; i++)
+            heap_caps_free(p[i]);
+    }
+    uint64_t t1 = esp_timer_get_time();
+    for (int r = 0; r < ARENA_BENCH_ROUNDS; r++)
     {
-        dpool_block_hdr_t *bh = (dpool_block_hdr_t *)((uint8_t *)ptr - sizeof(dpool_block_hdr_t));
-        dpool_page_t *pg = bh->owner;
-        *((void **)ptr) = pg->free_list;
-        pg->free_list = ptr;
-        if (pg->free_count < 0xFFFF)
-            pg->free_count++;
-        xSemaphoreGive(pm->lock);
+        arena_mark_t m = arena_mark(local);
+        for (int i = 0; i < 4; i++)
+            sink += (uintptr_t)arena_alloc(local, sz[i], 0, NULL);
+        arena_release_to(local, m);
     }
+    uint64_t t2 = esp_timer_get_time();
+    for (int r = 0; r < ARENA_BENCH_ROUNDS; r++)
+    {
+        for (int i = 0; i < 4; i++)
+            sink += (uintptr_t)arena_alloc(&shared, sz[i], 0, NULL);
+        arena_reset(&shared);
+    }
+    uint64_t t3 = esp_timer_get_time();
+    // ก้อนใหญ่กว่า block: ต่อ chain แล้วคืน (ครั้งถัดไปใช้ spare)
+    for (int r = 0; r < ARENA_BENCH_ROUNDS / 8; r++)
+    {
+        arena_mark_t m = arena_mark(local);
+        sink += (uintptr_t)arena_alloc(local, ARENA_LOCAL_BLOCK + 512, 0, NULL);
+        arena_release_to(local, m);
+    }
+    uint64_t t4 = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "\n⏱️ ═══ ARENA SCRATCH (4 allocs per request) ═══");
+    ESP_LOGI(TAG, "heap_caps malloc/free : %5lu ns/request", (unsigned long)((t1 - t0) * 1000ULL / ARENA_BENCH_ROUNDS));
+    ESP_LOGI(TAG, "task arena mark/release: %5lu ns/request", (unsigned long)((t2 - t1) * 1000ULL / ARENA_BENCH_ROUNDS));
+    ESP_LOGI(TAG, "shared arena (atomic) : %5lu ns/request", (unsigned long)((t3 - t2) * 1000ULL / ARENA_BENCH_ROUNDS));
+    ESP_LOGI(TAG, "grow past block + release: %5lu ns (grows=%lu)",
+             (unsigned long)((t4 - t3) * 1000ULL / (ARENA_BENCH_ROUNDS / 8)), (unsigned long)local->grows);
+    arena_destroy(&shared);
 }
+#endif
 
-static void dpool_dump(dynamic_pool_mgr_t *pm)
+#if RHEAP_BENCH_ENABLE
+// fragmentation torture: เติม region ด้วยก้อนเล็กขนาดสุ่ม → คืนครึ่งหนึ่งแบบสุ่ม (+ pin ค้างไว้ 2 ก้อน)
+// → largest free เหลือเล็กนิดเดียว → compaction แบบ incremental (budget ต่อขั้น) → largest กลับมา
+// → ขอก้อนใหญ่ครึ่งหนึ่งของ free ได้ → คืนทั้งหมดแล้วทำซ้ำ (หลายรอบโดยไม่ต้องรีบูต)
+static void rheap_bench(void)
 {
-    if (!pm || !pm->lock)
+    static rheap_handle_t hs[RHEAP_MAX_HANDLES];
+    rheap_t rh;
+    if (rheap_init(&rh, RHEAP_BENCH_BYTES, RHEAP_MAX_HANDLES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) != 0)
         return;
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(200)) == pdTRUE)
+
+    ESP_LOGI(TAG, "\n⏱️ ═══ HANDLE HEAP FRAGMENTATION TORTURE (%u B, step budget %u us) ═══",
+             (unsigned)RHEAP_BENCH_BYTES, (unsigned)RHEAP_STEP_BUDGET_US);
+    for (int ev = 0; ev < RHEAP_BENCH_EVENTS; ev++)
     {
-        ESP_LOGI(TAG, "🔎 DPOOL DUMP:");
-        for (int i = 0; i < DPOOL_NCLASS; i++)
+        int n = 0;
+        while (n < RHEAP_MAX_HANDLES)
         {
-            dpool_class_t *c = &pm->cls[i];
-            int pages = 0, free_blocks = 0, total_blocks = 0;
-            for (dpool_page_t *pg = c->pages; pg; pg = pg->next)
+            size_t sz = 32 + (esp_random() % 480);
+            rheap_handle_t h = rheap_alloc(&rh, sz);
+            if (h == RHEAP_INVALID)
+                break;
+            uint8_t *p = (uint8_t *)rheap_pin(&rh, h);
+            memset(p, (uint8_t)(h * 31u), sz);
+            rheap_unpin(&rh, h);
+            hs[n++] = h;
+        }
+        for (int i = 0; i < n; i++)
+            if (esp_random() & 1)
             {
-                pages++;
-                free_blocks += pg->free_count;
-                total_blocks += pg->blocks;
+                rheap_free(&rh, hs[i]);
+                hs[i] = RHEAP_INVALID;
             }
-            ESP_LOGI(TAG, "  class[%d]: size=%u pages=%d free=%d/%d",
-                     i, (unsigned)c->size, pages, free_blocks, total_blocks);
+        // pin ค้าง 2 ก้อน: compaction ต้องข้าม (ช่องว่างหน้ามันยังค้างได้)
+        rheap_handle_t pinned[2] = {RHEAP_INVALID, RHEAP_INVALID};
+        for (int i = 0, k = 0; i < n && k < 2; i += n / 3 + 1)
+            if (hs[i] && rheap_pin(&rh, hs[i]))
+                pinned[k++] = hs[i];
+
+        rheap_stats_t before, after;
+        rheap_get_stats(&rh, &before);
+        uint64_t t0 = esp_timer_get_time();
+        uint32_t steps = 0, moved = 0, max_step_us = 0;
+        int passes = 0;
+        while (passes < 2)
+        {
+            uint32_t m;
+            uint64_t s0 = esp_timer_get_time();
+            passes += rheap_compact(&rh, RHEAP_STEP_BUDGET_US, &m) ? 1 : 0;
+            uint32_t dt = (uint32_t)(esp_timer_get_time() - s0);
+            if (dt > max_step_us)
+                max_step_us = dt;
+            moved += m;
+            steps++;
+        }
+        uint64_t t1 = esp_timer_get_time();
+        rheap_get_stats(&rh, &after);
+
+        // ข้อมูลทุกก้อนต้องเหมือนเดิมหลังถูกย้าย
+        bool intact = rheap_check(&rh);
+        for (int i = 0; i < n && intact; i++)
+        {
+            if (!hs[i])
+                continue;
+            size_t sz = rheap_size(&rh, hs[i]);
+            const uint8_t *p = (const uint8_t *)rheap_pin(&rh, hs[i]);
+            for (size_t k = 0; k < sz; k++)
+                if (p[k] != (uint8_t)(hs[i] * 31u))
+                {
+                    intact = false;
+                    break;
+                }
+            rheap_unpin(&rh, hs[i]);
         }
-        xSemaphoreGive(pm->lock);
+        rheap_handle_t big = rheap_alloc(&rh, after.free_bytes / 2);
+
+        ESP_LOGI(TAG, "event %d: live=%lu largest %5u → %5u B  frag %4.1f%% → %4.1f%%  big alloc %s",
+                 ev, (unsigned long)after.live, (unsigned)before.largest_free, (unsigned)after.largest_free,
+                 before.fragmentation * 100.0f, after.fragmentation * 100.0f, big ? "ok" : "FAILED");
+        ESP_LOGI(TAG, "         moved %lu blocks in %lu steps, max step %lu us, total %llu us, data %s",
+                 (unsigned long)moved, (unsigned long)steps, (unsigned long)max_step_us,
+                 (unsigned long long)(t1 - t0), intact ? "intact" : "CORRUPTED");
+
+        for (int k = 0; k < 2; k++)
+            if (pinned[k])
+                rheap_unpin(&rh, pinned[k]);
+        if (big)
+            rheap_free(&rh, big);
+        for (int i = 0; i < n; i++)
+            if (hs[i])
+                rheap_free(&rh, hs[i]);
     }
+    rheap_stats_t st;
+    rheap_get_stats(&rh, &st);
+    ESP_LOGI(TAG, "total moved=%lu (%llu B) pinned skips=%lu sync compacts=%lu", (unsigned long)st.moves,
+             (unsigned long long)st.bytes_moved, (unsigned long)st.pinned_skips, (unsigned long)st.sync_compacts);
+    rheap_destroy(&rh);
 }
+#endif
 
-// ---- Bump Arena ----
-typedef struct bump_arena_t
-{
-    uint8_t *buf;
-    size_t cap;
-    size_t off;
-    uint32_t caps;
-    SemaphoreHandle_t lock;
-} bump_arena_t;
+#if SEG_BENCH_ENABLE
+static inline uint32_t seg_bench_mbps(uint64_t bytes, uint64_t us) { return (uint32_t)(bytes / (us ? us : 1)); }
 
-static int arena_init(bump_arena_t *ar, size_t capacity, uint32_t caps)
+// buffer ต่อเนื่อง vs segmented ขนาดเท่ากัน: เขียนเรียงทีละ 256 B, อ่านเรียง (checksum), อ่านสุ่ม 16 B
+// ผลเป็น MB/s (byte/us) — ส่วนต่างคือราคาของการแปลง offset → chunk และการตัดช่วงที่ขอบ chunk
+static void seg_bench(void)
 {
-    if (!ar || !capacity)
-        return -1;
-    memset(ar, 0, sizeof(*ar));
-    ar->caps = caps ? caps : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    ar->buf = (uint8_t *)tracked_malloc(capacity, ar->caps, "ARENA_BUF");
-    if (!ar->buf)
-        return -2;
-    ar->cap = capacity;
-    ar->lock = xSemaphoreCreateMutex();
-    return ar->lock ? 0 : -3;
+    dynamic_pool_mgr_t pm;
+    if (dpool_init(&pm, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) != 0)
+        return;
+    uint8_t *flat = (uint8_t *)heap_caps_malloc(SEG_BENCH_BYTES, MALLOC_CAP_8BIT);
+    seg_buf_t sb;
+    bool verbose = tracking_verbose;
+    tracking_verbose = false;
+    uint64_t a0 = esp_timer_get_time();
+    int rc = seg_alloc(&sb, &pm, SEG_BENCH_BYTES);
+    uint64_t a1 = esp_timer_get_time();
+    if (!flat || rc != 0)
+    {
+        ESP_LOGW(TAG, "seg bench: no memory for %u B", (unsigned)SEG_BENCH_BYTES);
+        heap_caps_free(flat);
+        tracking_verbose = verbose;
+        return;
+    }
+
+    ESP_LOGI(TAG, "\n⏱️ ═══ SEGMENTED vs CONTIGUOUS (%u B, %lu chunks x %u B) ═══", (unsigned)SEG_BENCH_BYTES,
+             (unsigned long)sb.nchunks, (unsigned)SEG_CHUNK);
+    uint8_t rec[256];
+    for (size_t i = 0; i < sizeof(rec); i++)
+        rec[i] = (uint8_t)i;
+    const uint64_t total = (uint64_t)SEG_BENCH_BYTES * SEG_BENCH_REPS;
+
+    // เขียนเรียง
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < SEG_BENCH_REPS; r++)
+        for (size_t off = 0; off < SEG_BENCH_BYTES; off += sizeof(rec))
+            memcpy(flat + off, rec, sizeof(rec));
+    uint64_t t1 = esp_timer_get_time();
+    for (int r = 0; r < SEG_BENCH_REPS; r++)
+        for (size_t off = 0; off < SEG_BENCH_BYTES; off += sizeof(rec))
+            seg_write(&sb, off, rec, sizeof(rec));
+    uint64_t t2 = esp_timer_get_time();
+    ESP_LOGI(TAG, "seq write 256B : flat %4lu MB/s  seg %4lu MB/s", (unsigned long)seg_bench_mbps(total, t1 - t0),
+             (unsigned long)seg_bench_mbps(total, t2 - t1));
+
+    // อ่านเรียง: loop ตรงบน flat vs iterator (ช่วงละ 1 chunk)
+    uint32_t sum_flat = 0, sum_seg = 0;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < SEG_BENCH_REPS; r++)
+        for (size_t i = 0; i < SEG_BENCH_BYTES; i++)
+            sum_flat += flat[i];
+    t1 = esp_timer_get_time();
+    for (int r = 0; r < SEG_BENCH_REPS; r++)
+    {
+        seg_iter_t it;
+        uint8_t *span;
+        size_t len;
+        seg_iter_init(&it, &sb, 0, SEG_BENCH_BYTES);
+        while ((len = seg_iter_next(&it, &span)) != 0)
+            for (size_t i = 0; i < len; i++)
+                sum_seg += span[i];
+    }
+    t2 = esp_timer_get_time();
+    ESP_LOGI(TAG, "seq read (sum) : flat %4lu MB/s  seg %4lu MB/s  %s", (unsigned long)seg_bench_mbps(total, t1 - t0),
+             (unsigned long)seg_bench_mbps(total, t2 - t1), sum_flat == sum_seg ? "match" : "MISMATCH");
+
+    // อ่านสุ่ม 16 B (LCG เดียวกันทั้งสองฝั่ง, บางครั้งคร่อมขอบ chunk)
+    uint8_t tmp[16];
+    uint32_t x = 12345, acc_flat = 0, acc_seg = 0;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < SEG_BENCH_REPS; r++)
+        for (int i = 0; i < SEG_BENCH_RANDOM; i++)
+        {
+            x = x * 1664525u + 1013904223u;
+            size_t off = (x >> 8) % (SEG_BENCH_BYTES - sizeof(tmp));
+            memcpy(tmp, flat + off, sizeof(tmp));
+            acc_flat += tmp[off & 15];
+        }
+    t1 = esp_timer_get_time();
+    x = 12345;
+    for (int r = 0; r < SEG_BENCH_REPS; r++)
+        for (int i = 0; i < SEG_BENCH_RANDOM; i++)
+        {
+            x = x * 1664525u + 1013904223u;
+            size_t off = (x >> 8) % (SEG_BENCH_BYTES - sizeof(tmp));
+            seg_read(&sb, off, tmp, sizeof(tmp));
+            acc_seg += tmp[off & 15];
+        }
+    t2 = esp_timer_get_time();
+    const uint64_t rnd = (uint64_t)SEG_BENCH_RANDOM * SEG_BENCH_REPS * sizeof(tmp);
+    ESP_LOGI(TAG, "random read 16B: flat %4lu MB/s  seg %4lu MB/s  %s", (unsigned long)seg_bench_mbps(rnd, t1 - t0),
+             (unsigned long)seg_bench_mbps(rnd, t2 - t1), acc_flat == acc_seg ? "match" : "MISMATCH");
+
+    // ค่าจองครั้งแรก (สร้าง page ใหม่) เทียบจองซ้ำ (page อยู่ใน empty cache แล้ว)
+    seg_free(&sb);
+    t0 = esp_timer_get_time();
+    rc = seg_alloc(&sb, &pm, SEG_BENCH_BYTES);
+    t1 = esp_timer_get_time();
+    ESP_LOGI(TAG, "seg_alloc      : first %llu us  again %llu us", (unsigned long long)(a1 - a0),
+             (unsigned long long)(t1 - t0));
+    if (rc == 0)
+        seg_free(&sb);
+    dpool_shrink(&pm);
+    tracking_verbose = verbose;
+    heap_caps_free(flat);
 }
+#endif
 
-static void *arena_alloc(bump_arena_t *ar, size_t size, size_t align, const char *desc)
+#if CODEC_BENCH_ENABLE
+// payload ตัวแทนของสิ่งที่จะเก็บแบบ cold: ประวัติ event (record ไบนารี), log ข้อความ, snapshot ที่ว่างเป็นส่วนใหญ่, ข้อมูลสุ่ม
+typedef struct
 {
-    if (!ar || !ar->lock || !size)
-        return NULL;
-    void *p = NULL;
-    if (xSemaphoreTake(ar->lock, pdMS_TO_TICKS(50)) == pdTRUE)
+    uint32_t ts_ms;
+    uint16_t id;
+    uint8_t level;
+    uint8_t flags;
+    int32_t value;
+} codec_bench_event_t;
+
+static size_t codec_bench_payload(int kind, uint8_t *p, size_t n)
+{
+    uint32_t x = 0x1234567u + (uint32_t)kind;
+    if (kind == 0)
     {
-        size_t a = (align == 0) ? 8 : align;
-        size_t off_aligned = ALIGN_UP(ar->off, a);
-        if (off_aligned + size <= ar->cap)
+        codec_bench_event_t ev = {.ts_ms = 1000, .id = 1, .level = 2, .flags = 0, .value = 100};
+        size_t len = 0;
+        for (; len + sizeof(ev) <= n; len += sizeof(ev))
         {
-            p = ar->buf + off_aligned;
-            ar->off = off_aligned + size;
-            register_allocation_manual(p, size, ar->caps, desc ? desc : "ARENA");
+            x = x * 1664525u + 1013904223u;
+            ev.ts_ms += 10 + (x >> 28);
+            ev.id = (uint16_t)(1 + ((x >> 8) & 7));
+            ev.value += (int32_t)((x >> 16) & 7) - 3;
+            memcpy(p + len, &ev, sizeof(ev));
         }
-        xSemaphoreGive(ar->lock);
+        return len;
     }
-    return p;
+    if (kind == 1)
+    {
+        size_t len = 0;
+        for (uint32_t seq = 0; len + 96 < n; seq++)
+        {
+            x = x * 1664525u + 1013904223u;
+            len += (size_t)snprintf((char *)p + len, n - len, "I (%lu) HEAP_MGMT: seq=%lu free=%u largest=%u frag=%u.%u%%\n",
+                                    (unsigned long)(seq * 1000u), (unsigned long)seq, 180000u - (x >> 20),
+                                    110000u - (x >> 21), (unsigned)((x >> 8) % 40), (unsigned)((x >> 4) % 10));
+        }
+        return len;
+    }
+    if (kind == 2)
+    {
+        memset(p, 0, n);
+        for (size_t off = 0; off + 64 <= n; off += 512) // record 64 byte ทุก 512 byte
+            for (size_t k = 0; k < 64; k++)
+            {
+                x = x * 1664525u + 1013904223u;
+                p[off + k] = (k < 16) ? (uint8_t)k : (uint8_t)(x >> 24);
+            }
+        return n;
+    }
+    for (size_t k = 0; k < n; k++)
+    {
+        x = x * 1664525u + 1013904223u;
+        p[k] = (uint8_t)(x >> 24);
+    }
+    return n;
 }
 
-static void arena_reset(bump_arena_t *ar)
+// ratio = ขนาดหลังบีบ/เดิม, MB/s = byte ดิบต่อ us (ทั้งขาบีบและขาคลาย)
+static void codec_bench(void)
 {
-    if (!ar || !ar->lock)
-        return;
-    if (xSemaphoreTake(ar->lock, pdMS_TO_TICKS(50)) == pdTRUE)
+    static const char *const kinds[] = {"events", "log text", "snapshot", "random"};
+    static const mcodec_id_t codecs[] = {MCODEC_RLE, MCODEC_LZ};
+    uint8_t *src = (uint8_t *)heap_caps_malloc(CODEC_BENCH_BYTES, MALLOC_CAP_8BIT);
+    uint8_t *enc = (uint8_t *)heap_caps_malloc(MCODEC_BOUND(CODEC_BENCH_BYTES), MALLOC_CAP_8BIT);
+    uint8_t *dec = (uint8_t *)heap_caps_malloc(CODEC_BENCH_BYTES, MALLOC_CAP_8BIT);
+    void *work = heap_caps_malloc(MCODEC_WORK_BYTES, MALLOC_CAP_8BIT);
+    if (!src || !enc || !dec || !work)
     {
-        // บันทึกสถิติแบบง่าย: “free” ก้อนใหญ่
-        ar->off = 0;
-        xSemaphoreGive(ar->lock);
+        ESP_LOGW(TAG, "codec bench: no memory");
+        goto out;
     }
-}
 
-static void arena_destroy(bump_arena_t *ar)
-{
-    if (!ar)
-        return;
-    if (ar->buf)
+    ESP_LOGI(TAG, "\n⏱️ ═══ CODEC RATIO / THROUGHPUT (%u B payloads, x%d) ═══", (unsigned)CODEC_BENCH_BYTES,
+             CODEC_BENCH_REPS);
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
     {
-        secure_wipe(ar->buf, ar->cap);
-        tracked_free(ar->buf, "ARENA_BUF");
+        size_t n = codec_bench_payload((int)k, src, CODEC_BENCH_BYTES);
+        for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++)
+        {
+            size_t clen = 0, dlen = 0;
+            uint64_t t0 = esp_timer_get_time();
+            for (int r = 0; r < CODEC_BENCH_REPS; r++)
+                clen = mcodec_compress(codecs[c], src, n, enc, MCODEC_BOUND(CODEC_BENCH_BYTES), work);
+            uint64_t t1 = esp_timer_get_time();
+            for (int r = 0; r < CODEC_BENCH_REPS; r++)
+                dlen = mcodec_decompress(codecs[c], enc, clen, dec, n);
+            uint64_t t2 = esp_timer_get_time();
+            bool ok = clen && dlen == n && memcmp(src, dec, n) == 0;
+            uint64_t total = (uint64_t)n * CODEC_BENCH_REPS;
+            ESP_LOGI(TAG, "%-8s %-3s: %5u → %5u B (%5.1f%%)  enc %4lu MB/s  dec %4lu MB/s  %s", kinds[k],
+                     mcodec_name(codecs[c]), (unsigned)n, (unsigned)clen, 100.0f * (float)clen / (float)n,
+                     (unsigned long)(total / (t1 - t0 ? t1 - t0 : 1)), (unsigned long)(total / (t2 - t1 ? t2 - t1 : 1)),
+                     ok ? "ok" : "MISMATCH");
+            vTaskDelay(1);
+        }
     }
-    if (ar->lock)
-        vSemaphoreDelete(ar->lock);
-    memset(ar, 0, sizeof(*ar));
+out:
+    heap_caps_free(src);
+    heap_caps_free(enc);
+    heap_caps_free(dec);
+    heap_caps_free(work);
 }
+#endif
 
-/* =========================
- *            TASKS
- * ========================= */
-static void memory_stress_test_task(void *pvParameters)
+#if SECURE_BENCH_ENABLE
+// secure_store+load (ctx ใหม่ทุกครั้ง, จอง cipher ใหม่, ถอดทั้งก้อน) vs stream (key cache, chunk, ถอดเฉพาะช่วง)
+// latency = us ต่อครั้ง, MB/s = byte ที่เข้า/ถอดต่อ us
+static void secure_bench(void)
 {
-    ESP_LOGI(TAG, "🧪 Memory stress test started");
-    void *test_ptrs[20] = {0};
-    int count = 0;
+    static const size_t sizes[] = {64, 1024, SECURE_BENCH_MAX};
+    uint8_t *plain = (uint8_t *)heap_caps_malloc(SECURE_BENCH_MAX, MALLOC_CAP_8BIT);
+    uint8_t *dst = (uint8_t *)heap_caps_malloc(SECURE_BENCH_MAX, MALLOC_CAP_8BIT);
+    uint8_t key[16];
+    bool verbose = tracking_verbose;
+    tracking_verbose = false;
+    if (!plain || !dst)
+    {
+        ESP_LOGW(TAG, "secure bench: no memory");
+        goto out;
+    }
+    fill_random(plain, SECURE_BENCH_MAX);
+    fill_random(key, sizeof(key));
 
-    while (1)
+    ESP_LOGI(TAG, "\n⏱️ ═══ SECURE BLOB: store/load vs stream (x%d) ═══", SECURE_BENCH_REPS);
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++)
     {
-        int action = (int)(esp_random() % 3);
-        if (action == 0 && count < 20)
+        size_t n = sizes[z];
+        uint64_t st_us = 0, ld_us = 0;
+        bool ok = true;
+        for (int r = 0; r < SECURE_BENCH_REPS; r++)
         {
-            size_t size = 100 + (esp_random() % 2000);
-            uint32_t caps = (esp_random() % 2) ? MALLOC_CAP_INTERNAL : MALLOC_CAP_DEFAULT;
-            test_ptrs[count] = tracked_malloc(size, caps, "StressTest");
-            if (test_ptrs[count])
+            secure_blob_t sb;
+            uint64_t t0 = esp_timer_get_time();
+            int rc = secure_store(&sb, plain, n, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, "BenchBlob");
+            uint64_t t1 = esp_timer_get_time();
+            if (rc != 0)
             {
-                memset(test_ptrs[count], 0xAA, size);
-                count++;
+                ok = false;
+                break;
             }
+            ok &= secure_load(&sb, dst, n) == (int)n;
+            uint64_t t2 = esp_timer_get_time();
+            ok &= memcmp(plain, dst, n) == 0;
+            secure_free(&sb);
+            st_us += t1 - t0;
+            ld_us += t2 - t1;
         }
-        else if (action == 1 && count > 0)
+
+        sec_stream_t ss;
+        uint64_t open_us = esp_timer_get_time();
+        if (sec_open(&ss, key, n, "BenchStream") != 0)
         {
-            int idx = (int)(esp_random() % count);
-            if (test_ptrs[idx])
-            {
-                tracked_free(test_ptrs[idx], "StressTest");
-                for (int i = idx; i < count - 1; i++)
-                    test_ptrs[i] = test_ptrs[i + 1];
-                count--;
-            }
+            ESP_LOGW(TAG, "secure bench: sec_open %u failed", (unsigned)n);
+            break;
         }
-        else
+        open_us = esp_timer_get_time() - open_us;
+        uint64_t t0 = esp_timer_get_time();
+        for (int r = 0; r < SECURE_BENCH_REPS; r++)
+            ok &= sec_write(&ss, 0, plain, n) == (int)n;
+        uint64_t t1 = esp_timer_get_time();
+        for (int r = 0; r < SECURE_BENCH_REPS; r++)
+            ok &= sec_read(&ss, 0, dst, n) == (int)n;
+        uint64_t t2 = esp_timer_get_time();
+        ok &= memcmp(plain, dst, n) == 0;
+
+        uint64_t bytes = (uint64_t)n * SECURE_BENCH_REPS;
+        ESP_LOGI(TAG, "%5u B old: store %5lu us load %5lu us (%3lu/%3lu MB/s) | stream: write %5lu us read %5lu us (%3lu/%3lu MB/s) open %lu us %s",
+                 (unsigned)n, (unsigned long)(st_us / SECURE_BENCH_REPS), (unsigned long)(ld_us / SECURE_BENCH_REPS),
+                 (unsigned long)(bytes / (st_us ? st_us : 1)), (unsigned long)(bytes / (ld_us ? ld_us : 1)),
+                 (unsigned long)((t1 - t0) / SECURE_BENCH_REPS), (unsigned long)((t2 - t1) / SECURE_BENCH_REPS),
+                 (unsigned long)(bytes / (t1 - t0 ? t1 - t0 : 1)), (unsigned long)(bytes / (t2 - t1 ? t2 - t1 : 1)),
+                 (unsigned long)open_us, ok ? "ok" : "MISMATCH");
+
+        if (n == SECURE_BENCH_MAX)
         {
-            analyze_memory_status();
+            // อ่าน field 32 byte ที่ offset สุ่ม: แบบเดิมต้องถอดทั้งก้อนก่อนเสมอ
+            secure_blob_t sb;
+            uint64_t old_us = 0, new_us = 0;
+            bool pok = secure_store(&sb, plain, n, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, "BenchBlob") == 0;
+            for (int r = 0; pok && r < SECURE_BENCH_REPS; r++)
+            {
+                size_t off = esp_random() % (n - 32);
+                uint64_t a = esp_timer_get_time();
+                pok &= secure_load(&sb, dst, n) == (int)n;
+                uint64_t b = esp_timer_get_time();
+                pok &= sec_read(&ss, off, dst + n - 32, 32) == 32;
+                uint64_t c = esp_timer_get_time();
+                pok &= memcmp(dst + n - 32, plain + off, 32) == 0;
+                old_us += b - a;
+                new_us += c - b;
+            }
+            if (sb.in_use)
+                secure_free(&sb);
+            ESP_LOGI(TAG, "32 B field of %u B: secure_load %lu us  sec_read %lu us  %s", (unsigned)n,
+                     (unsigned long)(old_us / SECURE_BENCH_REPS), (unsigned long)(new_us / SECURE_BENCH_REPS),
+                     pok ? "ok" : "MISMATCH");
         }
-        vTaskDelay(pdMS_TO_TICKS(1000 + (esp_random() % 2000)));
+        sec_close(&ss);
+        vTaskDelay(1);
     }
+out:
+    secure_wipe(key, sizeof(key));
+    tracking_verbose = verbose;
+    heap_caps_free(plain);
+    heap_caps_free(dst);
 }
+#endif
 
-static void memory_pool_test_task(void *pvParameters)
+#if LT_BENCH_ENABLE
+// ก้อนสั้น (ring) สลับกับก้อนยาว (ค้าง) ใน heap เดียว → วัด internal free/largest ตอนจบ (ก้อนยาวยังอยู่)
+// รอบแรกปิด policy (ระหว่างนั้นเรียนรู้ไปด้วย), รอบสองเปิด → ก้อนสั้นไป dpool, ก้อนยาวไป region แยก
+// policy ของ bench เอง (ตาราง + เกณฑ์ย่อ: สั้น < 20 ms, ยาว ≥ 150 ms) ให้จบในไม่กี่วินาที — g_lt ของ task อื่นไม่ถูกแตะ
+static void lt_bench_run(lt_policy_t *pol)
 {
-    ESP_LOGI(TAG, "🏊 Memory pool mini test started");
-    const size_t sizes[] = {64, 128, 256, 512, 1024};
-    void *p[5][6] = {{0}};
-    while (1)
+    static void *ring[LT_BENCH_RING];
+    static void *keep[LT_BENCH_LONG];
+    memset(ring, 0, sizeof(ring));
+    memset(keep, 0, sizeof(keep));
+    memset(pol->routed, 0, sizeof(pol->routed));
+    size_t f0 = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t l0 = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+
+    int nk = 0;
+    uint64_t t0 = esp_timer_get_time();
+    for (int step = 0; step < LT_BENCH_STEPS; step++)
     {
-        for (int s = 0; s < 5; s++)
-            for (int i = 0; i < 6; i++)
-            {
-                char d[24];
-                snprintf(d, sizeof(d), "Pool%u_%u", s, i);
-                p[s][i] = tracked_malloc(sizes[s], MALLOC_CAP_INTERNAL, d);
-                if (p[s][i])
-                    memset(p[s][i], 0x55 + s, sizes[s]);
-            }
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        for (int s = 4; s >= 0; s--)
-            for (int i = 5; i >= 0; i--)
-            {
-                if (p[s][i])
-                {
-                    tracked_free(p[s][i], "Pool");
-                    p[s][i] = NULL;
-                }
-            }
-        vTaskDelay(pdMS_TO_TICKS(4000));
+        for (int k = 0; k < 4; k++)
+        {
+            int slot = (int)(esp_random() % LT_BENCH_RING);
+            lt_free_with(pol, ring[slot], "LtBenchShort");
+            ring[slot] = lt_malloc_with(pol, 32 + (esp_random() % 992), MALLOC_CAP_INTERNAL, "LtBenchShort");
+        }
+        if ((step & 7) == 0 && nk < LT_BENCH_LONG)
+            keep[nk++] = lt_malloc_with(pol, 64 + (esp_random() % 448), MALLOC_CAP_INTERNAL, "LtBenchLong");
+        if (step % 50 == 49)
+            vTaskDelay(pdMS_TO_TICKS(10)); // ให้เวลาเดิน ≥ 400 ms ต่อรอบ (อายุวัดเป็น ms)
     }
+    uint64_t t1 = esp_timer_get_time();
+    for (int i = 0; i < LT_BENCH_RING; i++)
+        lt_free_with(pol, ring[i], "LtBenchShort");
+    dpool_shrink(&g_lt_pool); // page ของก้อนสั้นว่างหมดแล้ว → คืนให้ heap ก่อนวัด
+
+    size_t f1 = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t l1 = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    ESP_LOGI(TAG, "policy %-3s: internal largest %6u → %6u B  frag %4.1f%% → %4.1f%%  (%llu us, pool/long/heap=%lu/%lu/%lu)",
+             pol->enabled ? "on" : "off", (unsigned)l0, (unsigned)l1, f0 ? 100.0f * (1.0f - (float)l0 / (float)f0) : 0.0f,
+             f1 ? 100.0f * (1.0f - (float)l1 / (float)f1) : 0.0f, (unsigned long long)(t1 - t0),
+             (unsigned long)pol->routed[LT_ROUTE_POOL], (unsigned long)pol->routed[LT_ROUTE_LONG],
+             (unsigned long)pol->routed[LT_ROUTE_HEAP]);
+    for (int i = 0; i < nk; i++)
+        lt_free_with(pol, keep[i], "LtBenchLong");
 }
 
-static void large_allocation_test_task(void *pvParameters)
+static void lt_bench(void)
 {
-    ESP_LOGI(TAG, "🐘 Large allocation test started");
-    while (1)
+    if (!g_lt_long)
+        return;
+    ESP_LOGI(TAG, "\n⏱️ ═══ LIFETIME-SEGREGATED ALLOCATION (%u steps, %u long-lived) ═══", (unsigned)LT_BENCH_STEPS,
+             (unsigned)LT_BENCH_LONG);
+    static lt_policy_t pol;
+    memset(&pol, 0, sizeof(pol));
+    pol.short_ms = 20;
+    pol.long_ms = 150;
+    bool verbose = tracking_verbose;
+    tracking_verbose = false;
+    lt_bench_run(&pol); // เรียนรู้อย่างเดียว
+    pol.enabled = true;
+    lt_bench_run(&pol);
+    tracking_verbose = verbose;
+}
+#endif
+
+#if IC_BENCH_ENABLE
+// latency ของ heap_caps_check_integrity_all (ครั้งเดียวทั้ง heap) เทียบกับ step ยาวสุดของ incremental checker
+// และ coverage period ถ้าเรียกติดกันไม่พัก (บนเครื่องจริงคูณด้วยจำนวนครั้ง × IC_PERIOD_MS)
+static void ic_bench(void)
+{
+    ESP_LOGI(TAG, "\n⏱️ ═══ INTEGRITY CHECK: FULL SCAN vs INCREMENTAL (%u us budget) ═══", (unsigned)IC_BUDGET_US);
+    uint64_t t0 = esp_timer_get_time();
+    bool ok = heap_caps_check_integrity_all(false);
+    uint64_t full_us = esp_timer_get_time() - t0;
+
+    ic_state_t ic = {0};
+    while (!ic_step(&ic, IC_BUDGET_US) && ic.calls < 100000)
+        ;
+    ESP_LOGI(TAG, "full scan : %llu us in one stall (%s)", (unsigned long long)full_us, ok ? "OK" : "FAIL");
+    ESP_LOGI(TAG, "increment : %lu steps, max %lu us/step, %lu units, back-to-back cycle %lu ms (%s)",
+             (unsigned long)ic.calls, (unsigned long)ic.max_call_us, (unsigned long)ic.last_units,
+             (unsigned long)ic.last_period_ms, ic.errors ? "FAIL" : "OK");
+    ESP_LOGI(TAG, "coverage period at %u ms/step ≈ %lu ms", (unsigned)IC_PERIOD_MS,
+             (unsigned long)(ic.calls * IC_PERIOD_MS + ic.last_period_ms));
+}
+#endif
+
+#if MP_BENCH_ENABLE
+// spike จำลอง: เติม cache (page ว่างของ seg pool) แล้วใช้ ballast กิน internal RAM จนระดับขึ้น
+// รอบ poll: mp_poll หนึ่งครั้ง → reclaim ตาม priority → วัดเวลาจนระดับกลับ OK (recovery)
+// รอบ sync: กินจน block ใหญ่สุด < MP_BENCH_SYNC_BYTES → tracked_malloc ล้มครั้งแรก → reclaim แล้วได้ในครั้งที่สอง
+// ระหว่างนั้น task อื่นที่จองก็ถูก reclaim ช่วยด้วย (ผลจึงแกว่งตาม load)
+static int mp_bench_ballast(void **b, bool until_largest)
+{
+    int n = 0;
+    while (n < MP_BENCH_BALLAST &&
+           (until_largest ? heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) >= MP_BENCH_SYNC_BYTES
+                          : mp_current_level() == MP_NONE))
     {
-        size_t n = 50000 + (esp_random() % 100000);
-        void *buf = tracked_malloc(n, MALLOC_CAP_INTERNAL, "LargeInternal");
-        if (!buf)
-            buf = tracked_malloc(n, MALLOC_CAP_SPIRAM, "LargeSPIRAM");
-        if (buf)
-        {
-            // Fill then compress/decompress
-            for (size_t i = 0; i < n;)
-            {
-                size_t run = 1 + (esp_random() % 256);
-                uint8_t v = (uint8_t)(esp_random() & 0xFF);
-                if (i + run > n)
-                    run = n - i;
-                memset((uint8_t *)buf + i, v, run);
-                i += run;
-                size_t mix = (esp_random() % 64);
-                if (i + mix > n)
-                    mix = n - i;
-                for (size_t j = 0; j < mix; j++)
-                    ((uint8_t *)buf)[i + j] = (uint8_t)(esp_random() & 0xFF);
-                i += mix;
-            }
-            void *c = tracked_malloc(n + 64, MALLOC_CAP_INTERNAL, "RLE_C");
-            void *d = tracked_malloc(n, MALLOC_CAP_INTERNAL, "RLE_D");
-            if (c && d)
-            {
-                uint64_t cs = esp_timer_get_time();
-                size_t clen = rle_compress(buf, n, c, n + 64);
-                uint64_t ce = esp_timer_get_time();
-                uint64_t ds = esp_timer_get_time();
-                size_t dlen = rle_decompress(c, clen, d, n);
-                uint64_t de = esp_timer_get_time();
-                bool ok = (dlen == n) && (memcmp(buf, d, n) == 0);
-                ESP_LOGI(TAG, "🔁 RLE: orig=%u comp=%u (%.2f%%) enc_us=%llu dec_us=%llu ok=%d",
-                         (unsigned)n, (unsigned)clen, clen ? 100.f * (float)clen / (float)n : 0.f,
-                         (unsigned long long)(ce - cs), (unsigned long long)(de - ds), ok);
-            }
-            if (c)
-                tracked_free(c, "RLE_C");
-            if (d)
-                tracked_free(d, "RLE_D");
-            tracked_free(buf, "Large");
-        }
-        else
-        {
-            ESP_LOGW(TAG, "Large alloc failed");
-            analyze_memory_status();
-        }
-        vTaskDelay(pdMS_TO_TICKS(12000));
+        b[n] = heap_caps_malloc(1024, MALLOC_CAP_INTERNAL);
+        if (!b[n])
+            break;
+        n++;
     }
+    return n;
 }
 
-static void memory_monitor_task(void *pvParameters)
+static void mp_bench(void)
 {
-    ESP_LOGI(TAG, "📊 Memory monitor started");
-    while (1)
+    static void *ballast[MP_BENCH_BALLAST];
+    if (!s_mp_lock)
+        return;
+    ESP_LOGI(TAG, "\n⏱️ ═══ MEMORY PRESSURE: SPIKE → RECLAIM → RECOVERY ═══");
+    bool verbose = tracking_verbose;
+    tracking_verbose = false;
+    seg_buf_t sb;
+
+    if (seg_alloc(&sb, &g_seg_pool, MP_BENCH_CACHE) == 0)
+        seg_free(&sb);
+    int n = mp_bench_ballast(ballast, false);
+    mp_level_t spike = mp_current_level();
+    uint32_t rec0 = s_mp_stats.spikes;
+    uint64_t t0 = esp_timer_get_time();
+    mp_level_t after = mp_poll();
+    uint64_t t1 = esp_timer_get_time();
+    ESP_LOGI(TAG, "poll : ballast %d KB → %s, reclaim %llu us → %s%s", n, mp_level_name(spike),
+             (unsigned long long)(t1 - t0), mp_level_name(after),
+             after == MP_NONE && s_mp_stats.spikes != rec0 ? " (recovered)" : "");
+    for (int i = 0; i < n; i++)
+        heap_caps_free(ballast[i]);
+    mp_poll();
+    ESP_LOGI(TAG, "       recovery last %lu ms (max %lu ms)", (unsigned long)s_mp_stats.last_recovery_ms,
+             (unsigned long)s_mp_stats.max_recovery_ms);
+
+    if (seg_alloc(&sb, &g_seg_pool, MP_BENCH_CACHE) == 0)
+        seg_free(&sb);
+    n = mp_bench_ballast(ballast, true);
+    uint32_t rescued0 = __atomic_load_n(&s_mp_stats.sync_rescued, __ATOMIC_RELAXED);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    t0 = esp_timer_get_time();
+    void *p = tracked_malloc(MP_BENCH_SYNC_BYTES, MALLOC_CAP_INTERNAL, "MP_BENCH");
+    t1 = esp_timer_get_time();
+    ESP_LOGI(TAG, "sync : ballast %d KB, largest %u B, alloc %u B %s in %llu us", n, (unsigned)largest,
+             (unsigned)MP_BENCH_SYNC_BYTES,
+             !p ? "FAILED" : s_mp_stats.sync_rescued != rescued0 ? "rescued by reclaim" : "ok", (unsigned long long)(t1 - t0));
+    tracked_free(p, "MP_BENCH");
+    for (int i = 0; i < n; i++)
+        heap_caps_free(ballast[i]);
+    mp_poll();
+
+    for (int i = 0; i < s_mp_count; i++)
+        ESP_LOGI(TAG, "  %-14s prio %u (%s+) calls=%lu freed=%llu B", s_mp[i].name, (unsigned)s_mp[i].prio,
+                 mp_level_name((mp_level_t)s_mp[i].min_level), (unsigned long)s_mp[i].calls,
+                 (unsigned long long)s_mp[i].freed);
+    tracking_verbose = verbose;
+}
+#endif
+
+#if TRACK_BENCH_ENABLE
+// tracked_malloc แบบไม่ลง tracker (noinline ด้วยเหตุผลเดียวกับ tracked_malloc)
+static __attribute__((noinline)) void *bench_sampled_malloc(size_t size, uint32_t caps)
+{
+    return tracked_malloc_impl(size, caps, "BENCH", false, __builtin_return_address(0));
+}
+
+// เวลาต่อคู่ malloc+free (ns) ของ heap_caps_malloc ตรง ๆ เทียบกับ tracked_malloc ที่ live entry ระดับต่าง ๆ
+static void tracker_bench(void)
+{
+    static const uint32_t levels[] = {0, 100, 1000, 10000};
+    alloc_track_stats_t ts;
+    alloc_track_get_stats(&ts);
+
+    ESP_LOGI(TAG, "\n⏱️ ═══ TRACKER OVERHEAD (per malloc+free pair) ═══");
+    bool verbose = tracking_verbose;
+    tracking_verbose = false;
+    uint32_t filled = 0;
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++)
     {
-        vTaskDelay(pdMS_TO_TICKS(10000));
-        analyze_memory_status();
-        print_allocation_summary();
-        detect_memory_leaks();
-        if (!heap_caps_check_integrity_all(true))
-        {
-            ESP_LOGE(TAG, "🚨 HEAP CORRUPTION DETECTED");
-            gpio_set_level(LED_MEMORY_ERROR, 1);
-        }
-        ESP_LOGI(TAG, "Free heap: %u", (unsigned)esp_get_free_heap_size());
-        ESP_LOGI(TAG, "Uptime: %llu ms\n", (unsigned long long)(esp_timer_get_time() / 1000ULL));
+        // เหลือที่ว่างไว้ให้ task อื่น + รอบวัด
+        if (levels[l] + 256 > ts.capacity)
+            break;
+        // MANUAL: integrity checker ห้ามถาม heap_caps ถึง pointer ปลอม (ไม่งั้นนับเป็น corruption)
+        while (filled < levels[l] && alloc_track_insert(bench_fake_ptr(filled), 1, TRACK_CAP_MANUAL, "BENCH_FILL"))
+            filled++;
+
+        uint64_t t0 = esp_timer_get_time();
+        for (int r = 0; r < TRACK_BENCH_ROUNDS; r++)
+            heap_caps_free(heap_caps_malloc(TRACK_BENCH_SIZE, MALLOC_CAP_8BIT));
+        uint64_t t1 = esp_timer_get_time();
+        for (int r = 0; r < TRACK_BENCH_ROUNDS; r++)
+            tracked_free(tracked_malloc(TRACK_BENCH_SIZE, MALLOC_CAP_8BIT, "BENCH"), "BENCH");
+        uint64_t t2 = esp_timer_get_time();
+
+        uint32_t base_ns = (uint32_t)((t1 - t0) * 1000ULL / TRACK_BENCH_ROUNDS);
+        uint32_t tracked_ns = (uint32_t)((t2 - t1) * 1000ULL / TRACK_BENCH_ROUNDS);
+        alloc_track_get_stats(&ts);
+        ESP_LOGI(TAG, "live=%5lu  heap_caps=%5lu ns  tracked=%5lu ns  overhead=%5ld ns  max probe=%lu",
+                 (unsigned long)filled, (unsigned long)base_ns, (unsigned long)tracked_ns,
+                 (long)tracked_ns - (long)base_ns, (unsigned long)ts.max_probe);
+        vTaskDelay(1);
+    }
+    for (uint32_t i = 0; i < filled; i++)
+        alloc_track_remove(bench_fake_ptr(i), NULL);
+
+    // sampler อย่างเดียว (ข้าม tracker เฉพาะรอบวัดนี้ ไม่ปิด monitoring ของ task อื่น):
+    // ต้นทุนเฉลี่ยต่อคู่ควรต่ำกว่า 1% ของ heap_caps
+    uint64_t best_base = UINT64_MAX, best_sampled = UINT64_MAX;
+    for (int rep = 0; rep < 5; rep++)
+    {
+        uint64_t t0 = esp_timer_get_time();
+        for (int r = 0; r < TRACK_BENCH_ROUNDS; r++)
+            heap_caps_free(heap_caps_malloc(TRACK_BENCH_SIZE, MALLOC_CAP_8BIT));
+        uint64_t t1 = esp_timer_get_time();
+        for (int r = 0; r < TRACK_BENCH_ROUNDS; r++)
+            tracked_free_impl(bench_sampled_malloc(TRACK_BENCH_SIZE, MALLOC_CAP_8BIT), "BENCH", false);
+        uint64_t t2 = esp_timer_get_time();
+        if (t1 - t0 < best_base)
+            best_base = t1 - t0;
+        if (t2 - t1 < best_sampled)
+            best_sampled = t2 - t1;
+        vTaskDelay(1);
     }
+    heap_sample_stats_t hs;
+    heap_sample_get_stats(&hs);
+    int64_t bp = ((int64_t)best_sampled - (int64_t)best_base) * 10000 / (int64_t)(best_base ? best_base : 1); // 1/100 %
+    ESP_LOGI(TAG, "sampled only: heap_caps=%5lu ns  sampled=%5lu ns  overhead=%s%ld.%02ld%%  (1 sample / %lu B)",
+             (unsigned long)(best_base * 1000ULL / TRACK_BENCH_ROUNDS),
+             (unsigned long)(best_sampled * 1000ULL / TRACK_BENCH_ROUNDS), bp < 0 ? "-" : "",
+             (long)((bp < 0 ? -bp : bp) / 100), (long)((bp < 0 ? -bp : bp) % 100), (unsigned long)hs.mean_bytes);
+    tracking_verbose = verbose;
+}
+#endif
+
+#if BENCH_TASK_ENABLE
+static void bench_task(void *pvParameters)
+{
+#if TRACK_BENCH_ENABLE
+    tracker_bench();
+#endif
+#if DPOOL_BENCH_ENABLE
+    dpool_bench();
+#endif
+#if ARENA_BENCH_ENABLE
+    arena_bench();
+#endif
+#if RHEAP_BENCH_ENABLE
+    rheap_bench();
+#endif
+#if SEG_BENCH_ENABLE
+    seg_bench();
+#endif
+#if CODEC_BENCH_ENABLE
+    codec_bench();
+#endif
+#if SECURE_BENCH_ENABLE
+    secure_bench();
+#endif
+#if LT_BENCH_ENABLE
+    lt_bench();
+#endif
+#if IC_BENCH_ENABLE
+    ic_bench();
+#endif
+#if MP_BENCH_ENABLE
+    mp_bench();
+#endif
+    vTaskDelete(NULL);
 }
+#endif
 
 static void heap_integrity_test_task(void *pvParameters)
 {
-    ESP_LOGI(TAG, "🔍 Heap integrity/perf started");
+    ESP_LOGI(TAG, "🔍 Heap integrity (incremental %u us every %u ms)/perf started", (unsigned)IC_BUDGET_US,
+             (unsigned)IC_PERIOD_MS);
+    static ic_state_t ic;
+    TickType_t last = xTaskGetTickCount();
     while (1)
     {
-        vTaskDelay(pdMS_TO_TICKS(30000));
-        bool ok = heap_caps_check_integrity_all(false);
-        ESP_LOGI(TAG, "Heap integrity: %s", ok ? "OK" : "FAIL");
+        vTaskDelay(pdMS_TO_TICKS(IC_PERIOD_MS));
+        ic_step(&ic, IC_BUDGET_US);
+        if (xTaskGetTickCount() - last < pdMS_TO_TICKS(30000))
+            continue;
+        last = xTaskGetTickCount();
+        ESP_LOGI(TAG, "Heap integrity: %s (errors=%lu) coverage period %lu ms (max %lu) over %lu units, max step %lu us",
+                 ic.errors ? "FAIL" : "OK", (unsigned long)ic.errors, (unsigned long)ic.last_period_ms,
+                 (unsigned long)ic.max_period_ms, (unsigned long)ic.last_units, (unsigned long)ic.max_call_us);
         const size_t N = 4096;
         void *b = tracked_malloc(N, MALLOC_CAP_INTERNAL, "Perf");
         if (b)
@@ -1124,6 +3999,51 @@ static void sensitive_data_demo_task(void *pvParameters)
     secure_wipe(tmp, slen);
     tracked_free(tmp, "Tmp");
     secure_free(&sb);
+
+    // stream: ciphertext ใน chunk, ถอดเฉพาะช่วงของ Token (ส่วนอื่นไม่ถูกถอดเลย)
+    uint8_t key[16];
+    fill_random(key, sizeof(key));
+    sec_stream_t ss;
+    if (sec_open(&ss, key, slen, "SecureStream") == 0)
+    {
+        const char *tok = strstr(secret, "Token=");
+        size_t toff = (size_t)(tok - secret), tlen = strcspn(tok, ";");
+        char field[48];
+        if (sec_write(&ss, 0, secret, slen) == (int)slen && tlen < sizeof(field) &&
+            sec_read(&ss, toff, field, tlen) == (int)tlen)
+        {
+            field[tlen] = '\0';
+            ESP_LOGI(TAG, "🔓 Partial decrypt [%u..%u): %s", (unsigned)toff, (unsigned)(toff + tlen), field);
+            secure_wipe(field, tlen);
+
+            // ปิดค่า Token ในที่: ถอดเฉพาะช่วงนั้นใน chunk → แก้ผ่าน iovec → เข้ารหัสกลับ (ไม่ copy ออกมา)
+            size_t voff = toff + strlen("Token="), vlen = tlen - strlen("Token=");
+            seg_iovec_t iov[2];
+            int nv = 0;
+            bool ok = sec_crypt_inplace(&ss, voff, vlen) == (int)vlen;
+            if (ok)
+            {
+                nv = seg_iovec(&ss.seg, voff, vlen, iov, 2);
+                for (int i = 0; i < nv; i++)
+                    memset(iov[i].base, '*', iov[i].len);
+                ok = sec_crypt_inplace(&ss, voff, vlen) == (int)vlen;
+            }
+            // round-trip: ถอดทั้งก้อนต้องได้ secret เดิมที่ค่า Token เป็น '*'
+            char expect[64], back[64];
+            if (ok && slen <= sizeof(expect))
+            {
+                memcpy(expect, secret, slen);
+                memset(expect + voff, '*', vlen);
+                ok = sec_read(&ss, 0, back, slen) == (int)slen && memcmp(back, expect, slen) == 0;
+                secure_wipe(expect, slen);
+                secure_wipe(back, slen);
+            }
+            ESP_LOGI(TAG, "🔏 In-place redact [%u..%u) via %d iovec(s), re-encrypted: %s", (unsigned)voff,
+                     (unsigned)(voff + vlen), nv, ok ? "round-trip OK" : "MISMATCH");
+        }
+        sec_close(&ss);
+    }
+    secure_wipe(key, sizeof(key));
     ESP_LOGI(TAG, "🔐 Sensitive data demo finished");
     vTaskDelete(NULL);
 }
@@ -1169,8 +4089,27 @@ static void dynamic_pools_demo_task(void *arg)
             if (p)
                 memset(p, 0xA5, ask < 128 ? ask : 128);
         }
+        ESP_LOGI(TAG, "🧱 ARENA: used=%u reserved=%u blocks=%lu grows=%lu", (unsigned)arena_used(&arena),
+                 (unsigned)arena.reserved, (unsigned long)arena.blocks, (unsigned long)arena.grows);
         arena_reset(&arena);
 
+        // scratch ต่อ task: scope ซ้อนกัน (ชั้นในโตเกิน block → ต่อ chain แล้วคืนตอนออก scope)
+        bump_arena_t *scratch = arena_task_local();
+        if (scratch)
+        {
+            arena_mark_t outer = arena_mark(scratch);
+            uint8_t *hdr = (uint8_t *)arena_alloc(scratch, 256, 0, "SCRATCH");
+            arena_mark_t inner = arena_mark(scratch);
+            uint8_t *work = (uint8_t *)arena_alloc(scratch, ARENA_LOCAL_BLOCK * 2, 32, "SCRATCH");
+            if (hdr && work)
+            {
+                memset(hdr, 0x11, 256);
+                memset(work, 0x22, ARENA_LOCAL_BLOCK * 2);
+            }
+            arena_release_to(scratch, inner);
+            arena_release_to(scratch, outer);
+        }
+
         dpool_dump(&dpm);
         analyze_memory_status();
 
@@ -1206,14 +4145,30 @@ void app_main(void)
     gpio_set_level(LED_FRAGMENTATION, 0);
     gpio_set_level(LED_SPIRAM_ACTIVE, 0);
 
-    // Mutex + init
-    memory_mutex = xSemaphoreCreateMutex();
-    if (!memory_mutex)
+    // Tracker init (slab อยู่ SPIRAM ถ้ามี → track ได้หลายหมื่น allocation)
+    bool have_spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+    if (!alloc_track_init(have_spiram ? TRACK_CAPACITY_SPIRAM : TRACK_CAPACITY_INTERNAL,
+                          have_spiram ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)))
     {
-        ESP_LOGE(TAG, "Failed to create memory mutex!");
+        ESP_LOGE(TAG, "Failed to init allocation tracker!");
         return;
     }
-    memset(allocations, 0, sizeof(allocations));
+    if (!own_map_init())
+        ESP_LOGW(TAG, "Ownership map init failed");
+    heap_sample_init(HEAP_SAMPLE_MEAN_BYTES);
+    g_rheap_ready = rheap_init(&g_rheap, RHEAP_BYTES, RHEAP_MAX_HANDLES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) == 0;
+    if (!g_rheap_ready)
+        ESP_LOGW(TAG, "Handle heap init failed");
+    g_cold_ready = cold_init(&g_cold, COLD_MAX_ENTRIES, MCODEC_AUTO, COLD_IDLE_MS, MALLOC_CAP_8BIT) == 0;
+    if (!g_cold_ready)
+        ESP_LOGW(TAG, "Cold store init failed");
+    if (dpool_init(&g_seg_pool, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) != 0)
+        ESP_LOGW(TAG, "Segment pool init failed");
+    // chunk ถูกใช้เป็นช่วง ๆ (fallback / secure stream) → ไม่ต้องค้าง page 8KB ไว้ตลอด, burst ยัง cache ได้ถึง high
+    dpool_set_empty_cache(&g_seg_pool, DPOOL_NCLASS - 1, 0, DPOOL_EMPTY_HIGH, DPOOL_EMPTY_DECAY_MS);
+    if (!lt_init())
+        ESP_LOGW(TAG, "Lifetime policy init failed (lt_malloc → heap only)");
+    mp_register_handlers();
     ESP_LOGI(TAG, "Memory tracking system initialized");
 
     // Snapshot
@@ -1228,12 +4183,23 @@ void app_main(void)
 
     // Tasks
     xTaskCreate(memory_monitor_task, "MemMon", 4096, NULL, 6, NULL);
+    xTaskCreate(mem_pressure_task, "MemPressure", 3072, NULL, 6, NULL);
     xTaskCreate(memory_stress_test_task, "Stress", 3072, NULL, 5, NULL);
     xTaskCreate(memory_pool_test_task, "PoolMini", 3072, NULL, 5, NULL);
     xTaskCreate(large_allocation_test_task, "Large", 3072, NULL, 4, NULL);
     xTaskCreate(heap_integrity_test_task, "Integrity", 3072, NULL, 3, NULL);
     xTaskCreate(sensitive_data_demo_task, "Secure", 4096, NULL, 7, NULL);
     xTaskCreate(dynamic_pools_demo_task, "DynPools", 4096, NULL, 5, NULL);
+    if (g_rheap_ready)
+    {
+        xTaskCreate(rheap_compactor_task, "Compactor", 3072, NULL, 1, &g_rheap_compactor);
+        xTaskCreate(reloc_demo_task, "RelocDemo", 3072, NULL, 4, NULL);
+    }
+    if (g_cold_ready)
+        xTaskCreate(cold_log_task, "ColdLog", 3072, NULL, 3, NULL);
+#if BENCH_TASK_ENABLE
+    xTaskCreate(bench_task, "Bench", 3072, NULL, 2, NULL);
+#endif
 
 // Shared memory demo (ถ้ามีในโปรเจ็กต์)
 #ifdef CONFIG_APP_HAVE_SHARED_MEMORY_DEMO
@@ -1254,7 +4220,12 @@ void app_main(void)
 
     ESP_LOGI(TAG, "\n🔬 Features:");
     ESP_LOGI(TAG, "  • Heap Tracking / Monitor / Leak detection / Fragmentation");
-    ESP_LOGI(TAG, "  • RLE compress/decompress demo");
-    ESP_LOGI(TAG, "  • 🔒 Secure In-RAM Encryption (AES-CTR)");
+    ESP_LOGI(TAG, "  • 🗜️ RLE (word scan) / LZ stream codecs + 🧊 cold buffer store");
+    ESP_LOGI(TAG, "  • 🔒 Secure In-RAM Encryption (AES-CTR) + chunked stream with cached keys");
     ESP_LOGI(TAG, "  • 🧰 Dynamic Pools: Slab grow/shrink + Bump Arena");
+    ESP_LOGI(TAG, "  • 🧲 Relocatable handles + incremental compaction");
+    ESP_LOGI(TAG, "  • 📦 Segmented buffers (dpool chunks) for large payloads");
+    ESP_LOGI(TAG, "  • ⏳ Lifetime-segregated allocation (learned per description)");
+    ESP_LOGI(TAG, "  • 🔍 Incremental, time-budgeted integrity checking");
+    ESP_LOGI(TAG, "  • 🫧 Memory-pressure bus (prioritized reclaim + retry on alloc failure)");
 }
\ No newline at end of file
@@ -0,0 +1,554 @@
+#include <string.h>
+
+#include "esp_heap_caps.h"
+
+#include "mem_codec.h"
+
+/* ======================
+ * Word helpers
+ * ====================== */
+// ทำงานทีละ word ของ CPU (ESP32 = 4 byte) — load แบบไม่ต้อง align ผ่าน memcpy (compiler แปลงเป็น l32i/ldr)
+// bit trick สมมติ little-endian: byte แรกในหน่วยความจำ = บิตล่างสุดของ word
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "word scan assumes little-endian");
+
+typedef size_t mword_t;
+#define WSZ sizeof(mword_t)
+#define ONES ((mword_t)-1 / 0xFFu) // 0x01010101...
+#define HIGHS (ONES * 0x80u)       // 0x80808080...
+
+static inline mword_t load_w(const uint8_t *p)
+{
+    mword_t w;
+    memcpy(&w, p, WSZ);
+    return w;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// บิตสูงของ byte ที่เป็นศูนย์ (ตัวล่างสุดถูกต้องเสมอ ตัวที่สูงกว่าอาจเพี้ยน — ใช้หาแค่ตัวแรก)
+static inline mword_t zero_bytes(mword_t x) { return (x - ONES) & ~x & HIGHS; }
+static inline size_t first_byte(mword_t m) { return (size_t)__builtin_ctzll((unsigned long long)m) >> 3; }
+
+/* ======================
+ * RLE (word-at-a-time)
+ * ====================== */
+#define RLE_MAX_RUN 128
+#define RLE_MAX_LIT 128
+
+// ความยาว run ของ p[0] (ไม่เกิน max): XOR กับ byte ที่ขยายเต็ม word → byte แรกที่ไม่ใช่ศูนย์ = จุดจบ run
+static size_t rle_run(const uint8_t *p, size_t max)
+{
+    const mword_t pat = ONES * p[0];
+    size_t i = 0;
+    while (i + WSZ <= max)
+    {
+        mword_t x = load_w(p + i) ^ pat;
+        if (x)
+            return i + first_byte(x);
+        i += WSZ;
+    }
+    while (i < max && p[i] == p[0])
+        i++;
+    return i;
+}
+
+// ตำแหน่งแรกใน [i, lim) ที่มี byte ซ้ำกัน 3 ตัว (จุดเริ่ม run ที่คุ้มจะ encode), ไม่เจอ = lim
+// byte k ของ (w0^w1)|(w1^w2) เป็นศูนย์ ⇔ in[i+k] == in[i+k+1] == in[i+k+2]
+static size_t rle_next_triple(const uint8_t *in, size_t i, size_t lim, size_t n)
+{
+    while (i < lim && i + 2 + WSZ <= n)
+    {
+        mword_t w1 = load_w(in + i + 1);
+        mword_t m = zero_bytes((load_w(in + i) ^ w1) | (w1 ^ load_w(in + i + 2)));
+        if (m)
+        {
+            size_t q = i + first_byte(m);
+            return q < lim ? q : lim;
+        }
+        i += WSZ;
+    }
+    for (; i < lim && i + 2 < n; i++)
+        if (in[i] == in[i + 1] && in[i] == in[i + 2])
+            return i;
+    return lim;
+}
+
+// out = NULL → นับขนาดอย่างเดียว (ไว้เทียบกับ LZ โดยไม่ต้องมี buffer ที่สอง)
+static size_t rle_encode(const uint8_t *in, size_t n, uint8_t *out, size_t cap)
+{
+    size_t ip = 0, op = 0;
+    while (ip < n)
+    {
+        size_t max = n - ip < RLE_MAX_RUN ? n - ip : RLE_MAX_RUN;
+        size_t run = rle_run(in + ip, max);
+        if (run >= 3)
+        {
+            if (op + 2 > cap)
+                return 0;
+            if (out)
+            {
+                out[op] = (uint8_t)(257 - run); // 129..255
+                out[op + 1] = in[ip];
+            }
+            op += 2;
+            ip += run;
+        }
+        else
+        {
+            // ip เองไม่ใช่จุดเริ่ม run แน่นอน → literal ยาวอย่างน้อย 1
+            size_t lim = n - ip < RLE_MAX_LIT ? n : ip + RLE_MAX_LIT;
+            size_t end = rle_next_triple(in, ip, lim, n);
+            size_t lit = end - ip;
+            if (op + 1 + lit > cap)
+                return 0;
+            if (out)
+            {
+                out[op] = (uint8_t)(lit - 1);
+                memcpy(out + op + 1, in + ip, lit);
+            }
+            op += 1 + lit;
+            ip = end;
+        }
+    }
+    return op;
+}
+
+static size_t rle_decode(const uint8_t *in, size_t n, uint8_t *out, size_t cap)
+{
+    size_t ip = 0, op = 0;
+    while (ip < n && op < cap)
+    {
+        uint8_t h = in[ip++];
+        if (h <= 127)
+        {
+            size_t lit = (size_t)h + 1;
+            if (ip + lit > n || op + lit > cap)
+                break;
+            memcpy(out + op, in + ip, lit);
+            ip += lit;
+            op += lit;
+        }
+        else if (h >= 129)
+        {
+            size_t rep = 257 - (size_t)h;
+            if (ip >= n || op + rep > cap)
+                break;
+            memset(out + op, in[ip++], rep);
+            op += rep;
+        }
+        // 128 = NOP
+    }
+    return op;
+}
+
+/* ======================
+ * LZ (LZ4-style block)
+ * ====================== */
+// sequence = token [lit_len:4 | match_len-4:4] (+ byte ต่อความยาวถ้า nibble = 15) + literal + offset16 (+ byte ต่อ)
+// sequence สุดท้ายมีแต่ literal (จบ input หลัง literal = จบ block)
+#define LZ_MIN_MATCH 4
+#define LZ_SKIP_SHIFT 6 // หา match ไม่เจอติดกัน 64 ครั้ง → ก้าวยาวขึ้น (ข้อมูลสุ่มผ่านไปเร็ว)
+
+static inline uint32_t lz_hash(uint32_t v) { return (v * 2654435761u) >> (32 - MCODEC_LZ_HASH_LOG); }
+
+// ความยาวที่ a กับ b ตรงกัน (b อยู่หลัง a, หยุดที่ end) — XOR ทีละ word แล้วนับ byte ศูนย์ท้าย
+static size_t lz_match_len(const uint8_t *a, const uint8_t *b, const uint8_t *end)
+{
+    const uint8_t *start = b;
+    while (b + WSZ <= end)
+    {
+        mword_t x = load_w(a) ^ load_w(b);
+        if (x)
+            return (size_t)(b - start) + first_byte(x);
+        a += WSZ;
+        b += WSZ;
+    }
+    while (b < end && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return (size_t)(b - start);
+}
+
+static inline uint8_t *lz_put_len(uint8_t *op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// จำนวน byte สูงสุดที่ sequence หนึ่งใช้ (ไว้เช็ค cap ก่อนเขียน)
+static inline size_t lz_seq_bound(size_t lit, size_t ml) { return 1 + lit + lit / 255 + 1 + 2 + ml / 255 + 1; }
+
+static size_t lz_encode(const uint8_t *in, size_t n, uint8_t *out, size_t cap, uint16_t *tab)
+{
+    const uint8_t *ip = in, *anchor = in, *end = in + n;
+    uint8_t *op = out, *oend = out + cap;
+    memset(tab, 0, MCODEC_WORK_BYTES);
+
+    if (n >= LZ_MIN_MATCH)
+    {
+        const uint8_t *last = end - LZ_MIN_MATCH; // ตำแหน่งสุดท้ายที่อ่าน 4 byte ได้
+        uint32_t miss = 0;
+        while (ip <= last)
+        {
+            uint32_t h = lz_hash(read32(ip));
+            const uint8_t *ref = in + tab[h];
+            tab[h] = (uint16_t)(ip - in);
+            if (ref >= ip || read32(ref) != read32(ip))
+            {
+                ip += 1 + (miss++ >> LZ_SKIP_SHIFT);
+                continue;
+            }
+            miss = 0;
+            while (ip > anchor && ref > in && ip[-1] == ref[-1]) // ขยายย้อนไปกิน literal ที่ตรงกัน
+            {
+                ip--;
+                ref--;
+            }
+            size_t ml = LZ_MIN_MATCH + lz_match_len(ref + LZ_MIN_MATCH, ip + LZ_MIN_MATCH, end);
+            size_t lit = (size_t)(ip - anchor), off = (size_t)(ip - ref);
+            if (lz_seq_bound(lit, ml) > (size_t)(oend - op))
+                return 0;
+
+            uint8_t *tok = op++;
+            *tok = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+            if (lit >= 15)
+                op = lz_put_len(op, lit - 15);
+            memcpy(op, anchor, lit);
+            op += lit;
+            *op++ = (uint8_t)off;
+            *op++ = (uint8_t)(off >> 8);
+            size_t mc = ml - LZ_MIN_MATCH;
+            *tok |= (uint8_t)(mc >= 15 ? 15 : mc);
+            if (mc >= 15)
+                op = lz_put_len(op, mc - 15);
+
+            ip += ml;
+            anchor = ip;
+            if (ip - 2 <= last) // ลงตำแหน่งท้าย match ด้วย → match ถัดไปที่ต่อกันเจอเร็วขึ้น
+                tab[lz_hash(read32(ip - 2))] = (uint16_t)(ip - 2 - in);
+        }
+    }
+
+    size_t lit = (size_t)(end - anchor);
+    if (1 + lit + lit / 255 + 1 > (size_t)(oend - op))
+        return 0;
+    *op++ = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+    if (lit >= 15)
+        op = lz_put_len(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+    return (size_t)(op - out);
+}
+
+static size_t lz_decode(const uint8_t *in, size_t n, uint8_t *out, size_t cap)
+{
+    const uint8_t *ip = in, *iend = in + n;
+    uint8_t *op = out, *oend = out + cap;
+    while (ip < iend)
+    {
+        uint8_t tok = *ip++;
+        size_t lit = tok >> 4;
+        if (lit == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                    goto done;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+            goto done;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend)
+            break; // sequence สุดท้าย
+
+        if (iend - ip < 2)
+            goto done;
+        size_t off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (off == 0 || off > (size_t)(op - out))
+            goto done;
+        size_t ml = tok & 15u;
+        if (ml == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                    goto done;
+                b = *ip++;
+                ml += b;
+            } while (b == 255);
+        }
+        ml += LZ_MIN_MATCH;
+        if (ml > (size_t)(oend - op))
+            goto done;
+
+        const uint8_t *m = op - off;
+        if (off >= ml)
+        {
+            memcpy(op, m, ml);
+            op += ml;
+        }
+        else if (off >= WSZ)
+        {
+            // ซ้อนกันแต่ห่างอย่างน้อย 1 word: copy ทีละ word ได้ (แต่ละ word ที่อ่านเขียนเสร็จแล้ว)
+            uint8_t *stop = op + ml;
+            while (op + WSZ <= stop)
+            {
+                memcpy(op, m, WSZ);
+                op += WSZ;
+                m += WSZ;
+            }
+            while (op < stop)
+                *op++ = *m++;
+        }
+        else
+        {
+            for (size_t k = 0; k < ml; k++)
+                *op++ = *m++;
+        }
+    }
+done:
+    return (size_t)(op - out);
+}
+
+/* ======================
+ * API
+ * ====================== */
+const char *mcodec_name(mcodec_id_t id)
+{
+    switch (id)
+    {
+    case MCODEC_RAW:
+        return "raw";
+    case MCODEC_RLE:
+        return "rle";
+    case MCODEC_LZ:
+        return "lz";
+    case MCODEC_AUTO:
+        return "auto";
+    }
+    return "?";
+}
+
+size_t mcodec_compress(mcodec_id_t id, const void *in, size_t n, void *out, size_t cap, void *work)
+{
+    if (n > MCODEC_MAX_INPUT)
+        return 0;
+    switch (id)
+    {
+    case MCODEC_RAW:
+        if (n > cap)
+            return 0;
+        memcpy(out, in, n);
+        return n;
+    case MCODEC_RLE:
+        return rle_encode((const uint8_t *)in, n, (uint8_t *)out, cap);
+    case MCODEC_LZ:
+        return work ? lz_encode((const uint8_t *)in, n, (uint8_t *)out, cap, (uint16_t *)work) : 0;
+    default:
+        return 0;
+    }
+}
+
+size_t mcodec_decompress(mcodec_id_t id, const void *in, size_t n, void *out, size_t cap)
+{
+    switch (id)
+    {
+    case MCODEC_RAW:
+        n = n < cap ? n : cap;
+        memcpy(out, in, n);
+        return n;
+    case MCODEC_RLE:
+        return rle_decode((const uint8_t *)in, n, (uint8_t *)out, cap);
+    case MCODEC_LZ:
+        return lz_decode((const uint8_t *)in, n, (uint8_t *)out, cap);
+    default:
+        return 0;
+    }
+}
+
+size_t mcodec_compress_best(mcodec_id_t id, const void *in, size_t n, void *out, size_t cap, void *work,
+                            mcodec_id_t *used)
+{
+    // บีบแล้วต้องเล็กกว่าเดิมจริง ไม่งั้นเก็บ RAW
+    size_t lim = (n - 1 < cap) ? n - 1 : cap;
+    size_t len = 0;
+    mcodec_id_t pick = MCODEC_RAW;
+    if (n == 0)
+        goto raw;
+    if (id == MCODEC_AUTO)
+    {
+        // RLE นับขนาดอย่างเดียวก่อน (เร็ว) → LZ ลง out → RLE เขียนทับเฉพาะเมื่อเล็กกว่า
+        size_t rs = rle_encode((const uint8_t *)in, n, NULL, lim);
+        len = mcodec_compress(MCODEC_LZ, in, n, out, lim, work);
+        pick = MCODEC_LZ;
+        if (rs && (!len || rs < len))
+        {
+            len = rle_encode((const uint8_t *)in, n, (uint8_t *)out, lim);
+            pick = MCODEC_RLE;
+        }
+    }
+    else if (id == MCODEC_RLE || id == MCODEC_LZ)
+    {
+        len = mcodec_compress(id, in, n, out, lim, work);
+        pick = id;
+    }
+    if (len)
+    {
+        *used = pick;
+        return len;
+    }
+raw:
+    *used = MCODEC_RAW;
+    return mcodec_compress(MCODEC_RAW, in, n, out, cap, NULL);
+}
+
+/* ======================
+ * Streaming
+ * ====================== */
+int mcodec_stream_init(mcodec_stream_t *s, mcodec_id_t codec, bool decode, size_t block_bytes, uint32_t caps,
+                       mcodec_sink_fn sink, void *arg)
+{
+    memset(s, 0, sizeof(*s));
+    if (!block_bytes)
+        block_bytes = MCODEC_STREAM_BLOCK;
+    if (block_bytes > MCODEC_MAX_INPUT || !sink)
+        return -1;
+    s->codec = codec;
+    s->decode = decode;
+    s->block_bytes = block_bytes;
+    s->sink = sink;
+    s->arg = arg;
+    s->blk = (uint8_t *)heap_caps_malloc(block_bytes, caps);
+    s->comp = (uint8_t *)heap_caps_malloc(MCODEC_FRAME_HDR + block_bytes, caps);
+    if (!decode && codec != MCODEC_RLE && codec != MCODEC_RAW)
+        s->work = heap_caps_malloc(MCODEC_WORK_BYTES, caps);
+    if (!s->blk || !s->comp || (!decode && codec != MCODEC_RLE && codec != MCODEC_RAW && !s->work))
+    {
+        mcodec_stream_deinit(s);
+        return -1;
+    }
+    return 0;
+}
+
+void mcodec_stream_deinit(mcodec_stream_t *s)
+{
+    heap_caps_free(s->blk);
+    heap_caps_free(s->comp);
+    heap_caps_free(s->work);
+    s->blk = s->comp = NULL;
+    s->work = NULL;
+}
+
+static int stream_emit(mcodec_stream_t *s)
+{
+    if (s->fill == 0)
+        return 0;
+    mcodec_id_t used;
+    size_t clen = mcodec_compress_best(s->codec, s->blk, s->fill, s->comp + MCODEC_FRAME_HDR, s->block_bytes,
+                                       s->work, &used);
+    s->comp[0] = (uint8_t)used;
+    s->comp[1] = (uint8_t)s->fill;
+    s->comp[2] = (uint8_t)(s->fill >> 8);
+    s->comp[3] = (uint8_t)clen;
+    s->comp[4] = (uint8_t)(clen >> 8);
+    s->blocks[used]++;
+    s->raw_bytes += s->fill;
+    s->coded_bytes += MCODEC_FRAME_HDR + clen;
+    s->fill = 0;
+    int rc = s->sink(s->comp, MCODEC_FRAME_HDR + clen, s->arg);
+    if (rc)
+        s->err = rc;
+    return rc;
+}
+
+static int stream_decode_write(mcodec_stream_t *s, const uint8_t *p, size_t len)
+{
+    while (len)
+    {
+        if (s->hdr_fill < MCODEC_FRAME_HDR)
+        {
+            s->hdr[s->hdr_fill++] = *p++;
+            len--;
+            if (s->hdr_fill == MCODEC_FRAME_HDR)
+            {
+                size_t raw = s->hdr[1] | ((size_t)s->hdr[2] << 8);
+                size_t comp = s->hdr[3] | ((size_t)s->hdr[4] << 8);
+                if (s->hdr[0] > MCODEC_LZ || raw == 0 || raw > s->block_bytes || comp == 0 || comp > s->block_bytes)
+                    return s->err = -2;
+                s->fill = 0;
+            }
+            continue;
+        }
+        size_t comp = s->hdr[3] | ((size_t)s->hdr[4] << 8);
+        size_t take = comp - s->fill < len ? comp - s->fill : len;
+        memcpy(s->comp + s->fill, p, take);
+        s->fill += take;
+        p += take;
+        len -= take;
+        if (s->fill < comp)
+            break;
+
+        size_t raw = s->hdr[1] | ((size_t)s->hdr[2] << 8);
+        mcodec_id_t id = (mcodec_id_t)s->hdr[0];
+        if (mcodec_decompress(id, s->comp, comp, s->blk, raw) != raw)
+            return s->err = -2;
+        s->blocks[id]++;
+        s->coded_bytes += MCODEC_FRAME_HDR + comp;
+        s->raw_bytes += raw;
+        s->hdr_fill = 0;
+        s->fill = 0;
+        int rc = s->sink(s->blk, raw, s->arg);
+        if (rc)
+            return s->err = rc;
+    }
+    return 0;
+}
+
+int mcodec_stream_write(mcodec_stream_t *s, const void *data, size_t len)
+{
+    if (s->err)
+        return s->err;
+    const uint8_t *p = (const uint8_t *)data;
+    if (s->decode)
+        return stream_decode_write(s, p, len);
+    while (len)
+    {
+        size_t take = s->block_bytes - s->fill < len ? s->block_bytes - s->fill : len;
+        memcpy(s->blk + s->fill, p, take);
+        s->fill += take;
+        p += take;
+        len -= take;
+        if (s->fill == s->block_bytes && stream_emit(s))
+            return s->err;
+    }
+    return 0;
+}
+
+int mcodec_stream_flush(mcodec_stream_t *s)
+{
+    if (s->err)
+        return s->err;
+    if (s->decode)
+        return (s->hdr_fill || s->fill) ? (s->err = -2) : 0;
+    return stream_emit(s);
+}
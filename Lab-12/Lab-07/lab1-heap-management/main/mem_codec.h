@@ -0,0 +1,90 @@
+#ifndef MEM_CODEC_H
+#define MEM_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef MCODEC_LZ_HASH_LOG
+#define MCODEC_LZ_HASH_LOG 11 // ตาราง hash ของ LZ = 2^N ช่อง x 2 byte (work buffer ที่ผู้เรียกจัดให้)
+#endif
+
+#ifndef MCODEC_STREAM_BLOCK
+#define MCODEC_STREAM_BLOCK 4096 // ขนาด block ของ stream (แต่ละ block บีบอัดแยกกัน)
+#endif
+
+/* ======================
+ * Compression codecs
+ * ======================
+ * RLE: รูปแบบ PackBits เดิมของ lab (header 0..127 = literal len+1, 129..255 = run 257-h)
+ *      แต่หา run / จุดเริ่ม run ทีละ word (XOR + หา byte ศูนย์แบบ bit trick) แทนทีละ byte
+ * LZ : ตระกูล LZ4 (token 4+4 บิต, offset 16 บิต, match ขั้นต่ำ 4) ตาราง hash ตำแหน่งล่าสุด
+ *      ขยาย match ทีละ word — ได้ ratio ดีกว่า RLE มากกับข้อความ/record ที่ซ้ำเป็นแพทเทิร์น
+ * ทั้งสอง codec: input ต่อครั้งไม่เกิน MCODEC_MAX_INPUT (offset/ตำแหน่งเป็น 16 บิต)
+ * decompress ตรวจขอบเขตทุกครั้ง: ข้อมูลเสีย → คืนความยาวที่ไม่ตรงกับที่คาด ไม่เขียนเกิน out
+ */
+typedef enum
+{
+    MCODEC_RAW = 0,
+    MCODEC_RLE = 1,
+    MCODEC_LZ = 2,
+    MCODEC_AUTO = 0xFF, // ลองทั้งสองแล้วเลือกที่เล็กกว่า (RAW ถ้าไม่มีตัวไหนช่วย)
+} mcodec_id_t;
+
+#define MCODEC_MAX_INPUT 65535u
+#define MCODEC_WORK_BYTES (sizeof(uint16_t) << MCODEC_LZ_HASH_LOG)
+#define MCODEC_BOUND(n) ((n) + (n) / 128u + 16u) // ขนาด out ที่พอเสมอสำหรับทุก codec
+
+const char *mcodec_name(mcodec_id_t id);
+
+// คืนขนาดที่บีบได้, 0 = out ไม่พอ / input เกิน / codec ไม่รู้จัก
+// work: MCODEC_WORK_BYTES (ใช้เฉพาะ LZ, RLE ส่ง NULL ได้)
+size_t mcodec_compress(mcodec_id_t id, const void *in, size_t n, void *out, size_t cap, void *work);
+// คืนขนาดที่คลายได้ (ผู้เรียกเทียบกับขนาดเดิมที่เก็บไว้เอง)
+size_t mcodec_decompress(mcodec_id_t id, const void *in, size_t n, void *out, size_t cap);
+// id = RLE/LZ/AUTO: ผลต้องเล็กกว่า n จริง ไม่งั้น copy แบบ RAW (out ต้องจุ n); *used = codec ที่ใช้จริง
+size_t mcodec_compress_best(mcodec_id_t id, const void *in, size_t n, void *out, size_t cap, void *work,
+                            mcodec_id_t *used);
+
+/* ======================
+ * Streaming
+ * ======================
+ * encoder: เขียนทีละเท่าไรก็ได้ → สะสมครบ block → บีบ (AUTO ได้) แล้วส่ง frame ให้ sink
+ * decoder: ป้อน frame เป็นชิ้นขนาดใดก็ได้ → คลายทีละ block แล้วส่งข้อมูลดิบให้ sink
+ * frame = [codec:1][raw_len:2][comp_len:2] + payload (block ที่บีบไม่ลง → เก็บ RAW)
+ */
+#define MCODEC_FRAME_HDR 5
+
+typedef int (*mcodec_sink_fn)(const void *data, size_t len, void *arg); // != 0 = หยุด (ส่งกลับเป็น error)
+
+typedef struct
+{
+    mcodec_id_t codec;
+    bool decode;
+    uint8_t *blk;  // encode: raw ที่สะสม, decode: ผลลัพธ์ของ block
+    uint8_t *comp; // encode: frame ที่บีบแล้ว, decode: payload ที่กำลังรับ
+    void *work;
+    size_t block_bytes;
+    size_t fill; // byte ใน blk (encode) หรือ comp (decode)
+    uint8_t hdr[MCODEC_FRAME_HDR];
+    uint8_t hdr_fill;
+    mcodec_sink_fn sink;
+    void *arg;
+    uint64_t raw_bytes;
+    uint64_t coded_bytes;
+    uint32_t blocks[3]; // จำนวน block ตาม codec ที่ใช้จริง (RAW/RLE/LZ)
+    int err;
+} mcodec_stream_t;
+
+// block_bytes 0 = MCODEC_STREAM_BLOCK; buffer จองจาก caps
+int mcodec_stream_init(mcodec_stream_t *s, mcodec_id_t codec, bool decode, size_t block_bytes, uint32_t caps,
+                       mcodec_sink_fn sink, void *arg);
+int mcodec_stream_write(mcodec_stream_t *s, const void *data, size_t len);
+// encoder: ส่ง block ที่ค้าง, decoder: error ถ้ายังมี frame ค้างครึ่งทาง
+int mcodec_stream_flush(mcodec_stream_t *s);
+void mcodec_stream_deinit(mcodec_stream_t *s);
+
+#endif // MEM_CODEC_H
@@ -0,0 +1,457 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "reloc_heap.h"
+
+static const char *TAG = "RHEAP";
+
+/* ======================
+ * Block layout
+ * ====================== */
+// ทุก block: header 8 byte + payload, ขนาดรวมหาร 8 ลงตัว (3 บิตล่างของ size ใช้เป็น flag)
+// free block: header + next/prev ของ free list + footer (size) ที่ 4 byte สุดท้าย
+//             → block ถัดไปรู้ขนาดของ block ก่อนหน้าที่ว่างได้จาก footer (รวมซ้ายได้ทันที)
+#define RH_ALIGN 8u
+#define RH_FREE 1u
+#define RH_PREV_FREE 2u
+#define RH_FLAGS 7u
+#define RH_MAGIC 0x5248u // "RH"
+#define RH_NO_SLOT 0xFFFFu
+
+typedef struct
+{
+    uint32_t size; // ขนาดรวม header | flag
+    uint16_t slot; // index ใน handle table (free = RH_NO_SLOT)
+    uint16_t magic;
+} rh_hdr_t;
+
+typedef struct rh_free
+{
+    rh_hdr_t h;
+    struct rh_free *next;
+    struct rh_free *prev;
+} rh_free_t;
+
+#define RH_HDR sizeof(rh_hdr_t)
+#define RH_ALIGN_UP(x) (((x) + (RH_ALIGN - 1)) & ~(size_t)(RH_ALIGN - 1))
+#define RH_MIN_BLOCK RH_ALIGN_UP(sizeof(rh_free_t) + sizeof(uint32_t))
+
+_Static_assert(sizeof(rh_hdr_t) == RH_ALIGN, "payload must stay 8-byte aligned");
+
+static inline uint32_t bsize(const rh_hdr_t *b) { return b->size & ~RH_FLAGS; }
+static inline bool is_free(const rh_hdr_t *b) { return (b->size & RH_FREE) != 0; }
+static inline rh_hdr_t *next_of(const rh_hdr_t *b) { return (rh_hdr_t *)((uint8_t *)b + bsize(b)); }
+static inline void *payload_of(rh_hdr_t *b) { return (uint8_t *)b + RH_HDR; }
+
+// เรียกเฉพาะเมื่อ RH_PREV_FREE ตั้งอยู่
+static inline rh_hdr_t *prev_of(const rh_hdr_t *b)
+{
+    uint32_t psz = *(const uint32_t *)((const uint8_t *)b - sizeof(uint32_t));
+    return (rh_hdr_t *)((uint8_t *)b - psz);
+}
+
+static inline void set_prev_free(rheap_t *rh, rh_hdr_t *b, bool v)
+{
+    if ((uint8_t *)b >= rh->end)
+        return;
+    b->size = v ? (b->size | RH_PREV_FREE) : (b->size & ~RH_PREV_FREE);
+}
+
+/* ======================
+ * Free list (เรียกขณะถือ lock)
+ * ====================== */
+static void fl_insert(rheap_t *rh, rh_free_t *f)
+{
+    f->prev = NULL;
+    f->next = (rh_free_t *)rh->free_head;
+    if (f->next)
+        f->next->prev = f;
+    rh->free_head = f;
+    rh->free_blocks++;
+}
+
+static void fl_remove(rheap_t *rh, rh_free_t *f)
+{
+    if (f->prev)
+        f->prev->next = f->next;
+    else
+        rh->free_head = f->next;
+    if (f->next)
+        f->next->prev = f->prev;
+    rh->free_blocks--;
+}
+
+// เขียน header/footer ของ free block แล้วใส่ list (block ก่อนหน้าต้องไม่ว่าง — รวมมาก่อนแล้ว)
+static void make_free(rheap_t *rh, rh_hdr_t *b, uint32_t size)
+{
+    b->size = size | RH_FREE;
+    b->slot = RH_NO_SLOT;
+    b->magic = RH_MAGIC;
+    *(uint32_t *)((uint8_t *)b + size - sizeof(uint32_t)) = size;
+    fl_insert(rh, (rh_free_t *)b);
+    set_prev_free(rh, next_of(b), true);
+}
+
+/* ======================
+ * Handle table
+ * ====================== */
+static inline rheap_handle_t handle_of(const rheap_t *rh, uint16_t idx)
+{
+    return ((rheap_handle_t)rh->slots[idx].gen << 16) | (uint32_t)(idx + 1);
+}
+
+static rheap_slot_t *slot_lookup(rheap_t *rh, rheap_handle_t h)
+{
+    uint32_t idx1 = h & 0xFFFFu;
+    if (idx1 == 0 || idx1 > rh->nslots)
+        return NULL;
+    rheap_slot_t *s = &rh->slots[idx1 - 1];
+    return (s->ptr && s->gen == (uint16_t)(h >> 16)) ? s : NULL;
+}
+
+/* ======================
+ * Init
+ * ====================== */
+int rheap_init(rheap_t *rh, size_t bytes, uint16_t max_handles, uint32_t caps)
+{
+    memset(rh, 0, sizeof(*rh));
+    if (max_handles == 0 || max_handles >= RH_NO_SLOT || bytes < RH_MIN_BLOCK + RH_ALIGN || bytes > UINT32_MAX / 2)
+        return -1;
+    rh->mem = heap_caps_malloc(bytes, caps);
+    rh->slots = (rheap_slot_t *)heap_caps_calloc(max_handles, sizeof(rheap_slot_t), caps);
+    rh->lock = xSemaphoreCreateMutex();
+    if (!rh->mem || !rh->slots || !rh->lock)
+    {
+        ESP_LOGE(TAG, "init: no memory for %u bytes / %u handles", (unsigned)bytes, (unsigned)max_handles);
+        rheap_destroy(rh);
+        return -1;
+    }
+
+    rh->base = (uint8_t *)RH_ALIGN_UP((uintptr_t)rh->mem);
+    rh->cap = (bytes - (size_t)(rh->base - (uint8_t *)rh->mem)) & ~(size_t)(RH_ALIGN - 1);
+    rh->end = rh->base + rh->cap;
+    rh->caps = caps;
+    rh->cursor = rh->base;
+    rh->nslots = max_handles;
+    for (uint16_t i = 0; i < max_handles; i++)
+        rh->slots[i].size = (i + 1u < max_handles) ? i + 2u : 0;
+    rh->slot_free = 1;
+
+    make_free(rh, (rh_hdr_t *)rh->base, (uint32_t)rh->cap);
+    rh->free_bytes = rh->cap;
+    return 0;
+}
+
+void rheap_destroy(rheap_t *rh)
+{
+    heap_caps_free(rh->mem);
+    heap_caps_free(rh->slots);
+    if (rh->lock)
+        vSemaphoreDelete(rh->lock);
+    memset(rh, 0, sizeof(*rh));
+}
+
+/* ======================
+ * Alloc / free (ถือ lock)
+ * ====================== */
+static rh_hdr_t *alloc_block_locked(rheap_t *rh, uint32_t need)
+{
+    rh_free_t *f = (rh_free_t *)rh->free_head;
+    while (f && bsize(&f->h) < need)
+        f = f->next;
+    if (!f)
+        return NULL;
+
+    rh_hdr_t *b = &f->h;
+    uint32_t have = bsize(b);
+    fl_remove(rh, f);
+    if (have - need >= RH_MIN_BLOCK)
+    {
+        make_free(rh, (rh_hdr_t *)((uint8_t *)b + need), have - need); // block ถัดไปมี PREV_FREE อยู่แล้ว
+        have = need;
+    }
+    else
+    {
+        set_prev_free(rh, next_of(b), false);
+    }
+    b->size = have; // block ก่อน free block ไม่มีทางว่าง → PREV_FREE = 0
+    rh->free_bytes -= have;
+    return b;
+}
+
+static void free_block_locked(rheap_t *rh, rh_hdr_t *b)
+{
+    uint32_t size = bsize(b);
+    rh_hdr_t *n = next_of(b);
+    rh->free_bytes += size;
+    if (b->size & RH_PREV_FREE)
+    {
+        rh_hdr_t *p = prev_of(b);
+        fl_remove(rh, (rh_free_t *)p);
+        size += bsize(p);
+        b = p;
+    }
+    if ((uint8_t *)n < rh->end && is_free(n))
+    {
+        fl_remove(rh, (rh_free_t *)n);
+        size += bsize(n);
+    }
+    // cursor ต้องชี้หัว block เสมอ: ถ้าหัวที่ชี้อยู่ถูกรวมหายไป ให้ถอยมาที่หัวของ block ที่รวมแล้ว
+    if (rh->cursor > (uint8_t *)b && rh->cursor < (uint8_t *)b + size)
+        rh->cursor = (uint8_t *)b;
+    make_free(rh, b, size);
+}
+
+/* ======================
+ * Compaction (ถือ lock)
+ * ====================== */
+// เลื่อน block ที่ใช้อยู่ u ลงไปทับ free block f ที่อยู่ติดกันข้างหน้า → ช่องว่างย้ายไปอยู่หลัง u
+// แล้วรวมกับ free block ถัดไป (ถ้ามี) ทันที คืน free block ใหม่
+static rh_hdr_t *slide_locked(rheap_t *rh, rh_hdr_t *f, rh_hdr_t *u)
+{
+    uint32_t fs = bsize(f), us = bsize(u);
+    rh_hdr_t *after = next_of(u);
+    fl_remove(rh, (rh_free_t *)f);
+    memmove(f, u, us);
+    f->size = us; // ก่อนหน้า f ไม่ว่างแน่นอน
+    rh->slots[f->slot].ptr = payload_of(f);
+
+    rh_hdr_t *nf = (rh_hdr_t *)((uint8_t *)f + us);
+    if ((uint8_t *)after < rh->end && is_free(after))
+    {
+        fl_remove(rh, (rh_free_t *)after);
+        fs += bsize(after);
+    }
+    make_free(rh, nf, fs);
+    rh->moves++;
+    rh->bytes_moved += us - RH_HDR;
+    return nf;
+}
+
+// เดินต่อจาก cursor ไม่เกิน RHEAP_SCAN_BATCH block หรือจนย้ายได้ 1 block
+// คืน 1 = ย้ายแล้ว, *done = ถึงท้าย region (ครบรอบ → cursor กลับไปต้น)
+static int compact_step_locked(rheap_t *rh, bool *done)
+{
+    uint8_t *p = rh->cursor;
+    for (int n = 0; n < RHEAP_SCAN_BATCH; n++)
+    {
+        if (p >= rh->end)
+        {
+            rh->cursor = rh->base;
+            rh->passes++;
+            *done = true;
+            return 0;
+        }
+        rh_hdr_t *b = (rh_hdr_t *)p;
+        if (!is_free(b))
+        {
+            p += bsize(b);
+            continue;
+        }
+        rh_hdr_t *u = next_of(b);
+        if ((uint8_t *)u >= rh->end)
+        {
+            p = rh->end; // ช่องว่างท้าย region = ผลลัพธ์ที่ต้องการ
+            continue;
+        }
+        if (rh->slots[u->slot].pins)
+        {
+            // ย้ายไม่ได้: ช่องว่างนี้ค้างไว้ก่อน ไปต่อหลัง block ที่ถูก pin
+            rh->pinned_skips++;
+            p = (uint8_t *)next_of(u);
+            continue;
+        }
+        rh->cursor = (uint8_t *)slide_locked(rh, b, u);
+        return 1;
+    }
+    rh->cursor = p;
+    return 0;
+}
+
+/* ======================
+ * API
+ * ====================== */
+rheap_handle_t rheap_alloc(rheap_t *rh, size_t size)
+{
+    if (size == 0 || size > rh->cap)
+        return RHEAP_INVALID;
+    uint32_t need = (uint32_t)RH_ALIGN_UP(size + RH_HDR);
+    if (need < RH_MIN_BLOCK)
+        need = RH_MIN_BLOCK;
+
+    rheap_handle_t h = RHEAP_INVALID;
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    if (rh->slot_free)
+    {
+        rh_hdr_t *b = alloc_block_locked(rh, need);
+        if (!b && rh->free_bytes >= need)
+        {
+            // free รวมพอแต่กระจายอยู่: compact เต็มรอบทันที (ไม่จำกัดเวลา — เป็น path ของความล้มเหลวเท่านั้น)
+            bool done = false;
+            rh->sync_compacts++;
+            rh->cursor = rh->base;
+            while (!done)
+                compact_step_locked(rh, &done);
+            b = alloc_block_locked(rh, need);
+        }
+        if (b)
+        {
+            uint16_t idx = (uint16_t)(rh->slot_free - 1);
+            rheap_slot_t *s = &rh->slots[idx];
+            rh->slot_free = (uint16_t)s->size;
+            s->ptr = payload_of(b);
+            s->size = (uint32_t)size;
+            s->pins = 0;
+            b->slot = idx;
+            b->magic = RH_MAGIC;
+            rh->live++;
+            h = handle_of(rh, idx);
+        }
+    }
+    if (h == RHEAP_INVALID)
+        rh->alloc_fails++;
+    xSemaphoreGive(rh->lock);
+    return h;
+}
+
+bool rheap_free(rheap_t *rh, rheap_handle_t h)
+{
+    bool ok = false;
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    rheap_slot_t *s = slot_lookup(rh, h);
+    if (s && s->pins == 0)
+    {
+        free_block_locked(rh, (rh_hdr_t *)((uint8_t *)s->ptr - RH_HDR));
+        uint16_t idx = (uint16_t)(s - rh->slots);
+        s->ptr = NULL;
+        s->gen++;
+        s->size = rh->slot_free;
+        rh->slot_free = (uint16_t)(idx + 1);
+        rh->live--;
+        ok = true;
+    }
+    xSemaphoreGive(rh->lock);
+    if (s && !ok)
+        ESP_LOGW(TAG, "free of pinned handle 0x%08lx ignored", (unsigned long)h);
+    return ok;
+}
+
+void *rheap_pin(rheap_t *rh, rheap_handle_t h)
+{
+    void *p = NULL;
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    rheap_slot_t *s = slot_lookup(rh, h);
+    if (s && s->pins < UINT16_MAX)
+    {
+        s->pins++;
+        p = s->ptr;
+    }
+    xSemaphoreGive(rh->lock);
+    return p;
+}
+
+void rheap_unpin(rheap_t *rh, rheap_handle_t h)
+{
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    rheap_slot_t *s = slot_lookup(rh, h);
+    if (s && s->pins)
+        s->pins--;
+    xSemaphoreGive(rh->lock);
+}
+
+size_t rheap_size(rheap_t *rh, rheap_handle_t h)
+{
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    rheap_slot_t *s = slot_lookup(rh, h);
+    size_t n = s ? s->size : 0;
+    xSemaphoreGive(rh->lock);
+    return n;
+}
+
+bool rheap_compact(rheap_t *rh, uint32_t budget_us, uint32_t *moved)
+{
+    uint64_t t0 = esp_timer_get_time();
+    uint32_t m = 0;
+    bool done = false;
+    do
+    {
+        // ปล่อย lock ทุกขั้น → pin/alloc ของ task อื่นรอไม่เกินการย้าย 1 block
+        xSemaphoreTake(rh->lock, portMAX_DELAY);
+        m += (uint32_t)compact_step_locked(rh, &done);
+        xSemaphoreGive(rh->lock);
+    } while (!done && esp_timer_get_time() - t0 < budget_us);
+    if (moved)
+        *moved = m;
+    return done;
+}
+
+void rheap_get_stats(rheap_t *rh, rheap_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    uint32_t largest = 0;
+    for (rh_free_t *f = (rh_free_t *)rh->free_head; f; f = f->next)
+        if (bsize(&f->h) > largest)
+            largest = bsize(&f->h);
+    for (uint16_t i = 0; i < rh->nslots; i++)
+        out->pinned += (rh->slots[i].ptr && rh->slots[i].pins) ? 1u : 0u;
+    out->cap = rh->cap;
+    out->free_bytes = rh->free_bytes;
+    out->largest_free = largest > RH_HDR ? largest - RH_HDR : 0;
+    out->free_blocks = rh->free_blocks;
+    out->live = rh->live;
+    out->moves = rh->moves;
+    out->bytes_moved = rh->bytes_moved;
+    out->passes = rh->passes;
+    out->pinned_skips = rh->pinned_skips;
+    out->alloc_fails = rh->alloc_fails;
+    out->sync_compacts = rh->sync_compacts;
+    xSemaphoreGive(rh->lock);
+    out->fragmentation = out->free_bytes ? 1.0f - (float)largest / (float)out->free_bytes : 0.0f;
+}
+
+bool rheap_check(rheap_t *rh)
+{
+    bool ok = true, prev_free = false, cursor_seen = false;
+    uint32_t nfree = 0, nlive = 0;
+    size_t free_bytes = 0;
+
+    xSemaphoreTake(rh->lock, portMAX_DELAY);
+    uint8_t *p = rh->base;
+    while (ok && p < rh->end)
+    {
+        rh_hdr_t *b = (rh_hdr_t *)p;
+        uint32_t sz = bsize(b);
+        cursor_seen |= p == rh->cursor;
+        if (b->magic != RH_MAGIC || sz < RH_MIN_BLOCK || sz > (size_t)(rh->end - p) ||
+            ((b->size & RH_PREV_FREE) != 0) != prev_free)
+        {
+            ok = false;
+            break;
+        }
+        if (is_free(b))
+        {
+            ok = !prev_free && *(uint32_t *)(p + sz - sizeof(uint32_t)) == sz;
+            nfree++;
+            free_bytes += sz;
+        }
+        else
+        {
+            ok = b->slot < rh->nslots && rh->slots[b->slot].ptr == payload_of(b) &&
+                 rh->slots[b->slot].size + RH_HDR <= sz;
+            nlive++;
+        }
+        prev_free = is_free(b);
+        p += sz;
+    }
+    cursor_seen |= rh->cursor == rh->end;
+    ok = ok && p == rh->end && cursor_seen && nfree == rh->free_blocks && free_bytes == rh->free_bytes &&
+         nlive == rh->live;
+    xSemaphoreGive(rh->lock);
+    return ok;
+}
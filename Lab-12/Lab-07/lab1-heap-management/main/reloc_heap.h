@@ -0,0 +1,105 @@
+#ifndef RELOC_HEAP_H
+#define RELOC_HEAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef RHEAP_SCAN_BATCH
+#define RHEAP_SCAN_BATCH 32 // block ที่ compaction เดินผ่านได้ต่อครั้งที่ถือ lock (ถ้ายังไม่เจอสิ่งที่ต้องย้าย)
+#endif
+
+/* ======================
+ * Relocatable heap (handle-based)
+ * ======================
+ * ผู้ใช้ถือ handle ไม่ใช่ pointer: ต้อง pin เพื่อได้ pointer แล้ว unpin เมื่อเลิกใช้
+ * block ที่ไม่ถูก pin ย้ายได้ → compaction เลื่อน block ที่ใช้อยู่ลงไปทับช่องว่างข้างหน้า
+ * (sliding ทีละ block) จนช่องว่างทั้งหมดไปรวมกันท้าย region = largest free block กลับมาโดยไม่ต้องรีบูต
+ *
+ * - region ต่อเนื่องก้อนเดียว (จองตอน init), header 8 byte ต่อ block, free block มี footer → รวมซ้าย/ขวาทันที
+ * - compaction เป็น incremental: rheap_compact(budget_us) ทำทีละขั้น (ย้าย 1 block ต่อขั้น) แล้วหยุดเมื่อหมดเวลา
+ *   cursor จำตำแหน่งไว้ เรียกครั้งถัดไปทำต่อจากเดิม
+ * - pointer ที่ได้จาก pin ใช้ได้จนกว่าจะ unpin เท่านั้น (หลังจากนั้น block อาจถูกย้าย)
+ * - lock เป็น mutex (memmove ระหว่างย้ายยาวเกินกว่าจะปิด interrupt)
+ */
+typedef uint32_t rheap_handle_t; // (gen << 16) | (slot + 1), 0 = ไม่ถูกต้อง
+#define RHEAP_INVALID 0u
+
+typedef struct
+{
+    void *ptr;     // payload ปัจจุบัน (NULL = slot ว่าง)
+    uint32_t size; // ขนาดที่ขอ (slot ว่าง: index + 1 ของ slot ว่างถัดไป)
+    uint16_t pins;
+    uint16_t gen; // เพิ่มทุกครั้งที่ slot ถูกคืน → handle เก่าใช้ไม่ได้
+} rheap_slot_t;
+
+typedef struct
+{
+    void *mem;      // ที่ได้จาก heap_caps_malloc (base = mem ปัดขึ้นให้ align 8)
+    uint8_t *base;
+    uint8_t *end;
+    size_t cap;
+    uint32_t caps;
+    void *free_head; // free list (LIFO)
+    size_t free_bytes;
+    uint32_t free_blocks;
+    uint8_t *cursor; // ตำแหน่งของ compaction รอบปัจจุบัน
+    rheap_slot_t *slots;
+    uint16_t nslots;
+    uint16_t slot_free; // index + 1 ของ slot ว่างตัวแรก
+    uint16_t live;
+    SemaphoreHandle_t lock;
+    uint32_t moves;
+    uint64_t bytes_moved;
+    uint32_t passes;       // compaction ครบรอบ (cursor ถึงท้าย region)
+    uint32_t pinned_skips; // เจอ block ที่ถูก pin ระหว่าง compact
+    uint32_t alloc_fails;
+    uint32_t sync_compacts; // alloc ไม่เจอช่องพอดีแต่ free รวมพอ → compact ทันทีแล้วลองใหม่
+} rheap_t;
+
+typedef struct
+{
+    size_t cap;
+    size_t free_bytes;
+    size_t largest_free; // payload ใหญ่สุดที่ alloc ได้ตอนนี้
+    uint32_t free_blocks;
+    uint32_t live;
+    uint32_t pinned;
+    float fragmentation; // 1 - largest/free
+    uint32_t moves;
+    uint64_t bytes_moved;
+    uint32_t passes;
+    uint32_t pinned_skips;
+    uint32_t alloc_fails;
+    uint32_t sync_compacts;
+} rheap_stats_t;
+
+// region bytes จาก caps, รองรับ handle พร้อมกันสูงสุด max_handles
+int rheap_init(rheap_t *rh, size_t bytes, uint16_t max_handles, uint32_t caps);
+void rheap_destroy(rheap_t *rh);
+
+// RHEAP_INVALID = ไม่มีที่ (แม้หลัง compact แล้ว) หรือ handle เต็ม
+rheap_handle_t rheap_alloc(rheap_t *rh, size_t size);
+// block ที่ยังถูก pin อยู่จะไม่ถูกคืน (คืน false)
+bool rheap_free(rheap_t *rh, rheap_handle_t h);
+
+void *rheap_pin(rheap_t *rh, rheap_handle_t h);
+void rheap_unpin(rheap_t *rh, rheap_handle_t h);
+size_t rheap_size(rheap_t *rh, rheap_handle_t h);
+
+// ทำ compaction ต่อจาก cursor จนหมดเวลา budget_us หรือครบรอบ
+// true = ครบรอบแล้ว (ทุกช่องว่างที่ย้ายได้ถูกเลื่อนไปท้ายแล้ว), *moved = จำนวน block ที่ย้ายในครั้งนี้ (NULL ได้)
+// ย้ายทีละ 1 block ต่อการถือ lock → block ใหญ่หนึ่งก้อนอาจทำให้เกิน budget ได้เท่าเวลา memmove ของมัน
+bool rheap_compact(rheap_t *rh, uint32_t budget_us, uint32_t *moved);
+
+void rheap_get_stats(rheap_t *rh, rheap_stats_t *out);
+// เดินทุก block ตรวจ header/footer/flag และ pointer ใน handle table — O(n), ใช้ตอน debug/bench
+bool rheap_check(rheap_t *rh);
+
+#endif // RELOC_HEAP_H
@@ -0,0 +1,124 @@
+// ===== Host bench: thread cache (magazine) vs เข้า pool ตรง =====
+// build/run จาก lab2-memory-pools/ (ESP-IDF/FreeRTOS จำลองด้วย pthread ใน host_test/shim):
+//   C=../components; gcc -std=gnu11 -O2 -pthread -Ihost_test/shim -Imain -I$C/mem_ownmap/include -I$C/tlsf/include
+//     host_test/bench_pool_tcache.c host_test/shim/idf_shim.c main/pool_*.c $C/mem_ownmap/mem_ownmap.c $C/tlsf/tlsf.c
+//     -o /tmp/bench_tcache && /tmp/bench_tcache
+//   (ต่อสามบรรทัดนี้เป็นคำสั่งเดียว)
+//
+// แต่ละ thread (= task) ทำ alloc/free กับ Small pool สองแบบ:
+//   pair  : alloc แล้ว free ทันที (ทางที่ cache ควร hit เกือบทุกครั้ง)
+//   burst : alloc BURST ก้อนแล้ว free ทั้งหมด (เกิน magazine ครึ่งหนึ่ง → มี refill/flush)
+// เทียบ pool_malloc/pool_free (ถือ lock ของ pool ทุกครั้ง) กับ pool_class_malloc/pool_class_free (ผ่าน cache)
+// ที่ 1/2/4 thread; ตัวเลขเป็น ns ต่อ alloc+free หนึ่งคู่ (เฉลี่ยของทุก thread)
+
+#define app_main lab2_app_main
+#include "lab2-memory-pools.c"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+int idf_shim_start_task(TaskFunction_t fn, void *arg, int core, pthread_t *out);
+
+#define BENCH_ITERS 200000
+#define BENCH_BURST 8
+#define BENCH_MAX_THREADS 4
+
+typedef struct
+{
+    bool cached;
+    bool burst;
+    pthread_barrier_t *start;
+    uint64_t ns;
+    uint32_t failures;
+} bench_arg_t;
+
+static void *bench_alloc(bool cached)
+{
+    return cached ? pool_class_malloc(POOL_SMALL) : pool_malloc(&pools[POOL_SMALL]);
+}
+
+static void bench_free(bool cached, void *p)
+{
+    if (cached)
+        pool_class_free(POOL_SMALL, p);
+    else
+        pool_free(&pools[POOL_SMALL], p);
+}
+
+static void bench_worker(void *arg)
+{
+    bench_arg_t *a = arg;
+    void *held[BENCH_BURST];
+    const int rounds = a->burst ? BENCH_ITERS / BENCH_BURST : BENCH_ITERS;
+    const int n = a->burst ? BENCH_BURST : 1;
+
+    pthread_barrier_wait(a->start);
+    int64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            held[i] = bench_alloc(a->cached);
+            a->failures += !held[i];
+        }
+        for (int i = 0; i < n; i++)
+            if (held[i])
+                bench_free(a->cached, held[i]);
+    }
+    a->ns = (uint64_t)(esp_timer_get_time() - t0) * 1000ULL / ((uint64_t)rounds * n);
+    if (a->cached)
+        pool_tcache_drain(); // ที่เหลือใน magazine กลับ pool ก่อน thread จบ
+}
+
+static uint64_t bench_run(int threads, bool cached, bool burst, uint32_t *failures)
+{
+    pthread_t tid[BENCH_MAX_THREADS];
+    bench_arg_t args[BENCH_MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)threads);
+    for (int i = 0; i < threads; i++)
+    {
+        args[i] = (bench_arg_t){.cached = cached, .burst = burst, .start = &start};
+        if (idf_shim_start_task(bench_worker, &args[i], i, &tid[i]) != 0)
+        {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(1);
+        }
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tid[i], NULL);
+        sum += args[i].ns;
+        *failures += args[i].failures;
+    }
+    pthread_barrier_destroy(&start);
+    return sum / (uint64_t)threads;
+}
+
+int main(void)
+{
+    lab2_app_main(); // init pool ทั้งหมดตามค่า default (NVS ของ shim ว่าง)
+
+    static const int thread_counts[] = {1, 2, BENCH_MAX_THREADS};
+    printf("\n%-8s %-6s %12s %12s %8s\n", "threads", "mode", "direct ns", "tcache ns", "speedup");
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        for (int burst = 0; burst <= 1; burst++)
+        {
+            uint32_t failures = 0;
+            uint64_t direct = bench_run(thread_counts[t], false, burst, &failures);
+            uint64_t cached = bench_run(thread_counts[t], true, burst, &failures);
+            printf("%-8d %-6s %12llu %12llu %7.2fx", thread_counts[t], burst ? "burst" : "pair",
+                   (unsigned long long)direct, (unsigned long long)cached,
+                   cached ? (double)direct / (double)cached : 0.0);
+            if (failures)
+                printf("  (%lu alloc failures)", (unsigned long)failures);
+            printf("\n");
+        }
+    }
+
+    // hits/refills/flushes ของ cache จากทุกรอบข้างบน
+    print_pool_statistics();
+    return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+// ===== Host shim: FreeRTOS เท่าที่ lab2 ใช้ (task = pthread, ดู idf_shim.c) =====
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef void (*TlsDeleteCallbackFunction_t)(int, void *);
+
+typedef struct
+{
+    volatile uint32_t owner;
+    volatile uint32_t count;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 10
+#define configTICK_RATE_HZ 100
+#define portNUM_PROCESSORS 2
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 2
+#define CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)((ms) / portTICK_PERIOD_MS))
+#define configASSERT(x) ((void)(x))
+
+void portENTER_CRITICAL(portMUX_TYPE *m);
+void portEXIT_CRITICAL(portMUX_TYPE *m);
+#define portENTER_CRITICAL_ISR(m) portENTER_CRITICAL(m)
+#define portEXIT_CRITICAL_ISR(m) portEXIT_CRITICAL(m)
+#define taskENTER_CRITICAL(m) portENTER_CRITICAL(m)
+#define taskEXIT_CRITICAL(m) portEXIT_CRITICAL(m)
+#define taskENTER_CRITICAL_ISR(m) portENTER_CRITICAL(m)
+#define taskEXIT_CRITICAL_ISR(m) portEXIT_CRITICAL(m)
+#define portMUX_INITIALIZE(m) (*(m) = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED)
+
+BaseType_t xPortGetCoreID(void);
+BaseType_t xPortInIsrContext(void);
@@ -0,0 +1,18 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core);
+void vTaskDelete(TaskHandle_t t);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void taskYIELD(void);
+const char *pcTaskGetName(TaskHandle_t t);
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t t, BaseType_t index);
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t t, BaseType_t index, void *value);
+void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t t, BaseType_t index, void *value,
+                                                     TlsDeleteCallbackFunction_t cb);
@@ -0,0 +1,354 @@
+// ===== Host shim: ESP-IDF/FreeRTOS runtime บน pthread =====
+// พอให้ lab2-memory-pools.c รันบนเครื่อง dev ได้ (ใช้กับ host_test/bench_*.c):
+// - task = pthread, TLS pointer ต่อ thread + deletion callback ตอน thread จบ (เหมือน vTaskDelete)
+// - portMUX = spinlock แบบ recursive, mutex/semaphore = pthread mutex + cond
+// - heap_caps_* ตัดจาก region ใต้ 4 GB (ownership map ใช้ address 32 บิต) และไม่คืน memory
+// - NVS ว่างเสมอ → pool บูตด้วยค่า default; task ที่ app_main สร้างไม่ถูกรัน
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "driver/gpio.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+/* ===== heap ===== */
+#define SHIM_HEAP_BYTES (256u << 20)
+
+static pthread_mutex_t s_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t *s_heap;
+static size_t s_heap_off;
+
+void *heap_caps_aligned_alloc(size_t align, size_t size, uint32_t caps)
+{
+    (void)caps;
+    if (align < 16)
+        align = 16;
+    pthread_mutex_lock(&s_heap_lock);
+    if (!s_heap)
+    {
+        void *m = mmap(NULL, SHIM_HEAP_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+        s_heap = (m == MAP_FAILED) ? NULL : m;
+    }
+    void *p = NULL;
+    if (s_heap)
+    {
+        size_t off = (s_heap_off + sizeof(size_t) + align - 1) & ~(align - 1);
+        if (off + size <= SHIM_HEAP_BYTES)
+        {
+            p = s_heap + off;
+            ((size_t *)p)[-1] = size; // realloc ต้องรู้ขนาดเดิม
+            s_heap_off = off + size;
+        }
+    }
+    pthread_mutex_unlock(&s_heap_lock);
+    return p;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) { return heap_caps_aligned_alloc(16, size, caps); }
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    void *p = heap_caps_malloc(n * size, caps);
+    if (p)
+        memset(p, 0, n * size);
+    return p;
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+    void *p = heap_caps_malloc(size, caps);
+    if (p && ptr)
+    {
+        size_t old = ((size_t *)ptr)[-1];
+        memcpy(p, ptr, old < size ? old : size);
+    }
+    return p;
+}
+
+void heap_caps_free(void *ptr) { (void)ptr; }
+void heap_caps_aligned_free(void *ptr) { (void)ptr; }
+size_t heap_caps_get_allocated_size(void *ptr) { return ((size_t *)ptr)[-1]; }
+size_t heap_caps_get_free_size(uint32_t caps) { return SHIM_HEAP_BYTES - s_heap_off; }
+size_t heap_caps_get_largest_free_block(uint32_t caps) { return SHIM_HEAP_BYTES - s_heap_off; }
+size_t heap_caps_get_minimum_free_size(uint32_t caps) { return SHIM_HEAP_BYTES - s_heap_off; }
+size_t heap_caps_get_total_size(uint32_t caps) { return SHIM_HEAP_BYTES; }
+bool heap_caps_check_integrity_all(bool print_errors) { return true; }
+uint32_t esp_get_free_heap_size(void) { return (uint32_t)(SHIM_HEAP_BYTES - s_heap_off); }
+uint32_t esp_get_minimum_free_heap_size(void) { return esp_get_free_heap_size(); }
+
+/* ===== time ===== */
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t esp_timer_get_time(void) { return now_ns() / 1000; }
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) { return (esp_cpu_cycle_count_t)now_ns(); } // 1 "cycle" = 1 ns
+uint32_t esp_rom_get_cpu_ticks_per_us(void) { return 1000; }
+TickType_t xTaskGetTickCount(void) { return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS); }
+void vTaskDelay(TickType_t ticks) { usleep((useconds_t)ticks * portTICK_PERIOD_MS * 1000); }
+void taskYIELD(void) { sched_yield(); }
+
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t ticks)
+{
+    *prev_wake += ticks;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*prev_wake - now) > 0)
+        vTaskDelay(*prev_wake - now);
+}
+
+/* ===== critical section (portMUX) ===== */
+static __thread uint8_t t_self; // address ใช้เป็น id ของ thread
+
+void portENTER_CRITICAL(portMUX_TYPE *m)
+{
+    uint32_t me = (uint32_t)(uintptr_t)&t_self | 1u;
+    if (__atomic_load_n(&m->owner, __ATOMIC_RELAXED) == me)
+    {
+        m->count++;
+        return;
+    }
+    uint32_t free_ = 0;
+    while (!__atomic_compare_exchange_n(&m->owner, &free_, me, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        free_ = 0;
+        sched_yield();
+    }
+    m->count = 1;
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *m)
+{
+    if (--m->count == 0)
+        __atomic_store_n(&m->owner, 0, __ATOMIC_RELEASE);
+}
+
+BaseType_t xPortInIsrContext(void) { return pdFALSE; }
+
+/* ===== tasks ===== */
+typedef struct
+{
+    void *tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+    TlsDeleteCallbackFunction_t del[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+    int core;
+} shim_task_t;
+
+static __thread shim_task_t t_task;
+static pthread_key_t s_exit_key;
+static pthread_once_t s_exit_once = PTHREAD_ONCE_INIT;
+
+// thread จบ = task ถูกลบ → เรียก deletion callback ของทุก slot
+static void task_exit(void *arg)
+{
+    shim_task_t *t = arg;
+    for (int i = 0; i < configNUM_THREAD_LOCAL_STORAGE_POINTERS; i++)
+        if (t->del[i] && t->tls[i])
+            t->del[i](i, t->tls[i]);
+}
+
+static void exit_key_init(void) { pthread_key_create(&s_exit_key, task_exit); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return &t_task; }
+BaseType_t xPortGetCoreID(void) { return t_task.core; }
+const char *pcTaskGetName(TaskHandle_t t) { return "host"; }
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t t, BaseType_t index)
+{
+    return ((shim_task_t *)(t ? t : &t_task))->tls[index];
+}
+
+void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t t, BaseType_t index, void *value,
+                                                     TlsDeleteCallbackFunction_t cb)
+{
+    shim_task_t *k = t ? t : &t_task;
+    k->tls[index] = value;
+    k->del[index] = cb;
+    pthread_once(&s_exit_once, exit_key_init);
+    pthread_setspecific(s_exit_key, k);
+}
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t t, BaseType_t index, void *value)
+{
+    vTaskSetThreadLocalStoragePointerAndDelCallback(t, index, value, NULL);
+}
+
+typedef struct
+{
+    TaskFunction_t fn;
+    void *arg;
+    int core;
+} shim_start_t;
+
+static void *task_entry(void *p)
+{
+    shim_start_t s = *(shim_start_t *)p;
+    free(p);
+    t_task.core = s.core;
+    s.fn(s.arg);
+    return NULL;
+}
+
+// bench สร้าง worker ผ่านตัวนี้โดยตรง (task ที่ app_main สร้างไม่ถูกรันบน host)
+int idf_shim_start_task(TaskFunction_t fn, void *arg, int core, pthread_t *out)
+{
+    shim_start_t *s = malloc(sizeof(*s));
+    if (!s)
+        return -1;
+    s->fn = fn;
+    s->arg = arg;
+    s->core = core % portNUM_PROCESSORS;
+    int rc = pthread_create(out, NULL, task_entry, s);
+    if (rc)
+        free(s);
+    return rc;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    if (out)
+        *out = NULL;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, out, 0);
+}
+
+void vTaskDelete(TaskHandle_t t)
+{
+    if (!t)
+        pthread_exit(NULL);
+}
+
+/* ===== semaphores ===== */
+typedef struct
+{
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    UBaseType_t count, max;
+    TaskHandle_t holder;
+} shim_sem_t;
+
+static SemaphoreHandle_t sem_new(UBaseType_t max, UBaseType_t initial)
+{
+    shim_sem_t *s = calloc(1, sizeof(*s));
+    if (!s)
+        return NULL;
+    pthread_mutex_init(&s->mu, NULL);
+    pthread_cond_init(&s->cv, NULL);
+    s->count = initial;
+    s->max = max;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return sem_new(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return sem_new(1, 0); }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) { return sem_new(max, initial); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t h, TickType_t ticks)
+{
+    shim_sem_t *s = h;
+    pthread_mutex_lock(&s->mu);
+    if (ticks == portMAX_DELAY)
+    {
+        while (!s->count)
+            pthread_cond_wait(&s->cv, &s->mu);
+    }
+    else if (!s->count && ticks)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        int64_t ns = ts.tv_nsec + (int64_t)ticks * portTICK_PERIOD_MS * 1000000LL;
+        ts.tv_sec += ns / 1000000000LL;
+        ts.tv_nsec = ns % 1000000000LL;
+        while (!s->count && pthread_cond_timedwait(&s->cv, &s->mu, &ts) == 0)
+        {
+        }
+    }
+    BaseType_t ok = s->count ? pdTRUE : pdFALSE;
+    if (ok)
+    {
+        s->count--;
+        s->holder = xTaskGetCurrentTaskHandle();
+    }
+    pthread_mutex_unlock(&s->mu);
+    return ok;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t h)
+{
+    shim_sem_t *s = h;
+    pthread_mutex_lock(&s->mu);
+    BaseType_t ok = s->count < s->max ? pdTRUE : pdFALSE;
+    if (ok)
+    {
+        s->count++;
+        s->holder = NULL;
+        pthread_cond_signal(&s->cv);
+    }
+    pthread_mutex_unlock(&s->mu);
+    return ok;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t h) { return ((shim_sem_t *)h)->holder; }
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t h)
+{
+    shim_sem_t *s = h;
+    pthread_mutex_lock(&s->mu);
+    UBaseType_t n = s->count;
+    pthread_mutex_unlock(&s->mu);
+    return n;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t h)
+{
+    shim_sem_t *s = h;
+    pthread_mutex_destroy(&s->mu);
+    pthread_cond_destroy(&s->cv);
+    free(s);
+}
+
+/* ===== GPIO / NVS / misc ===== */
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode) { return ESP_OK; }
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) { return ESP_OK; }
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+esp_err_t nvs_flash_erase(void) { return ESP_OK; }
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    *out = 1;
+    return ESP_OK;
+}
+void nvs_close(nvs_handle_t h) {}
+esp_err_t nvs_commit(nvs_handle_t h) { return ESP_OK; }
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t v) { return ESP_OK; }
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *v) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t v) { return ESP_OK; }
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *v) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_u64(nvs_handle_t h, const char *key, uint64_t v) { return ESP_OK; }
+esp_err_t nvs_get_u64(nvs_handle_t h, const char *key, uint64_t *v) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *v, size_t len) { return ESP_OK; }
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *v, size_t *len) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key) { return ESP_OK; }
+
+const char *esp_err_to_name(esp_err_t e) { return e == ESP_OK ? "ESP_OK" : "ESP_FAIL"; }
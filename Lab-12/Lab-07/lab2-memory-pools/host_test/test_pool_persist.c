@@ -0,0 +1,230 @@
+// ===== Host test: pool_persist (ไม่ต้องมี ESP-IDF) =====
+// build/run จาก lab2-memory-pools/:
+//   gcc -std=gnu11 -Wall -Imain host_test/test_pool_persist.c main/pool_persist.c main/pool_hist.c -o /tmp/tpp && /tmp/tpp
+//
+// ครอบคลุม: encode กรณีค่าใหญ่สุด, เลือก slot ที่ seq ใหม่สุด (รวม seq วนรอบ),
+//           torn write ของ slot ล่าสุด → ถอยไป slot เก่า และเขียนครั้งถัดไปทับ slot ที่เสีย
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pool_persist.h"
+
+#define NCH 4
+
+// ตรวจผลแบบไม่ขึ้นกับ NDEBUG (assert หายไปทั้งบรรทัดเมื่อ build แบบ release)
+// ฟังก์ชันที่มี side effect ให้เรียกก่อนแล้วค่อยส่งผลเข้า CHECK
+#define CHECK(cond)                                                                  \
+    do                                                                               \
+    {                                                                                \
+        if (!(cond))                                                                 \
+        {                                                                            \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+static uint64_t s_now;
+static uint64_t fake_clock(void) { return s_now; }
+
+static pool_persist_rec_t s_cur[NCH];
+static void fetch_cur(void *arg, pool_persist_rec_t *out, uint32_t n)
+{
+    (void)arg;
+    memcpy(out, s_cur, n * sizeof(*out));
+}
+
+static char s_dir[64];
+
+static void slot_path(const char *key, char *out, size_t cap) { snprintf(out, cap, "%s/%s.bin", s_dir, key); }
+
+static long slot_size(const char *key)
+{
+    char path[128];
+    slot_path(key, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    CHECK(fp);
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fclose(fp);
+    return n;
+}
+
+// จำลองไฟดับกลางการเขียน: เหลือแค่ n byte แรก
+static void slot_truncate(const char *key, long n)
+{
+    char path[128];
+    slot_path(key, path, sizeof(path));
+    int rc = truncate(path, n);
+    if (rc != 0)
+    {
+        perror("truncate");
+        exit(1);
+    }
+}
+
+static void slot_flip_byte(const char *key, long off)
+{
+    char path[128];
+    slot_path(key, path, sizeof(path));
+    FILE *fp = fopen(path, "r+b");
+    CHECK(fp);
+    fseek(fp, off, SEEK_SET);
+    int c = fgetc(fp);
+    fseek(fp, off, SEEK_SET);
+    fputc(c ^ 0xFF, fp);
+    fclose(fp);
+}
+
+static void expect_loaded(const pool_persist_rec_t *ld)
+{
+    for (int i = 0; i < NCH; i++)
+    {
+        CHECK(ld[i].block_count == s_cur[i].block_count);
+        CHECK(ld[i].peak_usage == s_cur[i].peak_usage);
+        CHECK(ld[i].allocation_failures == s_cur[i].allocation_failures);
+        CHECK(ld[i].total_allocations == s_cur[i].total_allocations);
+        CHECK(ld[i].total_deallocations == s_cur[i].total_deallocations);
+    }
+}
+
+static void test_worst_case_encode(void)
+{
+    pool_persist_rec_t recs[POOL_PERSIST_MAX_CHANNELS];
+    for (int i = 0; i < POOL_PERSIST_MAX_CHANNELS; i++)
+    {
+        recs[i].block_count = recs[i].peak_usage = recs[i].allocation_failures = UINT32_MAX;
+        recs[i].total_allocations = UINT64_MAX;
+        recs[i].total_deallocations = INT64_MAX; // ส่วนต่าง = INT64_MIN → zigzag 10 byte
+    }
+    uint8_t buf[POOL_PERSIST_SLOT_MAX + 8];
+    memset(buf, 0xA5, sizeof(buf));
+    size_t len = pool_persist_encode(buf, POOL_PERSIST_SLOT_MAX, 1, recs, POOL_PERSIST_MAX_CHANNELS);
+    CHECK(len == POOL_PERSIST_SLOT_MAX);
+    for (size_t i = POOL_PERSIST_SLOT_MAX; i < sizeof(buf); i++)
+        CHECK(buf[i] == 0xA5); // ไม่เขียนเลยขอบ
+
+    pool_persist_rec_t back[POOL_PERSIST_MAX_CHANNELS];
+    uint32_t seq;
+    bool ok = pool_persist_decode(buf, len, &seq, back, POOL_PERSIST_MAX_CHANNELS);
+    CHECK(ok);
+    CHECK(seq == 1);
+    for (int i = 0; i < POOL_PERSIST_MAX_CHANNELS; i++)
+    {
+        CHECK(back[i].block_count == UINT32_MAX && back[i].allocation_failures == UINT32_MAX);
+        CHECK(back[i].total_allocations == UINT64_MAX && back[i].total_deallocations == INT64_MAX);
+    }
+
+    // buffer เล็กกว่ากรณีแย่สุด → ปฏิเสธ ไม่เขียนล้น
+    len = pool_persist_encode(buf, POOL_PERSIST_SLOT_MAX - 1, 1, recs, POOL_PERSIST_MAX_CHANNELS);
+    CHECK(len == 0);
+}
+
+static void test_slot_selection_and_torn_write(void)
+{
+    pool_persist_file_t f = {s_dir, 0};
+    pool_persist_backend_t be;
+    pool_persist_file_backend(&be, &f);
+
+    pool_persist_t p, q;
+    pool_persist_rec_t ld[NCH];
+    pool_persist_init(&p, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    bool ok = pool_persist_load(&p, ld);
+    CHECK(!ok); // ยังไม่มี slot
+
+    // เขียนสลับ A/B สามครั้ง → slot ล่าสุดคือ A (seq 3)
+    for (int i = 1; i <= 3; i++)
+    {
+        s_cur[0].total_allocations = 100u * i;
+        s_cur[0].total_deallocations = 90u * i;
+        s_cur[1].peak_usage = (uint32_t)i;
+        pool_persist_touch(&p, 0);
+        int n = pool_persist_flush(&p, fetch_cur, NULL);
+        CHECK(n == 1);
+    }
+    CHECK(f.writes == 3 && p.seq == 3);
+
+    pool_persist_init(&q, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    ok = pool_persist_load(&q, ld);
+    CHECK(ok && q.seq == 3 && q.next_slot == 1);
+    expect_loaded(ld);
+
+    // torn write: slot A เหลือครึ่งเดียว → โหลดได้ B (seq 2)
+    slot_truncate("a", slot_size("a") / 2);
+    pool_persist_init(&q, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    ok = pool_persist_load(&q, ld);
+    CHECK(ok && q.seq == 2 && ld[1].peak_usage == 2);
+
+    // ครั้งถัดไปต้องเขียนทับ slot ที่เสีย (A) ไม่ใช่ slot ดีตัวเดียวที่เหลือ
+    CHECK(q.next_slot == 0);
+    s_cur[2].allocation_failures = 7;
+    pool_persist_touch(&q, 2);
+    int n = pool_persist_flush(&q, fetch_cur, NULL);
+    CHECK(n == 1);
+    pool_persist_init(&p, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    ok = pool_persist_load(&p, ld);
+    CHECK(ok && p.seq == 3 && p.next_slot == 1);
+    expect_loaded(ld);
+
+    // checksum เสีย (byte ใน payload) ก็ถอยเหมือนกัน
+    slot_flip_byte("a", POOL_PERSIST_HDR_SIZE + 1);
+    pool_persist_init(&q, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    ok = pool_persist_load(&q, ld);
+    CHECK(ok && q.seq == 2);
+
+    // ทั้งสอง slot เสีย → ไม่มีอะไรให้โหลด
+    slot_truncate("b", 3);
+    pool_persist_init(&q, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    ok = pool_persist_load(&q, ld);
+    CHECK(!ok);
+}
+
+static void test_seq_wraparound(void)
+{
+    pool_persist_file_t f = {s_dir, 0};
+    pool_persist_backend_t be;
+    pool_persist_file_backend(&be, &f);
+
+    pool_persist_t p;
+    pool_persist_rec_t ld[NCH];
+    pool_persist_init(&p, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    p.seq = UINT32_MAX - 1; // slot ถัดไปได้ seq 0xFFFFFFFF แล้ววนเป็น 0
+    for (int i = 0; i < 2; i++)
+    {
+        s_cur[3].block_count = 10u + (uint32_t)i;
+        pool_persist_touch(&p, 3);
+        int n = pool_persist_flush(&p, fetch_cur, NULL);
+        CHECK(n == 1);
+    }
+    CHECK(p.seq == 0);
+
+    pool_persist_t q;
+    pool_persist_init(&q, &be, "a", "b", NCH, POOL_PERSIST_BURST_BYTES, fake_clock);
+    bool ok = pool_persist_load(&q, ld);
+    CHECK(ok && q.seq == 0 && ld[3].block_count == 11);
+}
+
+int main(void)
+{
+    snprintf(s_dir, sizeof(s_dir), "/tmp/pool_persist_XXXXXX");
+    if (!mkdtemp(s_dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    test_worst_case_encode();
+    test_slot_selection_and_torn_write();
+    test_seq_wraparound();
+
+    char path[128];
+    slot_path("a", path, sizeof(path));
+    remove(path);
+    slot_path("b", path, sizeof(path));
+    remove(path);
+    rmdir(s_dir);
+    printf("pool_persist: all tests passed\n");
+    return 0;
+}
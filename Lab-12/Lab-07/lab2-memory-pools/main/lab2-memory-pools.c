@@ -7,6 +7,8 @@
 #include "esp_heap_caps.h"
 #include "esp_timer.h"
 #include "esp_system.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
 #include "driver/gpio.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -25,14 +27,51 @@ static const char *TAG = "MEM_POOLS";
 // ============================
 //     Pool configuration (defaults)
 // ============================
+// pool_sizeclass_gen.h = header ที่ได้จาก "SCGEN|" ใน log (profile จากเครื่องจริง) ถ้ามีจะใช้แทนค่าข้างล่าง
+// ลำดับตอนบูต: blob "sc_cfg" ใน NVS > header ที่ generate > ค่า default
+#if defined(__has_include)
+#if __has_include("pool_sizeclass_gen.h")
+#include "pool_sizeclass_gen.h"
+#endif
+#endif
+#ifndef SMALL_POOL_BLOCK_SIZE
 #define SMALL_POOL_BLOCK_SIZE 64
 #define SMALL_POOL_BLOCK_COUNT 64
+#endif
+#ifndef MEDIUM_POOL_BLOCK_SIZE
 #define MEDIUM_POOL_BLOCK_SIZE 256
 #define MEDIUM_POOL_BLOCK_COUNT 32
+#endif
+#ifndef LARGE_POOL_BLOCK_SIZE
 #define LARGE_POOL_BLOCK_SIZE 1024
 #define LARGE_POOL_BLOCK_COUNT 24
+#endif
+#ifndef HUGE_POOL_BLOCK_SIZE
 #define HUGE_POOL_BLOCK_SIZE 4096
 #define HUGE_POOL_BLOCK_COUNT 8
+#endif
+
+// Profile-guided size classes (ดู pool_sizeclass.h)
+#ifndef POOL_SC_PROFILE
+#define POOL_SC_PROFILE 1 // เก็บ histogram ขนาดที่ขอผ่าน smart_pool_malloc
+#endif
+#ifndef POOL_SC_BUDGET_BYTES
+#define POOL_SC_BUDGET_BYTES 0 // memory รวมของ pool ที่ generator ต้องไม่เกิน (0 = เท่าที่ใช้อยู่ตอนนี้)
+#endif
+#ifndef POOL_SC_MAX_WASTE_PPM
+#define POOL_SC_MAX_WASTE_PPM 150000 // waste ภายใน block ที่ยอมรับ (15%)
+#endif
+#ifndef POOL_SC_REPORT_EVERY
+#define POOL_SC_REPORT_EVERY 12 // รายงานทุก N รอบ monitor (5s × 12 = 1 นาที)
+#endif
+#ifndef POOL_SC_AUTO_APPLY
+#define POOL_SC_AUTO_APPLY 0 // 1 = บันทึก config ที่ดีกว่าลง NVS ให้บูตถัดไปใช้เอง
+#endif
+
+// Fallback ของคำขอที่ไม่มี pool รับ: TLSF บน region ที่จองไว้ตอนบูต (เวลาคงที่) ก่อน heap_caps_malloc
+#ifndef POOL_TLSF_BYTES
+#define POOL_TLSF_BYTES (32 * 1024) // 0 = ตกไป heap_caps_malloc ตรง ๆ แบบเดิม
+#endif
 
 // ============================
 //     Pool & Sync Structs
@@ -46,7 +85,35 @@ typedef struct memory_block
     size_t size_used; // ขนาดข้อมูลจริงที่ผู้ใช้ใช้ (ช่วยเรื่อง migrate/realloc)
 } memory_block_t;
 
+// compact mode: metadata ต่อ block อยู่ใน side arrays แทน header
+typedef struct
+{
+    uint16_t *used;  // size_used ต่อ block (NULL = ไม่เก็บ)
+    uint32_t *ts;    // alloc time (ms) สุ่มเก็บทุก POOL_COMPACT_TS_EVERY block
+    uint32_t *magic; // debug layer: magic ต่อ block
+    uint32_t *cached; // ไม่มี magic: 1 bit ต่อ block = อยู่ใน magazine ของ tcache (จับ double free)
+} pool_meta_arrays_t;
+
+// extent = memory ต่อเนื่องหนึ่งก้อนของ pool (extent 0 = ก้อนตอนบูต, ที่เหลือเพิ่มตอน runtime)
+typedef struct
+{
+    uint8_t *mem;
+    size_t count;            // block ใน extent นี้
+    pool_meta_arrays_t meta; // side arrays ของ extent นี้ (compact mode)
+    int own_id;              // region id ใน ownership map
+} pool_extent_t;
+
+#ifndef POOL_MAX_EXTENTS
+#define POOL_MAX_EXTENTS 4
+#endif
+
 #include "pool_sync.h" // ต้องมี pool_sync_t + SYNC_TIMEOUT_MS + ฟังก์ชัน lock ต่าง ๆ
+#include "pool_telemetry.h"
+#include "pool_hist.h"
+#include "pool_persist.h"
+#include "pool_sizeclass.h"
+#include "mem_ownmap.h" // components/mem_ownmap: pointer -> pool ใน O(1)
+#include "tlsf.h"       // components/tlsf: fallback allocator เวลาคงที่
 
 typedef struct
 {
@@ -56,21 +123,50 @@ typedef struct
     size_t alignment;
     uint32_t caps;
 
-    void *pool_memory;
-    memory_block_t *free_list;
-    uint8_t *usage_bitmap; // 1 bit ต่อ block
+    // extents: global index = (extent << ext_shift) | local index
+    pool_extent_t ext[POOL_MAX_EXTENTS];
+    uint8_t ext_count;  // extent ที่ใช้งาน (ต่อเนื่อง 0..ext_count-1) — block_count = ผลรวม
+    uint8_t ext_shift;  // >= 5: แต่ละ extent ได้ bitmap word ของตัวเอง
+    size_t ext_blocks;  // ขนาด extent ที่เพิ่มตอน runtime
+
+    bool compact;          // true = ไม่มี header หน้า payload (ดู pool_meta_*)
+    size_t hdr_size;       // sizeof(memory_block_t) หรือ 0 เมื่อ compact
+    size_t block_stride;   // header + payload (aligned) ต่อ block
+    uint32_t stride_recip; // ceil(2^32 / block_stride): offset -> index ด้วยการคูณแทนการหาร
+    uint32_t *usage_bitmap; // 1 bit ต่อ global index, index ที่ไม่มี block จริง = 1 เสมอ
+    size_t scan_hint;       // word แรกที่อาจมี block ว่าง (locked mode)
+
+    // growth/shrink policy (ดู pool_autosize_tick)
+    uint32_t grow_seen_failures;
+    size_t grow_seen_peak;
+    uint8_t shrink_idle;
+    uint32_t grows;
+    uint32_t shrinks;
+
+    // lock-free mode: free list แบบ tagged index [tag:16][index+1:16]
+    bool lockfree;
+    volatile uint32_t lf_head;
 
     // stats
     size_t allocated_blocks;
     size_t peak_usage;
     uint64_t total_allocations;
     uint64_t total_deallocations;
-    uint64_t allocation_time_total;
-    uint64_t deallocation_time_total;
+    pool_hist_t lat[POOL_HIST_KIND_COUNT]; // latency (us): alloc / free / รอ lock
     uint32_t allocation_failures;
+    uint32_t quarantined; // block ที่ magic เสีย ถูกกันไว้ (bit ค้างเป็น 1) ไม่แจกต่อ
+    uint64_t req_count; // ผ่าน smart_pool_malloc: ใช้วัด waste ภายใน block จริง
+    uint64_t req_bytes;
+
+    // thread cache stats
+    uint32_t tc_hits;
+    uint32_t tc_misses;
+    uint32_t tc_refills;
+    uint32_t tc_flushes;
 
     pool_sync_t sync;
     uint32_t pool_id;
+    bool no_persist; // pool ชั่วคราวของ bench: alloc/free ไม่ทำให้สถิติใน NVS dirty
 } memory_pool_t;
 
 typedef enum
@@ -87,6 +183,31 @@ static memory_pool_t pools[POOL_COUNT];
 // Magic numbers
 #define POOL_MAGIC_FREE 0xDEADBEEF
 #define POOL_MAGIC_ALLOC 0xCAFEBABE
+#define POOL_MAGIC_CACHED 0xC0FFEE00 // อยู่ใน magazine ของ tcache (ยังนับว่า allocated ใน bitmap)
+
+// Lock-free mode (CAS free list + ABA tag)
+#ifndef POOL_LOCKFREE_DEFAULT
+#define POOL_LOCKFREE_DEFAULT 0 // 1 = เปิด lock-free ให้ทุก pool ตั้งแต่บูต
+#endif
+#define LF_IDX_NONE 0u
+#define LF_MAX_BLOCKS 0xFFFEu // index+1 ต้องอยู่ใน 16 bit
+
+// Compact metadata mode: pool ขนาดเล็กตัด header 32 byte ทิ้ง (Small 64 byte = overhead 50%)
+#ifndef POOL_COMPACT_META
+#define POOL_COMPACT_META 1 // 0 = ทุก pool ใช้ header แบบเดิม
+#endif
+#ifndef POOL_COMPACT_MAX_BLOCK
+#define POOL_COMPACT_MAX_BLOCK 128 // pool ที่ block_size <= ค่านี้จะเป็น compact
+#endif
+#ifndef POOL_COMPACT_TRACK_SIZE
+#define POOL_COMPACT_TRACK_SIZE 1 // เก็บ size_used 16 bit ต่อ block (realloc ใช้)
+#endif
+#ifndef POOL_COMPACT_TS_EVERY
+#define POOL_COMPACT_TS_EVERY 8 // เก็บ alloc time 1 ใน N block (0 = ไม่เก็บ)
+#endif
+#ifndef POOL_COMPACT_DEBUG
+#define POOL_COMPACT_DEBUG 0 // 1 = เพิ่ม magic ต่อ block กลับมา (ตรวจ corruption/double free)
+#endif
 
 typedef struct
 {
@@ -108,38 +229,406 @@ static const pool_config_t POOL_DEFAULTS[POOL_COUNT] = {
 //    Persistence (NVS) config
 // ============================
 #define NVS_NS "mem_pools"
-#define SAVE_INTERVAL_MS 30000ULL // อัตโนมัติทุก ~30s หากมีการเปลี่ยนแปลง
+#define PERSIST_KEY_A "stats_a"
+#define PERSIST_KEY_B "stats_b"
+#define PERSIST_TICK_MS 1000 // รอบของ persist task (การเขียนจริงถูกคุมด้วย POOL_PERSIST_BUDGET_BPS)
 static nvs_handle_t g_nvs = 0;
 static bool g_nvs_ready = false;
-static uint64_t g_last_saved_stamp = 0;
-static uint32_t g_dirty_epoch = 1; // เพิ่มเมื่อ stats เปลี่ยน เพื่อ trigger save
+static pool_persist_t g_persist; // hot path แค่ตั้ง dirty bit ต่อ pool
+static pool_persist_rec_t g_persist_base[POOL_COUNT]; // ค่าสะสมจากบูตก่อน ๆ (บวกกับของรอบนี้ตอนเขียน)
+#define SC_CFG_KEY "sc_cfg"
 
 // ============================
 //       Helpers / inline
 // ============================
-static inline memory_block_t *data_to_block(void *data)
+// compact mode: memory_block_t * ชี้ต้น block แต่ใช้ได้แค่ ->next ตอน block ว่าง (ทับ payload)
+static inline memory_block_t *data_to_block(const memory_pool_t *pool, void *data)
 {
-    return (memory_block_t *)((uint8_t *)data - sizeof(memory_block_t));
+    return (memory_block_t *)((uint8_t *)data - pool->hdr_size);
 }
-static inline void *block_to_data(memory_block_t *blk)
+static inline void *block_to_data(const memory_pool_t *pool, memory_block_t *blk)
 {
-    return (void *)((uint8_t *)blk + sizeof(memory_block_t));
+    return (void *)((uint8_t *)blk + pool->hdr_size);
+}
+
+static inline size_t pool_calc_stride(size_t block_size, size_t alignment, size_t hdr_size)
+{
+    size_t aligned = (block_size + alignment - 1) & ~(alignment - 1);
+    return hdr_size + aligned;
+}
+
+static inline uint32_t pool_calc_recip(size_t stride)
+{
+    return (uint32_t)(0xFFFFFFFFu / stride + 1);
+}
+
+// offset ที่เป็นพหุคูณของ stride → index แม่นยำเสมอ (offset*ความคลาดเคลื่อน < 2^32 ภายใน pool)
+static inline size_t pool_off_to_index(const memory_pool_t *pool, size_t off)
+{
+    return (size_t)(((uint64_t)off * pool->stride_recip) >> 32);
+}
+
+static inline size_t pool_index_space(const memory_pool_t *pool)
+{
+    return (size_t)POOL_MAX_EXTENTS << pool->ext_shift;
+}
+
+static inline size_t pool_local_index(const memory_pool_t *pool, size_t idx)
+{
+    return idx & (((size_t)1 << pool->ext_shift) - 1);
+}
+
+static inline memory_block_t *pool_block_at(const memory_pool_t *pool, size_t idx)
+{
+    const pool_extent_t *x = &pool->ext[idx >> pool->ext_shift];
+    return (memory_block_t *)(x->mem + pool_local_index(pool, idx) * pool->block_stride);
+}
+
+// หา extent ที่ครอบ block (extent มีไม่กี่ก้อน → เดินเส้นตรง) คืน global index
+static inline bool pool_locate(const memory_pool_t *pool, const void *blkp, size_t *idx_out)
+{
+    uint8_t n = __atomic_load_n(&pool->ext_count, __ATOMIC_ACQUIRE);
+    for (uint8_t e = 0; e < n; e++)
+    {
+        const pool_extent_t *x = &pool->ext[e];
+        if ((const uint8_t *)blkp < x->mem)
+            continue;
+        size_t off = (size_t)((const uint8_t *)blkp - x->mem);
+        if (off >= x->count * pool->block_stride)
+            continue;
+        size_t local = pool_off_to_index(pool, off);
+        if (local * pool->block_stride != off)
+            return false;
+        *idx_out = ((size_t)e << pool->ext_shift) | local;
+        return true;
+    }
+    return false;
+}
+
+// ผู้เรียกต้องรู้อยู่แล้วว่า blk อยู่ใน pool นี้ (ตรวจผ่าน ptr_in_pool_range / ownership map มาแล้ว)
+static inline size_t pool_block_index(const memory_pool_t *pool, const memory_block_t *blk)
+{
+    size_t idx = 0;
+    pool_locate(pool, blk, &idx);
+    return idx;
 }
 
 static inline bool ptr_in_pool_range(const memory_pool_t *pool, const void *data_ptr)
 {
-    if (!pool || !pool->pool_memory || pool->block_count == 0 || !data_ptr)
+    size_t idx;
+    if (!pool || pool->ext_count == 0 || !data_ptr)
         return false;
+    return pool_locate(pool, (const uint8_t *)data_ptr - pool->hdr_size, &idx);
+}
+
+// ---- usage bitmap (word ละ 32 bit) ----
+static inline size_t bitmap_words(size_t bits) { return (bits + 31) / 32; }
+
+// เปิด/ปิดช่วง index ของ extent ใน bitmap (first ต้องลงตัว word, bit ที่เกิน count = 1 เสมอ)
+// → scan ไม่ต้องเช็คขอบ extent
+static void bitmap_open_window(uint32_t *bm, size_t first, size_t count)
+{
+    size_t w = first >> 5;
+    for (; count >= 32; count -= 32)
+        __atomic_store_n(&bm[w++], 0u, __ATOMIC_RELEASE);
+    if (count)
+        __atomic_store_n(&bm[w], ~((1u << count) - 1u), __ATOMIC_RELEASE);
+}
+
+// ปิด window คืน true ถ้าทุก block ใน window ว่าง (ถ้าไม่ว่างจะไม่แตะอะไร)
+static bool bitmap_close_window(uint32_t *bm, size_t first, size_t count)
+{
+    size_t w0 = first >> 5, nw = bitmap_words(count);
+    for (size_t i = 0; i < nw; i++)
+    {
+        size_t bits = (count - i * 32 >= 32) ? 32 : count - i * 32;
+        uint32_t mask = (bits == 32) ? 0xFFFFFFFFu : ((1u << bits) - 1u);
+        if (bm[w0 + i] & mask)
+            return false;
+    }
+    for (size_t i = 0; i < nw; i++)
+        bm[w0 + i] = 0xFFFFFFFFu;
+    return true;
+}
+
+static inline void bitmap_set(uint32_t *bm, size_t idx) { bm[idx >> 5] |= (1u << (idx & 31)); }
+static inline void bitmap_clear(uint32_t *bm, size_t idx) { bm[idx >> 5] &= ~(1u << (idx & 31)); }
+
+// ใช้ใน lock-free mode: S32C1I บน ESP32 รองรับ CAS 32 bit โดยตรง
+static inline void bitmap_set_atomic(uint32_t *bm, size_t idx)
+{
+    __atomic_fetch_or(&bm[idx >> 5], 1u << (idx & 31), __ATOMIC_RELAXED);
+}
+static inline void bitmap_clear_atomic(uint32_t *bm, size_t idx)
+{
+    __atomic_fetch_and(&bm[idx >> 5], ~(1u << (idx & 31)), __ATOMIC_RELAXED);
+}
+// คืน true ถ้า bit เคยเป็น 1 (= free ครั้งแรก)
+static inline bool bitmap_test_clear_atomic(uint32_t *bm, size_t idx)
+{
+    uint32_t bit = 1u << (idx & 31);
+    return (__atomic_fetch_and(&bm[idx >> 5], ~bit, __ATOMIC_ACQ_REL) & bit) != 0;
+}
+
+// ============================
+//   Block metadata (header หรือ side arrays)
+// ============================
+// full mode   : magic/pool_id/alloc_time/size_used อยู่ใน memory_block_t หน้า payload
+// compact mode: สถานะว่าง/ใช้อยู่ใน bitmap อย่างเดียว ที่เหลือเป็น side arrays (ถ้าเปิด)
+//               ไม่มี debug layer → magic เหลือแค่ bit "CACHED" ต่อ block, double free จับได้จาก bitmap + bit นี้
+static inline size_t pool_data_index(const memory_pool_t *pool, void *data)
+{
+    return pool_block_index(pool, data_to_block(pool, data));
+}
 
-    size_t header = sizeof(memory_block_t);
-    size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-    size_t total = header + aligned;
+static inline const pool_meta_arrays_t *pool_meta_of(const memory_pool_t *pool, size_t idx)
+{
+    return &pool->ext[idx >> pool->ext_shift].meta;
+}
 
-    const uint8_t *base = (const uint8_t *)pool->pool_memory;
-    const uint8_t *end = base + (total * pool->block_count);
-    const uint8_t *blkp = (const uint8_t *)data_ptr - header;
+static inline uint32_t *pool_meta_magic_ptr(const memory_pool_t *pool, size_t idx)
+{
+    if (!pool->compact)
+        return &pool_block_at(pool, idx)->magic;
+    const pool_meta_arrays_t *m = pool_meta_of(pool, idx);
+    return m->magic ? &m->magic[pool_local_index(pool, idx)] : NULL;
+}
 
-    return (blkp >= base) && (blkp < end) && ((((size_t)(blkp - base)) % total) == 0);
+// compact ไม่มี magic: word ของ bit CACHED (NULL = ไม่เก็บ)
+static inline uint32_t *pool_meta_cached_word(const memory_pool_t *pool, size_t idx, uint32_t *bit)
+{
+    const pool_meta_arrays_t *m = pool_meta_of(pool, idx);
+    size_t li = pool_local_index(pool, idx);
+    *bit = 1u << (li & 31);
+    return m->cached ? &m->cached[li >> 5] : NULL;
+}
+
+static inline bool pool_meta_is(const memory_pool_t *pool, size_t idx, uint32_t magic, uint32_t *seen)
+{
+    uint32_t *mp = pool_meta_magic_ptr(pool, idx);
+    if (!mp)
+    {
+        uint32_t bit;
+        uint32_t *cw = pool_meta_cached_word(pool, idx, &bit);
+        bool cached = cw && (__atomic_load_n(cw, __ATOMIC_ACQUIRE) & bit);
+        if (seen)
+            *seen = cached ? POOL_MAGIC_CACHED : magic;
+        return !cw || cached == (magic == POOL_MAGIC_CACHED);
+    }
+    uint32_t v = __atomic_load_n(mp, __ATOMIC_ACQUIRE);
+    if (seen)
+        *seen = v;
+    return v == magic && (pool->compact || pool_block_at(pool, idx)->pool_id == pool->pool_id);
+}
+
+static inline void pool_meta_set(const memory_pool_t *pool, size_t idx, uint32_t magic)
+{
+    uint32_t *mp = pool_meta_magic_ptr(pool, idx);
+    uint32_t bit, *cw;
+    if (mp)
+        __atomic_store_n(mp, magic, __ATOMIC_RELEASE);
+    else if ((cw = pool_meta_cached_word(pool, idx, &bit)) && magic == POOL_MAGIC_CACHED)
+        __atomic_fetch_or(cw, bit, __ATOMIC_RELEASE);
+    else if (cw)
+        __atomic_fetch_and(cw, ~bit, __ATOMIC_RELEASE);
+}
+
+// เปลี่ยนสถานะแบบ CAS (กันสอง core free block เดียวกันพร้อมกัน)
+static inline bool pool_meta_cas(const memory_pool_t *pool, size_t idx, uint32_t from, uint32_t to, uint32_t *seen)
+{
+    uint32_t *mp = pool_meta_magic_ptr(pool, idx);
+    if (!mp)
+    {
+        // เข้า/ออก CACHED = test-and-set/clear bit เดียว, ทางอื่นแค่ต้องไม่อยู่ใน magazine
+        uint32_t bit;
+        uint32_t *cw = pool_meta_cached_word(pool, idx, &bit);
+        if (!cw)
+            return true;
+        bool was;
+        if (to == POOL_MAGIC_CACHED)
+            was = __atomic_fetch_or(cw, bit, __ATOMIC_ACQ_REL) & bit;
+        else if (from == POOL_MAGIC_CACHED)
+            was = __atomic_fetch_and(cw, ~bit, __ATOMIC_ACQ_REL) & bit;
+        else
+            was = __atomic_load_n(cw, __ATOMIC_ACQUIRE) & bit;
+        if (seen)
+            *seen = was ? POOL_MAGIC_CACHED : POOL_MAGIC_ALLOC;
+        return was == (from == POOL_MAGIC_CACHED);
+    }
+    uint32_t expect = from;
+    bool ok = (pool->compact || pool_block_at(pool, idx)->pool_id == pool->pool_id) &&
+              __atomic_compare_exchange_n(mp, &expect, to, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    if (seen)
+        *seen = expect;
+    return ok;
+}
+
+static inline void pool_meta_set_used(const memory_pool_t *pool, size_t idx, size_t used)
+{
+    if (!pool->compact)
+        pool_block_at(pool, idx)->size_used = used;
+    else if (pool_meta_of(pool, idx)->used)
+        pool_meta_of(pool, idx)->used[pool_local_index(pool, idx)] = (uint16_t)used;
+}
+
+static inline size_t pool_meta_used(const memory_pool_t *pool, size_t idx)
+{
+    if (!pool->compact)
+        return pool_block_at(pool, idx)->size_used;
+    const pool_meta_arrays_t *m = pool_meta_of(pool, idx);
+    return m->used ? m->used[pool_local_index(pool, idx)] : 0;
+}
+
+static inline void pool_meta_stamp(const memory_pool_t *pool, size_t idx, uint64_t now_us)
+{
+    if (!pool->compact)
+        pool_block_at(pool, idx)->alloc_time = now_us;
+#if POOL_COMPACT_TS_EVERY
+    else if (pool_meta_of(pool, idx)->ts && (idx % POOL_COMPACT_TS_EVERY) == 0)
+        pool_meta_of(pool, idx)->ts[pool_local_index(pool, idx) / POOL_COMPACT_TS_EVERY] = (uint32_t)(now_us / 1000);
+#endif
+}
+
+static bool pool_meta_alloc(const memory_pool_t *pool, size_t count, pool_meta_arrays_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!pool->compact)
+        return true;
+    if (POOL_COMPACT_TRACK_SIZE && pool->block_size <= UINT16_MAX)
+        out->used = heap_caps_calloc(count, sizeof(uint16_t), MALLOC_CAP_8BIT);
+#if POOL_COMPACT_TS_EVERY
+    out->ts = heap_caps_calloc((count + POOL_COMPACT_TS_EVERY - 1) / POOL_COMPACT_TS_EVERY, sizeof(uint32_t),
+                               MALLOC_CAP_8BIT);
+#endif
+    if (POOL_COMPACT_DEBUG)
+        out->magic = heap_caps_calloc(count, sizeof(uint32_t), MALLOC_CAP_8BIT);
+    else
+        out->cached = heap_caps_calloc(bitmap_words(count), sizeof(uint32_t), MALLOC_CAP_8BIT);
+
+    bool ok = (out->used || !(POOL_COMPACT_TRACK_SIZE && pool->block_size <= UINT16_MAX)) &&
+              (out->ts || !POOL_COMPACT_TS_EVERY) && (POOL_COMPACT_DEBUG ? out->magic != NULL : out->cached != NULL);
+    if (!ok)
+    {
+        heap_caps_free(out->used);
+        heap_caps_free(out->ts);
+        heap_caps_free(out->magic);
+        heap_caps_free(out->cached);
+        memset(out, 0, sizeof(*out));
+    }
+    return ok;
+}
+
+static void pool_meta_release(pool_meta_arrays_t *m)
+{
+    heap_caps_free(m->used);
+    heap_caps_free(m->ts);
+    heap_caps_free(m->magic);
+    heap_caps_free(m->cached);
+    memset(m, 0, sizeof(*m));
+}
+
+// ตั้งทุก block ของ extent e เป็น "ว่าง" (เรียกหลังตั้ง ext[e] แล้ว ก่อนเปิด window ใน bitmap)
+static void pool_meta_format(memory_pool_t *pool, uint8_t e)
+{
+    size_t first = (size_t)e << pool->ext_shift;
+    for (size_t i = first; i < first + pool->ext[e].count; i++)
+    {
+        memory_block_t *blk = pool_block_at(pool, i);
+        blk->next = NULL;
+        if (!pool->compact)
+        {
+            blk->pool_id = pool->pool_id;
+            blk->alloc_time = 0;
+            blk->size_used = 0;
+        }
+        pool_meta_set(pool, i, POOL_MAGIC_FREE);
+    }
+}
+
+// byte ที่ใช้เก็บ metadata จริง (ไม่รวม bitmap ซึ่งมีทั้งสองโหมด)
+static size_t pool_meta_bytes(const memory_pool_t *pool)
+{
+    if (!pool->compact)
+        return pool->block_count * pool->hdr_size;
+    size_t bytes = 0;
+    for (uint8_t e = 0; e < pool->ext_count; e++)
+    {
+        const pool_extent_t *x = &pool->ext[e];
+        if (x->meta.used)
+            bytes += x->count * sizeof(uint16_t);
+#if POOL_COMPACT_TS_EVERY
+        if (x->meta.ts)
+            bytes += ((x->count + POOL_COMPACT_TS_EVERY - 1) / POOL_COMPACT_TS_EVERY) * sizeof(uint32_t);
+#endif
+        if (x->meta.magic)
+            bytes += x->count * sizeof(uint32_t);
+        if (x->meta.cached)
+            bytes += bitmap_words(x->count) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+// ============================
+//   Lock-free free list (Treiber stack + ABA tag)
+// ============================
+// head = [tag:16][index+1:16] → CAS 32 bit ครั้งเดียวต่อ push/pop
+// tag เพิ่มทุกครั้งที่ head เปลี่ยน กัน ABA (block ถูก pop/push กลับมาระหว่างที่อีก core อ่าน next)
+static inline uint32_t lf_pack(uint32_t tag, uint32_t idx1) { return (tag << 16) | (idx1 & 0xFFFFu); }
+static inline uint32_t lf_idx1(uint32_t head) { return head & 0xFFFFu; }
+static inline uint32_t lf_tag(uint32_t head) { return head >> 16; }
+
+// next ที่อ่านมาอาจเป็นค่าขยะ (block ถูก pop ไปใช้แล้ว) → ไม่เจอ extent ก็คืน NONE, CAS จะล้มเองเพราะ tag
+static inline uint32_t lf_idx1_of(const memory_pool_t *pool, const memory_block_t *blk)
+{
+    size_t idx;
+    return (blk && pool_locate(pool, blk, &idx)) ? (uint32_t)idx + 1 : LF_IDX_NONE;
+}
+
+static memory_block_t *lf_pop(memory_pool_t *pool)
+{
+    uint32_t head = __atomic_load_n(&pool->lf_head, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        uint32_t top = lf_idx1(head);
+        if (top == LF_IDX_NONE)
+            return NULL;
+
+        memory_block_t *blk = pool_block_at(pool, top - 1);
+        // next อาจเป็นค่าเก่าถ้า block นี้ถูก pop ไปแล้ว → tag ไม่ตรง CAS จะล้มเอง
+        memory_block_t *next = __atomic_load_n(&blk->next, __ATOMIC_RELAXED);
+        uint32_t nh = lf_pack(lf_tag(head) + 1, lf_idx1_of(pool, next));
+
+        if (__atomic_compare_exchange_n(&pool->lf_head, &head, nh, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return blk;
+    }
+}
+
+static void lf_push(memory_pool_t *pool, memory_block_t *blk)
+{
+    uint32_t idx1 = lf_idx1_of(pool, blk);
+    uint32_t head = __atomic_load_n(&pool->lf_head, __ATOMIC_RELAXED);
+    uint32_t nh;
+    do
+    {
+        uint32_t top = lf_idx1(head);
+        __atomic_store_n(&blk->next, top ? pool_block_at(pool, top - 1) : NULL, __ATOMIC_RELAXED);
+        nh = lf_pack(lf_tag(head) + 1, idx1);
+    } while (!__atomic_compare_exchange_n(&pool->lf_head, &head, nh, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// สร้าง stack ใหม่จาก bit ว่างใน bitmap (ถือ write lock อยู่) โดยให้ index ต่ำสุดอยู่บนสุด
+static void lf_rebuild_from_bitmap(memory_pool_t *pool)
+{
+    uint32_t top = LF_IDX_NONE;
+    for (size_t i = pool_index_space(pool); i-- > 0;)
+    {
+        if (pool->usage_bitmap[i >> 5] & (1u << (i & 31)))
+            continue;
+        memory_block_t *blk = pool_block_at(pool, i);
+        blk->next = top ? pool_block_at(pool, top - 1) : NULL;
+        top = (uint32_t)i + 1;
+    }
+    pool->lf_head = lf_pack(lf_tag(pool->lf_head) + 1, top);
 }
 
 // ============================
@@ -172,11 +661,89 @@ static bool nvs_open_namespace(void)
     return true;
 }
 
-static inline void nvs_mark_dirty(void) { g_dirty_epoch++; }
+// backend ของ pool_persist บน NVS จริง (blob ต่อ slot)
+static int nvs_be_read(void *ctx, const char *key, void *buf, size_t cap, size_t *len)
+{
+    *len = cap;
+    esp_err_t err = nvs_get_blob(g_nvs, key, buf, len);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return POOL_PERSIST_ERR_NOT_FOUND;
+    return (err == ESP_OK) ? 0 : POOL_PERSIST_ERR_IO;
+}
+
+static int nvs_be_write(void *ctx, const char *key, const void *buf, size_t len)
+{
+    return (nvs_set_blob(g_nvs, key, buf, len) == ESP_OK) ? 0 : POOL_PERSIST_ERR_IO;
+}
+
+static int nvs_be_commit(void *ctx)
+{
+    return (nvs_commit(g_nvs) == ESP_OK) ? 0 : POOL_PERSIST_ERR_IO;
+}
+
+static uint64_t persist_clock_us(void) { return (uint64_t)esp_timer_get_time(); }
+
+static inline void nvs_mark_dirty(const memory_pool_t *pool)
+{
+    if (!pool->no_persist)
+        pool_persist_touch(&g_persist, pool->pool_id - 1);
+}
 
 // ============================
 //   Pool core (init/malloc/free)
 // ============================
+static bool pool_set_lockfree(memory_pool_t *pool, bool enable);
+
+// ---- extents ----
+static bool pool_extent_create(memory_pool_t *pool, size_t count, own_kind_t kind, pool_extent_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    size_t bytes = pool->block_stride * count;
+    out->mem = heap_caps_aligned_alloc(16, bytes, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    if (!out->mem)
+        return false;
+    if (!pool_meta_alloc(pool, count, &out->meta))
+    {
+        heap_caps_free(out->mem);
+        out->mem = NULL;
+        return false;
+    }
+    out->own_id = own_register(out->mem, bytes, kind, pool, pool->block_stride, pool->hdr_size);
+    if (out->own_id < 0)
+    {
+        pool_meta_release(&out->meta);
+        heap_caps_free(out->mem);
+        out->mem = NULL;
+        return false;
+    }
+    out->count = count;
+    return true;
+}
+
+static void pool_extent_destroy(pool_extent_t *x)
+{
+    if (!x->mem)
+        return;
+    own_unregister(x->own_id);
+    pool_meta_release(&x->meta);
+    heap_caps_free(x->mem);
+    memset(x, 0, sizeof(*x));
+}
+
+// bitmap ครอบ index space ทั้งหมด (POOL_MAX_EXTENTS window) เริ่มต้น "ใช้แล้ว" ทั้งหมด
+static uint32_t *pool_bitmap_create(size_t base_count, uint8_t *shift_out)
+{
+    uint8_t shift = 5;
+    while (((size_t)1 << shift) < base_count)
+        shift++;
+    size_t bbytes = (((size_t)POOL_MAX_EXTENTS << shift) >> 5) * sizeof(uint32_t);
+    uint32_t *bm = heap_caps_malloc(bbytes, MALLOC_CAP_8BIT);
+    if (bm)
+        memset(bm, 0xFF, bbytes);
+    *shift_out = shift;
+    return bm;
+}
+
 static bool init_memory_pool(memory_pool_t *pool, const pool_config_t *cfg, uint32_t pool_id)
 {
     memset(pool, 0, sizeof(*pool));
@@ -186,109 +753,484 @@ static bool init_memory_pool(memory_pool_t *pool, const pool_config_t *cfg, uint
     pool->alignment = 4;
     pool->caps = cfg->caps;
     pool->pool_id = pool_id;
+    // payload ต้องจุ pointer ได้ (lock-free mode ใช้ต้น block เก็บ next ตอนว่าง)
+    pool->compact = POOL_COMPACT_META && cfg->block_size <= POOL_COMPACT_MAX_BLOCK &&
+                    cfg->block_size >= sizeof(memory_block_t *);
+    pool->hdr_size = pool->compact ? 0 : sizeof(memory_block_t);
 
-    size_t header = sizeof(memory_block_t);
-    size_t aligned = (cfg->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-    size_t total = header + aligned;
-    size_t bytes = total * cfg->block_count;
-
-    pool->pool_memory = heap_caps_aligned_alloc(16, bytes, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-    if (!pool->pool_memory)
-    {
-        ESP_LOGE(TAG, "Failed to alloc %s pool memory", cfg->name);
-        return false;
-    }
+    size_t total = pool_calc_stride(cfg->block_size, pool->alignment, pool->hdr_size);
+    pool->block_stride = total;
+    pool->stride_recip = pool_calc_recip(total);
+    pool->ext_blocks = cfg->block_count;
 
-    size_t bits = cfg->block_count;
-    size_t bbytes = (bits + 7) / 8;
-    pool->usage_bitmap = heap_caps_calloc(1, bbytes, MALLOC_CAP_8BIT);
+    pool->usage_bitmap = pool_bitmap_create(cfg->block_count, &pool->ext_shift);
     if (!pool->usage_bitmap)
     {
-        heap_caps_free(pool->pool_memory);
         ESP_LOGE(TAG, "Failed to alloc %s bitmap", cfg->name);
         return false;
     }
 
-    // build free-list
-    uint8_t *p = (uint8_t *)pool->pool_memory;
-    for (size_t i = 0; i < cfg->block_count; i++)
+    if (!pool_extent_create(pool, cfg->block_count, OWN_KIND_STATIC_POOL, &pool->ext[0]))
     {
-        memory_block_t *blk = (memory_block_t *)(p + i * total);
-        blk->magic = POOL_MAGIC_FREE;
-        blk->pool_id = pool->pool_id;
-        blk->alloc_time = 0;
-        blk->size_used = 0;
-        blk->next = pool->free_list;
-        pool->free_list = blk;
+        heap_caps_free(pool->usage_bitmap);
+        ESP_LOGE(TAG, "Failed to alloc %s pool memory", cfg->name);
+        return false;
     }
+    pool->ext_count = 1;
+
+    // bitmap เป็นตัวจริงของสถานะว่าง/ใช้ → แค่ตั้ง metadata แล้วเปิด window ก็พอ
+    pool_meta_format(pool, 0);
+    bitmap_open_window(pool->usage_bitmap, 0, cfg->block_count);
 
     if (!pool_sync_init(&pool->sync))
     {
-        heap_caps_free(pool->pool_memory);
+        pool_extent_destroy(&pool->ext[0]);
         heap_caps_free(pool->usage_bitmap);
         ESP_LOGE(TAG, "Failed to init sync for %s", cfg->name);
         return false;
     }
 
-    ESP_LOGI(TAG, "✅ Initialized %s: %d blocks × %d bytes", cfg->name, (int)cfg->block_count, (int)cfg->block_size);
+    if (POOL_LOCKFREE_DEFAULT)
+        pool_set_lockfree(pool, true);
+
+    ESP_LOGI(TAG, "✅ Initialized %s: %d blocks × %d bytes%s%s", cfg->name, (int)cfg->block_count, (int)cfg->block_size,
+             pool->compact ? " (compact meta)" : "", pool->lockfree ? " (lock-free)" : "");
     return true;
 }
 
-static void *pool_malloc(memory_pool_t *pool)
+static void deinit_memory_pool(memory_pool_t *pool)
 {
-    uint64_t t0 = esp_timer_get_time();
-    void *result = NULL;
+    if (!pool || pool->ext_count == 0)
+        return;
+    for (int e = 0; e < POOL_MAX_EXTENTS; e++)
+        pool_extent_destroy(&pool->ext[e]);
+    pool_sync_deinit(&pool->sync);
+    heap_caps_free(pool->usage_bitmap);
+    memset(pool, 0, sizeof(*pool));
+}
 
-    if (pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+// สลับโหมด locked <-> lock-free
+// หมายเหตุ: เรียกเฉพาะตอน pool ไม่มี alloc/free ค้างอยู่ (เช่นตอนบูต หรือระหว่างรอบ benchmark)
+// เพราะฝั่ง lock-free ไม่ได้ถือ write lock
+static bool pool_set_lockfree(memory_pool_t *pool, bool enable)
+{
+    if (!pool || pool->ext_count == 0)
+        return false;
+    if (enable && pool_index_space(pool) > LF_MAX_BLOCKS)
     {
-        if (pool->free_list)
-        {
-            memory_block_t *blk = pool->free_list;
-            pool->free_list = blk->next;
+        ESP_LOGW(TAG, "%s: too many blocks for lock-free mode (%d)", pool->name, (int)pool_index_space(pool));
+        return false;
+    }
+    if (!pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+        return false;
 
-            if (blk->magic != POOL_MAGIC_FREE || blk->pool_id != pool->pool_id)
-            {
-                ESP_LOGE(TAG, "🚨 Corruption in %s block %p", pool->name, (void *)blk);
-                gpio_set_level(LED_POOL_ERROR, 1);
-                pool_sync_write_unlock(&pool->sync);
-                return NULL;
-            }
+    if (enable && !pool->lockfree)
+    {
+        lf_rebuild_from_bitmap(pool);
+    }
+    else if (!enable && pool->lockfree)
+    {
+        // bitmap ถูกอัปเดตทั้งสองโหมดอยู่แล้ว ทิ้ง stack ได้เลย
+        pool->lf_head = lf_pack(lf_tag(pool->lf_head) + 1, LF_IDX_NONE);
+        pool->scan_hint = 0;
+    }
+    __atomic_store_n(&pool->lockfree, enable, __ATOMIC_RELEASE);
 
-            blk->magic = POOL_MAGIC_ALLOC;
-            blk->next = NULL;
-            blk->alloc_time = esp_timer_get_time();
-            blk->size_used = 0;
+    pool_sync_write_unlock(&pool->sync);
+    return true;
+}
+
+// ============================
+//   Statistics snapshot (versioned, ไม่ถือ lock)
+// ============================
+// writer ครอบการแก้ field ที่ต้องไปด้วยกัน (used/peak/totals/ความจุ) ด้วย pool_stats_begin/end
+// monitor/persistence อ่านผ่าน pool_stats_read → ไม่แตะ lock ของ allocation path เลย
+typedef struct
+{
+    size_t block_count;
+    size_t allocated_blocks;
+    size_t peak_usage;
+    uint64_t total_allocations;
+    uint64_t total_deallocations;
+    uint32_t allocation_failures;
+    uint32_t quarantined;
+    uint8_t ext_count;
+    uint32_t grows;
+    uint32_t shrinks;
+} pool_stats_snap_t;
+
+static inline void pool_stats_begin(memory_pool_t *pool) { pool_seq_write_begin(&pool->sync.stats_seq); }
+static inline void pool_stats_end(memory_pool_t *pool) { pool_seq_write_end(&pool->sync.stats_seq); }
+
+// คืน false ถ้าชน writer จนครบจำนวนรอบ (ค่าใน out เป็นรอบล่าสุดแบบ best-effort)
+static bool pool_stats_read(const memory_pool_t *pool, pool_stats_snap_t *out)
+{
+    const volatile memory_pool_t *vp = pool;
+    for (int tries = 0;; tries++)
+    {
+        uint32_t v = pool_seq_read_begin(&pool->sync.stats_seq);
+        out->block_count = vp->block_count;
+        out->allocated_blocks = vp->allocated_blocks;
+        out->peak_usage = vp->peak_usage;
+        out->total_allocations = vp->total_allocations;
+        out->total_deallocations = vp->total_deallocations;
+        out->allocation_failures = vp->allocation_failures;
+        out->quarantined = vp->quarantined;
+        out->ext_count = vp->ext_count;
+        out->grows = vp->grows;
+        out->shrinks = vp->shrinks;
+        if (!pool_seq_read_retry(&pool->sync.stats_seq, v))
+            return true;
+        if (!pool_seq_backoff(tries))
+            return false;
+    }
+}
+
+// ============================
+//   Live growth / shrink (extents)
+// ============================
+// โตด้วยการต่อ extent ใหม่ (pointer เดิมไม่ขยับ) หดด้วยการปลด extent สุดท้ายที่ว่างทั้งก้อน
+// เพราะ scan ให้ address ต่ำก่อน extent ท้าย ๆ จึงมักว่างก่อนเสมอ
+#ifndef POOL_GROW_ENABLE
+#define POOL_GROW_ENABLE 1
+#endif
+#define POOL_GROW_FAIL_RATE 1       // allocation_failures ที่เพิ่มต่อรอบ monitor → โต
+#define POOL_GROW_PEAK_PCT 90       // peak_usage ใหม่แตะ % ของความจุ → โตล่วงหน้า
+#define POOL_SHRINK_LOW_PCT 50      // ใช้ <= % ของความจุที่เหลือหลังปลด → หดได้
+#define POOL_SHRINK_IDLE_CHECKS 3   // ต้องเข้าเงื่อนไขหดติดกันกี่รอบ (กันแกว่ง)
+
+static bool pool_grow(memory_pool_t *pool)
+{
+    uint8_t e = pool->ext_count;
+    if (e >= POOL_MAX_EXTENTS)
+        return false;
+
+    // จอง memory นอก lock ก่อน
+    pool_extent_t x;
+    if (!pool_extent_create(pool, pool->ext_blocks, OWN_KIND_POOL_EXTENT, &x))
+    {
+        ESP_LOGW(TAG, "%s: grow failed (no memory for %d blocks)", pool->name, (int)pool->ext_blocks);
+        return false;
+    }
+    if (!pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+    {
+        pool_extent_destroy(&x);
+        return false;
+    }
+    if (pool->ext_count != e)
+    {
+        pool_sync_write_unlock(&pool->sync);
+        pool_extent_destroy(&x);
+        return false;
+    }
+
+    size_t first = (size_t)e << pool->ext_shift;
+    pool->ext[e] = x;
+    pool_meta_format(pool, e);
+    pool_stats_begin(pool);
+    __atomic_store_n(&pool->ext_count, (uint8_t)(e + 1), __ATOMIC_RELEASE);
+    pool->block_count += x.count;
+    pool->grows++;
+    pool_stats_end(pool);
+
+    bitmap_open_window(pool->usage_bitmap, first, x.count);
+    if (__atomic_load_n(&pool->lockfree, __ATOMIC_ACQUIRE))
+    {
+        // lock-free alloc ทำงานขนานได้ตลอด: push ทีละ block (index สูงก่อน → ต่ำอยู่บน)
+        for (size_t i = first + x.count; i-- > first;)
+            lf_push(pool, pool_block_at(pool, i));
+    }
+    else if ((first >> 5) < pool->scan_hint)
+    {
+        pool->scan_hint = first >> 5;
+    }
+    nvs_mark_dirty(pool);
+    pool_sync_write_unlock(&pool->sync);
+
+    ESP_LOGI(TAG, "%s: grew to %d extents (%d blocks)", pool->name, (int)(e + 1), (int)pool->block_count);
+    return true;
+}
+
+// ปลด extent สุดท้ายถ้าว่างทั้งก้อน (block ใน thread cache นับเป็น "ใช้อยู่" จึงไม่โดนปลด)
+static bool pool_shrink(memory_pool_t *pool)
+{
+    // lock-free mode: block ว่างของ extent ค้างอยู่ใน stack ที่แกะออกอย่างปลอดภัยไม่ได้
+    if (__atomic_load_n(&pool->lockfree, __ATOMIC_ACQUIRE))
+        return false;
+    if (!pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+        return false;
+
+    uint8_t e = pool->ext_count;
+    pool_extent_t x = {0};
+    bool ok = e > 1 && bitmap_close_window(pool->usage_bitmap, (size_t)(e - 1) << pool->ext_shift,
+                                           pool->ext[e - 1].count);
+    if (ok)
+    {
+        x = pool->ext[e - 1];
+        pool_stats_begin(pool);
+        __atomic_store_n(&pool->ext_count, (uint8_t)(e - 1), __ATOMIC_RELEASE);
+        memset(&pool->ext[e - 1], 0, sizeof(pool->ext[e - 1]));
+        pool->block_count -= x.count;
+        pool->shrinks++;
+        pool_stats_end(pool);
+        nvs_mark_dirty(pool);
+    }
+    pool_sync_write_unlock(&pool->sync);
+
+    if (ok)
+    {
+        pool_extent_destroy(&x);
+        ESP_LOGI(TAG, "%s: shrank to %d extents (%d blocks)", pool->name, (int)(e - 1), (int)pool->block_count);
+    }
+    return ok;
+}
+
+// เรียกจาก monitor ทุกรอบ: ตัดสินจาก allocation_failures (อัตรา) และ peak_usage
+static void pool_autosize_tick(memory_pool_t *pool)
+{
+    pool_stats_snap_t st;
+    pool_stats_read(pool, &st);
+
+    uint32_t dfail = st.allocation_failures - pool->grow_seen_failures;
+    pool->grow_seen_failures = st.allocation_failures;
+
+    bool peak_hot = st.peak_usage > pool->grow_seen_peak && st.peak_usage * 100 >= st.block_count * POOL_GROW_PEAK_PCT;
+    pool->grow_seen_peak = st.peak_usage;
+
+    if (dfail >= POOL_GROW_FAIL_RATE || peak_hot)
+    {
+        pool->shrink_idle = 0;
+        pool_grow(pool);
+        return;
+    }
+
+    uint8_t n = st.ext_count;
+    size_t keep = n > 1 ? st.block_count - pool->ext[n - 1].count : 0;
+    if (n > 1 && dfail == 0 && st.allocated_blocks * 100 <= keep * POOL_SHRINK_LOW_PCT)
+    {
+        if (++pool->shrink_idle >= POOL_SHRINK_IDLE_CHECKS && pool_shrink(pool))
+            pool->shrink_idle = 0;
+    }
+    else
+    {
+        pool->shrink_idle = 0;
+    }
+}
+
+// อัปเดต peak โดยไม่ใช้ lock (CAS loop)
+static inline void pool_note_usage_atomic(memory_pool_t *pool, size_t used)
+{
+    size_t peak = __atomic_load_n(&pool->peak_usage, __ATOMIC_RELAXED);
+    while (used > peak &&
+           !__atomic_compare_exchange_n(&pool->peak_usage, &peak, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+static void pool_note_exhausted(memory_pool_t *pool)
+{
+    pool_stats_begin(pool);
+    __atomic_add_fetch(&pool->allocation_failures, 1, __ATOMIC_RELAXED);
+    pool_stats_end(pool);
+    nvs_mark_dirty(pool);
+    // LED/log ทำใน indicator task
+    pool_tel_record(pool_tel_channel(pool->pool_id), POOL_TEL_EXHAUSTED, pool, (uint32_t)pool->allocated_blocks);
+}
+
+// block ที่ magic ไม่ตรงตอนจะแจก: ตั้ง bit ค้างไว้ (ไม่กลับเข้า free list/scan/shrink) แล้วนับ + แจ้ง
+static void pool_quarantine(memory_pool_t *pool, size_t idx, memory_block_t *blk, uint32_t seen)
+{
+    bitmap_set_atomic(pool->usage_bitmap, idx);
+    pool_stats_begin(pool);
+    __atomic_add_fetch(&pool->quarantined, 1, __ATOMIC_RELAXED);
+    pool_stats_end(pool);
+    pool_tel_record(pool_tel_channel(pool->pool_id), POOL_TEL_CORRUPT, blk, seen);
+}
+
+// คืน NULL เฉพาะเมื่อ lf_pop เจอ stack ว่างจริง (ผู้เรียกนับเป็น exhausted ได้ตรง ๆ)
+static void *pool_malloc_lockfree(memory_pool_t *pool)
+{
+    memory_block_t *blk;
+    size_t idx;
+    for (;;)
+    {
+        blk = lf_pop(pool);
+        if (!blk)
+            return NULL;
+
+        // pop สำเร็จ = block เป็นของเราคนเดียวแล้ว เขียน metadata ได้ตรง ๆ
+        idx = pool_block_index(pool, blk);
+        uint32_t seen = 0;
+        if (pool_meta_is(pool, idx, POOL_MAGIC_FREE, &seen))
+            break;
+        pool_quarantine(pool, idx, blk, seen);
+    }
 
-            pool->allocated_blocks++;
-            if (pool->allocated_blocks > pool->peak_usage)
-                pool->peak_usage = pool->allocated_blocks;
-            pool->total_allocations++;
-            nvs_mark_dirty();
-
-            // mark bitmap
-            size_t header = sizeof(memory_block_t);
-            size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-            size_t total = header + aligned;
-            size_t idx = ((size_t)((uint8_t *)blk - (uint8_t *)pool->pool_memory)) / total;
-            if (idx < pool->block_count)
-                pool->usage_bitmap[idx >> 3] |= (1 << (idx & 7));
-
-            result = block_to_data(blk);
+    blk->next = NULL;
+    pool_meta_stamp(pool, idx, esp_timer_get_time());
+    pool_meta_set_used(pool, idx, 0);
+    pool_meta_set(pool, idx, POOL_MAGIC_ALLOC);
+
+    bitmap_set_atomic(pool->usage_bitmap, idx);
+
+    pool_stats_begin(pool);
+    size_t used = __atomic_add_fetch(&pool->allocated_blocks, 1, __ATOMIC_RELAXED);
+    pool_note_usage_atomic(pool, used);
+    __atomic_add_fetch(&pool->total_allocations, 1, __ATOMIC_RELAXED);
+    pool_stats_end(pool);
+    nvs_mark_dirty(pool);
+
+    return block_to_data(pool, blk);
+}
+
+static bool pool_free_lockfree(memory_pool_t *pool, void *ptr)
+{
+    memory_block_t *blk = data_to_block(pool, ptr);
+    size_t idx = pool_block_index(pool, blk);
+
+    // ALLOC -> FREE ด้วย CAS: กัน double free จากสอง core พร้อมกัน
+    // (compact ไม่มี magic: bit ใน bitmap ทำหน้าที่แทน)
+    uint32_t seen = 0;
+    if (!pool_meta_cas(pool, idx, POOL_MAGIC_ALLOC, POOL_MAGIC_FREE, &seen) ||
+        !bitmap_test_clear_atomic(pool->usage_bitmap, idx))
+    {
+        pool_tel_record(pool_tel_channel(pool->pool_id), POOL_TEL_INVALID_FREE, ptr, seen);
+        return false;
+    }
+
+    pool_meta_set_used(pool, idx, 0);
+    lf_push(pool, blk);
+
+    pool_stats_begin(pool);
+    __atomic_sub_fetch(&pool->allocated_blocks, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->total_deallocations, 1, __ATOMIC_RELAXED);
+    pool_stats_end(pool);
+    nvs_mark_dirty(pool);
+    return true;
+}
+
+// ---- locked path: เรียกขณะถือ write lock ----
+// bitmap เป็นตัวจริง: scan ทีละ word ด้วย ctz(~word) → ได้ block ว่างที่ address ต่ำสุดก่อน
+// (ลด fragmentation และ cache/TLB footprint) ไม่ต้องเดิน linked list ผ่าน header ของ block
+static size_t pool_take_bulk_locked(memory_pool_t *pool, size_t n, void **out)
+{
+    size_t got = 0;
+    size_t words = pool_index_space(pool) >> 5;
+    size_t w = pool->scan_hint;
+    uint64_t now = esp_timer_get_time();
+
+    while (got < n && w < words)
+    {
+        uint32_t free_bits = ~pool->usage_bitmap[w];
+        if (!free_bits)
+        {
+            w++;
+            continue;
         }
-        else
+
+        // หยิบหลาย bit จาก word เดียวกันก่อนขยับไป word ถัดไป
+        while (free_bits && got < n)
         {
-            pool->allocation_failures++;
-            nvs_mark_dirty();
-            gpio_set_level(LED_POOL_FULL, 1);
-            if ((pool->allocation_failures % 32) == 1)
+            uint32_t bit = (uint32_t)__builtin_ctz(free_bits);
+            free_bits &= free_bits - 1;
+            pool->usage_bitmap[w] |= (1u << bit);
+
+            size_t idx = (w << 5) + bit;
+            memory_block_t *blk = pool_block_at(pool, idx);
+            uint32_t seen = 0;
+            if (!pool_meta_is(pool, idx, POOL_MAGIC_FREE, &seen))
             {
-                ESP_LOGW(TAG, "🔴 %s exhausted! (%d/%d)", pool->name, (int)pool->allocated_blocks, (int)pool->block_count);
+                pool_quarantine(pool, idx, blk, seen);
+                continue;
             }
+
+            pool_meta_set(pool, idx, POOL_MAGIC_ALLOC);
+            blk->next = NULL;
+            pool_meta_stamp(pool, idx, now);
+            pool_meta_set_used(pool, idx, 0);
+            out[got++] = block_to_data(pool, blk);
         }
+    }
+    pool->scan_hint = w;
+
+    if (got)
+    {
+        pool_stats_begin(pool);
+        pool->allocated_blocks += got;
+        if (pool->allocated_blocks > pool->peak_usage)
+            pool->peak_usage = pool->allocated_blocks;
+        pool->total_allocations += got;
+        pool_stats_end(pool);
+        nvs_mark_dirty(pool);
+    }
+    return got;
+}
+
+static bool pool_give_locked(memory_pool_t *pool, void *ptr)
+{
+    size_t idx = pool_data_index(pool, ptr);
+    uint32_t seen = 0;
+    uint32_t bit = 1u << (idx & 31);
+
+    if (!pool_meta_is(pool, idx, POOL_MAGIC_ALLOC, &seen) || !(pool->usage_bitmap[idx >> 5] & bit))
+    {
+        pool_tel_record(pool_tel_channel(pool->pool_id), POOL_TEL_INVALID_FREE, ptr, seen);
+        return false;
+    }
+
+    pool->usage_bitmap[idx >> 5] &= ~bit;
+    if ((idx >> 5) < pool->scan_hint)
+        pool->scan_hint = idx >> 5;
+
+    pool_meta_set(pool, idx, POOL_MAGIC_FREE);
+    pool_meta_set_used(pool, idx, 0);
+
+    pool_stats_begin(pool);
+    if (pool->allocated_blocks)
+        pool->allocated_blocks--;
+    pool->total_deallocations++;
+    pool_stats_end(pool);
+    nvs_mark_dirty(pool);
+    return true;
+}
+
+// ---- latency: บันทึกลง histogram แบบ lock-free (ไม่มี += ที่แข่งกันนอก lock อีกต่อไป) ----
+static inline void pool_lat_note(memory_pool_t *pool, pool_hist_kind_t kind, uint64_t t0)
+{
+    pool_hist_record(&pool->lat[kind], (uint32_t)(esp_timer_get_time() - t0));
+}
+
+// ขอ write lock พร้อมจับเวลารอ (นับทั้งกรณีได้และ timeout)
+static inline bool pool_lock_timed(memory_pool_t *pool)
+{
+    uint64_t t0 = esp_timer_get_time();
+    bool ok = pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS));
+    pool_lat_note(pool, POOL_HIST_LOCK_WAIT, t0);
+    return ok;
+}
+
+static void *pool_malloc(memory_pool_t *pool)
+{
+    uint64_t t0 = esp_timer_get_time();
+    void *result = NULL;
+
+    if (__atomic_load_n(&pool->lockfree, __ATOMIC_ACQUIRE))
+    {
+        result = pool_malloc_lockfree(pool);
+        if (!result)
+            pool_note_exhausted(pool);
+        pool_lat_note(pool, POOL_HIST_ALLOC, t0);
+        return result;
+    }
+
+    if (pool_lock_timed(pool))
+    {
+        if (pool_take_bulk_locked(pool, 1, &result) == 0)
+            pool_note_exhausted(pool);
         pool_sync_write_unlock(&pool->sync);
     }
 
-    pool->allocation_time_total += (esp_timer_get_time() - t0);
+    pool_lat_note(pool, POOL_HIST_ALLOC, t0);
     return result;
 }
 
@@ -300,83 +1242,417 @@ static bool pool_free(memory_pool_t *pool, void *ptr)
     uint64_t t0 = esp_timer_get_time();
     bool ok = false;
 
-    if (pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+    if (__atomic_load_n(&pool->lockfree, __ATOMIC_ACQUIRE))
     {
-        memory_block_t *blk = data_to_block(ptr);
+        ok = pool_free_lockfree(pool, ptr);
+    }
+    else if (pool_lock_timed(pool))
+    {
+        ok = pool_give_locked(pool, ptr);
+        pool_sync_write_unlock(&pool->sync);
+    }
+
+    pool_lat_note(pool, POOL_HIST_FREE, t0);
+    return ok;
+}
+
+// ---- bulk: จอง/คืนหลาย block ด้วย lock ครั้งเดียว (thread cache / ผู้เรียกที่ต้องการหลาย buffer) ----
+// คืนจำนวนที่ได้จริง (อาจน้อยกว่า n เมื่อ pool ใกล้เต็ม) — latency นับ 1 ตัวอย่างต่อการเรียก
+size_t pool_malloc_bulk(memory_pool_t *pool, size_t n, void **out)
+{
+    if (!pool || !out || n == 0)
+        return 0;
+
+    uint64_t t0 = esp_timer_get_time();
+    size_t got = 0;
+    if (__atomic_load_n(&pool->lockfree, __ATOMIC_ACQUIRE))
+    {
+        while (got < n && (out[got] = pool_malloc_lockfree(pool)) != NULL)
+            got++;
+    }
+    else if (pool_lock_timed(pool))
+    {
+        got = pool_take_bulk_locked(pool, n, out);
+        pool_sync_write_unlock(&pool->sync);
+    }
+    if (got == 0)
+        pool_note_exhausted(pool);
 
-        if (blk->magic != POOL_MAGIC_ALLOC || blk->pool_id != pool->pool_id)
+    pool_lat_note(pool, POOL_HIST_ALLOC, t0);
+    return got;
+}
+
+size_t pool_free_bulk(memory_pool_t *pool, size_t n, void *const *ptrs)
+{
+    if (!pool || !ptrs)
+        return 0;
+
+    uint64_t t0 = esp_timer_get_time();
+    size_t done = 0;
+    if (__atomic_load_n(&pool->lockfree, __ATOMIC_ACQUIRE))
+    {
+        for (size_t i = 0; i < n; i++)
+            done += (ptr_in_pool_range(pool, ptrs[i]) && pool_free_lockfree(pool, ptrs[i])) ? 1 : 0;
+    }
+    else if (pool_lock_timed(pool))
+    {
+        for (size_t i = 0; i < n; i++)
+            done += (ptr_in_pool_range(pool, ptrs[i]) && pool_give_locked(pool, ptrs[i])) ? 1 : 0;
+        pool_sync_write_unlock(&pool->sync);
+    }
+
+    pool_lat_note(pool, POOL_HIST_FREE, t0);
+    return done;
+}
+
+// ============================
+//   Thread cache (per-task magazines)
+// ============================
+// แต่ละ task มี magazine ต่อ size class: alloc/free คู่ที่พบบ่อยไม่แตะ lock ของ pool เลย
+// เติม/ระบายเป็นชุด (ครึ่ง magazine) ด้วย pool_malloc_bulk / pool_free_bulk
+#ifndef POOL_TCACHE_ENABLE
+#define POOL_TCACHE_ENABLE 1
+#endif
+#define POOL_TCACHE_MAG_SIZE 8   // block สูงสุดต่อ class ต่อ task
+#define POOL_TCACHE_BATCH (POOL_TCACHE_MAG_SIZE / 2)
+#define POOL_TCACHE_MAX_TASKS 8  // จำนวน task ที่มี cache ได้พร้อมกัน (bounded)
+#define POOL_TCACHE_TLS_INDEX 1  // slot 0 เป็นของ pthread TLS ใน ESP-IDF (sdkconfig.defaults ตั้งไว้ 2 slot)
+_Static_assert(POOL_TCACHE_TLS_INDEX > 0 && POOL_TCACHE_TLS_INDEX < configNUM_THREAD_LOCAL_STORAGE_POINTERS,
+               "raise CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS for the tcache slot");
+#ifndef CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS
+#error "tcache needs CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS=y (see sdkconfig.defaults)"
+#endif
+
+typedef enum
+{
+    TCACHE_SLOT_FREE = 0,
+    TCACHE_SLOT_ACTIVE,
+    TCACHE_SLOT_ORPHAN, // task ถูกลบแล้ว รอ monitor ระบายคืน pool
+} tcache_slot_state_t;
+
+typedef struct
+{
+    void *slots[POOL_TCACHE_MAG_SIZE];
+    uint8_t count;
+} pool_mag_t;
+
+typedef struct
+{
+    pool_mag_t mag[POOL_COUNT];
+    TaskHandle_t owner;
+    volatile tcache_slot_state_t state;
+} pool_tcache_t;
+
+static pool_tcache_t g_tcaches[POOL_TCACHE_MAX_TASKS];
+static portMUX_TYPE g_tcache_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t g_tcache_none; // sentinel: task นี้ขอ cache แล้วแต่ slot เต็ม
+
+// callback ตอน task ถูกลบ: อาจรันใน idle task → ห้าม block, แค่ mark ไว้ให้ monitor ระบาย
+static void tcache_task_deleted_cb(int index, void *value)
+{
+    (void)index;
+    pool_tcache_t *tc = (pool_tcache_t *)value;
+    if (!tc || value == (void *)&g_tcache_none)
+        return;
+    portENTER_CRITICAL(&g_tcache_mux);
+    tc->state = TCACHE_SLOT_ORPHAN;
+    tc->owner = NULL;
+    portEXIT_CRITICAL(&g_tcache_mux);
+}
+
+static pool_tcache_t *tcache_get(void)
+{
+    void *v = pvTaskGetThreadLocalStoragePointer(NULL, POOL_TCACHE_TLS_INDEX);
+    if (v == (void *)&g_tcache_none)
+        return NULL;
+    if (v)
+        return (pool_tcache_t *)v;
+
+    pool_tcache_t *tc = NULL;
+    portENTER_CRITICAL(&g_tcache_mux);
+    for (int i = 0; i < POOL_TCACHE_MAX_TASKS; i++)
+    {
+        if (g_tcaches[i].state == TCACHE_SLOT_FREE)
         {
-            ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08X pid=%lu",
-                     ptr, pool->name, blk->magic, (unsigned long)blk->pool_id);
-            gpio_set_level(LED_POOL_ERROR, 1);
-            pool_sync_write_unlock(&pool->sync);
-            return false;
+            tc = &g_tcaches[i];
+            memset(tc, 0, sizeof(*tc));
+            tc->state = TCACHE_SLOT_ACTIVE;
+            tc->owner = xTaskGetCurrentTaskHandle();
+            break;
         }
+    }
+    portEXIT_CRITICAL(&g_tcache_mux);
 
-        size_t header = sizeof(memory_block_t);
-        size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-        size_t total = header + aligned;
-        size_t idx = ((size_t)((uint8_t *)blk - (uint8_t *)pool->pool_memory)) / total;
-        if (idx < pool->block_count)
-            pool->usage_bitmap[idx >> 3] &= ~(1 << (idx & 7));
+    vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, POOL_TCACHE_TLS_INDEX,
+                                                    tc ? (void *)tc : (void *)&g_tcache_none,
+                                                    tcache_task_deleted_cb);
+    return tc;
+}
 
-        blk->magic = POOL_MAGIC_FREE;
-        blk->size_used = 0;
-        blk->next = pool->free_list;
-        pool->free_list = blk;
+static bool tcache_refill(pool_tcache_t *tc, int ci)
+{
+    memory_pool_t *pool = &pools[ci];
+    pool_mag_t *m = &tc->mag[ci];
+    size_t got = pool_malloc_bulk(pool, POOL_TCACHE_BATCH, &m->slots[m->count]);
+    for (size_t i = 0; i < got; i++)
+        pool_meta_set(pool, pool_data_index(pool, m->slots[m->count + i]), POOL_MAGIC_CACHED);
+    m->count += (uint8_t)got;
+    if (got)
+        __atomic_add_fetch(&pool->tc_refills, 1, __ATOMIC_RELAXED);
+    return got > 0;
+}
+
+// คืน n block ที่เก่าที่สุด (ก้น magazine) กลับ pool
+static void tcache_flush(pool_tcache_t *tc, int ci, size_t n)
+{
+    memory_pool_t *pool = &pools[ci];
+    pool_mag_t *m = &tc->mag[ci];
+    if (n > m->count)
+        n = m->count;
+    if (n == 0)
+        return;
+    for (size_t i = 0; i < n; i++)
+        pool_meta_set(pool, pool_data_index(pool, m->slots[i]), POOL_MAGIC_ALLOC);
+    pool_free_bulk(pool, n, m->slots);
+    memmove(&m->slots[0], &m->slots[n], (m->count - n) * sizeof(void *));
+    m->count -= (uint8_t)n;
+    __atomic_add_fetch(&pool->tc_flushes, 1, __ATOMIC_RELAXED);
+}
+
+static void tcache_flush_all(pool_tcache_t *tc)
+{
+    for (int ci = 0; ci < POOL_COUNT; ci++)
+        tcache_flush(tc, ci, tc->mag[ci].count);
+}
+
+static void *tcache_alloc(pool_tcache_t *tc, int ci)
+{
+    pool_mag_t *m = &tc->mag[ci];
+    if (m->count)
+    {
+        __atomic_add_fetch(&pools[ci].tc_hits, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_add_fetch(&pools[ci].tc_misses, 1, __ATOMIC_RELAXED);
+        if (!tcache_refill(tc, ci))
+            return NULL;
+    }
+    memory_pool_t *pool = &pools[ci];
+    void *p;
+    size_t idx;
+    uint32_t seen = 0;
+    // CACHED -> ALLOC: block ใน magazine ที่สถานะไม่ตรง (header ถูกเขียนทับ) → กักไว้ แล้วหยิบตัวถัดไป
+    for (;;)
+    {
+        if (!m->count && !tcache_refill(tc, ci))
+            return NULL;
+        p = m->slots[--m->count];
+        idx = pool_data_index(pool, p);
+        if (pool_meta_cas(pool, idx, POOL_MAGIC_CACHED, POOL_MAGIC_ALLOC, &seen))
+            break;
+        pool_quarantine(pool, idx, data_to_block(pool, p), seen);
+    }
+    pool_meta_stamp(pool, idx, esp_timer_get_time());
+    pool_meta_set_used(pool, idx, 0);
+    return p;
+}
+
+static bool tcache_free(pool_tcache_t *tc, int ci, void *ptr)
+{
+    memory_pool_t *pool = &pools[ci];
+    size_t idx = pool_data_index(pool, ptr);
+    uint32_t seen = 0;
+    // ต้องเป็น block ที่แจกไปแล้วจริง (bit ใน bitmap) และยังไม่อยู่ใน magazine ไหน (ALLOC -> CACHED ด้วย CAS)
+    if (!(__atomic_load_n(&pool->usage_bitmap[idx >> 5], __ATOMIC_ACQUIRE) & (1u << (idx & 31))) ||
+        !pool_meta_cas(pool, idx, POOL_MAGIC_ALLOC, POOL_MAGIC_CACHED, &seen))
+    {
+        pool_tel_record(pool_tel_channel(pool->pool_id), POOL_TEL_INVALID_FREE, ptr, seen);
+        return false;
+    }
+
+    pool_mag_t *m = &tc->mag[ci];
+    if (m->count == POOL_TCACHE_MAG_SIZE)
+        tcache_flush(tc, ci, POOL_TCACHE_BATCH);
+    m->slots[m->count++] = ptr;
+    pool_meta_set_used(pool, idx, 0);
+    return true;
+}
+
+// Public: ระบาย cache ของ task ปัจจุบันคืน pool (เช่น ก่อน vTaskDelete(NULL) หรือก่อนหลับนาน)
+void pool_tcache_drain(void)
+{
+    void *v = pvTaskGetThreadLocalStoragePointer(NULL, POOL_TCACHE_TLS_INDEX);
+    if (!v || v == (void *)&g_tcache_none)
+        return;
+    tcache_flush_all((pool_tcache_t *)v);
+}
+
+// monitor เรียกเป็นระยะ: ระบาย cache ของ task ที่ถูกลบไปแล้ว แล้วคืน slot
+static void pool_tcache_reap(void)
+{
+    for (int i = 0; i < POOL_TCACHE_MAX_TASKS; i++)
+    {
+        pool_tcache_t *tc = &g_tcaches[i];
+        if (tc->state != TCACHE_SLOT_ORPHAN)
+            continue;
+        tcache_flush_all(tc);
+        portENTER_CRITICAL(&g_tcache_mux);
+        tc->state = TCACHE_SLOT_FREE;
+        portEXIT_CRITICAL(&g_tcache_mux);
+    }
+}
+
+static size_t pool_tcache_cached_blocks(int ci)
+{
+    size_t n = 0;
+    for (int i = 0; i < POOL_TCACHE_MAX_TASKS; i++)
+        if (g_tcaches[i].state != TCACHE_SLOT_FREE)
+            n += g_tcaches[i].mag[ci].count;
+    return n;
+}
+
+// ชั้น size class: ใช้ cache ถ้ามี ไม่งั้นวิ่งเข้า pool ตรง
+static void *pool_class_malloc(int ci)
+{
+#if POOL_TCACHE_ENABLE
+    pool_tcache_t *tc = tcache_get();
+    if (tc)
+        return tcache_alloc(tc, ci);
+#endif
+    return pool_malloc(&pools[ci]);
+}
+
+static bool pool_class_free(int ci, void *ptr)
+{
+#if POOL_TCACHE_ENABLE
+    pool_tcache_t *tc = tcache_get();
+    if (tc)
+        return tcache_free(tc, ci, ptr);
+#endif
+    return pool_free(&pools[ci], ptr);
+}
+
+// ============================
+//   Smart API (malloc/free)
+// ============================
+#if POOL_SC_PROFILE
+static pool_sc_recorder_t g_sc_rec; // histogram ขนาดที่ขอ (รวมที่ตกไป heap)
+#define SC_NOTE_ALLOC(sz) pool_sc_note_alloc(&g_sc_rec, (sz))
+#define SC_NOTE_FREE(sz) pool_sc_note_free(&g_sc_rec, (sz))
+#else
+#define SC_NOTE_ALLOC(sz) ((void)0)
+#define SC_NOTE_FREE(sz) ((void)0)
+#endif
+
+// ============================
+//   Fallback: TLSF -> heap
+// ============================
+static tlsf_t *g_tlsf; // NULL = ไม่มี region (POOL_TLSF_BYTES = 0 หรือจองไม่ได้)
+
+static bool pool_tlsf_init(void)
+{
+#if POOL_TLSF_BYTES > 0
+    void *mem = heap_caps_malloc(POOL_TLSF_BYTES, MALLOC_CAP_8BIT);
+    g_tlsf = mem ? tlsf_create(mem, POOL_TLSF_BYTES) : NULL;
+    if (!g_tlsf)
+    {
+        heap_caps_free(mem);
+        return false;
+    }
+#endif
+    return true;
+}
 
-        if (pool->allocated_blocks)
-            pool->allocated_blocks--;
-        pool->total_deallocations++;
-        nvs_mark_dirty();
-        ok = true;
+// TLSF ก่อน (ไม่มี lock ของ heap ระบบ, เวลาคงที่) เต็มแล้วค่อยไป heap
+static void *pool_fallback_malloc(size_t size)
+{
+    void *p = g_tlsf ? tlsf_malloc(g_tlsf, size) : NULL;
+    return p ? p : heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+}
 
-        pool_sync_write_unlock(&pool->sync);
-    }
+static size_t pool_fallback_size(void *ptr)
+{
+    return tlsf_owns(g_tlsf, ptr) ? tlsf_block_size(ptr) : heap_caps_get_allocated_size(ptr);
+}
 
-    pool->deallocation_time_total += (esp_timer_get_time() - t0);
-    return ok;
+static void pool_fallback_free(void *ptr)
+{
+    if (tlsf_owns(g_tlsf, ptr))
+        tlsf_free(g_tlsf, ptr);
+    else
+        heap_caps_free(ptr);
 }
 
-// ============================
-//   Smart API (malloc/free)
-// ============================
 static void *smart_pool_malloc(size_t size)
 {
-    size_t need = size + 16; // safety margin
+    // block_size คือ payload ล้วน (header อยู่นอก block_size แล้ว) → ไม่ต้องเผื่อ margin
+    // (เดิม +16 ทำให้คำขอ 250 byte ตกไป class 1024)
+    SC_NOTE_ALLOC(size);
     for (int i = 0; i < POOL_COUNT; i++)
     {
-        if (need <= pools[i].block_size)
+        if (size <= pools[i].block_size)
         {
-            void *p = pool_malloc(&pools[i]);
+            void *p = pool_class_malloc(i);
             if (p)
             {
-                memory_block_t *blk = data_to_block(p);
-                size_t cap = pools[i].block_size;
-                blk->size_used = (size <= cap) ? size : cap;
-
-                // pulse LED
-                gpio_set_level(((gpio_num_t)POOL_DEFAULTS[i].led_pin), 1);
-                vTaskDelay(1);
-                gpio_set_level(((gpio_num_t)POOL_DEFAULTS[i].led_pin), 0);
+                pool_meta_set_used(&pools[i], pool_data_index(&pools[i], p), size);
+#if POOL_SC_PROFILE
+                __atomic_add_fetch(&pools[i].req_count, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&pools[i].req_bytes, size, __ATOMIC_RELAXED);
+#endif
+
+                // LED pulse ย้ายไป indicator task (เดิม vTaskDelay(1) = 1 tick ทุกครั้งที่จอง)
+                pool_tel_count(pool_tel_channel(pools[i].pool_id), POOL_TEL_ALLOC);
                 return p;
             }
         }
     }
-    return heap_caps_malloc(size, MALLOC_CAP_DEFAULT); // fallback heap
+    return pool_fallback_malloc(size);
+}
+
+// หา pool เจ้าของ ptr ผ่าน ownership map: O(1) ไม่ว่าจะมีกี่ pool
+// คืน false ถ้า ptr ไม่ใช่ของ pool ใด ๆ (→ heap), *out = NULL ถ้าอยู่ใน pool แต่ไม่ตรงหัว payload
+static bool pool_owner_of(const void *ptr, memory_pool_t **out)
+{
+    own_lookup_t own;
+    *out = NULL;
+    if (!own_lookup(ptr, &own) || (own.kind != OWN_KIND_STATIC_POOL && own.kind != OWN_KIND_POOL_EXTENT))
+        return false;
+    if (own.exact)
+        *out = (memory_pool_t *)own.owner;
+    return true;
+}
+
+static inline int pool_class_of(const memory_pool_t *pool)
+{
+    return (pool >= &pools[0] && pool < &pools[POOL_COUNT]) ? (int)(pool - pools) : -1;
 }
 
 static bool smart_pool_free(void *ptr)
 {
     if (!ptr)
         return false;
-    for (int i = 0; i < POOL_COUNT; i++)
+
+    memory_pool_t *pool;
+    if (!pool_owner_of(ptr, &pool))
     {
-        if (ptr_in_pool_range(&pools[i], ptr))
-            return pool_free(&pools[i], ptr);
+        // heap ไม่รู้ขนาดที่ขอ → ใช้ขนาดที่ allocator ให้ (ปัดขึ้นไม่กี่ byte อาจคลาด bucket ได้บ้าง)
+        SC_NOTE_FREE(pool_fallback_size(ptr));
+        pool_fallback_free(ptr);
+        return true;
     }
-    heap_caps_free(ptr);
-    return true;
+    if (!pool)
+    {
+        // pointer กลาง block: ห้ามส่งต่อให้ heap_caps_free
+        pool_tel_record(0, POOL_TEL_INVALID_FREE, ptr, 0);
+        return false;
+    }
+
+    pool_tel_count(pool_tel_channel(pool->pool_id), POOL_TEL_FREE);
+    SC_NOTE_FREE(pool_meta_used(pool, pool_data_index(pool, ptr)));
+    int ci = pool_class_of(pool);
+    return (ci >= 0) ? pool_class_free(ci, ptr) : pool_free(pool, ptr);
 }
 
 // ============================
@@ -393,38 +1669,51 @@ static void *pool_realloc_smart(void *old_ptr, size_t new_size)
     }
 
     memory_pool_t *owner = NULL;
-    for (int i = 0; i < POOL_COUNT; i++)
+    if (!pool_owner_of(old_ptr, &owner))
     {
-        if (ptr_in_pool_range(&pools[i], old_ptr))
+        size_t old_size = pool_fallback_size(old_ptr);
+        // block ของ TLSF ขยาย/ย่อในที่ได้ถ้าข้างหลังว่าง → ไม่ต้อง copy
+        if (tlsf_owns(g_tlsf, old_ptr) && new_size > pools[POOL_COUNT - 1].block_size)
         {
-            owner = &pools[i];
-            break;
+            void *np = tlsf_realloc(g_tlsf, old_ptr, new_size);
+            if (np)
+            {
+                SC_NOTE_FREE(old_size);
+                SC_NOTE_ALLOC(new_size);
+                return np;
+            }
         }
-    }
-    if (!owner)
-    {
         void *np = smart_pool_malloc(new_size);
         if (!np)
             return NULL;
-        memcpy(np, old_ptr, new_size); // ผู้เรียกควรรู้ขนาดเดิม
-        heap_caps_free(old_ptr);
+        memcpy(np, old_ptr, old_size < new_size ? old_size : new_size);
+        SC_NOTE_FREE(old_size);
+        pool_fallback_free(old_ptr);
         return np;
     }
+    if (!owner)
+        return NULL;
 
-    size_t need = new_size + 16;
-    if (need <= owner->block_size)
+    if (new_size <= owner->block_size)
     {
-        data_to_block(old_ptr)->size_used = new_size;
+        size_t idx = pool_data_index(owner, old_ptr);
+        SC_NOTE_FREE(pool_meta_used(owner, idx));
+        SC_NOTE_ALLOC(new_size);
+        pool_meta_set_used(owner, idx, new_size);
         return old_ptr;
     }
 
     void *np = smart_pool_malloc(new_size);
     if (!np)
         return NULL;
-    size_t old_used = data_to_block(old_ptr)->size_used ? data_to_block(old_ptr)->size_used : owner->block_size;
+    size_t old_used = pool_meta_used(owner, pool_data_index(owner, old_ptr));
+    if (!old_used)
+        old_used = owner->block_size;
     memcpy(np, old_ptr, (new_size < old_used) ? new_size : old_used);
     smart_pool_free(old_ptr);
-    data_to_block(np)->size_used = new_size;
+    memory_pool_t *np_owner;
+    if (pool_owner_of(np, &np_owner) && np_owner)
+        pool_meta_set_used(np_owner, pool_data_index(np_owner, np), new_size);
     return np;
 }
 
@@ -433,60 +1722,53 @@ static void *pool_realloc_smart(void *old_ptr, size_t new_size)
 // ============================
 static bool resize_pool_boot(memory_pool_t *pool, size_t new_count)
 {
-    // เรียกตอนบูตเท่านั้น (ยังไม่มี allocation)
+    // เรียกตอนบูตเท่านั้น (ยังไม่มี allocation และยังไม่มี extent เพิ่ม)
+    // ระหว่างทำงานให้ pool_autosize_tick โต/หดด้วย extent แทน
     if (!pool || new_count == 0)
         return false;
-    if (pool->allocated_blocks != 0)
+    if (pool->allocated_blocks != 0 || pool->ext_count != 1)
     {
         ESP_LOGW(TAG, "resize_pool_boot(%s): busy", pool->name);
         return false;
     }
 
-    size_t header = sizeof(memory_block_t);
-    size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-    size_t total = header + aligned;
-    size_t bytes = total * new_count;
+    uint8_t shift;
+    uint32_t *bitmap = pool_bitmap_create(new_count, &shift);
+    if (pool->lockfree && ((size_t)POOL_MAX_EXTENTS << shift) > LF_MAX_BLOCKS)
+    {
+        heap_caps_free(bitmap);
+        ESP_LOGW(TAG, "resize_pool_boot(%s): too many blocks for lock-free mode", pool->name);
+        return false;
+    }
 
-    void *new_mem = heap_caps_aligned_alloc(16, bytes, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-    size_t bits = new_count;
-    size_t bbytes = (bits + 7) / 8;
-    uint8_t *bitmap = (uint8_t *)heap_caps_calloc(1, bbytes, MALLOC_CAP_8BIT);
-    if (!new_mem || !bitmap)
+    pool_extent_t x;
+    if (!bitmap || !pool_extent_create(pool, new_count, OWN_KIND_STATIC_POOL, &x))
     {
-        if (new_mem)
-            heap_caps_free(new_mem);
         if (bitmap)
             heap_caps_free(bitmap);
         ESP_LOGE(TAG, "resize_pool_boot(%s): alloc fail", pool->name);
         return false;
     }
 
-    // free list ใหม่
-    memory_block_t *new_free = NULL;
-    uint8_t *p = (uint8_t *)new_mem;
-    for (size_t i = 0; i < new_count; i++)
-    {
-        memory_block_t *blk = (memory_block_t *)(p + i * total);
-        blk->magic = POOL_MAGIC_FREE;
-        blk->pool_id = pool->pool_id;
-        blk->alloc_time = 0;
-        blk->size_used = 0;
-        blk->next = new_free;
-        new_free = blk;
-    }
-
     // ทิ้งของเก่า
-    if (pool->pool_memory)
-        heap_caps_free(pool->pool_memory);
-    if (pool->usage_bitmap)
-        heap_caps_free(pool->usage_bitmap);
+    pool_extent_destroy(&pool->ext[0]);
+    heap_caps_free(pool->usage_bitmap);
 
-    pool->pool_memory = new_mem;
     pool->usage_bitmap = bitmap;
-    pool->free_list = new_free;
+    pool->ext_shift = shift;
+    pool->ext[0] = x;
+    pool->ext_blocks = new_count;
+    pool_meta_format(pool, 0);
+    bitmap_open_window(pool->usage_bitmap, 0, new_count);
+    pool->scan_hint = 0;
+    if (pool->lockfree)
+        lf_rebuild_from_bitmap(pool);
+    pool_stats_begin(pool);
     pool->block_count = new_count;
     pool->allocated_blocks = 0;
     pool->peak_usage = 0;
+    pool_stats_end(pool);
+    pool->grow_seen_peak = 0;
 
     ESP_LOGI(TAG, "Boot-resized %s → %d blocks", pool->name, (int)new_count);
     return true;
@@ -495,76 +1777,181 @@ static bool resize_pool_boot(memory_pool_t *pool, size_t new_count)
 // ============================
 //   Persistence: SAVE / LOAD
 // ============================
+// write-behind: alloc/free แค่ตั้ง dirty bit → persist task รวมทุกอย่างเป็น slot เดียว (varint)
+// แล้วเขียนสลับ stats_a/stats_b ตาม budget bytes/sec (ดู pool_persist.h)
+// ค่าที่เขียน = ค่าสะสมจากบูตก่อน (g_persist_base) + ค่าของรอบนี้
+static void pools_persist_fetch(void *arg, pool_persist_rec_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const pool_persist_rec_t *b = &g_persist_base[i];
+        pool_stats_snap_t st;
+        pool_stats_read(&pools[i], &st);
+        out[i].block_count = (uint32_t)st.block_count;
+        out[i].peak_usage = (st.peak_usage > b->peak_usage) ? (uint32_t)st.peak_usage : b->peak_usage;
+        out[i].allocation_failures = b->allocation_failures + st.allocation_failures;
+        out[i].total_allocations = b->total_allocations + st.total_allocations;
+        out[i].total_deallocations = b->total_deallocations + st.total_deallocations;
+    }
+}
+
 static esp_err_t pools_persist_load_counts_from_nvs(size_t out_counts[POOL_COUNT])
 {
+    for (int i = 0; i < POOL_COUNT; i++)
+        out_counts[i] = POOL_DEFAULTS[i].block_count; // default
+
     if (!nvs_open_namespace())
         return ESP_FAIL;
 
+    pool_persist_backend_t be = {NULL, nvs_be_read, nvs_be_write, nvs_be_commit};
+    pool_persist_init(&g_persist, &be, PERSIST_KEY_A, PERSIST_KEY_B, POOL_COUNT, POOL_PERSIST_BUDGET_BPS,
+                      persist_clock_us);
+
+    if (pool_persist_load(&g_persist, g_persist_base))
+    {
+        for (int i = 0; i < POOL_COUNT; i++)
+        {
+            if (g_persist_base[i].block_count > 0)
+                out_counts[i] = g_persist_base[i].block_count;
+        }
+        ESP_LOGI(TAG, "Persist: loaded slot seq=%lu", (unsigned long)g_persist.seq);
+        return ESP_OK;
+    }
+
+    // ยังไม่มี slot → อ่าน key แบบเก่า ("Small_blocks" ...) ครั้งเดียว
     for (int i = 0; i < POOL_COUNT; i++)
     {
         char key[32];
-        snprintf(key, sizeof(key), "%s_blocks", POOL_DEFAULTS[i].name); // "Small_blocks" ...
+        snprintf(key, sizeof(key), "%s_blocks", POOL_DEFAULTS[i].name);
         uint32_t val = 0;
-        esp_err_t err = nvs_get_u32(g_nvs, key, &val);
-        if (err == ESP_OK && val > 0)
-        {
+        if (nvs_get_u32(g_nvs, key, &val) == ESP_OK && val > 0)
             out_counts[i] = val;
-        }
-        else
-        {
-            out_counts[i] = POOL_DEFAULTS[i].block_count; // default
-        }
     }
     return ESP_OK;
 }
 
-static esp_err_t pools_persist_save_counts_to_nvs(void)
+// Public: on-demand save (เรียกจากที่ไหนก็ได้) — ข้าม budget แต่ยัง coalesce ถ้าไม่มีอะไรเปลี่ยน
+void pools_persist_save_now(void)
+{
+    if (!g_nvs_ready)
+        return;
+
+    int r = pool_persist_flush(&g_persist, pools_persist_fetch, NULL);
+    if (r < 0)
+        ESP_LOGW(TAG, "Persist: flush failed (%d)", r);
+    else
+        ESP_LOGI(TAG, "Persist: %s (seq=%lu)", r ? "saved" : "unchanged", (unsigned long)g_persist.seq);
+}
+
+// Background: เขียนเมื่อ dirty และ token พอ (ความสำคัญต่ำสุด ไม่แย่ง CPU งานหลัก)
+static void pool_persist_task(void *arg)
 {
-    if (!nvs_open_namespace())
-        return ESP_FAIL;
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(PERSIST_TICK_MS));
+        if (!g_nvs_ready)
+            continue;
+        int r = pool_persist_tick(&g_persist, pools_persist_fetch, NULL);
+        if (r < 0)
+            ESP_LOGW(TAG, "Persist: write failed (%d), retry next tick", r);
+    }
+}
 
-    for (int i = 0; i < POOL_COUNT; i++)
+// ============================
+//   Size classes (profile-guided)
+// ============================
+// โหลด config จาก NVS: คืน true ถ้ามี blob ที่ใช้กับ pool ชุดนี้ได้ (*fresh = ยังไม่เคยบูตด้วย count ชุดนี้)
+static bool pools_sizeclass_load(pool_sc_config_t *cfg, bool *fresh)
+{
+    uint8_t buf[POOL_SC_CFG_MAX_SIZE];
+    size_t len = sizeof(buf);
+    if (!nvs_open_namespace() || nvs_get_blob(g_nvs, SC_CFG_KEY, buf, &len) != ESP_OK)
+        return false;
+    if (!pool_sc_config_decode(buf, len, cfg, fresh) || cfg->n != POOL_COUNT)
     {
-        char key[32];
-        snprintf(key, sizeof(key), "%s_blocks", pools[i].name);
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(g_nvs, key, (uint32_t)pools[i].block_count));
+        ESP_LOGW(TAG, "SC | ignoring invalid '%s' blob", SC_CFG_KEY);
+        return false;
     }
-    return nvs_commit(g_nvs);
+    return true;
 }
 
-static esp_err_t pools_persist_save_stats_to_nvs(void)
+static esp_err_t pools_sizeclass_store(const pool_sc_config_t *cfg, bool fresh)
 {
-    if (!nvs_open_namespace())
+    uint8_t buf[POOL_SC_CFG_MAX_SIZE];
+    size_t len = pool_sc_config_encode(buf, sizeof(buf), cfg, fresh);
+    if (!len || !nvs_open_namespace())
         return ESP_FAIL;
+    esp_err_t err = nvs_set_blob(g_nvs, SC_CFG_KEY, buf, len);
+    return (err == ESP_OK) ? nvs_commit(g_nvs) : err;
+}
 
+#if POOL_SC_PROFILE
+// predicted (model จาก histogram) vs actual (วัดจาก smart_pool_malloc) ของ config ปัจจุบัน
+// + config ที่ generator แนะนำ; save = เขียนลง NVS ให้บูตถัดไปใช้
+void pools_sizeclass_report(bool save)
+{
+    uint32_t cur_sizes[POOL_COUNT];
+    uint64_t cur_mem = 0, req = 0, cap = 0;
     for (int i = 0; i < POOL_COUNT; i++)
     {
-        char k1[32], k2[32], k3[32], k4[32];
-        snprintf(k1, sizeof(k1), "%s_peak", pools[i].name);
-        snprintf(k2, sizeof(k2), "%s_alloc", pools[i].name);
-        snprintf(k3, sizeof(k3), "%s_freec", pools[i].name);
-        snprintf(k4, sizeof(k4), "%s_fail", pools[i].name);
-
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(g_nvs, k1, (uint32_t)pools[i].peak_usage));
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u64(g_nvs, k2, pools[i].total_allocations));
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u64(g_nvs, k3, pools[i].total_deallocations));
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(g_nvs, k4, pools[i].allocation_failures));
+        pool_stats_snap_t st;
+        pool_stats_read(&pools[i], &st);
+        cur_sizes[i] = (uint32_t)pools[i].block_size;
+        cur_mem += (uint64_t)st.block_count * pools[i].block_stride;
+        uint64_t n = __atomic_load_n(&pools[i].req_count, __ATOMIC_RELAXED);
+        req += __atomic_load_n(&pools[i].req_bytes, __ATOMIC_RELAXED);
+        cap += n * pools[i].block_size;
     }
-    return nvs_commit(g_nvs);
-}
-
-// Public: on-demand save (เรียกจากที่ไหนก็ได้)
-void pools_persist_save_now(void)
-{
-    if (!g_nvs_ready && !nvs_open_namespace())
+    uint32_t actual_ppm = cap ? (uint32_t)((cap - req) * 1000000u / cap) : 0;
+    uint32_t model_ppm = pool_sc_predict_waste_ppm(&g_sc_rec, cur_sizes, POOL_COUNT);
+    ESP_LOGI(TAG, "SC | current %lu/%lu/%lu/%lu waste predicted=%lu.%lu%% actual=%lu.%lu%% overflow=%lu",
+             (unsigned long)cur_sizes[0], (unsigned long)cur_sizes[1], (unsigned long)cur_sizes[2],
+             (unsigned long)cur_sizes[3], (unsigned long)(model_ppm / 10000), (unsigned long)(model_ppm / 1000 % 10),
+             (unsigned long)(actual_ppm / 10000), (unsigned long)(actual_ppm / 1000 % 10),
+             (unsigned long)g_sc_rec.overflow);
+
+    pool_sc_target_t t = {
+        .budget_bytes = POOL_SC_BUDGET_BYTES ? POOL_SC_BUDGET_BYTES : cur_mem,
+        .max_waste_ppm = POOL_SC_MAX_WASTE_PPM,
+        .min_classes = POOL_COUNT, // จำนวน pool คงที่ใน lab นี้ → class ที่ i คือ pool ที่ i
+        .max_classes = POOL_COUNT,
+    };
+    // overhead จริงต่อ block ของแต่ละ pool: header + padding ของ stride + side arrays (compact pool ไม่มี header)
+    for (int i = 0; i < POOL_COUNT; i++)
+        t.overhead[i] = (uint32_t)(pools[i].block_stride - pools[i].block_size +
+                                   (pools[i].block_count ? pool_meta_bytes(&pools[i]) / pools[i].block_count : 0));
+    pool_sc_config_t cfg;
+    pool_sc_report_t rep;
+    if (!pool_sc_generate(&g_sc_rec, &t, &cfg, &rep))
         return;
 
-    ESP_LOGI(TAG, "MON | Persist: saving counts+stats to NVS...");
-    ESP_ERROR_CHECK_WITHOUT_ABORT(pools_persist_save_counts_to_nvs());
-    ESP_ERROR_CHECK_WITHOUT_ABORT(pools_persist_save_stats_to_nvs());
-    g_last_saved_stamp = esp_timer_get_time() / 1000ULL;
-    ESP_LOGI(TAG, "MON | Persist: done");
+    ESP_LOGI(TAG, "SC | suggest %lu x%lu / %lu x%lu / %lu x%lu / %lu x%lu", (unsigned long)cfg.size[0],
+             (unsigned long)cfg.count[0], (unsigned long)cfg.size[1], (unsigned long)cfg.count[1],
+             (unsigned long)cfg.size[2], (unsigned long)cfg.count[2], (unsigned long)cfg.size[3],
+             (unsigned long)cfg.count[3]);
+    ESP_LOGI(TAG, "   | predicted waste=%lu.%lu%% (%s) coverage=%lu.%lu%% mem=%llu/%llu%s",
+             (unsigned long)(rep.waste_ppm / 10000), (unsigned long)(rep.waste_ppm / 1000 % 10),
+             rep.waste_ok ? "ok" : "over target", (unsigned long)(rep.coverage_ppm / 10000),
+             (unsigned long)(rep.coverage_ppm / 1000 % 10), (unsigned long long)rep.mem_bytes,
+             (unsigned long long)t.budget_bytes, rep.budget_ok ? "" : " (counts trimmed to budget)");
+
+    // header สำหรับ copy ไปเป็น main/pool_sizeclass_gen.h
+    static const char *const names[POOL_COUNT] = {"SMALL", "MEDIUM", "LARGE", "HUGE"};
+    char hdr[512];
+    if (pool_sc_emit_header(hdr, sizeof(hdr), &cfg, names, &rep))
+    {
+        char *save_ptr = NULL;
+        for (char *line = strtok_r(hdr, "\n", &save_ptr); line; line = strtok_r(NULL, "\n", &save_ptr))
+            ESP_LOGI(TAG, "SCGEN|%s", line);
+    }
+
+    if (save && model_ppm > rep.waste_ppm)
+    {
+        esp_err_t err = pools_sizeclass_store(&cfg, true);
+        ESP_LOGI(TAG, "SC | saved for next boot: %s", esp_err_to_name(err));
+    }
 }
+#endif
 
 // ============================
 //     Monitor / utilities
@@ -575,37 +1962,214 @@ static void print_pool_statistics(void)
     for (int i = 0; i < POOL_COUNT; i++)
     {
         memory_pool_t *pool = &pools[i];
-        if (pool_sync_stats_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+        pool_stats_snap_t st;
+        bool consistent = pool_stats_read(pool, &st);
+        ESP_LOGI(TAG, "%-6s | used %2d/%-2d  peak=%-2d  alloc=%llu  free=%llu  fail=%lu%s",
+                 pool->name, (int)st.allocated_blocks, (int)st.block_count, (int)st.peak_usage,
+                 (unsigned long long)st.total_allocations,
+                 (unsigned long long)st.total_deallocations,
+                 (unsigned long)st.allocation_failures, consistent ? "" : " (~)");
+        ESP_LOGI(TAG, "       | extents=%d/%d grow=%lu shrink=%lu quarantined=%lu",
+                 (int)st.ext_count, POOL_MAX_EXTENTS, (unsigned long)st.grows, (unsigned long)st.shrinks,
+                 (unsigned long)st.quarantined);
+        ESP_LOGI(TAG, "       | tcache cached=%d hit=%lu miss=%lu refill=%lu flush=%lu",
+                 (int)pool_tcache_cached_blocks(i), (unsigned long)pool->tc_hits,
+                 (unsigned long)pool->tc_misses, (unsigned long)pool->tc_refills,
+                 (unsigned long)pool->tc_flushes);
+        // header mode จะใช้ sizeof(memory_block_t) ต่อ block (stride ใหญ่ขึ้นด้วย)
+        size_t meta_now = pool_meta_bytes(pool);
+        size_t hdr_equiv = pool->block_count *
+                           (pool_calc_stride(pool->block_size, pool->alignment, sizeof(memory_block_t)) - pool->block_stride +
+                            pool->hdr_size);
+        if (pool->compact)
+        {
+            ESP_LOGI(TAG, "       | meta compact=%d bytes (header mode %d) saved=%d bytes%s", (int)meta_now,
+                     (int)hdr_equiv, (int)(hdr_equiv - meta_now), pool->ext[0].meta.magic ? " [debug]" : "");
+        }
+        else
+        {
+            ESP_LOGI(TAG, "       | meta header=%d bytes (%d%% of payload)", (int)meta_now,
+                     (int)(meta_now * 100 / (pool->block_size * pool->block_count)));
+        }
+
+        static const char *const lat_names[POOL_HIST_KIND_COUNT] = {"alloc", "free", "lock"};
+        for (int k = 0; k < POOL_HIST_KIND_COUNT; k++)
+        {
+            const pool_hist_t *h = &pool->lat[k];
+            if (pool_hist_count(h) == 0)
+                continue;
+            ESP_LOGI(TAG, "       | %-5s us p50=%lu p99=%lu p99.9=%lu max=%lu (n=%lu)", lat_names[k],
+                     (unsigned long)pool_hist_value_at(h, 500000), (unsigned long)pool_hist_value_at(h, 990000),
+                     (unsigned long)pool_hist_value_at(h, 999000), (unsigned long)h->max,
+                     (unsigned long)pool_hist_count(h));
+        }
+    }
+    ESP_LOGI(TAG, "ownmap | regions=%d overhead=%d bytes", (int)own_map_region_count(), (int)own_map_overhead_bytes());
+    if (g_tlsf)
+    {
+        tlsf_stats_t ts;
+        tlsf_get_stats(g_tlsf, &ts);
+        ESP_LOGI(TAG, "tlsf   | used %d/%d peak=%d largest_free=%d frag_blocks=%lu alloc=%lu free=%lu fail=%lu",
+                 (int)ts.used_bytes, (int)ts.pool_bytes, (int)ts.peak_used, (int)ts.largest_free,
+                 (unsigned long)ts.free_blocks, (unsigned long)ts.allocs, (unsigned long)ts.frees,
+                 (unsigned long)ts.fails);
+    }
+    if (g_nvs_ready)
+    {
+        pool_persist_stats_t ps;
+        pool_persist_get_stats(&g_persist, &ps);
+        ESP_LOGI(TAG, "persist| writes=%lu (%lu/h) bytes=%llu coalesced=%lu deferred=%lu err=%lu seq=%lu",
+                 (unsigned long)ps.writes, (unsigned long)ps.writes_per_hour, (unsigned long long)ps.bytes_written,
+                 (unsigned long)ps.coalesced, (unsigned long)ps.deferred, (unsigned long)ps.write_errors,
+                 (unsigned long)ps.last_seq);
+        ESP_LOGI(TAG, "       | commit us p50=%lu p99=%lu max=%lu", (unsigned long)ps.commit_p50_us,
+                 (unsigned long)ps.commit_p99_us, (unsigned long)ps.commit_max_us);
+    }
+}
+
+// ============================
+//   Latency snapshot export
+// ============================
+// binary snapshot (รูปแบบใน pool_hist.h) ของทุก pool × {alloc, free, lock}
+// build_tag = hash ของเวลา build → แยก snapshot ของแต่ละ firmware ตอนเทียบ offline
+static uint32_t pools_build_tag(void)
+{
+    static const char stamp[] = __DATE__ " " __TIME__;
+    return pool_hist_fnv1a(0, stamp, sizeof(stamp) - 1);
+}
+
+size_t pools_hist_export(void *buf, size_t cap)
+{
+    pool_hist_src_t src[POOL_COUNT * POOL_HIST_KIND_COUNT];
+    size_t n = 0;
+    for (int i = 0; i < POOL_COUNT; i++)
+        for (int k = 0; k < POOL_HIST_KIND_COUNT; k++)
+            src[n++] = (pool_hist_src_t){&pools[i].lat[k], pools[i].pool_id, (pool_hist_kind_t)k};
+    return pool_hist_snapshot(buf, cap, src, n, pools_build_tag(), (uint64_t)esp_timer_get_time());
+}
+
+// พิมพ์ snapshot เป็น hex ทาง log ("HIST|...") ให้เก็บจาก serial monitor ไปเทียบระหว่าง build
+void pools_hist_dump_log(void)
+{
+    size_t cap = pool_hist_snapshot_size(POOL_COUNT * POOL_HIST_KIND_COUNT);
+    uint8_t *buf = heap_caps_malloc(cap, MALLOC_CAP_8BIT);
+    if (!buf)
+        return;
+    size_t len = pools_hist_export(buf, cap);
+
+    char line[2 * 32 + 1];
+    ESP_LOGI(TAG, "HIST|begin len=%u tag=%08lx", (unsigned)len, (unsigned long)pools_build_tag());
+    for (size_t off = 0; off < len; off += 32)
+    {
+        size_t n = (len - off < 32) ? len - off : 32;
+        for (size_t j = 0; j < n; j++)
+            snprintf(&line[2 * j], 3, "%02x", buf[off + j]);
+        ESP_LOGI(TAG, "HIST|%s", line);
+    }
+    ESP_LOGI(TAG, "HIST|end");
+    heap_caps_free(buf);
+}
+
+// Indicator task: ขับ LED + log จาก telemetry ตามรอบ (ไม่อยู่ใน hot path)
+#define INDICATOR_PERIOD_MS 50
+#define INDICATOR_LOG_MIN_MS 1000 // log exhausted ไม่ถี่กว่านี้ต่อ pool
+
+static void pool_indicator_task(void *arg)
+{
+    uint32_t last_alloc[POOL_COUNT] = {0};
+    uint32_t exhausted_pending[POOL_COUNT] = {0};
+    uint64_t last_log_ms[POOL_COUNT] = {0};
+    pool_tel_record_t recs[8];
+    TickType_t wake = xTaskGetTickCount();
+
+    while (1)
+    {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(INDICATOR_PERIOD_MS));
+        uint64_t now_ms = esp_timer_get_time() / 1000ULL;
+
+        // LED ต่อ pool ติด 1 รอบถ้ามี alloc ในรอบนี้
+        for (int i = 0; i < POOL_COUNT; i++)
+        {
+            uint32_t ch = pool_tel_channel(pools[i].pool_id);
+            uint32_t a = pool_tel_read(ch, POOL_TEL_ALLOC);
+            gpio_set_level((gpio_num_t)POOL_DEFAULTS[i].led_pin, a != last_alloc[i]);
+            last_alloc[i] = a;
+        }
+
+        uint32_t dropped = 0, dropped_total = 0;
+        size_t n;
+        do
+        {
+            n = pool_tel_drain(recs, sizeof(recs) / sizeof(recs[0]), &dropped);
+            dropped_total += dropped;
+            for (size_t k = 0; k < n; k++)
+            {
+                const pool_tel_record_t *r = &recs[k];
+                int pi = (r->channel > 0 && r->channel <= POOL_COUNT) ? (int)r->channel - 1 : -1;
+                const char *name = (pi >= 0) ? pools[pi].name : "?";
+                switch (r->type)
+                {
+                case POOL_TEL_EXHAUSTED:
+                    gpio_set_level(LED_POOL_FULL, 1);
+                    if (pi >= 0)
+                        exhausted_pending[pi]++;
+                    break;
+                case POOL_TEL_CORRUPT:
+                    gpio_set_level(LED_POOL_ERROR, 1);
+                    ESP_LOGE(TAG, "🚨 Corruption in %s block %p (magic=0x%08lX)", name, r->addr, (unsigned long)r->arg);
+                    break;
+                case POOL_TEL_INVALID_FREE:
+                    gpio_set_level(LED_POOL_ERROR, 1);
+                    ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08lX", r->addr, name, (unsigned long)r->arg);
+                    break;
+                default:
+                    break;
+                }
+            }
+        } while (n == sizeof(recs) / sizeof(recs[0]));
+        if (dropped_total)
+            ESP_LOGW(TAG, "IND | telemetry ring overrun, %lu events dropped", (unsigned long)dropped_total);
+
+        for (int i = 0; i < POOL_COUNT; i++)
         {
-            int used = (int)pool->allocated_blocks;
-            int tot = (int)pool->block_count;
-            ESP_LOGI(TAG, "%-6s | used %2d/%-2d  peak=%-2d  alloc=%llu  free=%llu  fail=%lu",
-                     pool->name, used, tot, (int)pool->peak_usage,
-                     (unsigned long long)pool->total_allocations,
-                     (unsigned long long)pool->total_deallocations,
-                     (unsigned long)pool->allocation_failures);
-            pool_sync_stats_unlock(&pool->sync);
+            if (exhausted_pending[i] && (now_ms - last_log_ms[i]) >= INDICATOR_LOG_MIN_MS)
+            {
+                pool_stats_snap_t st;
+                pool_stats_read(&pools[i], &st);
+                ESP_LOGW(TAG, "🔴 %s exhausted! (%d/%d) x%lu", pools[i].name, (int)st.allocated_blocks,
+                         (int)st.block_count, (unsigned long)exhausted_pending[i]);
+                exhausted_pending[i] = 0;
+                last_log_ms[i] = now_ms;
+            }
         }
     }
 }
 
-// Monitor task: แสดงผล + autosave NVS เป็นระยะเมื่อมี “dirty”
+// Monitor task: แสดงผล + autosize + LED (การบันทึก NVS อยู่ใน pool_persist_task)
 static void pool_monitor_task(void *arg)
 {
     ESP_LOGI(TAG, "MON | started");
-    uint32_t last_seen_epoch = g_dirty_epoch;
+    uint32_t rounds = 0;
 
     while (1)
     {
         vTaskDelay(pdMS_TO_TICKS(5000));
+        rounds++;
 
+        pool_tcache_reap();
+#if POOL_GROW_ENABLE
+        for (int i = 0; i < POOL_COUNT; i++)
+            pool_autosize_tick(&pools[i]);
+#endif
         print_pool_statistics();
 
         // LED เตือน
         bool any_full = false;
         for (int i = 0; i < POOL_COUNT; i++)
         {
-            if (pools[i].allocated_blocks >= pools[i].block_count)
+            pool_stats_snap_t st;
+            pool_stats_read(&pools[i], &st);
+            if (st.allocated_blocks >= st.block_count)
             {
                 any_full = true;
                 break;
@@ -613,24 +2177,329 @@ static void pool_monitor_task(void *arg)
         }
         gpio_set_level(LED_POOL_FULL, any_full ? 1 : 0);
 
-        // Autosave ถ้ามีสถิติเปลี่ยน หรือผ่านไปนานกว่า SAVE_INTERVAL_MS
-        uint64_t now_ms = esp_timer_get_time() / 1000ULL;
-        bool epoch_changed = (g_dirty_epoch != last_seen_epoch);
-        bool timed = (now_ms - g_last_saved_stamp) > SAVE_INTERVAL_MS;
-        if (epoch_changed || timed)
+#if POOL_SC_PROFILE
+        if (POOL_SC_REPORT_EVERY && rounds % POOL_SC_REPORT_EVERY == 0)
+            pools_sizeclass_report(POOL_SC_AUTO_APPLY);
+#endif
+    }
+}
+
+// ============================
+//   Contention benchmark (locked vs lock-free)
+// ============================
+#ifndef POOL_BENCH_ENABLE
+#define POOL_BENCH_ENABLE 0 // 1 = รัน benchmark ตอนบูต (หลายวินาที แย่ง CPU กับ task จริง)
+#endif
+#if POOL_BENCH_ENABLE
+#define BENCH_DURATION_MS 1000
+#define BENCH_BLOCKS_PER_TASK 4
+#define BENCH_MAX_TASKS 8
+
+typedef struct
+{
+    memory_pool_t *pool;
+    volatile int *phase; // 0 = รอ, 1 = วิ่ง, 2 = หยุด
+    uint32_t ops;
+    SemaphoreHandle_t done;
+} bench_worker_t;
+
+static void bench_worker_task(void *arg)
+{
+    bench_worker_t *w = (bench_worker_t *)arg;
+    void *held[BENCH_BLOCKS_PER_TASK];
+    uint32_t ops = 0;
+
+    while (*w->phase == 0)
+        vTaskDelay(1);
+
+    while (*w->phase == 1)
+    {
+        int n = 0;
+        for (int k = 0; k < BENCH_BLOCKS_PER_TASK; k++)
+        {
+            held[n] = pool_malloc(w->pool);
+            if (held[n])
+            {
+                *(volatile uint8_t *)held[n] = (uint8_t)k;
+                n++;
+                ops++;
+            }
+        }
+        while (n > 0)
+            pool_free(w->pool, held[--n]);
+    }
+
+    w->ops = ops;
+    xSemaphoreGive(w->done);
+    vTaskDelete(NULL);
+}
+
+static uint32_t bench_run_once(memory_pool_t *pool, int ntasks)
+{
+    static bench_worker_t workers[BENCH_MAX_TASKS];
+    volatile int phase = 0;
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(BENCH_MAX_TASKS, 0);
+    if (!done)
+        return 0;
+
+    int started = 0;
+    for (int i = 0; i < ntasks; i++)
+    {
+        workers[i] = (bench_worker_t){.pool = pool, .phase = &phase, .ops = 0, .done = done};
+        // กระจายสลับ core 0/1
+        if (xTaskCreatePinnedToCore(bench_worker_task, "BenchW", 2048, &workers[i], 3, NULL, i % 2) == pdPASS)
+            started++;
+    }
+
+    phase = 1;
+    vTaskDelay(pdMS_TO_TICKS(BENCH_DURATION_MS));
+    phase = 2;
+
+    uint32_t total = 0;
+    for (int i = 0; i < started; i++)
+        xSemaphoreTake(done, portMAX_DELAY);
+    for (int i = 0; i < started; i++)
+        total += workers[i].ops;
+
+    vSemaphoreDelete(done);
+    return (uint32_t)((uint64_t)total * 1000ULL / BENCH_DURATION_MS);
+}
+
+// alloc/free เป็นคู่ใน task เดียว: thread cache vs เข้า pool ตรง
+#define BENCH_PAIR_ITERS 20000
+static void bench_tcache_pairs(void)
+{
+    uint64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < BENCH_PAIR_ITERS; i++)
+    {
+        void *p = pool_malloc(&pools[POOL_SMALL]);
+        if (p)
+            pool_free(&pools[POOL_SMALL], p);
+    }
+    uint64_t direct_us = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < BENCH_PAIR_ITERS; i++)
+    {
+        void *p = pool_class_malloc(POOL_SMALL);
+        if (p)
+            pool_class_free(POOL_SMALL, p);
+    }
+    uint64_t cached_us = esp_timer_get_time() - t0;
+    pool_tcache_drain();
+
+    ESP_LOGI(TAG, "BENCH | alloc/free pair: direct=%llu ns  tcache=%llu ns  (%d iters)",
+             (unsigned long long)(direct_us * 1000ULL / BENCH_PAIR_ITERS),
+             (unsigned long long)(cached_us * 1000ULL / BENCH_PAIR_ITERS), BENCH_PAIR_ITERS);
+}
+
+// จอง 16 block: เรียก pool_malloc ทีละตัว vs pool_malloc_bulk ครั้งเดียว
+#define BENCH_BULK_N 16
+#define BENCH_BULK_ROUNDS 2000
+static void bench_bulk(void)
+{
+    static const pool_config_t cfg = {"BulkB", SMALL_POOL_BLOCK_SIZE, 256, MALLOC_CAP_DEFAULT, LED_SMALL_POOL};
+    memory_pool_t *pool = heap_caps_calloc(1, sizeof(memory_pool_t), MALLOC_CAP_8BIT);
+    if (!pool || !init_memory_pool(pool, &cfg, 0xBF))
+    {
+        heap_caps_free(pool);
+        return;
+    }
+    pool->no_persist = true;
+
+    void *ptrs[BENCH_BULK_N];
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_BULK_ROUNDS; r++)
+    {
+        for (int i = 0; i < BENCH_BULK_N; i++)
+            ptrs[i] = pool_malloc(pool);
+        for (int i = 0; i < BENCH_BULK_N; i++)
+            pool_free(pool, ptrs[i]);
+    }
+    uint64_t single_us = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_BULK_ROUNDS; r++)
+    {
+        size_t got = pool_malloc_bulk(pool, BENCH_BULK_N, ptrs);
+        pool_free_bulk(pool, got, ptrs);
+    }
+    uint64_t bulk_us = esp_timer_get_time() - t0;
+
+    ESP_LOGI(TAG, "BENCH | %d blocks alloc+free: single=%llu ns  bulk=%llu ns", BENCH_BULK_N,
+             (unsigned long long)(single_us * 1000ULL / BENCH_BULK_ROUNDS),
+             (unsigned long long)(bulk_us * 1000ULL / BENCH_BULK_ROUNDS));
+
+    deinit_memory_pool(pool);
+    heap_caps_free(pool);
+}
+
+// latency ของ smart_pool_malloc: แบบเดิม (LED pulse + vTaskDelay(1) ใน hot path) vs deferred telemetry
+#define BENCH_LAT_SAMPLES 200
+
+static void *bench_legacy_smart_malloc(size_t size)
+{
+    void *p = smart_pool_malloc(size);
+    if (p && ptr_in_pool_range(&pools[POOL_SMALL], p))
+    {
+        gpio_set_level(LED_SMALL_POOL, 1);
+        vTaskDelay(1);
+        gpio_set_level(LED_SMALL_POOL, 0);
+    }
+    return p;
+}
+
+static void bench_latency_histogram(const char *label, void *(*alloc_fn)(size_t))
+{
+    static pool_hist_t hist;
+    pool_hist_reset(&hist);
+    for (int i = 0; i < BENCH_LAT_SAMPLES; i++)
+    {
+        uint64_t t0 = esp_timer_get_time();
+        void *p = alloc_fn(32);
+        pool_hist_record(&hist, (uint32_t)(esp_timer_get_time() - t0));
+        smart_pool_free(p);
+    }
+
+    ESP_LOGI(TAG, "BENCH | smart_pool_malloc latency [%s] p50=%lu p99=%lu p99.9=%lu max=%lu us", label,
+             (unsigned long)pool_hist_value_at(&hist, 500000), (unsigned long)pool_hist_value_at(&hist, 990000),
+             (unsigned long)pool_hist_value_at(&hist, 999000), (unsigned long)hist.max);
+}
+
+// worst-case latency ของ fallback: TLSF vs heap_caps_malloc ภายใต้ workload ที่ทำให้ fragment
+// ลำดับ alloc/free/ขนาดเหมือนกันทั้งสองฝั่ง (LCG seed เดียวกัน), จับเวลาเป็น cycle ต่อ operation
+// max รวม interrupt ที่บังเอิญเข้ามาด้วย → ดู p99.9 ประกอบ
+#define BENCH_TLSF_BYTES (24 * 1024)
+#define BENCH_TLSF_SLOTS 48
+#define BENCH_TLSF_OPS 6000
+
+typedef struct
+{
+    const char *name;
+    void *(*alloc)(void *ctx, size_t size);
+    void (*free)(void *ctx, void *p);
+    void *ctx;
+} bench_allocator_t;
+
+static void *bench_tlsf_alloc(void *ctx, size_t size) { return tlsf_malloc((tlsf_t *)ctx, size); }
+static void bench_tlsf_free(void *ctx, void *p) { tlsf_free((tlsf_t *)ctx, p); }
+static void *bench_heap_alloc(void *ctx, size_t size) { return heap_caps_malloc(size, MALLOC_CAP_DEFAULT); }
+static void bench_heap_free(void *ctx, void *p) { heap_caps_free(p); }
+
+static void bench_fallback_run(const bench_allocator_t *a)
+{
+    static pool_hist_t h_alloc, h_free;
+    void *slot[BENCH_TLSF_SLOTS] = {0};
+    uint32_t seed = 0x7115F00Du, fails = 0;
+    uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+
+    pool_hist_reset(&h_alloc);
+    pool_hist_reset(&h_free);
+    for (int pass = 0; pass < 2; pass++) // รอบแรก = warm-up ให้ heap fragment ก่อนวัด
+    {
+        for (int i = 0; i < BENCH_TLSF_OPS; i++)
         {
-            pools_persist_save_now();
-            last_seen_epoch = g_dirty_epoch;
+            seed = seed * 1664525u + 1013904223u;
+            int k = (int)((seed >> 8) % BENCH_TLSF_SLOTS);
+            // ขนาดกระจาย 16..1023 ส่วนใหญ่, ~1/8 เป็นก้อนใหญ่ 1..2.5KB
+            size_t size = (seed >> 29) == 0 ? 1024 + ((seed >> 4) & 0x5FF) : 16 + ((seed >> 12) & 0x3EF);
+            uint32_t c0 = esp_cpu_get_cycle_count();
+            if (slot[k])
+            {
+                a->free(a->ctx, slot[k]);
+                slot[k] = NULL;
+                if (pass)
+                    pool_hist_record(&h_free, esp_cpu_get_cycle_count() - c0);
+            }
+            else
+            {
+                slot[k] = a->alloc(a->ctx, size);
+                if (pass)
+                    pool_hist_record(&h_alloc, esp_cpu_get_cycle_count() - c0);
+                fails += slot[k] == NULL;
+            }
+        }
+    }
+    for (int k = 0; k < BENCH_TLSF_SLOTS; k++)
+        if (slot[k])
+            a->free(a->ctx, slot[k]);
+
+    ESP_LOGI(TAG, "BENCH | %-4s alloc ns p50=%lu p99.9=%lu max=%lu | free ns p50=%lu p99.9=%lu max=%lu | fail=%lu",
+             a->name, (unsigned long)(pool_hist_value_at(&h_alloc, 500000) * 1000u / mhz),
+             (unsigned long)(pool_hist_value_at(&h_alloc, 999000) * 1000u / mhz),
+             (unsigned long)(h_alloc.max * 1000u / mhz),
+             (unsigned long)(pool_hist_value_at(&h_free, 500000) * 1000u / mhz),
+             (unsigned long)(pool_hist_value_at(&h_free, 999000) * 1000u / mhz),
+             (unsigned long)(h_free.max * 1000u / mhz), (unsigned long)fails);
+}
+
+static void bench_fallback_worst_case(void)
+{
+    void *mem = heap_caps_malloc(BENCH_TLSF_BYTES, MALLOC_CAP_8BIT);
+    tlsf_t *t = mem ? tlsf_create(mem, BENCH_TLSF_BYTES) : NULL;
+    if (!t)
+    {
+        heap_caps_free(mem);
+        return;
+    }
+    ESP_LOGI(TAG, "BENCH | fallback worst-case: %d slots, %d ops, TLSF region %d bytes", BENCH_TLSF_SLOTS,
+             BENCH_TLSF_OPS, BENCH_TLSF_BYTES);
+    const bench_allocator_t tl = {"tlsf", bench_tlsf_alloc, bench_tlsf_free, t};
+    const bench_allocator_t hp = {"heap", bench_heap_alloc, bench_heap_free, NULL};
+    bench_fallback_run(&tl);
+    bench_fallback_run(&hp);
+    if (!tlsf_check(t))
+        ESP_LOGE(TAG, "BENCH | tlsf_check failed");
+    heap_caps_free(mem);
+}
+
+static void pool_contention_bench_task(void *arg)
+{
+    static const int task_counts[] = {1, 2, 4, 8};
+    static const pool_config_t bench_cfg = {"Bench", SMALL_POOL_BLOCK_SIZE, BENCH_MAX_TASKS * BENCH_BLOCKS_PER_TASK,
+                                            MALLOC_CAP_DEFAULT, LED_SMALL_POOL};
+    memory_pool_t *bench = heap_caps_calloc(1, sizeof(memory_pool_t), MALLOC_CAP_8BIT);
+    if (!bench || !init_memory_pool(bench, &bench_cfg, 0xBE))
+    {
+        ESP_LOGE(TAG, "BENCH | init failed");
+        heap_caps_free(bench);
+        vTaskDelete(NULL);
+        return;
+    }
+    bench->no_persist = true;
+
+    ESP_LOGI(TAG, "BENCH | %d-byte pool, %d ms per run, workers pinned core0/core1",
+             (int)bench->block_size, BENCH_DURATION_MS);
+    for (int mode = 0; mode < 2; mode++)
+    {
+        pool_set_lockfree(bench, mode == 1);
+        for (size_t i = 0; i < sizeof(task_counts) / sizeof(task_counts[0]); i++)
+        {
+            uint32_t rate = bench_run_once(bench, task_counts[i]);
+            ESP_LOGI(TAG, "BENCH | %-9s tasks=%d : %lu allocs/s", mode ? "lock-free" : "locked",
+                     task_counts[i], (unsigned long)rate);
         }
     }
+
+    deinit_memory_pool(bench);
+    heap_caps_free(bench);
+
+    bench_tcache_pairs();
+    bench_bulk();
+    bench_latency_histogram("before: inline LED+delay", bench_legacy_smart_malloc);
+    bench_latency_histogram("after: deferred", smart_pool_malloc);
+    bench_fallback_worst_case();
+    pools_hist_dump_log();
+    vTaskDelete(NULL);
 }
+#endif
 
 // ============================
 //      Demo / test task
 // ============================
 static void persistence_demo_task(void *arg)
 {
-    // ตัวอย่างการใช้งาน: จอง/คืน/ปรับขนาด แล้วปล่อยให้ monitor บันทึกลง NVS ให้อัตโนมัติ
+    // ตัวอย่างการใช้งาน: จอง/คืน/ปรับขนาด แล้วปล่อยให้ persist task บันทึกลง NVS ให้อัตโนมัติ
     void *p = smart_pool_malloc(120); // น่าจะได้ Medium
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
@@ -664,26 +2533,53 @@ void app_main(void)
     gpio_set_level(LED_POOL_FULL, 0);
     gpio_set_level(LED_POOL_ERROR, 0);
 
+    if (!own_map_init())
+    {
+        ESP_LOGE(TAG, "Ownership map init failed");
+        return;
+    }
+
     // ----- Load desired block counts from NVS (ถ้ามี) -----
     size_t boot_counts[POOL_COUNT];
     pools_persist_load_counts_from_nvs(boot_counts);
 
+    // ----- Size classes จาก profile (ถ้ามี) -----
+    // count ใน blob ใช้ครั้งแรกที่บูตด้วย config นี้ หลังจากนั้นใช้ count ที่ autosize/persist ปรับไว้
+    pool_sc_config_t sc;
+    bool sc_fresh = false;
+    bool sc_ok = pools_sizeclass_load(&sc, &sc_fresh);
+    if (sc_ok && sc_fresh)
+    {
+        for (int i = 0; i < POOL_COUNT; i++)
+            boot_counts[i] = sc.count[i];
+        pools_sizeclass_store(&sc, false);
+    }
+
     // ----- Init pools (ใช้จำนวนที่โหลดมา) -----
     for (int i = 0; i < POOL_COUNT; i++)
     {
         pool_config_t cfg = POOL_DEFAULTS[i]; // copy
         cfg.block_count = boot_counts[i];     // override from NVS
+        if (sc_ok)
+            cfg.block_size = sc.size[i];
         if (!init_memory_pool(&pools[i], &cfg, (uint32_t)(i + 1)))
         {
             ESP_LOGE(TAG, "Init %s failed", cfg.name);
             return;
         }
     }
+    if (!pool_tlsf_init())
+        ESP_LOGW(TAG, "TLSF fallback region (%d bytes) unavailable, using heap only", POOL_TLSF_BYTES);
     print_pool_statistics();
 
     // ----- Tasks -----
     xTaskCreate(pool_monitor_task, "PoolMon", 4096, NULL, 5, NULL);
+    xTaskCreate(pool_indicator_task, "PoolInd", 3072, NULL, 2, NULL);
+    xTaskCreate(pool_persist_task, "PoolPersist", 3072, NULL, 1, NULL);
     xTaskCreate(persistence_demo_task, "PersistD", 4096, NULL, 6, NULL);
+#if POOL_BENCH_ENABLE
+    xTaskCreate(pool_contention_bench_task, "PoolBench", 4096, NULL, 6, NULL);
+#endif
 
     ESP_LOGI(TAG, "System up.");
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <string.h>
+#include "pool_hist.h"
+
+_Static_assert(POOL_HIST_MAX_EXP < 31, "POOL_HIST_MAX_EXP must fit in 32-bit values");
+
+uint32_t pool_hist_bucket_upper(uint32_t idx)
+{
+    if (idx < POOL_HIST_SUB_COUNT)
+        return idx;
+    uint32_t group = idx / POOL_HIST_SUB_COUNT;
+    uint32_t sub = idx % POOL_HIST_SUB_COUNT;
+    uint32_t shift = group - 1; // = e - SUB_BITS
+    uint32_t lower = (POOL_HIST_SUB_COUNT + sub) << shift;
+    return lower + ((1u << shift) - 1u);
+}
+
+uint32_t pool_hist_count(const pool_hist_t *h)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < POOL_HIST_BUCKETS; i++)
+        n += __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+    return n;
+}
+
+uint32_t pool_hist_value_at(const pool_hist_t *h, uint32_t q_ppm)
+{
+    uint32_t total = pool_hist_count(h);
+    if (total == 0)
+        return 0;
+
+    // อันดับที่ต้องการ (ปัดขึ้น) เช่น p99.9 ของ 1000 ตัวอย่าง = ตัวที่ 999
+    uint32_t rank = (uint32_t)(((uint64_t)total * q_ppm + 999999u) / 1000000u);
+    if (rank == 0)
+        rank = 1;
+
+    uint32_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < POOL_HIST_BUCKETS; i++)
+    {
+        seen += __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+        if (seen >= rank)
+        {
+            uint32_t up = pool_hist_bucket_upper(i);
+            return (up < max) ? up : max;
+        }
+    }
+    return max;
+}
+
+void pool_hist_reset(pool_hist_t *h)
+{
+    for (uint32_t i = 0; i < POOL_HIST_BUCKETS; i++)
+        __atomic_store_n(&h->counts[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+uint32_t pool_hist_fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    if (hash == 0)
+        hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// ---- writer แบบ little-endian ไม่พึ่ง layout ของ struct ----
+static inline uint8_t *put_u8(uint8_t *p, uint8_t v)
+{
+    *p = v;
+    return p + 1;
+}
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+static inline uint8_t *put_u64(uint8_t *p, uint64_t v)
+{
+    p = put_u32(p, (uint32_t)v);
+    return put_u32(p, (uint32_t)(v >> 32));
+}
+
+size_t pool_hist_snapshot(void *buf, size_t cap, const pool_hist_src_t *src, size_t n, uint32_t build_tag,
+                          uint64_t uptime_us)
+{
+    size_t need = pool_hist_snapshot_size(n);
+    if (!buf || cap < need || n > UINT16_MAX)
+        return 0;
+
+    uint8_t *p = (uint8_t *)buf;
+    p = put_u32(p, POOL_HIST_SNAP_MAGIC);
+    p = put_u16(p, POOL_HIST_SNAP_VERSION);
+    p = put_u8(p, POOL_HIST_SUB_BITS);
+    p = put_u8(p, POOL_HIST_MAX_EXP);
+    p = put_u16(p, POOL_HIST_BUCKETS);
+    p = put_u16(p, (uint16_t)n);
+    p = put_u32(p, build_tag);
+    p = put_u64(p, uptime_us);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const pool_hist_t *h = src[i].hist;
+        p = put_u32(p, src[i].channel);
+        p = put_u8(p, (uint8_t)src[i].kind);
+        p = put_u8(p, 0); // unit: us
+        p = put_u16(p, 0);
+        p = put_u32(p, pool_hist_count(h));
+        p = put_u32(p, __atomic_load_n(&h->max, __ATOMIC_RELAXED));
+        for (uint32_t b = 0; b < POOL_HIST_BUCKETS; b++)
+            p = put_u32(p, __atomic_load_n(&h->counts[b], __ATOMIC_RELAXED));
+    }
+
+    uint32_t sum = pool_hist_fnv1a(0, buf, (size_t)(p - (uint8_t *)buf));
+    p = put_u32(p, sum);
+    return (size_t)(p - (uint8_t *)buf);
+}
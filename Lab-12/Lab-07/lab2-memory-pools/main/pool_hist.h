@@ -0,0 +1,102 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== Latency histogram แบบ log-linear (HDR-style) =====
+// ค่า < 2^SUB_BITS เก็บละเอียดทีละ 1, เกินจากนั้นแต่ละช่วงกำลังสองแบ่งเป็น 2^SUB_BITS ช่องเท่ากัน
+// → ความคลาดเคลื่อนสัมพัทธ์ไม่เกิน 1/2^SUB_BITS ทุกช่วงค่า, record = atomic add ครั้งเดียว (+CAS ของ max)
+// หน่วยค่าตามผู้เรียก (lab นี้ใช้ us จาก esp_timer_get_time)
+
+#ifndef POOL_HIST_SUB_BITS
+#define POOL_HIST_SUB_BITS 3 // 8 ช่องต่อช่วงกำลังสอง (~12.5%)
+#endif
+#ifndef POOL_HIST_MAX_EXP
+#define POOL_HIST_MAX_EXP 20 // ค่าสูงสุดที่แยกช่องได้ ~2^21 (เกินนี้รวมในช่องสุดท้าย, max ยังถูกต้อง)
+#endif
+
+#define POOL_HIST_SUB_COUNT (1u << POOL_HIST_SUB_BITS)
+#define POOL_HIST_BUCKETS ((POOL_HIST_MAX_EXP - POOL_HIST_SUB_BITS + 2) * POOL_HIST_SUB_COUNT)
+
+typedef struct
+{
+    uint32_t counts[POOL_HIST_BUCKETS];
+    uint32_t max;
+} pool_hist_t;
+
+typedef enum
+{
+    POOL_HIST_ALLOC = 0,
+    POOL_HIST_FREE,
+    POOL_HIST_LOCK_WAIT,
+    POOL_HIST_KIND_COUNT
+} pool_hist_kind_t;
+
+// แหล่งข้อมูลสำหรับ snapshot (หนึ่ง histogram ต่อรายการ)
+typedef struct
+{
+    const pool_hist_t *hist;
+    uint32_t channel; // เช่น pool_id
+    pool_hist_kind_t kind;
+} pool_hist_src_t;
+
+// ===== Binary snapshot (little-endian) =====
+// header  : u32 magic 'PHS1' | u16 version | u8 sub_bits | u8 max_exp | u16 buckets | u16 n_hist
+//           u32 build_tag | u64 uptime_us
+// ต่อ hist: u32 channel | u8 kind | u8 unit(0=us) | u16 reserved | u32 count | u32 max | u32 counts[buckets]
+// trailer : u32 fnv1a ของทุก byte ก่อนหน้า
+#define POOL_HIST_SNAP_MAGIC 0x31534850u // "PHS1"
+#define POOL_HIST_SNAP_VERSION 1
+#define POOL_HIST_SNAP_HDR_SIZE 24
+#define POOL_HIST_SNAP_ENTRY_SIZE (16 + 4 * POOL_HIST_BUCKETS)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    static inline uint32_t pool_hist_index(uint32_t v)
+    {
+        if (v < POOL_HIST_SUB_COUNT)
+            return v;
+        uint32_t e = 31u - (uint32_t)__builtin_clz(v);
+        if (e > POOL_HIST_MAX_EXP)
+            return POOL_HIST_BUCKETS - 1;
+        uint32_t sub = (v >> (e - POOL_HIST_SUB_BITS)) - POOL_HIST_SUB_COUNT;
+        return (e - POOL_HIST_SUB_BITS + 1) * POOL_HIST_SUB_COUNT + sub;
+    }
+
+    // lock-free: เรียกได้จากหลาย task/core พร้อมกัน
+    static inline void pool_hist_record(pool_hist_t *h, uint32_t v)
+    {
+        __atomic_add_fetch(&h->counts[pool_hist_index(v)], 1, __ATOMIC_RELAXED);
+        uint32_t m = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+        while (v > m && !__atomic_compare_exchange_n(&h->max, &m, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+    }
+
+    // ค่าสูงสุดที่ตกอยู่ใน bucket idx
+    uint32_t pool_hist_bucket_upper(uint32_t idx);
+
+    uint32_t pool_hist_count(const pool_hist_t *h);
+
+    // q_ppm = ส่วนในล้าน เช่น 500000 = p50, 999000 = p99.9 (คืนขอบบนของ bucket, ไม่เกิน max)
+    uint32_t pool_hist_value_at(const pool_hist_t *h, uint32_t q_ppm);
+
+    void pool_hist_reset(pool_hist_t *h);
+
+    uint32_t pool_hist_fnv1a(uint32_t hash, const void *data, size_t len);
+
+    static inline size_t pool_hist_snapshot_size(size_t n)
+    {
+        return POOL_HIST_SNAP_HDR_SIZE + n * POOL_HIST_SNAP_ENTRY_SIZE + 4;
+    }
+
+    // เขียน snapshot ลง buf คืนจำนวน byte (0 = buf เล็กไป)
+    size_t pool_hist_snapshot(void *buf, size_t cap, const pool_hist_src_t *src, size_t n, uint32_t build_tag,
+                              uint64_t uptime_us);
+
+#ifdef __cplusplus
+}
+#endif
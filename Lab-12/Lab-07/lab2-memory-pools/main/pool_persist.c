@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <string.h>
+#include "pool_persist.h"
+
+_Static_assert(POOL_PERSIST_MAX_CHANNELS <= 32, "dirty mask is 32 bits");
+_Static_assert(POOL_PERSIST_SLOT_MAX <= UINT16_MAX, "payload_len is u16");
+
+_Static_assert(POOL_PERSIST_REC_MAX >= 3 * 5 + 2 * 10, "worst-case varint record must fit");
+
+// ---- varint (LEB128) ----
+// คืน NULL ถ้าไม่พอที่ (p == NULL ส่งต่อได้ → เช็คครั้งเดียวตอนจบ)
+static uint8_t *put_varint(uint8_t *p, const uint8_t *end, uint64_t v)
+{
+    for (; p; v >>= 7)
+    {
+        if (p >= end)
+            return NULL;
+        if (v < 0x80)
+        {
+            *p++ = (uint8_t)v;
+            return p;
+        }
+        *p++ = (uint8_t)(v | 0x80);
+    }
+    return NULL;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+    uint64_t r = 0;
+    for (uint32_t shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t b = *p++;
+        r |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+        {
+            *v = r;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+static inline void put_u32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+static inline uint32_t get_u32le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ============================
+//   Encode / decode
+// ============================
+size_t pool_persist_encode(void *buf, size_t cap, uint32_t seq, const pool_persist_rec_t *recs, uint32_t n)
+{
+    if (!buf || n > POOL_PERSIST_MAX_CHANNELS || cap < POOL_PERSIST_HDR_SIZE + n * POOL_PERSIST_REC_MAX + 4)
+        return 0;
+
+    uint8_t *base = (uint8_t *)buf;
+    const uint8_t *end = base + cap - 4; // เหลือที่ให้ checksum
+    uint8_t *p = base + POOL_PERSIST_HDR_SIZE;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        p = put_varint(p, end, recs[i].block_count);
+        p = put_varint(p, end, recs[i].peak_usage);
+        p = put_varint(p, end, recs[i].allocation_failures);
+        p = put_varint(p, end, recs[i].total_allocations);
+        // frees ใกล้เคียง allocs เสมอ → เก็บส่วนต่าง (เล็ก) แทนค่าเต็ม
+        p = put_varint(p, end, zigzag((int64_t)(recs[i].total_allocations - recs[i].total_deallocations)));
+    }
+    if (!p)
+        return 0;
+    uint16_t plen = (uint16_t)(p - base - POOL_PERSIST_HDR_SIZE);
+
+    put_u32le(base, POOL_PERSIST_MAGIC);
+    put_u32le(base + 4, seq);
+    base[8] = POOL_PERSIST_VERSION;
+    base[9] = (uint8_t)n;
+    base[10] = (uint8_t)plen;
+    base[11] = (uint8_t)(plen >> 8);
+
+    put_u32le(p, pool_hist_fnv1a(0, base, (size_t)(p - base)));
+    return (size_t)(p - base) + 4;
+}
+
+bool pool_persist_decode(const void *buf, size_t len, uint32_t *seq, pool_persist_rec_t *recs, uint32_t n)
+{
+    const uint8_t *base = (const uint8_t *)buf;
+    if (!buf || len < POOL_PERSIST_HDR_SIZE + 4)
+        return false;
+    if (get_u32le(base) != POOL_PERSIST_MAGIC || base[8] != POOL_PERSIST_VERSION || base[9] != n)
+        return false;
+    size_t plen = (size_t)base[10] | ((size_t)base[11] << 8);
+    if (POOL_PERSIST_HDR_SIZE + plen + 4 != len)
+        return false;
+    const uint8_t *end = base + POOL_PERSIST_HDR_SIZE + plen;
+    if (get_u32le(end) != pool_hist_fnv1a(0, base, (size_t)(end - base)))
+        return false; // torn write / เสีย
+
+    const uint8_t *p = base + POOL_PERSIST_HDR_SIZE;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t v[5];
+        for (int k = 0; k < 5; k++)
+        {
+            p = get_varint(p, end, &v[k]);
+            if (!p)
+                return false;
+        }
+        recs[i].block_count = (uint32_t)v[0];
+        recs[i].peak_usage = (uint32_t)v[1];
+        recs[i].allocation_failures = (uint32_t)v[2];
+        recs[i].total_allocations = v[3];
+        recs[i].total_deallocations = v[3] - (uint64_t)unzigzag(v[4]);
+    }
+    if (p != end)
+        return false;
+    *seq = get_u32le(base + 4);
+    return true;
+}
+
+// ============================
+//   Lifecycle
+// ============================
+void pool_persist_init(pool_persist_t *p, const pool_persist_backend_t *be, const char *key_a, const char *key_b,
+                       uint32_t n_channels, uint32_t budget_bps, uint64_t (*clock_us)(void))
+{
+    memset(p, 0, sizeof(*p));
+    p->be = *be;
+    p->key[0] = key_a;
+    p->key[1] = key_b;
+    p->n_channels = (n_channels > POOL_PERSIST_MAX_CHANNELS) ? POOL_PERSIST_MAX_CHANNELS : n_channels;
+    p->budget_bps = budget_bps;
+    p->burst = POOL_PERSIST_BURST_BYTES;
+    p->clock_us = clock_us;
+    p->start_us = p->last_tick_us = clock_us();
+    p->tokens_milli = (uint64_t)p->burst * 1000u; // เขียนครั้งแรกได้ทันที
+}
+
+bool pool_persist_load(pool_persist_t *p, pool_persist_rec_t *out)
+{
+    uint8_t buf[POOL_PERSIST_SLOT_MAX];
+    pool_persist_rec_t tmp[POOL_PERSIST_MAX_CHANNELS];
+    int best = -1;
+    uint32_t best_seq = 0;
+
+    for (int s = 0; s < 2; s++)
+    {
+        size_t len = 0;
+        uint32_t seq;
+        if (p->be.read(p->be.ctx, p->key[s], buf, sizeof(buf), &len) != 0)
+            continue;
+        if (!pool_persist_decode(buf, len, &seq, tmp, p->n_channels))
+            continue;
+        // seq วนรอบได้ → เทียบแบบ signed difference
+        if (best < 0 || (int32_t)(seq - best_seq) > 0)
+        {
+            best = s;
+            best_seq = seq;
+            memcpy(out, tmp, p->n_channels * sizeof(*out));
+            p->last_len = (uint16_t)(len - POOL_PERSIST_HDR_SIZE - 4);
+            memcpy(p->last_payload, buf + POOL_PERSIST_HDR_SIZE, p->last_len);
+        }
+    }
+    if (best < 0)
+        return false;
+
+    p->seq = best_seq;
+    p->next_slot = (uint8_t)(best ^ 1); // เขียนทับ slot ที่เก่ากว่าเสมอ
+    return true;
+}
+
+// ============================
+//   Flush
+// ============================
+static void refill_tokens(pool_persist_t *p, uint64_t now)
+{
+    uint64_t dt = now - p->last_tick_us;
+    p->last_tick_us = now;
+    // us * (byte/s) / 1000 = byte * 1000
+    p->tokens_milli += dt * p->budget_bps / 1000u;
+    uint64_t cap = (uint64_t)p->burst * 1000u;
+    if (p->tokens_milli > cap)
+        p->tokens_milli = cap;
+}
+
+static int persist_write(pool_persist_t *p, pool_persist_fetch_fn fetch, void *arg, bool force)
+{
+    uint64_t now = p->clock_us();
+    refill_tokens(p, now);
+
+    // เคลียร์ก่อน fetch: การเปลี่ยนแปลงระหว่าง fetch จะตั้ง bit ใหม่และถูกเก็บรอบหน้า
+    uint32_t dirty = __atomic_exchange_n(&p->dirty, 0, __ATOMIC_ACQUIRE);
+    if (!dirty && !force)
+        return 0;
+
+    pool_persist_rec_t recs[POOL_PERSIST_MAX_CHANNELS];
+    uint8_t buf[POOL_PERSIST_SLOT_MAX];
+    fetch(arg, recs, p->n_channels);
+    size_t len = pool_persist_encode(buf, sizeof(buf), p->seq + 1, recs, p->n_channels);
+    if (len == 0)
+    {
+        __atomic_fetch_or(&p->dirty, dirty, __ATOMIC_RELAXED);
+        p->write_errors++;
+        return POOL_PERSIST_ERR_IO;
+    }
+    size_t plen = len - POOL_PERSIST_HDR_SIZE - 4;
+
+    // coalesce: alloc+free คู่กันหลายพันครั้งอาจจบที่ image เดิม → ไม่ต้องแตะ flash
+    if (plen == p->last_len && memcmp(buf + POOL_PERSIST_HDR_SIZE, p->last_payload, plen) == 0)
+    {
+        p->coalesced++;
+        return 0;
+    }
+
+    if (!force && p->tokens_milli < (uint64_t)len * 1000u)
+    {
+        __atomic_fetch_or(&p->dirty, dirty, __ATOMIC_RELAXED);
+        p->deferred++;
+        return 0;
+    }
+
+    uint64_t t0 = p->clock_us();
+    int err = p->be.write(p->be.ctx, p->key[p->next_slot], buf, len);
+    if (err == 0 && p->be.commit)
+        err = p->be.commit(p->be.ctx);
+    uint64_t t1 = p->clock_us();
+
+    if (err != 0)
+    {
+        // slot ที่เขียนไม่สำเร็จอาจเสีย แต่ slot ล่าสุดยังอยู่ → ลองใหม่รอบหน้าที่ slot เดิม
+        __atomic_fetch_or(&p->dirty, dirty ? dirty : 1u, __ATOMIC_RELAXED);
+        p->write_errors++;
+        return err;
+    }
+
+    pool_hist_record(&p->commit_lat, (uint32_t)(t1 - t0));
+    p->tokens_milli = (p->tokens_milli > (uint64_t)len * 1000u) ? p->tokens_milli - (uint64_t)len * 1000u : 0;
+    p->seq++;
+    p->next_slot ^= 1;
+    p->last_len = (uint16_t)plen;
+    memcpy(p->last_payload, buf + POOL_PERSIST_HDR_SIZE, plen);
+    p->writes++;
+    p->bytes_written += len;
+    return 1;
+}
+
+int pool_persist_tick(pool_persist_t *p, pool_persist_fetch_fn fetch, void *arg)
+{
+    return persist_write(p, fetch, arg, false);
+}
+
+int pool_persist_flush(pool_persist_t *p, pool_persist_fetch_fn fetch, void *arg)
+{
+    return persist_write(p, fetch, arg, true);
+}
+
+void pool_persist_get_stats(const pool_persist_t *p, pool_persist_stats_t *out)
+{
+    uint64_t up = p->clock_us() - p->start_us;
+    out->writes = p->writes;
+    out->write_errors = p->write_errors;
+    out->coalesced = p->coalesced;
+    out->deferred = p->deferred;
+    out->bytes_written = p->bytes_written;
+    out->writes_per_hour = up ? (uint32_t)((uint64_t)p->writes * 3600000000ULL / up) : 0;
+    out->last_seq = p->seq;
+    out->commit_p50_us = pool_hist_value_at(&p->commit_lat, 500000);
+    out->commit_p99_us = pool_hist_value_at(&p->commit_lat, 990000);
+    out->commit_max_us = p->commit_lat.max;
+}
+
+// ============================
+//   File-backed backend
+// ============================
+static void file_path(const pool_persist_file_t *f, const char *key, char *out, size_t cap)
+{
+    snprintf(out, cap, "%s/%s.bin", f->dir, key);
+}
+
+static int file_read(void *ctx, const char *key, void *buf, size_t cap, size_t *len)
+{
+    char path[128];
+    file_path((const pool_persist_file_t *)ctx, key, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return POOL_PERSIST_ERR_NOT_FOUND;
+    size_t n = fread(buf, 1, cap, fp);
+    int err = ferror(fp) ? POOL_PERSIST_ERR_IO : 0;
+    fclose(fp);
+    *len = n;
+    return err;
+}
+
+static int file_write(void *ctx, const char *key, const void *buf, size_t len)
+{
+    pool_persist_file_t *f = (pool_persist_file_t *)ctx;
+    char path[128];
+    file_path(f, key, path, sizeof(path));
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return POOL_PERSIST_ERR_IO;
+    size_t n = fwrite(buf, 1, len, fp);
+    int err = (fclose(fp) != 0 || n != len) ? POOL_PERSIST_ERR_IO : 0;
+    if (err == 0)
+        f->writes++;
+    return err;
+}
+
+void pool_persist_file_backend(pool_persist_backend_t *be, pool_persist_file_t *f)
+{
+    be->ctx = f;
+    be->read = file_read;
+    be->write = file_write;
+    be->commit = NULL; // fclose แล้วถือว่าถึง "flash"
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pool_hist.h"
+
+// ===== Write-behind persistence สำหรับสถิติ pool =====
+// hot path แค่ตั้ง dirty bit ของ channel (ไม่มีการเขียน flash)
+// background task เรียก pool_persist_tick() เป็นระยะ → รวมการเปลี่ยนแปลงทั้งหมดเป็น image เดียว
+// แล้วเขียนเมื่อ token bucket (bytes/sec) พอ → จำนวนครั้งที่เขียน flash ถูกจำกัดไม่ว่าจะ alloc/free ถี่แค่ไหน
+//
+// Layout แบบ double-buffer: slot A/B สลับกันเขียน แต่ละ slot มี seq + checksum
+// ตอนโหลดเลือก slot ที่ valid และ seq ใหม่สุด → ไฟดับกลางการเขียนยังเหลือ slot เก่าที่สมบูรณ์
+//
+// ไม่พึ่ง ESP-IDF: backend (NVS จริง / ไฟล์บน host) และนาฬิกา (clock_us) มาจากผู้เรียก
+
+#ifndef POOL_PERSIST_MAX_CHANNELS
+#define POOL_PERSIST_MAX_CHANNELS 8
+#endif
+#ifndef POOL_PERSIST_BUDGET_BPS
+#define POOL_PERSIST_BUDGET_BPS 4 // bytes/sec เฉลี่ยที่ยอมให้เขียน (record ~60B → ไม่เกิน ~1 ครั้ง/15s)
+#endif
+#ifndef POOL_PERSIST_BURST_BYTES
+#define POOL_PERSIST_BURST_BYTES 256 // token สะสมได้สูงสุด (flush ติดกันได้หลังเงียบไปนาน)
+#endif
+
+// ค่าต่อ channel (หนึ่ง pool) ที่เก็บถาวร
+typedef struct
+{
+    uint32_t block_count;
+    uint32_t peak_usage;
+    uint32_t allocation_failures;
+    uint64_t total_allocations;
+    uint64_t total_deallocations;
+} pool_persist_rec_t;
+
+// backend: คืน 0 = สำเร็จ, < 0 = ผิดพลาด (read: POOL_PERSIST_ERR_NOT_FOUND ถ้าไม่มี key)
+typedef struct
+{
+    void *ctx;
+    int (*read)(void *ctx, const char *key, void *buf, size_t cap, size_t *len);
+    int (*write)(void *ctx, const char *key, const void *buf, size_t len);
+    int (*commit)(void *ctx);
+} pool_persist_backend_t;
+
+#define POOL_PERSIST_ERR_NOT_FOUND (-2)
+#define POOL_PERSIST_ERR_IO (-1)
+
+// ===== Slot format (little-endian) =====
+// u32 magic 'PPS1' | u32 seq | u8 version | u8 n_channels | u16 payload_len | payload | u32 fnv1a
+// payload ต่อ channel (varint): block_count | peak | failures | allocs | allocs - frees (zigzag)
+#define POOL_PERSIST_MAGIC 0x31535050u // "PPS1"
+#define POOL_PERSIST_VERSION 1
+#define POOL_PERSIST_HDR_SIZE 12
+#define POOL_PERSIST_REC_MAX 35 // 3*5 + 2*10 byte ต่อ channel ในกรณีแย่สุด (ปกติ ~10-15)
+#define POOL_PERSIST_SLOT_MAX (POOL_PERSIST_HDR_SIZE + POOL_PERSIST_MAX_CHANNELS * POOL_PERSIST_REC_MAX + 4)
+
+typedef struct
+{
+    uint32_t writes;         // จำนวนครั้งที่เขียน slot สำเร็จ
+    uint32_t write_errors;
+    uint32_t coalesced;      // tick ที่มี dirty แต่ image ไม่เปลี่ยน → ไม่ต้องเขียน
+    uint32_t deferred;       // tick ที่ token ไม่พอ → เลื่อนไป
+    uint64_t bytes_written;
+    uint32_t writes_per_hour; // คิดจากช่วงเวลาตั้งแต่ init
+    uint32_t last_seq;
+    uint32_t commit_p50_us;
+    uint32_t commit_p99_us;
+    uint32_t commit_max_us;
+} pool_persist_stats_t;
+
+typedef struct
+{
+    pool_persist_backend_t be;
+    const char *key[2]; // slot A / B
+    uint32_t n_channels;
+    uint32_t dirty; // bit ต่อ channel (hot path ตั้ง, tick เคลียร์)
+    uint32_t budget_bps;
+    uint32_t burst;
+    uint64_t (*clock_us)(void);
+    uint64_t tokens_milli; // byte * 1000 (ละเอียดพอสำหรับ budget ต่ำ ๆ)
+    uint64_t last_tick_us;
+    uint64_t start_us;
+    uint32_t seq;      // seq ของ slot ล่าสุดที่ valid
+    uint8_t next_slot; // slot ที่จะเขียนครั้งถัดไป (ไม่ใช่ slot ล่าสุด)
+    uint16_t last_len;
+    uint8_t last_payload[POOL_PERSIST_SLOT_MAX]; // payload ที่เขียนล่าสุด ใช้ตัดสิน coalesce
+    uint32_t writes;
+    uint32_t write_errors;
+    uint32_t coalesced;
+    uint32_t deferred;
+    uint64_t bytes_written;
+    pool_hist_t commit_lat; // us, รวม write + commit ของ backend
+} pool_persist_t;
+
+// ดึงค่าปัจจุบันของทุก channel (ผู้เรียกอ่านจาก snapshot ของ pool)
+typedef void (*pool_persist_fetch_fn)(void *arg, pool_persist_rec_t *out, uint32_t n_channels);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // hot path: เช็คก่อนแล้วค่อย OR → ส่วนใหญ่เป็นแค่ load (ไม่ต้อง RMW เมื่อ bit ตั้งอยู่แล้ว)
+    static inline void pool_persist_touch(pool_persist_t *p, uint32_t channel)
+    {
+        uint32_t bit = 1u << (channel & 31u);
+        if ((__atomic_load_n(&p->dirty, __ATOMIC_RELAXED) & bit) == 0)
+            __atomic_fetch_or(&p->dirty, bit, __ATOMIC_RELAXED);
+    }
+
+    void pool_persist_init(pool_persist_t *p, const pool_persist_backend_t *be, const char *key_a,
+                           const char *key_b, uint32_t n_channels, uint32_t budget_bps, uint64_t (*clock_us)(void));
+
+    // โหลด slot ที่ valid ล่าสุด → out[n_channels]; คืน false ถ้าไม่มี slot ที่ใช้ได้
+    bool pool_persist_load(pool_persist_t *p, pool_persist_rec_t *out);
+
+    // เรียกจาก background task: คืน 1 = เขียนแล้ว, 0 = ไม่ได้เขียน (ไม่ dirty / coalesce / token ไม่พอ), < 0 = error
+    int pool_persist_tick(pool_persist_t *p, pool_persist_fetch_fn fetch, void *arg);
+
+    // เขียนทันทีโดยไม่สน budget (เช่น ก่อน reboot / ผู้ใช้สั่ง)
+    int pool_persist_flush(pool_persist_t *p, pool_persist_fetch_fn fetch, void *arg);
+
+    void pool_persist_get_stats(const pool_persist_t *p, pool_persist_stats_t *out);
+
+    // encode/decode ของ slot (ใช้ใน tool ฝั่ง host ได้ด้วย)
+    size_t pool_persist_encode(void *buf, size_t cap, uint32_t seq, const pool_persist_rec_t *recs, uint32_t n);
+    bool pool_persist_decode(const void *buf, size_t len, uint32_t *seq, pool_persist_rec_t *recs, uint32_t n);
+
+    // ===== File-backed backend (host test / เครื่องที่มี VFS) =====
+    // แต่ละ key = ไฟล์ "<dir>/<key>.bin" เขียนทับตรง ๆ (ไม่ atomic เหมือน flash จริง → ทดสอบ torn write ได้)
+    typedef struct
+    {
+        const char *dir;
+        uint32_t writes; // นับจำนวนครั้งเขียนจริง (ใช้เทียบกับสถิติฝั่ง persist)
+    } pool_persist_file_t;
+
+    void pool_persist_file_backend(pool_persist_backend_t *be, pool_persist_file_t *f);
+
+#ifdef __cplusplus
+}
+#endif
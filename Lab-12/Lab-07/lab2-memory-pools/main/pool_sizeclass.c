@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool_sizeclass.h"
+#include "pool_hist.h" // pool_hist_fnv1a
+
+_Static_assert(POOL_SC_MAX_EXP < 31, "POOL_SC_MAX_EXP must fit in 32-bit values");
+_Static_assert(POOL_SC_MAX_CLASSES <= 255, "class count is u8 in the NVS blob");
+
+void pool_sc_bucket_range(uint32_t idx, uint32_t *lo, uint32_t *hi)
+{
+    if (idx < POOL_SC_SUB_COUNT)
+    {
+        *lo = *hi = idx;
+        return;
+    }
+    uint32_t shift = idx / POOL_SC_SUB_COUNT - 1;
+    *lo = (POOL_SC_SUB_COUNT + idx % POOL_SC_SUB_COUNT) << shift;
+    *hi = *lo + ((1u << shift) - 1u);
+}
+
+void pool_sc_reset(pool_sc_recorder_t *r)
+{
+    for (uint32_t i = 0; i < POOL_SC_BUCKETS; i++)
+    {
+        __atomic_store_n(&r->freq[i], 0, __ATOMIC_RELAXED);
+        // live ไม่รีเซ็ต (block ยังค้างอยู่จริง) แต่ peak เริ่มนับจาก live ปัจจุบัน
+        __atomic_store_n(&r->peak[i], __atomic_load_n(&r->live[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&r->overflow, 0, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t round_up(uint32_t v, uint32_t a) { return (v + a - 1u) / a * a; }
+
+// ขนาดตัวแทนของคำขอใน bucket (bucket ละเอียดพอที่จุดกึ่งกลางใช้ประมาณได้)
+static inline uint32_t bucket_mid(uint32_t idx)
+{
+    uint32_t lo, hi;
+    pool_sc_bucket_range(idx, &lo, &hi);
+    return lo + (hi - lo) / 2u;
+}
+
+uint32_t pool_sc_predict_waste_ppm(const pool_sc_recorder_t *r, const uint32_t *sizes, uint32_t n)
+{
+    uint64_t reserved = 0, waste = 0;
+    for (uint32_t b = 0; b < POOL_SC_BUCKETS; b++)
+    {
+        uint32_t f = __atomic_load_n(&r->freq[b], __ATOMIC_RELAXED);
+        if (!f)
+            continue;
+        uint32_t mid = bucket_mid(b);
+        for (uint32_t c = 0; c < n; c++)
+        {
+            if (sizes[c] >= mid)
+            {
+                reserved += (uint64_t)f * sizes[c];
+                waste += (uint64_t)f * (sizes[c] - mid);
+                break;
+            }
+        }
+    }
+    return reserved ? (uint32_t)(waste * 1000000u / reserved) : 0;
+}
+
+// ============================
+//   Generator
+// ============================
+typedef struct
+{
+    uint32_t idx;
+    uint32_t cls; // class size ถ้า class จบที่ bucket นี้
+    uint32_t freq;
+    uint32_t peak;
+} sc_bucket_t;
+
+// DP: best[k][j] = byte ที่จองให้น้อยสุดเมื่อใช้ k+1 class ครอบคลุม bucket 0..j (class สุดท้ายจบที่ j)
+// waste = byte ที่จอง - byte ที่ขอจริง (ค่าหลังคงที่) → ลดอันแรก = ลด waste
+// แถว c ขึ้นกับแถว c-1 เท่านั้น → รอบเดียวที่ k สูงสุดได้คำตอบของทุก k ที่น้อยกว่าด้วย
+static void sc_partition(const sc_bucket_t *bk, uint32_t m, const uint64_t *pf, uint32_t k, uint64_t *best,
+                         uint16_t *from)
+{
+    for (uint32_t j = 0; j < m; j++)
+    {
+        best[j] = (uint64_t)bk[j].cls * pf[j + 1];
+        from[j] = 0;
+    }
+    for (uint32_t c = 1; c < k; c++)
+    {
+        uint64_t *cur = best + (size_t)c * m;
+        const uint64_t *prev = best + (size_t)(c - 1) * m;
+        uint16_t *fr = from + (size_t)c * m;
+        for (uint32_t j = 0; j < m; j++)
+        {
+            cur[j] = UINT64_MAX;
+            // class ที่ c ครอบ bucket i+1..j
+            for (uint32_t i = c - 1; i < j; i++)
+            {
+                if (prev[i] == UINT64_MAX)
+                    continue;
+                uint64_t v = prev[i] + (uint64_t)bk[j].cls * (pf[j + 1] - pf[i + 1]);
+                if (v < cur[j])
+                {
+                    cur[j] = v;
+                    fr[j] = (uint16_t)(i + 1);
+                }
+            }
+        }
+    }
+}
+
+static void sc_fit_budget(pool_sc_config_t *out, const pool_sc_target_t *t, pool_sc_report_t *rep)
+{
+    uint64_t mem = 0;
+    for (uint32_t c = 0; c < out->n; c++)
+        mem += (uint64_t)out->count[c] * (out->size[c] + t->overhead[c]);
+    rep->budget_ok = true;
+
+    if (t->budget_bytes && mem > t->budget_bytes)
+    {
+        rep->budget_ok = false;
+        // ลดตามสัดส่วนก่อน แล้วค่อยตัดทีละ block จาก class ที่กิน memory มากสุด
+        for (uint32_t c = 0; c < out->n; c++)
+        {
+            uint64_t v = (uint64_t)out->count[c] * t->budget_bytes / mem;
+            out->count[c] = v ? (uint32_t)v : 1u;
+        }
+        for (;;)
+        {
+            mem = 0;
+            uint32_t worst = UINT32_MAX;
+            uint64_t worst_mem = 0;
+            for (uint32_t c = 0; c < out->n; c++)
+            {
+                uint64_t m = (uint64_t)out->count[c] * (out->size[c] + t->overhead[c]);
+                mem += m;
+                if (out->count[c] > 1 && m > worst_mem)
+                {
+                    worst = c;
+                    worst_mem = m;
+                }
+            }
+            if (mem <= t->budget_bytes || worst == UINT32_MAX)
+                break;
+            out->count[worst]--;
+        }
+    }
+    rep->mem_bytes = mem;
+}
+
+bool pool_sc_generate(const pool_sc_recorder_t *r, const pool_sc_target_t *t, pool_sc_config_t *out,
+                      pool_sc_report_t *rep)
+{
+    // ตาราง DP + รายการ bucket ~15KB → ใช้ heap (เรียกนาน ๆ ครั้งจาก task ที่ stack เล็ก)
+    const size_t kcap = POOL_SC_MAX_CLASSES;
+    size_t bytes = sizeof(sc_bucket_t) * POOL_SC_BUCKETS + sizeof(uint64_t) * (POOL_SC_BUCKETS + 1) +
+                   sizeof(uint64_t) * kcap * POOL_SC_BUCKETS + sizeof(uint16_t) * kcap * POOL_SC_BUCKETS;
+    uint8_t *mem = (uint8_t *)malloc(bytes);
+    if (!mem)
+        return false;
+    uint64_t *best = (uint64_t *)mem;
+    uint64_t *pf = best + kcap * POOL_SC_BUCKETS; // prefix ของ freq
+    sc_bucket_t *bk = (sc_bucket_t *)(pf + POOL_SC_BUCKETS + 1);
+    uint16_t *from = (uint16_t *)(bk + POOL_SC_BUCKETS);
+    uint64_t req_total = 0, freq_total = 0;
+    uint32_t m = 0;
+
+    for (uint32_t b = 0; b < POOL_SC_BUCKETS; b++)
+    {
+        uint32_t f = __atomic_load_n(&r->freq[b], __ATOMIC_RELAXED);
+        uint32_t p = __atomic_load_n(&r->peak[b], __ATOMIC_RELAXED);
+        if (!f && !p)
+            continue;
+        uint32_t lo, hi;
+        pool_sc_bucket_range(b, &lo, &hi);
+        uint32_t cls = round_up(hi ? hi : 1u, POOL_SC_ALIGN);
+        // bucket ที่ปัดแล้วได้ class เดียวกันรวมเป็นรายการเดียว (DP เล็กลง)
+        if (m > 0 && bk[m - 1].cls == cls)
+        {
+            bk[m - 1].freq += f;
+            bk[m - 1].peak += p;
+        }
+        else
+            bk[m++] = (sc_bucket_t){b, cls, f, p};
+        req_total += (uint64_t)f * bucket_mid(b);
+        freq_total += f;
+    }
+    if (m == 0 || freq_total == 0)
+    {
+        free(mem);
+        return false;
+    }
+
+    pf[0] = 0;
+    for (uint32_t j = 0; j < m; j++)
+        pf[j + 1] = pf[j] + bk[j].freq;
+
+    uint32_t kmax = t->max_classes;
+    if (kmax > POOL_SC_MAX_CLASSES)
+        kmax = POOL_SC_MAX_CLASSES;
+    uint32_t kmin = t->min_classes ? t->min_classes : 1u;
+    if (kmin > kmax)
+        kmin = kmax;
+    uint32_t kdp = (kmax < m) ? kmax : m;
+
+    sc_partition(bk, m, pf, kdp, best, from);
+
+    uint32_t k = (kmin < kdp) ? kmin : kdp;
+    for (; k < kdp; k++)
+    {
+        uint64_t reserved = best[(size_t)(k - 1) * m + m - 1];
+        uint64_t waste = reserved - req_total;
+        if (waste * 1000000u <= (uint64_t)t->max_waste_ppm * reserved)
+            break;
+    }
+    // ย้อนหาจุดจบของแต่ละ class
+    uint32_t ends[POOL_SC_MAX_CLASSES];
+    uint32_t j = m - 1;
+    for (uint32_t c = k; c-- > 0;)
+    {
+        ends[c] = j;
+        if (c > 0)
+            j = from[(size_t)c * m + j] - 1u;
+    }
+    uint64_t reserved = best[(size_t)(k - 1) * m + m - 1];
+
+    memset(out, 0, sizeof(*out));
+    uint32_t start = 0;
+    for (uint32_t c = 0; c < k; c++)
+    {
+        uint64_t peak = 0;
+        for (uint32_t i = start; i <= ends[c]; i++)
+            peak += bk[i].peak;
+        start = ends[c] + 1;
+        out->size[c] = bk[ends[c]].cls;
+        uint64_t cnt = (peak * (100u + POOL_SC_HEADROOM_PCT) + 99u) / 100u;
+        out->count[c] = cnt ? (uint32_t)cnt : 1u;
+    }
+    out->n = k;
+    free(mem);
+
+    // histogram แคบกว่าจำนวน class ที่ต้องการ → เติม class ใหญ่ขึ้นทีละเท่าตัวไว้รับขนาดที่ยังไม่เคยเห็น
+    while (out->n < kmin)
+    {
+        uint32_t last = out->size[out->n - 1];
+        uint32_t next = round_up(last * 2u, POOL_SC_ALIGN);
+        out->size[out->n] = (next > POOL_SC_MAX_SIZE) ? round_up(last + POOL_SC_ALIGN, POOL_SC_ALIGN) : next;
+        out->count[out->n] = 1;
+        out->n++;
+    }
+
+    rep->waste_ppm = reserved ? (uint32_t)((reserved - req_total) * 1000000u / reserved) : 0;
+    rep->waste_ok = rep->waste_ppm <= t->max_waste_ppm;
+    uint64_t all = freq_total + __atomic_load_n(&r->overflow, __ATOMIC_RELAXED);
+    rep->coverage_ppm = (uint32_t)(freq_total * 1000000u / all);
+    sc_fit_budget(out, t, rep);
+    return true;
+}
+
+// ============================
+//   NVS blob / header
+// ============================
+static inline void put_u32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+static inline uint32_t get_u32le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t pool_sc_config_encode(void *buf, size_t cap, const pool_sc_config_t *cfg, bool fresh)
+{
+    size_t need = 8 + (size_t)cfg->n * 8 + 4;
+    if (!buf || cap < need || cfg->n == 0 || cfg->n > POOL_SC_MAX_CLASSES)
+        return 0;
+    uint8_t *p = (uint8_t *)buf;
+    put_u32le(p, POOL_SC_CFG_MAGIC);
+    p[4] = POOL_SC_CFG_VERSION;
+    p[5] = (uint8_t)cfg->n;
+    p[6] = fresh ? 1 : 0;
+    p[7] = 0;
+    for (uint32_t c = 0; c < cfg->n; c++)
+    {
+        put_u32le(p + 8 + c * 8, cfg->size[c]);
+        put_u32le(p + 12 + c * 8, cfg->count[c]);
+    }
+    put_u32le(p + need - 4, pool_hist_fnv1a(0, buf, need - 4));
+    return need;
+}
+
+bool pool_sc_config_decode(const void *buf, size_t len, pool_sc_config_t *cfg, bool *fresh)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    if (!buf || len < 12 || get_u32le(p) != POOL_SC_CFG_MAGIC || p[4] != POOL_SC_CFG_VERSION)
+        return false;
+    uint32_t n = p[5];
+    if (n == 0 || n > POOL_SC_MAX_CLASSES || len != 8 + (size_t)n * 8 + 4)
+        return false;
+    if (get_u32le(p + len - 4) != pool_hist_fnv1a(0, buf, len - 4))
+        return false;
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->n = n;
+    for (uint32_t c = 0; c < n; c++)
+    {
+        cfg->size[c] = get_u32le(p + 8 + c * 8);
+        cfg->count[c] = get_u32le(p + 12 + c * 8);
+        if (cfg->size[c] == 0 || cfg->count[c] == 0 || (c > 0 && cfg->size[c] <= cfg->size[c - 1]))
+            return false;
+    }
+    if (fresh)
+        *fresh = p[6] != 0;
+    return true;
+}
+
+size_t pool_sc_emit_header(char *buf, size_t cap, const pool_sc_config_t *cfg, const char *const *names,
+                           const pool_sc_report_t *rep)
+{
+    size_t off = 0;
+    int w = snprintf(buf, cap, "// generated from allocation profile: waste=%lu.%lu%% coverage=%lu.%lu%% mem=%llu\n"
+                               "#pragma once\n",
+                     (unsigned long)(rep->waste_ppm / 10000), (unsigned long)(rep->waste_ppm / 1000 % 10),
+                     (unsigned long)(rep->coverage_ppm / 10000), (unsigned long)(rep->coverage_ppm / 1000 % 10),
+                     (unsigned long long)rep->mem_bytes);
+    if (w < 0 || (size_t)w >= cap)
+        return 0;
+    off = (size_t)w;
+    for (uint32_t c = 0; c < cfg->n; c++)
+    {
+        w = snprintf(buf + off, cap - off, "#define %s_POOL_BLOCK_SIZE %lu\n#define %s_POOL_BLOCK_COUNT %lu\n", names[c],
+                     (unsigned long)cfg->size[c], names[c], (unsigned long)cfg->count[c]);
+        if (w < 0 || (size_t)w >= cap - off)
+            return 0;
+        off += (size_t)w;
+    }
+    return off;
+}
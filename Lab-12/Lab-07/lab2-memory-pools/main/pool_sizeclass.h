@@ -0,0 +1,139 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== Profile-guided size classes =====
+// recorder: histogram ขนาดที่ขอจริง (log-linear แบบเดียวกับ pool_hist แต่ละเอียดกว่า)
+//   ต่อ bucket เก็บ freq (จำนวนครั้งที่ขอ) + live/peak (จำนวนที่ค้างอยู่พร้อมกัน) → ใช้หาจำนวน block
+// generator: เลือก class size ด้วย DP ให้ waste ภายใน block รวมต่ำสุด แล้วแบ่งจำนวน block ตาม peak
+//   ภายใต้ memory budget → เก็บลง NVS (blob) หรือพิมพ์เป็น header ให้ compile เข้า firmware
+
+#ifndef POOL_SC_SUB_BITS
+#define POOL_SC_SUB_BITS 4 // 16 ช่องต่อช่วงกำลังสอง (~6%)
+#endif
+#ifndef POOL_SC_MAX_EXP
+#define POOL_SC_MAX_EXP 12 // ขนาดที่ติดตามได้ถึง 2^13-1 byte, เกินนั้นนับเป็น overflow
+#endif
+#ifndef POOL_SC_MAX_CLASSES
+#define POOL_SC_MAX_CLASSES 8
+#endif
+#ifndef POOL_SC_ALIGN
+#define POOL_SC_ALIGN 8 // class size ปัดขึ้นเป็นพหุคูณของค่านี้
+#endif
+#ifndef POOL_SC_HEADROOM_PCT
+#define POOL_SC_HEADROOM_PCT 25 // เผื่อ block เพิ่มจาก peak ที่เห็น
+#endif
+
+#define POOL_SC_SUB_COUNT (1u << POOL_SC_SUB_BITS)
+#define POOL_SC_BUCKETS ((POOL_SC_MAX_EXP - POOL_SC_SUB_BITS + 2) * POOL_SC_SUB_COUNT)
+#define POOL_SC_MAX_SIZE ((2u << POOL_SC_MAX_EXP) - 1u)
+
+typedef struct
+{
+    uint32_t freq[POOL_SC_BUCKETS];
+    uint32_t live[POOL_SC_BUCKETS];
+    uint32_t peak[POOL_SC_BUCKETS];
+    uint32_t overflow; // ขอเกิน POOL_SC_MAX_SIZE
+} pool_sc_recorder_t;
+
+typedef struct
+{
+    uint32_t n;
+    uint32_t size[POOL_SC_MAX_CLASSES];  // payload ต่อ block (เรียงจากเล็กไปใหญ่)
+    uint32_t count[POOL_SC_MAX_CLASSES]; // จำนวน block
+} pool_sc_config_t;
+
+typedef struct
+{
+    uint64_t budget_bytes;  // memory รวมของทุก pool (payload + overhead ต่อ block)
+    uint32_t overhead[POOL_SC_MAX_CLASSES]; // byte ต่อ block ที่ไม่ใช่ payload ของ class ที่ c (header/metadata)
+    uint32_t max_waste_ppm; // waste ภายในที่ยอมรับ (ส่วนในล้านของ byte ที่จองให้)
+    uint32_t min_classes;
+    uint32_t max_classes;
+} pool_sc_target_t;
+
+typedef struct
+{
+    uint32_t waste_ppm;    // waste ภายในที่คาดการณ์ (ตาม histogram)
+    uint32_t coverage_ppm; // สัดส่วนคำขอที่ class ใหญ่สุดรองรับ (ที่เหลือไป heap)
+    uint64_t mem_bytes;    // memory ที่ config นี้ใช้
+    bool waste_ok;         // ได้ตาม max_waste_ppm หรือไม่
+    bool budget_ok;        // ต้องลดจำนวน block จาก peak เพื่อให้ลง budget หรือไม่ (false = ลดแล้ว)
+} pool_sc_report_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    static inline uint32_t pool_sc_index(uint32_t v)
+    {
+        if (v < POOL_SC_SUB_COUNT)
+            return v;
+        uint32_t e = 31u - (uint32_t)__builtin_clz(v);
+        uint32_t sub = (v >> (e - POOL_SC_SUB_BITS)) - POOL_SC_SUB_COUNT;
+        return (e - POOL_SC_SUB_BITS + 1) * POOL_SC_SUB_COUNT + sub;
+    }
+
+    // hot path: atomic ล้วน ใช้ได้จากหลาย task/core
+    static inline void pool_sc_note_alloc(pool_sc_recorder_t *r, size_t size)
+    {
+        if (size > POOL_SC_MAX_SIZE)
+        {
+            __atomic_add_fetch(&r->overflow, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        uint32_t b = pool_sc_index((uint32_t)size);
+        __atomic_add_fetch(&r->freq[b], 1, __ATOMIC_RELAXED);
+        uint32_t live = __atomic_add_fetch(&r->live[b], 1, __ATOMIC_RELAXED);
+        uint32_t pk = __atomic_load_n(&r->peak[b], __ATOMIC_RELAXED);
+        while (live > pk && !__atomic_compare_exchange_n(&r->peak[b], &pk, live, true, __ATOMIC_RELAXED,
+                                                         __ATOMIC_RELAXED))
+        {
+        }
+    }
+
+    // size = ขนาดเดียวกับตอน note_alloc (0 = ไม่รู้ → ข้าม)
+    static inline void pool_sc_note_free(pool_sc_recorder_t *r, size_t size)
+    {
+        if (size == 0 || size > POOL_SC_MAX_SIZE)
+            return;
+        uint32_t b = pool_sc_index((uint32_t)size);
+        uint32_t cur = __atomic_load_n(&r->live[b], __ATOMIC_RELAXED);
+        while (cur > 0 &&
+               !__atomic_compare_exchange_n(&r->live[b], &cur, cur - 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+    }
+
+    // ช่วงขนาด [lo, hi] ที่ตกใน bucket idx
+    void pool_sc_bucket_range(uint32_t idx, uint32_t *lo, uint32_t *hi);
+
+    void pool_sc_reset(pool_sc_recorder_t *r);
+
+    // waste ภายในที่คาดการณ์ถ้าใช้ class sizes ชุดนี้กับ histogram ปัจจุบัน
+    uint32_t pool_sc_predict_waste_ppm(const pool_sc_recorder_t *r, const uint32_t *sizes, uint32_t n);
+
+    // สร้าง config ใหม่: false ถ้ายังไม่มีข้อมูล
+    bool pool_sc_generate(const pool_sc_recorder_t *r, const pool_sc_target_t *t, pool_sc_config_t *out,
+                          pool_sc_report_t *rep);
+
+    // ===== NVS blob (little-endian) =====
+    // u32 magic 'PSC1' | u8 version | u8 n | u8 fresh | u8 reserved | n × (u32 size, u32 count) | u32 fnv1a
+    // fresh = 1 → บูตถัดไปใช้ count จาก blob นี้ (แทน count ที่ persist ไว้ของ config เก่า)
+#define POOL_SC_CFG_MAGIC 0x31435350u // "PSC1"
+#define POOL_SC_CFG_VERSION 1
+#define POOL_SC_CFG_MAX_SIZE (8 + POOL_SC_MAX_CLASSES * 8 + 4)
+
+    size_t pool_sc_config_encode(void *buf, size_t cap, const pool_sc_config_t *cfg, bool fresh);
+    bool pool_sc_config_decode(const void *buf, size_t len, pool_sc_config_t *cfg, bool *fresh);
+
+    // header สำหรับ compile เข้า firmware: "#define <NAME>_POOL_BLOCK_SIZE ..." ต่อ class
+    // names[i] = prefix ของ class ที่ i (เช่น "SMALL"), คืนจำนวน byte ที่เขียน (0 = buf เล็กไป)
+    size_t pool_sc_emit_header(char *buf, size_t cap, const pool_sc_config_t *cfg, const char *const *names,
+                               const pool_sc_report_t *rep);
+
+#ifdef __cplusplus
+}
+#endif
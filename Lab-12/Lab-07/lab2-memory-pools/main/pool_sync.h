@@ -12,16 +12,30 @@
 #define SYNC_TIMEOUT_MS 200 // ค่า default ถ้า caller ไม่กำหนด
 #endif
 
+#ifndef POOL_SEQ_MAX_TRIES
+#define POOL_SEQ_MAX_TRIES 64 // reader ลองอ่านซ้ำได้กี่รอบก่อนยอมแพ้
+#endif
+
+// Versioned snapshot (seqlock แบบหลาย writer):
+// writer เพิ่ม writers ตอนเริ่ม, ตอนจบเพิ่ม version ก่อนแล้วค่อยลด writers
+// → writer ไม่เคยรอ reader, reader อ่านซ้ำถ้ามี writer ค้างหรือ version เปลี่ยน
+// (writer ใน lock-free mode ทำงานพร้อมกันได้หลายตัว จึงใช้ตัวนับแทนบิตคี่/คู่แบบ seqlock ปกติ)
+// ทั้งสองตัวเป็น 32-bit: version ไม่วนกลับมาค่าเดิมระหว่างที่ reader หนึ่งรอบยัง copy อยู่
+typedef struct
+{
+    volatile uint32_t version; // +1 ทุกครั้งที่ writer ทำงานจบ
+    volatile uint32_t writers; // จำนวน writer ที่กำลังแก้อยู่
+} pool_seq_t;
+
 // กลยุทธ์ซิงก์:
 // - ใช้ mutex (priority-inheritance) สำหรับ write (ปรับโครงสร้าง/แก้ freelist)
-// - ใช้ counting semaphore สำหรับ read (อ่านสถิติได้พร้อมกันหลาย task)
+// - อ่านสถิติผ่าน stats_seq (ไม่ถือ lock ใด ๆ → ไม่ถ่วง allocator)
 // - ใช้ spinlock แบบ portMUX_TYPE ป้องกัน race สั้น ๆ ที่ต้อง atomic ใน ISR/critical
 typedef struct
 {
-    SemaphoreHandle_t rw_mutex;    // exclusive writers
-    SemaphoreHandle_t readers_sem; // permits for readers (MAX_READERS)
-    volatile int readers;          // readers in critical
-    portMUX_TYPE spin;             // short critical sections / ISR
+    SemaphoreHandle_t rw_mutex; // exclusive writers
+    pool_seq_t stats_seq;       // version ของสถิติ (ดู pool_seq_*)
+    portMUX_TYPE spin;          // short critical sections / ISR
 } pool_sync_t;
 
 #ifdef __cplusplus
@@ -37,9 +51,35 @@ extern "C"
     bool pool_sync_write_lock(pool_sync_t *s, TickType_t to_ticks);
     void pool_sync_write_unlock(pool_sync_t *s);
 
-    // Read (stats) lock (shared)
-    bool pool_sync_stats_lock(pool_sync_t *s, TickType_t to_ticks);
-    void pool_sync_stats_unlock(pool_sync_t *s);
+    // ===== Versioned snapshot =====
+    // writer: ครอบการแก้หลาย field ที่ต้องสอดคล้องกัน (ไม่ block, ใช้ได้ทั้งถือ/ไม่ถือ write lock)
+    static inline void pool_seq_write_begin(pool_seq_t *q)
+    {
+        __atomic_add_fetch(&q->writers, 1u, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+    static inline void pool_seq_write_end(pool_seq_t *q)
+    {
+        // version++ ต้องเห็นก่อน writers-- → reader ที่เห็น writers == 0 จะเห็น version ใหม่เสมอ
+        __atomic_add_fetch(&q->version, 1u, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&q->writers, 1u, __ATOMIC_RELEASE);
+    }
+
+    // reader: v = read_begin → copy → ถ้า read_retry(v) ให้วนใหม่
+    // writer ที่ค้างอยู่ตอน read_begin จะยังค้างหรือไม่ก็เพิ่ม version ไปแล้วตอน read_retry
+    static inline uint32_t pool_seq_read_begin(const pool_seq_t *q)
+    {
+        return __atomic_load_n(&q->version, __ATOMIC_ACQUIRE);
+    }
+    static inline bool pool_seq_read_retry(const pool_seq_t *q, uint32_t v)
+    {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&q->writers, __ATOMIC_ACQUIRE) != 0 || __atomic_load_n(&q->version, __ATOMIC_RELAXED) != v;
+    }
+
+    // reader ชน writer: รอบแรก ๆ yield, หลังจากนั้นหลับ 1 tick ให้ writer ที่ priority ต่ำกว่าได้วิ่งจบ
+    // คืน false เมื่อครบ POOL_SEQ_MAX_TRIES (ผู้เรียกควรใช้ค่าที่อ่านได้ล่าสุดแบบ best-effort)
+    bool pool_seq_backoff(int tries);
 
     // Deadlock symptom checker (best-effort)
     static inline bool pool_sync_check_deadlock(pool_sync_t *s)
@@ -0,0 +1,73 @@
+#include <string.h>
+#include "pool_telemetry.h"
+
+#define RING_MASK (POOL_TEL_RING_SIZE - 1)
+_Static_assert((POOL_TEL_RING_SIZE & RING_MASK) == 0, "POOL_TEL_RING_SIZE must be a power of two");
+
+uint32_t g_pool_tel_counters[POOL_TEL_MAX_CHANNELS][POOL_TEL_EVENT_COUNT];
+
+static pool_tel_record_t s_ring[POOL_TEL_RING_SIZE];
+static uint32_t s_head; // ลำดับ record ถัดไปที่จะเขียน
+static uint32_t s_tail; // ลำดับ record ถัดไปที่ consumer จะอ่าน
+
+void pool_tel_record(uint32_t channel, pool_tel_event_t ev, const void *addr, uint32_t arg)
+{
+    pool_tel_count(channel, ev);
+
+    uint32_t n = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    pool_tel_record_t *r = &s_ring[n & RING_MASK];
+
+    // seq = 0 ระหว่างเขียน → consumer จะรอรอบหน้า
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->type = (uint16_t)ev;
+    r->channel = (uint16_t)channel;
+    r->arg = arg;
+    r->addr = addr;
+    __atomic_store_n(&r->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+size_t pool_tel_drain(pool_tel_record_t *out, size_t max, uint32_t *dropped)
+{
+    uint32_t lost = 0;
+    size_t got = 0;
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+
+    // ตามไม่ทันเกินขนาด ring → ข้ามไปส่วนที่ยังอยู่
+    if (head - s_tail > POOL_TEL_RING_SIZE)
+    {
+        lost += head - s_tail - POOL_TEL_RING_SIZE;
+        s_tail = head - POOL_TEL_RING_SIZE;
+    }
+
+    while (got < max && s_tail != head)
+    {
+        pool_tel_record_t *r = &s_ring[s_tail & RING_MASK];
+        uint32_t s1 = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        if (s1 == 0 || (int32_t)(s1 - (s_tail + 1)) < 0)
+            break; // producer ยังเขียนไม่เสร็จ
+
+        pool_tel_record_t tmp;
+        tmp.type = r->type;
+        tmp.channel = r->channel;
+        tmp.arg = r->arg;
+        tmp.addr = r->addr;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint32_t s2 = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+
+        if (s1 != s_tail + 1 || s2 != s1)
+        {
+            // ถูกรอบใหม่เขียนทับ
+            lost++;
+            s_tail++;
+            continue;
+        }
+        tmp.seq = s1;
+        out[got++] = tmp;
+        s_tail++;
+    }
+
+    if (dropped)
+        *dropped = lost;
+    return got;
+}
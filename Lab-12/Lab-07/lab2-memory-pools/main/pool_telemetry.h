@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== Deferred telemetry สำหรับ pool =====
+// hot path (alloc/free) แค่เพิ่ม counter หรือเขียนลง ring แบบ lock-free
+// งานช้า (gpio, ESP_LOG) ย้ายไปทำใน indicator task ความสำคัญต่ำตามรอบเวลา
+
+#ifndef POOL_TEL_MAX_CHANNELS
+#define POOL_TEL_MAX_CHANNELS 8 // channel = pool_id (0 = อื่น ๆ)
+#endif
+
+#ifndef POOL_TEL_RING_SIZE
+#define POOL_TEL_RING_SIZE 32 // ต้องเป็นกำลังสอง
+#endif
+
+typedef enum
+{
+    POOL_TEL_ALLOC = 0,     // counter เท่านั้น
+    POOL_TEL_FREE,          // counter เท่านั้น
+    POOL_TEL_EXHAUSTED,     // counter + ring
+    POOL_TEL_CORRUPT,       // counter + ring
+    POOL_TEL_INVALID_FREE,  // counter + ring
+    POOL_TEL_EVENT_COUNT
+} pool_tel_event_t;
+
+typedef struct
+{
+    volatile uint32_t seq; // 0 = กำลังเขียน, n+1 = record ลำดับที่ n
+    uint16_t type;
+    uint16_t channel;
+    uint32_t arg;
+    const void *addr;
+} pool_tel_record_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    extern uint32_t g_pool_tel_counters[POOL_TEL_MAX_CHANNELS][POOL_TEL_EVENT_COUNT];
+
+    static inline uint32_t pool_tel_channel(uint32_t pool_id)
+    {
+        return (pool_id < POOL_TEL_MAX_CHANNELS) ? pool_id : 0;
+    }
+
+    // นับอย่างเดียว: atomic add ครั้งเดียว ใช้ได้ทั้ง task/ISR
+    static inline void pool_tel_count(uint32_t channel, pool_tel_event_t ev)
+    {
+        __atomic_add_fetch(&g_pool_tel_counters[channel][ev], 1, __ATOMIC_RELAXED);
+    }
+
+    static inline uint32_t pool_tel_read(uint32_t channel, pool_tel_event_t ev)
+    {
+        return __atomic_load_n(&g_pool_tel_counters[channel][ev], __ATOMIC_RELAXED);
+    }
+
+    // นับ + บันทึกรายละเอียดลง ring (multi-producer, เขียนทับของเก่าถ้า consumer ตามไม่ทัน)
+    void pool_tel_record(uint32_t channel, pool_tel_event_t ev, const void *addr, uint32_t arg);
+
+    // consumer เดียว (indicator task): ดึง record ที่ยังไม่ได้อ่าน
+    // *dropped = จำนวน record ที่ถูกเขียนทับก่อนอ่านทัน
+    size_t pool_tel_drain(pool_tel_record_t *out, size_t max, uint32_t *dropped);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,6 +10,7 @@
 #include "esp_system.h"
 #include "esp_random.h"
 #include "driver/gpio.h"
+#include "tlsf.h" // components/tlsf
 
 static const char *TAG = "LAB6_MEMSYS";
 
@@ -28,6 +29,8 @@ static const char *TAG = "LAB6_MEMSYS";
 #define STACK_MONITOR 3072
 #define STACK_MEMUSAGE 3072
 
+#define TPL_TLSF_BYTES (16 * 1024) // region ของ fallback (0 = ใช้ malloc ตรง ๆ)
+
 /* =========================================================
  * GLOBAL STATS
  * =======================================================*/
@@ -98,6 +101,7 @@ typedef struct
 static tplsys_t tpl = {
     .sizes = {16, 32, 64, 128, 256, 512, 1024, 2048},
     .counts = {64, 32, 16, 16, 8, 8, 4, 2}};
+static tlsf_t *tpl_tlsf; // fallback เวลาคงที่เมื่อ pool เต็ม/ขนาดเกิน
 
 void template_init(void)
 {
@@ -109,6 +113,11 @@ void template_init(void)
             tpl.pools[i].blocks[j] = malloc(tpl.sizes[i]);
         ESP_LOGI(TAG, "TPL[%d]: %d×%dB", i, tpl.counts[i], tpl.sizes[i]);
     }
+#if TPL_TLSF_BYTES > 0
+    void *mem = malloc(TPL_TLSF_BYTES);
+    tpl_tlsf = mem ? tlsf_create(mem, TPL_TLSF_BYTES) : NULL;
+    ESP_LOGI(TAG, "TPL fallback: TLSF %dB %s", TPL_TLSF_BYTES, tpl_tlsf ? "ready" : "unavailable");
+#endif
 }
 
 void *template_malloc(size_t s)
@@ -121,7 +130,8 @@ void *template_malloc(size_t s)
                     tpl.pools[i].used[j] = true;
                     return tpl.pools[i].blocks[j];
                 }
-    return malloc(s);
+    void *p = tpl_tlsf ? tlsf_malloc(tpl_tlsf, s) : NULL;
+    return p ? p : malloc(s);
 }
 void template_free(void *p)
 {
@@ -132,7 +142,10 @@ void template_free(void *p)
                 tpl.pools[i].used[j] = false;
                 return;
             }
-    free(p);
+    if (tlsf_owns(tpl_tlsf, p))
+        tlsf_free(tpl_tlsf, p);
+    else
+        free(p);
 }
 
 /* =========================================================